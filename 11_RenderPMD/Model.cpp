@@ -19,15 +19,11 @@ using namespace glm;
 
 
 
-inline Model::PMDVertex convertTo(const loader::PMDVertex& v)
-{
-  return Model::PMDVertex{
-    v.getPosition(), v.getNormal(), v.getUV(),
-    uvec2(v.getBoneIndex(0), v.getBoneIndex(1)),
-    vec2(v.getBoneWeight(0), v.getBoneWeight(1)),
-    v.getEdgeFlag(),
-  };
-}
+// [_[WJς݂̒_̂܂܎g, CAEgvĂKv.
+static_assert(sizeof(Model::PMDVertex) == sizeof(loader::PMDVertex), "PMDVertex layout mismatch.");
+static_assert(offsetof(Model::PMDVertex, boneIndices) == 32, "PMDVertex layout mismatch.");
+static_assert(offsetof(Model::PMDVertex, boneWeights) == 40, "PMDVertex layout mismatch.");
+static_assert(offsetof(Model::PMDVertex, edgeFlag) == 48, "PMDVertex layout mismatch.");
 
 void Material::Update(VulkanAppBase* app)
 {
@@ -63,23 +59,14 @@ void Bone::UpdateMatrices()
 
 void Model::Load(const char* filename, VulkanAppBase* app)
 {
-  ifstream infile(filename, std::ios::binary);
-  loader::PMDFile loader(infile);
+  auto mappedFile = std::make_shared<loader::MappedFile>(filename);
+  loader::PMDFile loader(mappedFile);
   auto device = app->GetDevice();
 
   auto vertexCount = loader.getVertexCount();
   auto indexCount = loader.getIndexCount();
   m_hostMemVertices.resize(vertexCount);
-  for (uint32_t i = 0; i < vertexCount; ++i)
-  {
-    m_hostMemVertices[i] = convertTo(loader.getVertex(i));
-  }
-  std::vector<uint32_t> modelIndices(indexCount);
-  for (uint32_t i = 0; i < indexCount; ++i)
-  {
-    auto& v = modelIndices[i];
-    v = loader.getIndices()[i];
-  }
+  memcpy(m_hostMemVertices.data(), loader.getVertex(), vertexCount * sizeof(PMDVertex));
 
   uint32_t bufferSizeIB = indexCount * sizeof(uint32_t);
   VkMemoryPropertyFlags stageMemProps = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
@@ -90,7 +77,7 @@ void Model::Load(const char* filename, VulkanAppBase* app)
   m_indexBuffer = app->CreateBuffer(bufferSizeIB,
     VK_BUFFER_USAGE_INDEX_BUFFER_BIT  | VK_BUFFER_USAGE_TRANSFER_DST_BIT, deviceLocal );
 
-  app->WriteToHostVisibleMemory(stagingIB.memory, bufferSizeIB, modelIndices.data());
+  app->WriteToHostVisibleMemory(stagingIB.memory, bufferSizeIB, loader.getIndices());
 
   // Stageing => DeviceLocal ֓].
   auto command = app->CreateCommandBuffer();
@@ -120,7 +107,7 @@ void Model::Load(const char* filename, VulkanAppBase* app)
     materialParams.useTexture.x = 0;
     materialParams.edgeFlag.x = src.getEdgeFlag();
 
-    auto textureFileName = src.getTexture();
+    std::string textureFileName(src.getTexture());
     auto hasSphereMap = textureFileName.find('*');
     if (hasSphereMap != std::string::npos)
     {
@@ -179,7 +166,7 @@ void Model::Load(const char* filename, VulkanAppBase* app)
     const auto& boneSrc = loader.getBone(i);
     auto index = boneSrc.getParent();
 
-    auto bone = new Bone(boneSrc.getName());
+    auto bone = new Bone(std::string(boneSrc.getName()));
     auto translation = boneSrc.getPosition();
     if (index != 0xFFFFu)
     {
@@ -1,5 +1,6 @@
 #include "AnimationApp.h"
 #include "VulkanBookUtil.h"
+#include "SkinningKernel.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -10,6 +11,11 @@
 using namespace std;
 using namespace glm;
 
+// Aj[V͕\̃tbV[gƂ͓Ɨ, ŒԊũeBbNŐi߂.
+static const double AnimationFrameRate = 30.0;      // VMD ̃t[[g.
+static const double SimulationTickSeconds = 1.0 / 60.0;
+static const double MaxElapsedSeconds = 0.25;       // ~܂ɑʂ̃eBbNȂ߂̏.
+
 inline std::array<VkAttachmentDescription, 2> GetDefaultRenderPassAttachments(
   VkFormat color, VkFormat depth
 )
@@ -34,6 +40,23 @@ RenderPMDApp::RenderPMDApp()
   m_drawOutline = true;
   m_frameCount = 0;
   m_isAnimeStart = false;
+  m_animeTime = 0.0;
+  m_tickAccumulator = 0.0;
+  m_evaluatedTime = -1.0;
+  m_lastRenderTime = chrono::steady_clock::now();
+  m_useBakedAnimation = false;
+  m_useCompressedAnimation = false;
+  m_useAnimationLod = false;
+  m_animationLodLevel = 0;
+  m_poseCache = std::make_shared<PoseCache>();
+  m_usePoseCache = false;
+  m_usePhysics = true;
+  m_threadPool.reset(new ThreadPool());
+}
+
+void RenderPMDApp::SetSkinningMode(Model::SkinningMode mode)
+{
+  m_model.SetSkinningMode(mode, m_threadPool.get());
 }
 
 void RenderPMDApp::Prepare()
@@ -67,7 +90,7 @@ void RenderPMDApp::Prepare()
   ImGui_ImplVulkan_Init(&info, GetRenderPass("default"));
 
   const char filePath[] = "~N.pmd"; // ̃f[^͗pӂĂB
-  m_model.Load(filePath, this);
+  m_model.Load(filePath, this, *m_threadPool);
   m_model.SetShadowMap(m_shadowColor);
   m_model.Prepare(this);
 
@@ -141,22 +164,54 @@ void RenderPMDApp::Render()
   m_sceneParameters.lightViewProjBias = matBias * m_sceneParameters.lightViewProj;
 
   // Aj[VKp.
-  if (!m_isAnimeStart)
+  // Đ͌oߎԂeBbNɕčĐʒui߂. p̌vZ͍ĐʒuςƂ̂ݍs,
+  // eBbN̕`ł͑O̎p̂܂܎g.
+  auto now = chrono::steady_clock::now();
+  auto elapsed = std::min(chrono::duration<double>(now - m_lastRenderTime).count(), MaxElapsedSeconds);
+  m_lastRenderTime = now;
+  if (m_isAnimeStart)
   {
+    m_tickAccumulator += elapsed;
+    while (m_tickAccumulator >= SimulationTickSeconds)
+    {
+      m_tickAccumulator -= SimulationTickSeconds;
+      m_animeTime += AnimationFrameRate * SimulationTickSeconds;
+    }
+    m_frameCount = int(m_animeTime);
+  }
+  else
+  {
+    auto frameCount = m_frameCount;
     if (ImGui::GetIO().KeysDown[ImGui::GetKeyIndex(ImGuiKey_LeftArrow)])
     {
-      m_frameCount--;
+      frameCount--;
     }
     if (ImGui::GetIO().KeysDown[ImGui::GetKeyIndex(ImGuiKey_RightArrow)])
     {
-      m_frameCount++;
+      frameCount++;
     }
+    SetAnimationFrame(frameCount);
+  }
+  // LOD ̒iKςꍇ, ~łpvZ.
+  auto lodLevel = 0u;
+  if (m_useAnimationLod)
+  {
+    auto distance = length(m_model.GetBoundingCenter() - m_camera.GetPosition());
+    auto screenSize = AnimationLodPolicy::ComputeScreenSize(m_model.GetBoundingRadius(), distance, m_sceneParameters.proj[1][1]);
+    lodLevel = m_animationLod.Select(distance, screenSize, m_animationLodLevel);
+  }
+  if (lodLevel != m_animationLodLevel)
+  {
+    m_animationLodLevel = lodLevel;
+    m_animator.SetLod(m_animationLod.GetLevel(lodLevel), float(AnimationFrameRate * SimulationTickSeconds));
+    m_evaluatedTime = -1.0;
   }
-  if (m_frameCount < 0)
+  if (m_animeTime != m_evaluatedTime)
   {
-    m_frameCount = 0;
+    m_animator.UpdateAnimation(float(m_animeTime));
+    m_model.UpdateHostData();
+    m_evaluatedTime = m_animeTime;
   }
-  m_animator.UpdateAnimation(m_frameCount);
 
   m_model.SetSceneParameter(m_sceneParameters);
   m_model.Update(imageIndex, this);
@@ -172,6 +227,9 @@ void RenderPMDApp::Render()
   };
   vkBeginCommandBuffer(command, &commandBI);
 
+  // SĂ̕`pXŎg_, `̑O 1 xXLjO.
+  m_model.RecordSkinning(command, imageIndex, this);
+
   auto renderPass = GetRenderPass("default");
   VkRenderPassBeginInfo rpBI{
     VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
@@ -240,11 +298,17 @@ void RenderPMDApp::Render()
   vkQueueSubmit(m_deviceQueue, 1, &submitInfo, fence);
 
   m_swapchain->QueuePresent(m_deviceQueue, imageIndex, m_renderCompletedSem);
+}
 
-  if (m_isAnimeStart)
+void RenderPMDApp::SetAnimationFrame(int frame)
+{
+  frame = std::max(frame, 0);
+  if (frame != m_frameCount || m_isAnimeStart)
   {
-    m_frameCount++;
+    m_animeTime = frame;
+    m_tickAccumulator = 0.0;
   }
+  m_frameCount = frame;
 }
 
 bool RenderPMDApp::OnSizeChanged(uint32_t width, uint32_t height)
@@ -411,7 +475,31 @@ void RenderPMDApp::PrepareLayout()
   ThrowIfFailed(result, "vkCreatePipelineLayout Failed.");
   RegisterLayout("model", pipelineLayout);
 
+  // XLjǑvZVF[_[p. {[s, ͒_, XLjOςݒ_, \[ẗړʂƏd݂, _̃vbV萔.
+  array<VkDescriptorSetLayoutBinding, 6> skinningBindings{
+    {
+      { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // Bone
+      { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // InputVertices
+      { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // OutputVertices
+      { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // MorphRowOffsets
+      { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // MorphDeltas
+      { 5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}, // MorphWeights
+    }
+  };
+  descriptorSetLayoutCI.bindingCount = uint32_t(skinningBindings.size());
+  descriptorSetLayoutCI.pBindings = skinningBindings.data();
+  result = vkCreateDescriptorSetLayout(m_device, &descriptorSetLayoutCI, nullptr, &descriptorSetLayout);
+  ThrowIfFailed(result, "vkCreateDescriptorSetLayout Failed.");
+  RegisterLayout("modelSkinning", descriptorSetLayout);
 
+  VkPushConstantRange skinningPushConstant{
+    VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t)
+  };
+  pipelineLayoutCI.pushConstantRangeCount = 1;
+  pipelineLayoutCI.pPushConstantRanges = &skinningPushConstant;
+  result = vkCreatePipelineLayout(m_device, &pipelineLayoutCI, nullptr, &pipelineLayout);
+  ThrowIfFailed(result, "vkCreatePipelineLayout Failed.");
+  RegisterLayout("modelSkinning", pipelineLayout);
 }
 
 void RenderPMDApp::PrepareCommandBuffersPrimary()
@@ -475,11 +563,61 @@ void RenderPMDApp::RenderImGui(VkCommandBuffer command)
     ImGui::Checkbox("Outline", &m_drawOutline);
     ImGui::ColorEdit3("Outline", (float*)&m_sceneParameters.outlineColor);
     ImGui::Spacing();
-    ImGui::InputInt("Frame: ", &m_frameCount);
+    auto frameCount = m_frameCount;
+    if (ImGui::InputInt("Frame: ", &frameCount))
+    {
+      SetAnimationFrame(frameCount);
+    }
     if (ImGui::Checkbox("EnableAnimation", &m_isAnimeStart))
     {
-      m_frameCount = m_isAnimeStart ? 0 : m_frameCount;
+      SetAnimationFrame(m_isAnimeStart ? 0 : m_frameCount);
+    }
+    if (ImGui::Checkbox("BakedAnimation", &m_useBakedAnimation))
+    {
+      if (m_useBakedAnimation)
+      {
+        m_animator.Bake();
+      }
+      else
+      {
+        m_animator.SetBakedClip(nullptr);
+      }
+    }
+    if (ImGui::Checkbox("CompressedAnimation", &m_useCompressedAnimation))
+    {
+      if (m_useCompressedAnimation)
+      {
+        m_animator.Compress(ClipCompressionSettings());
+      }
+      else
+      {
+        m_animator.SetCompressedClip(nullptr);
+      }
+    }
+    ImGui::Checkbox("AnimationLOD", &m_useAnimationLod);
+    ImGui::Text("AnimationLOD level: %u", m_animationLodLevel);
+    if (ImGui::Checkbox("PoseCache", &m_usePoseCache))
+    {
+      m_poseCache->Clear();
+      m_animator.SetPoseCache(m_usePoseCache ? m_poseCache : nullptr);
+    }
+    ImGui::Text("PoseCache hit/miss: %llu / %llu",
+      (unsigned long long)m_poseCache->GetHitCount(), (unsigned long long)m_poseCache->GetMissCount());
+    if (m_model.GetSkinningMode() == Model::SKINNING_CPU)
+    {
+      ImGui::Text("Skinning: CPU (%s, %u threads)", GetSkinningKernelName(), m_threadPool->GetThreadCount() + 1);
+    }
+    else
+    {
+      ImGui::Text("Skinning: GPU");
+    }
+    if (ImGui::Checkbox("Physics", &m_usePhysics))
+    {
+      m_animator.EnablePhysics(m_usePhysics);
     }
+    const auto& solver = m_model.GetRigidBodySolver();
+    ImGui::Text("Physics bodies/joints/contacts: %u / %u / %u",
+      solver.GetBodyCount(), solver.GetJointCount(), solver.GetContactCount());
     ImGui::End();
   }
 
@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 #include "VulkanAppBase.h"
 
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -9,10 +9,12 @@
 #include <functional>
 #include <algorithm>
 #include <memory>
+#include <chrono>
 
 #include "Camera.h"
 #include "Model.h"
 #include "Animator.h"
+#include "ThreadPool.h"
 
 class RenderPMDApp : public VulkanAppBase
 {
@@ -28,6 +30,9 @@ public:
   virtual void OnMouseButtonUp(int button);
   virtual void OnMouseMove(int dx, int dy);
 
+  // Initialize より前に呼ぶ. CPU の場合はスキニング用のスレッドを用意する.
+  void SetSkinningMode(Model::SkinningMode mode);
+
 private:
   void CreateRenderPass();
   void PrepareDepthbuffer();
@@ -38,6 +43,7 @@ private:
 
   void RenderShadowPass(VkCommandBuffer command, uint32_t imageIndex);
   void RenderImGui(VkCommandBuffer command);
+  void SetAnimationFrame(int frame);
 private:
   ImageObject m_depthBuffer;
   std::vector<VkFramebuffer> m_framebuffers;
@@ -65,5 +71,28 @@ private:
 
   int m_frameCount;
   bool m_isAnimeStart;
+
+  // 再生位置(30fps 単位のフレーム)と, 固定間隔のティックに分けるための経過時間の蓄積.
+  double m_animeTime;
+  double m_tickAccumulator;
+  double m_evaluatedTime;   // 最後に姿勢を計算した再生位置.
+  std::chrono::steady_clock::time_point m_lastRenderTime;
+  bool m_useBakedAnimation;
+  bool m_useCompressedAnimation;
+
+  // カメラからの距離と画面上の大きさで選ぶアニメーションの LOD.
+  AnimationLodPolicy m_animationLod;
+  bool m_useAnimationLod;
+  uint32_t m_animationLodLevel;
+
+  // キーフレームから評価した姿勢のキャッシュ. 再生位置を行き来する場合に再評価を省く.
+  std::shared_ptr<PoseCache> m_poseCache;
+  bool m_usePoseCache;
+
+  // 剛体とジョイントによる揺れものの物理演算.
+  bool m_usePhysics;
+
+  // モデルの読み込みと, CPU でスキニングする場合に使うスレッド.
+  std::unique_ptr<ThreadPool> m_threadPool;
 };
 
@@ -0,0 +1,100 @@
+﻿#include "AnimationLod.h"
+#include "PoseKernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+AnimationLodPolicy::AnimationLodPolicy() : m_hysteresis(0.1f)
+{
+  m_levels.resize(4);
+  m_levels[0].minScreenSize = 0.25f;
+  m_levels[1].minScreenSize = 0.1f;
+  m_levels[1].tickInterval = 2;
+  m_levels[2].minScreenSize = 0.04f;
+  m_levels[2].tickInterval = 4;
+  m_levels[2].updateIK = false;
+  m_levels[2].updatePhysics = false;
+  m_levels[3].tickInterval = 8;
+  m_levels[3].updateIK = false;
+  m_levels[3].updateMorphs = false;
+  m_levels[3].updatePhysics = false;
+}
+
+AnimationLodPolicy::AnimationLodPolicy(std::vector<AnimationLodLevel> levels, float hysteresis)
+  : m_levels(std::move(levels)), m_hysteresis(std::max(hysteresis, 0.0f))
+{
+  if (m_levels.empty())
+  {
+    throw std::runtime_error("AnimationLodPolicy requires at least one level.");
+  }
+}
+
+float AnimationLodPolicy::ComputeScreenSize(float radius, float distance, float projScaleY)
+{
+  if (distance <= radius)
+  {
+    return std::numeric_limits<float>::max();
+  }
+  return radius * projScaleY / distance;
+}
+
+uint32_t AnimationLodPolicy::Select(float distance, float screenSize, uint32_t currentLevel) const
+{
+  const auto lastLevel = GetLevelCount() - 1;
+  for (uint32_t i = 0; i < lastLevel; ++i)
+  {
+    // 現在より詳細な段階は厳しく, 現在の段階は緩く判定する.
+    auto scale = i < currentLevel ? 1.0f + m_hysteresis : (i == currentLevel ? 1.0f - m_hysteresis : 1.0f);
+    const auto& level = m_levels[i];
+    if (screenSize >= level.minScreenSize * scale && distance * scale <= level.maxDistance)
+    {
+      return i;
+    }
+  }
+  return lastLevel;
+}
+
+const AnimationPose& AnimationLodSampler::Sample(float frame, float interval, float phase, const Sampler& sampler)
+{
+  if (interval <= 0.0f)
+  {
+    m_hasKeys = false;
+    sampler(frame, m_pose);
+    return m_pose;
+  }
+  if (interval != m_interval || phase != m_phase)
+  {
+    m_interval = interval;
+    m_phase = phase;
+    m_hasKeys = false;
+  }
+
+  auto position = double(frame) / interval + phase;
+  auto segment = int64_t(std::floor(position));
+  auto keyFrame = [&](int64_t n) { return float((double(n) - phase) * interval); };
+  if (!m_hasKeys || segment != m_segment)
+  {
+    // 次の区間に進んだ場合は, 前の区間の終点をそのまま始点にする.
+    if (m_hasKeys && segment == m_segment + 1)
+    {
+      std::swap(m_keys[0], m_keys[1]);
+    }
+    else
+    {
+      sampler(keyFrame(segment), m_keys[0]);
+    }
+    sampler(keyFrame(segment + 1), m_keys[1]);
+    m_segment = segment;
+    m_hasKeys = true;
+  }
+
+  if (m_pose.GetBoneCount() != m_keys[0].GetBoneCount())
+  {
+    m_pose.Resize(m_keys[0].GetBoneCount());
+  }
+  auto rate = float(position - double(segment));
+  BlendPoses(m_keys[0].GetData(), m_keys[1].GetData(), nullptr, rate, true, m_pose.GetStride(), m_pose.GetData());
+  return m_pose;
+}
@@ -0,0 +1,77 @@
+﻿#pragma once
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "AnimationPose.h"
+
+// アニメーションの詳細度(LOD)の 1 段階.
+struct AnimationLodLevel
+{
+  // この段階を使う画面上の大きさ(AnimationLodPolicy::ComputeScreenSize)の下限と, カメラからの距離の上限.
+  float minScreenSize = 0.0f;
+  float maxDistance = std::numeric_limits<float>::max();
+  // ノードアニメーションを評価するシミュレーションのティック間隔. 間のティックでは前後の姿勢を補間する.
+  uint32_t tickInterval = 1;
+  // false の場合は表情モーフの重み, IK を更新しない(直前の値のまま).
+  bool updateMorphs = true;
+  bool updateIK = true;
+  // false の場合は物理演算を進めず, 物理演算の剛体のボーンはアニメーションの姿勢のままとする.
+  bool updatePhysics = true;
+};
+
+// カメラからの距離と画面上の大きさからアニメーションの LOD を選ぶ. 描画には依存しない.
+// 段階は詳細なものから順に並べ, 条件を満たす最初の段階を選ぶ. 最後の段階は条件によらず選ばれる.
+// 境界付近で段階が切り替わり続けないよう, 現在の段階の条件は hysteresis の割合だけ緩め,
+// 現在より詳細な段階の条件は同じ割合だけ厳しくして判定する.
+class AnimationLodPolicy
+{
+public:
+  // 既定の段階. 毎ティック, 2 ティックごと, 4 ティックごと(IK, 物理演算なし),
+  // 8 ティックごと(IK, 表情モーフ, 物理演算なし).
+  AnimationLodPolicy();
+  // levels が空の場合は例外を投げる.
+  AnimationLodPolicy(std::vector<AnimationLodLevel> levels, float hysteresis);
+
+  // 半径 radius の球が distance の距離にあるときの, 画面の高さに対する直径の比.
+  // projScaleY は射影行列の [1][1] (1 / tan(縦の画角 / 2)).
+  static float ComputeScreenSize(float radius, float distance, float projScaleY);
+
+  // currentLevel は前回選んだ段階.
+  uint32_t Select(float distance, float screenSize, uint32_t currentLevel) const;
+
+  uint32_t GetLevelCount() const { return uint32_t(m_levels.size()); }
+  const AnimationLodLevel& GetLevel(uint32_t level) const { return m_levels[level]; }
+  float GetHysteresis() const { return m_hysteresis; }
+private:
+  std::vector<AnimationLodLevel> m_levels;
+  float m_hysteresis;
+};
+
+// ノードアニメーションを一定間隔の時刻でのみ評価し, 間の時刻では前後の姿勢を補間する.
+// 評価した姿勢は次の区間でも使うため, 再生位置が順に進む場合の評価は間隔ごとに 1 回になる.
+class AnimationLodSampler
+{
+public:
+  // frame 時点の姿勢を pose に書き込む.
+  using Sampler = std::function<void(float frame, AnimationPose& pose)>;
+
+  AnimationLodSampler() : m_segment(0), m_interval(0.0f), m_phase(0.0f), m_hasKeys(false) { }
+
+  // frame 時点の姿勢を返す. interval は評価する間隔(30fps 単位のフレーム数)で, 0 以下の場合は毎回評価する.
+  // 評価する時刻は (n - phase) * interval (n は整数) に限る. phase は [0, 1) で,
+  // キャラクターごとに変えると評価するティックが分散する.
+  const AnimationPose& Sample(float frame, float interval, float phase, const Sampler& sampler);
+
+  // 保持している姿勢を破棄する. 評価元のクリップが変わった場合に呼ぶ.
+  void Reset() { m_hasKeys = false; }
+private:
+  // m_keys[0], m_keys[1] は区間 m_segment の始点と終点の姿勢.
+  AnimationPose m_keys[2];
+  AnimationPose m_pose;
+  int64_t m_segment;
+  float m_interval;
+  float m_phase;
+  bool m_hasKeys;
+};
@@ -0,0 +1,43 @@
+﻿#include "AnimationPose.h"
+
+#include <algorithm>
+
+void AnimationPose::Resize(uint32_t boneCount)
+{
+  m_boneCount = boneCount;
+  m_stride = (boneCount + Alignment - 1) / Alignment * Alignment;
+  m_data.assign(size_t(ChannelCount) * m_stride, 0.0f);
+  std::fill_n(GetChannel(RotationW), m_stride, 1.0f);
+}
+
+glm::vec3 AnimationPose::GetTranslation(uint32_t bone) const
+{
+  return glm::vec3(
+    GetChannel(TranslationX)[bone],
+    GetChannel(TranslationY)[bone],
+    GetChannel(TranslationZ)[bone]);
+}
+
+glm::quat AnimationPose::GetRotation(uint32_t bone) const
+{
+  return glm::quat(
+    GetChannel(RotationW)[bone],
+    GetChannel(RotationX)[bone],
+    GetChannel(RotationY)[bone],
+    GetChannel(RotationZ)[bone]);
+}
+
+void AnimationPose::SetTranslation(uint32_t bone, const glm::vec3& translation)
+{
+  GetChannel(TranslationX)[bone] = translation.x;
+  GetChannel(TranslationY)[bone] = translation.y;
+  GetChannel(TranslationZ)[bone] = translation.z;
+}
+
+void AnimationPose::SetRotation(uint32_t bone, const glm::quat& rotation)
+{
+  GetChannel(RotationX)[bone] = rotation.x;
+  GetChannel(RotationY)[bone] = rotation.y;
+  GetChannel(RotationZ)[bone] = rotation.z;
+  GetChannel(RotationW)[bone] = rotation.w;
+}
@@ -0,0 +1,43 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// ボーンごとの移動量と回転の組.
+// 成分ごとに連続した配列(SoA)で持ち, 各配列の長さは Alignment の倍数に切り上げる.
+class AnimationPose
+{
+public:
+  enum Channel
+  {
+    TranslationX, TranslationY, TranslationZ,
+    RotationX, RotationY, RotationZ, RotationW,
+    ChannelCount
+  };
+  static const uint32_t Alignment = 8;
+
+  AnimationPose() : m_boneCount(0), m_stride(0) { }
+  explicit AnimationPose(uint32_t boneCount) : AnimationPose() { Resize(boneCount); }
+
+  // 全ボーンを移動量 0, 回転なしで初期化する.
+  void Resize(uint32_t boneCount);
+
+  uint32_t GetBoneCount() const { return m_boneCount; }
+  uint32_t GetStride() const { return m_stride; }
+
+  float* GetData() { return m_data.data(); }
+  const float* GetData() const { return m_data.data(); }
+  float* GetChannel(Channel channel) { return m_data.data() + channel * m_stride; }
+  const float* GetChannel(Channel channel) const { return m_data.data() + channel * m_stride; }
+
+  glm::vec3 GetTranslation(uint32_t bone) const;
+  glm::quat GetRotation(uint32_t bone) const;
+  void SetTranslation(uint32_t bone, const glm::vec3& translation);
+  void SetRotation(uint32_t bone, const glm::quat& rotation);
+private:
+  uint32_t m_boneCount;
+  uint32_t m_stride;
+  std::vector<float> m_data;
+};
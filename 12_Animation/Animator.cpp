@@ -1,94 +1,102 @@
 #include "Animator.h"
 #include <fstream>
+#include <stdexcept>
 
 #include "loader/PMDloader.h"
 
 #include "Model.h"
+#include "ThreadPool.h"
+#include "PoseKernel.h"
 
 using namespace std;
 using namespace glm;
 
-static float dFx(float ax, float ay, float t)
+namespace
 {
-  float s = 1.0f - t;
-  float v = -6.0f * s * t * t * ax + 3.0f * s * s * ax - 3.0f * t * t * ay + 6.0f * s * t * ay + 3.0f * t * t;
-  return v;
-}
-static float fx(float ax, float ay, float t, float x0)
-{
-  float s = 1.0f - t;
-  return 3.0f * s * s * t * ax + 3.0f * s * t * t * ay + t * t * t - x0;
-}
-
-static float funcBezierX(glm::vec4 k, float t)
-{
-  float s = 1.0f - t;
-  return 3.0f * s * s * t * k.x + 3.0f * s * t * t * k.y + t * t * t;
-}
-static float funcBezierY(glm::vec4 k, float t)
-{
-  float s = 1.0f - t;
-  return 3.0f * s * s * t * k.y + 3.0f * s * t * t * k.w + t * t * t;
+  // PoseCache ̌ɎgnbV(FNV-1a).
+  uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+  {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+  }
+  const uint64_t HashBasis = 14695981039346656037ull;
 }
 
-
 void Animator::Prepare(const char* filename)
 {
   std::ifstream infile(filename, std::ios::binary);
   loader::VMDFile loader(infile);
 
   m_framePeriod = loader.getKeyframeCount();
+  m_easingTable = std::make_shared<BezierEasingTable>();
+  m_motionKey = HashBasis;
   uint32_t nodeCount = loader.getNodeCount();
+  m_nodeAnimations.resize(nodeCount);
   for (uint32_t i = 0; i < nodeCount; ++i)
   {
-    const auto& name = loader.getNodeName(i);
-    m_nodeMap[name] = NodeAnimation();
-    auto& keyframes = m_nodeMap[name];
-    auto framesSrc = loader.getKeyframes(name);
-
-    auto frameCount = uint32_t(framesSrc.size());
+    const auto& nodeName = loader.getNodeName(i);
+    m_nodeMap[nodeName] = i;
+    m_motionKey = HashBytes(m_motionKey, nodeName.data(), nodeName.size() + 1);
+    auto& keyframes = m_nodeAnimations[i];
+    auto frameNumbers = loader.getNodeFrames(i);
+    auto locations = loader.getNodeLocations(i);
+    auto rotations = loader.getNodeRotations(i);
+    auto interpolations = loader.getNodeInterpolations(i);
+
+    auto frameCount = uint32_t(frameNumbers.size());
     std::vector<NodeAnimeFrame> frames(frameCount);
-    for (uint32_t i = 0; i < frameCount; ++i)
+    for (uint32_t j = 0; j < frameCount; ++j)
     {
-      auto& dst = frames[i];
-      auto& src = framesSrc[i];
-      dst.frame = src.getKeyframeNumber();
-      dst.translation = src.getLocation();
-      dst.rotation = src.getRotation();
-      dst.interpX = src.getBezierParam(0);
-      dst.interpY = src.getBezierParam(1);
-      dst.interpZ = src.getBezierParam(2);
-      dst.interpR = src.getBezierParam(3);
+      auto& dst = frames[j];
+      dst.frame = frameNumbers[j];
+      dst.translation = locations[j];
+      dst.rotation = rotations[j];
+      for (int k = 0; k < 4; ++k)
+      {
+        auto bezier = interpolations[j].getBezierParam(k);
+        dst.interpCurves[k] = m_easingTable->Register(bezier);
+        m_motionKey = HashBytes(m_motionKey, &bezier, sizeof(bezier));
+      }
+      m_motionKey = HashBytes(m_motionKey, &dst.frame, sizeof(dst.frame));
+      m_motionKey = HashBytes(m_motionKey, &dst.translation, sizeof(dst.translation));
+      m_motionKey = HashBytes(m_motionKey, &dst.rotation, sizeof(dst.rotation));
     }
-    keyframes.SetKeyframes(frames);
+    keyframes.SetKeyframes(std::move(frames));
   }
 
   uint32_t morphCount = loader.getMorphCount();
+  m_morphAnimations.resize(morphCount);
   for (uint32_t i = 0; i < morphCount; ++i)
   {
-    const auto& name = loader.getMorphName(i);
-    m_morphMap[name] = MorphAnimation();
-    auto& keyframes = m_morphMap[name];
-    auto framesSrc = loader.getMorphKeyframes(name);
+    m_morphMap[loader.getMorphName(i)] = i;
+    auto& keyframes = m_morphAnimations[i];
+    auto frameNumbers = loader.getMorphFrames(i);
+    auto weights = loader.getMorphWeights(i);
     
-    auto frameCount = uint32_t(framesSrc.size());
+    auto frameCount = uint32_t(frameNumbers.size());
     std::vector<MorphAnimeFrame> frames(frameCount);
-    for (uint32_t i = 0; i < frameCount; ++i)
+    for (uint32_t j = 0; j < frameCount; ++j)
     {
-      auto& dst = frames[i];
-      const auto& src = framesSrc[i];
-      dst.frame = src.getKeyframeNumber();
-      dst.weight = src.getWeight();
+      auto& dst = frames[j];
+      dst.frame = frameNumbers[j];
+      dst.weight = weights[j];
     }
-    keyframes.SetKeyframes(frames);
+    keyframes.SetKeyframes(std::move(frames));
   }
+
+  // Ƀfݒ肳Ăꍇ͂Ŋ֘At.
+  BindTracks();
 }
 
 void Animator::Cleanup()
 {
 }
 
-void Animator::UpdateAnimation(uint32_t animeFrame)
+void Animator::UpdateAnimation(float animeFrame)
 {
   if (m_model == nullptr)
   {
@@ -97,192 +105,281 @@ void Animator::UpdateAnimation(uint32_t animeFrame)
 
   // SẴm[hŎw肳ꂽt[ł̒lvZ.
   UpdateNodeAnimation(animeFrame);
-  UpdateMorthAnimation(animeFrame);
+  if (m_lodLevel.updateMorphs)
+  {
+    UpdateMorthAnimation(animeFrame);
+  }
 
-  UpdateIKchains();
+  if (m_lodLevel.updateIK)
+  {
+    UpdateIKchains();
+  }
+  UpdatePhysics(animeFrame);
 }
 
-void Animator::UpdateNodeAnimation(uint32_t animeFrame)
+void Animator::SetLod(const AnimationLodLevel& level, float tickFrames, float phase)
 {
-  auto boneCount = m_model->GetBoneCount();
-  for (uint32_t i = 0; i < boneCount; ++i) {
-    auto bone = m_model->GetBone(i);
+  m_lodLevel = level;
+  m_lodInterval = level.tickInterval > 1 ? float(level.tickInterval) * tickFrames : 0.0f;
+  m_lodPhase = phase;
+}
 
-    auto itr = m_nodeMap.find(bone->GetName());
-    if (itr == m_nodeMap.end())
-    {
-      continue;
-    }
-    auto segment = (*itr).second.FindSegment(animeFrame);
-    auto start = std::get<0>(segment);
-    auto last = std::get<1>(segment);
+void Animator::UpdateNodeAnimation(float animeFrame)
+{
+  const auto& pose = m_lodSampler.Sample(animeFrame, m_lodInterval, m_lodPhase,
+    [this](float frame, AnimationPose& pose) { SampleNodePose(frame, pose); });
+  ApplyNodePose(pose);
+}
+void Animator::SampleNodePose(float frame, AnimationPose& pose)
+{
+  if (m_compressedClip)
+  {
+    m_compressedClip->Sample(frame, pose);
+  }
+  else if (m_bakedClip)
+  {
+    m_bakedClip->Sample(frame, pose);
+  }
+  else
+  {
+    SampleKeyframePose(frame, pose);
+  }
+}
+void Animator::SampleKeyframePose(float frame, AnimationPose& pose)
+{
+  if (m_poseCache)
+  {
+    pose = *m_poseCache->Get(m_motionKey, m_bindingKey, frame,
+      [this](float frame, AnimationPose& pose) { EvaluateNodePose(frame, pose); });
+  }
+  else
+  {
+    EvaluateNodePose(frame, pose);
+  }
+}
+void Animator::EvaluateNodePose(float frame, AnimationPose& pose)
+{
+  // Ԃ̗[̃L[ƕԗW߂Ă, S{[܂Ƃ߂ĕԂ.
+  auto boneCount = uint32_t(m_nodeBindings.size());
+  if (m_blendStart.GetBoneCount() != boneCount)
+  {
+    m_blendStart.Resize(boneCount);
+    m_blendLast.Resize(boneCount);
+    m_blendRates.assign(4 * size_t(m_blendStart.GetStride()), 0.0f);
+  }
+  if (pose.GetBoneCount() != boneCount)
+  {
+    pose.Resize(boneCount);
+  }
 
-    // `.
-    auto range = float(last.frame - start.frame);
-    vec3 translation = start.translation;
-    quat rotation = start.rotation;
-    if (range > 0)
-    {
-      auto rate = float(animeFrame - start.frame) / float(range);
-      translation = start.translation;
-      translation += (last.translation - start.translation) * rate;
-      translation += bone->GetInitialTranslation();
-      rotation = normalize(glm::slerp(start.rotation, last.rotation, rate));
-    }
-    if (range == 0)
+  const auto stride = m_blendStart.GetStride();
+  for (uint32_t i = 0; i < boneCount; ++i)
+  {
+    float rates[4];
+    auto segment = m_nodeAnimations[m_nodeBindings[i].track].FindBlend(frame, *m_easingTable, rates);
+    const auto& initial = m_initialTranslations[i];
+    m_blendStart.SetTranslation(i, segment.start.translation + initial);
+    m_blendStart.SetRotation(i, segment.start.rotation);
+    m_blendLast.SetTranslation(i, segment.last.translation + initial);
+    m_blendLast.SetRotation(i, segment.last.rotation);
+    for (uint32_t c = 0; c < 4; ++c)
     {
-      continue;
+      m_blendRates[c * stride + i] = rates[c];
     }
-    bone->SetTranslation(translation);
-    bone->SetRotation(rotation);
-
-#if 01
-    auto rate = float(animeFrame - start.frame) / float(range);
-    vec4 bezierK(0.f);
-    bezierK.x = InterporateBezier(start.interpX, rate);
-    bezierK.y = InterporateBezier(start.interpY, rate);
-    bezierK.z = InterporateBezier(start.interpZ, rate);
-    bezierK.w = InterporateBezier(start.interpR, rate);
-
-    translation = start.translation;
-    translation += (last.translation - start.translation) * vec3(bezierK);
-    translation += bone->GetInitialTranslation();
-    bone->SetTranslation(translation);
-
-    rotation = glm::slerp(start.rotation, last.rotation, bezierK.w);
-    bone->SetRotation(rotation);
-#endif
   }
-  // e{[̎pZbĝōsXV.
-  m_model->UpdateMatrices();
+  BlendPoses(m_blendStart.GetData(), m_blendLast.GetData(), m_blendRates.data(), 0.0f, true, stride, pose.GetData());
 }
-float Animator::InterporateBezier(const glm::vec4& bezier, float x)
+void Animator::ApplyNodePose(const AnimationPose& pose)
 {
-  float t = 0.5f;
-  float ft = fx(bezier.x, bezier.z, t, x);
-  for (int i = 0; i < 32; ++i)
+  auto& skeleton = m_model->GetSkeleton();
+  for (uint32_t i = 0; i < uint32_t(m_nodeBindings.size()); ++i)
   {
-    auto dfx = dFx(bezier.x, bezier.z, t);
-    t = t - ft / dfx;
-    ft = fx(bezier.x, bezier.z, t, x);
+    auto bone = m_nodeBindings[i].target;
+    skeleton.SetTranslation(bone, pose.GetTranslation(i));
+    skeleton.SetRotation(bone, pose.GetRotation(i));
   }
-  t = std::min(std::max(0.0f, t), 1.0f);
-  float dy = funcBezierY(bezier, t);
-  return dy;
 }
-
-void Animator::UpdateMorthAnimation(uint32_t animeFrame)
+void Animator::UpdateMorthAnimation(float animeFrame)
 {
-  for (auto& m : m_morphMap)
+  for (const auto& binding : m_morphBindings)
   {
-    auto name = m.first;
-    auto segment = m.second.FindSegment(animeFrame);
-    auto start = std::get<0>(segment);
-    auto last = std::get<1>(segment);
+    auto segment = m_morphAnimations[binding.track].FindSegment(animeFrame);
+    const auto& start = segment.start;
+    const auto& last = segment.last;
 
     auto range = float(last.frame - start.frame);
     auto weight = start.weight;
     if (range > 0)
     {
-      auto rate = float(animeFrame - start.frame) / range;
+      auto rate = (animeFrame - float(start.frame)) / range;
       weight += (last.weight - start.weight) * rate;
     }
 
-    auto index = m_model->GetFaceMorphIndex(name);
-    m_model->SetFaceMorphWeight(index, weight);
+    m_model->SetFaceMorphWeight(binding.target, weight);
   }
 }
 
 void Animator::Attach(Model* model)
 {
   m_model = model;
+  m_physicsRunning = false;
+  BindTracks();
 }
 
-void Animator::UpdateIKchains()
+void Animator::BindTracks()
 {
+  // Oɂ錟͂ 1 xs, t[̍XVł͔ԍ̑ĝ݂g.
+  m_nodeBindings.clear();
+  m_initialTranslations.clear();
+  m_morphBindings.clear();
+  m_bindingKey = HashBasis;
+  m_bakedClip.reset();
+  m_compressedClip.reset();
+  m_lodSampler.Reset();
   if (m_model == nullptr)
   {
     return;
   }
-  auto ikCount = m_model->GetBoneIKCount();
-  for (uint32_t i = 0; i < ikCount; ++i)
+
+  const auto& skeleton = m_model->GetSkeleton();
+  auto boneCount = skeleton.GetBoneCount();
+  for (uint32_t i = 0; i < boneCount; ++i)
   {
-    SolveIK(m_model->GetBoneIK(i));
+    auto itr = m_nodeMap.find(skeleton.GetName(i));
+    if (itr != m_nodeMap.end())
+    {
+      m_nodeBindings.push_back(TrackBinding{ i, itr->second });
+      m_initialTranslations.push_back(skeleton.GetInitialTranslation(i));
+      m_bindingKey = HashBytes(m_bindingKey, &itr->second, sizeof(itr->second));
+      m_bindingKey = HashBytes(m_bindingKey, &m_initialTranslations.back(), sizeof(glm::vec3));
+    }
   }
+
+  for (const auto& m : m_morphMap)
+  {
+    auto index = m_model->GetFaceMorphIndex(m.first);
+    if (index >= 0)
+    {
+      m_morphBindings.push_back(TrackBinding{ uint32_t(index), m.second });
+    }
+  }
+  // \[tԍɕׂăANZXAɂ.
+  std::sort(m_morphBindings.begin(), m_morphBindings.end(),
+    [](const TrackBinding& a, const TrackBinding& b) { return a.target < b.target; });
 }
 
-inline glm::vec4 GetPosition(const glm::mat4& m)
+std::shared_ptr<const BakedClip> Animator::Bake(uint32_t samplesPerFrame)
 {
-  return glm::vec4(m[3]);
+  m_bakedClip = BuildBakedClip(samplesPerFrame);
+  m_lodSampler.Reset();
+  return m_bakedClip;
 }
 
-void Animator::SolveIK(const PMDBoneIK& boneIk)
+std::shared_ptr<const BakedClip> Animator::BuildBakedClip(uint32_t samplesPerFrame)
 {
-  auto target = boneIk.GetTarget();
-  auto eff = boneIk.GetEffector();
+  if (m_model == nullptr)
+  {
+    throw std::runtime_error("Animator::Bake requires an attached model.");
+  }
 
-  const auto& chains = boneIk.GetChains();
-  for (int ite = 0; ite < boneIk.GetIterationCount(); ++ite)
+  auto clip = std::make_shared<BakedClip>();
+  auto boneCount = uint32_t(m_nodeBindings.size());
+  clip->Build(boneCount, m_framePeriod, samplesPerFrame, [&](float frame, AnimationPose& pose) {
+    EvaluateNodePose(frame, pose);
+  });
+  return clip;
+}
+
+void Animator::SetBakedClip(std::shared_ptr<const BakedClip> clip)
+{
+  if (clip && clip->GetBoneCount() != m_nodeBindings.size())
   {
-    for (uint32_t i = 0; i < chains.size(); ++i)
-    {
-      auto bone = chains[i];
-      auto mtxInvBone = glm::inverse(bone->GetWorldMatrix());
+    throw std::runtime_error("BakedClip does not match the attached model.");
+  }
+  m_bakedClip = std::move(clip);
+  m_lodSampler.Reset();
+}
 
-      // GtFN^ƃ^[Qbg̈ʒuA݃{[ł̃[JԂɂ.
-      auto effectorPos = vec3(mtxInvBone * GetPosition(eff->GetWorldMatrix()));
-      auto targetPos = vec3(mtxInvBone * GetPosition(target->GetWorldMatrix()));
+std::shared_ptr<const CompressedClip> Animator::Compress(const ClipCompressionSettings& settings)
+{
+  if (m_model == nullptr)
+  {
+    throw std::runtime_error("Animator::Compress requires an attached model.");
+  }
 
-      auto len = glm::length(targetPos - effectorPos);
-      if (len * len < 0.0001f)
-      {
-        return;
-      }
-      // {[^[QbgуGtFN^֌xNg𐶐.
-      auto vecToEff = glm::normalize(effectorPos);
-      auto vecToTarget = glm::normalize(targetPos);
-
-      auto dot = glm::dot(vecToEff, vecToTarget);
-      dot = glm::clamp(dot, -1.0f, 1.0f);
-      float radian = acosf(dot);
-      if (radian < 0.0001f)
-        continue;
-      auto limitAngle = boneIk.GetAngleWeight();
-      radian = glm::clamp(radian, -limitAngle, limitAngle);
-
-      // ]߂.
-      auto axis = normalize(cross(vecToTarget, vecToEff));
-
-      if (radian < 0.001f)
-      {
-        continue;
-      }
+  // {[ԍŎw肳ꂽe덷Nbv̕тɍ킹.
+  ClipCompressionSettings clipSettings;
+  clipSettings.defaultTolerance = settings.defaultTolerance;
+  std::vector<const NodeAnimation*> tracks;
+  for (const auto& binding : m_nodeBindings)
+  {
+    clipSettings.boneTolerances.push_back(settings.GetTolerance(binding.target));
+    tracks.push_back(&m_nodeAnimations[binding.track]);
+  }
 
-      if (bone->GetName().find("Ђ") != std::string::npos )
-      {
-        auto rotation = angleAxis(radian, axis);
-        auto eulerAngle = eulerAngles(rotation);
-        eulerAngle.y = 0.0f; eulerAngle.z = 0.0f;
-        eulerAngle.x = clamp(eulerAngle.x, 0.002f, glm::pi<float>());
-        rotation = quat(eulerAngle);
-
-        rotation = normalize(bone->GetRotation() * rotation);
-        bone->SetRotation(rotation);
-      }
-      else
-      {
-        auto rotation = angleAxis(radian, axis);
-        rotation = normalize(bone->GetRotation() * rotation);
-        bone->SetRotation(rotation);
-      }
-      
-      // ʒuWXV.
-      for (int j = i; j >= 0; --j)
-      {
-        chains[j]->UpdateWorldMatrix();
-      }
-      eff->UpdateWorldMatrix();
-      target->UpdateWorldMatrix();
-    }
+  auto clip = std::make_shared<CompressedClip>();
+  clip->Build(tracks, m_initialTranslations, m_easingTable, clipSettings);
+  m_compressedClip = clip;
+  m_lodSampler.Reset();
+  return clip;
+}
+
+void Animator::SetCompressedClip(std::shared_ptr<const CompressedClip> clip)
+{
+  if (clip && clip->GetBoneCount() != m_nodeBindings.size())
+  {
+    throw std::runtime_error("CompressedClip does not match the attached model.");
   }
+  m_compressedClip = std::move(clip);
+  m_lodSampler.Reset();
+}
+
+void Animator::UpdateIKchains()
+{
+  if (m_model == nullptr)
+  {
+    return;
+  }
+  auto& skeleton = m_model->GetSkeleton();
+  auto ikCount = m_model->GetBoneIKCount();
+  for (uint32_t i = 0; i < ikCount; ++i)
+  {
+    SolveBoneIK(skeleton, m_model->GetBoneIK(i));
+  }
+}
+
+void Animator::UpdatePhysics(float animeFrame)
+{
+  auto& solver = m_model->GetRigidBodySolver();
+  if (!m_physicsEnabled || !m_lodLevel.updatePhysics || solver.GetBodyCount() == 0)
+  {
+    m_physicsRunning = false;
+    return;
+  }
+
+  // 1  Update Ői߂鎞Ԃ𒴂(V[N)Ɗ߂, ̂{[̈ʒuɖ߂.
+  auto& skeleton = m_model->GetSkeleton();
+  const float deltaTime = (animeFrame - m_physicsFrame) / 30.0f;
+  const float maxDeltaTime = solver.GetTimeStep() * float(solver.GetMaxSubSteps());
+  if (!m_physicsRunning || deltaTime < 0.0f || deltaTime > maxDeltaTime)
+  {
+    solver.Reset(skeleton);
+  }
+  else
+  {
+    solver.Update(skeleton, deltaTime);
+  }
+  m_physicsRunning = true;
+  m_physicsFrame = animeFrame;
+}
+
+void UpdateAnimations(ThreadPool& pool, Animator* const* animators, const float* animeFrames, uint32_t count)
+{
+  pool.ParallelFor(count, [&](uint32_t i) {
+    animators[i]->UpdateAnimation(animeFrames[i]);
+    if (auto model = animators[i]->GetModel())
+    {
+      model->UpdateHostData();
+    }
+  });
 }
@@ -1,42 +1,119 @@
-#pragma once
+﻿#pragma once
 
 #include <string>
+#include <vector>
 #include <unordered_map>
 #include <algorithm>
+#include <memory>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include "BezierEasing.h"
+#include "BakedClip.h"
+#include "CompressedClip.h"
+#include "AnimationLod.h"
+#include "PoseCache.h"
+
 class Model;
-class PMDBoneIK;
+class ThreadPool;
 
 template<class T>
 class Animation
 {
 public:
- 
-  using Segment = std::tuple<T, T>;
-  Segment FindSegment(uint32_t frame)
+  // frame を含むキーフレーム区間. start.frame <= frame < last.frame となる.
+  // 先頭のキーより前, 末尾のキー以降では start と last は同じキーを指す.
+  struct Segment
   {
-    const T refValue{ frame };
-    typename std::vector<T>::iterator first, last;
+    const T& start;
+    const T& last;
+  };
+
+  Animation() : m_cursor(0), m_bucketFrames(1) { }
 
-    last = std::upper_bound(m_keyframes.begin(), m_keyframes.end(),
-      refValue, [](const T& a, const T& b) { return a.frame < b.frame; });
-    first = last - 1;
-    if (last == m_keyframes.end())
+  // frame は 30fps 単位のフレーム番号(小数を含む).
+  Segment FindSegment(float frame)
+  {
+    const auto count = uint32_t(m_keyframes.size());
+    if (frame < m_keyframes.front().frame)
     {
-      last = first;
+      m_cursor = 0;
+      return Segment{ m_keyframes.front(), m_keyframes.front() };
     }
-    Segment ret;
-    std::get<0>(ret) = *first;
-    std::get<1>(ret) = *last;
-    return ret;
+
+    // 順方向の再生では前回の区間かその次の区間になる.
+    // それ以外(シークや巻き戻し)はバケットから探す.
+    if (!IsInSegment(m_cursor, frame))
+    {
+      if (m_cursor + 1 < count && IsInSegment(m_cursor + 1, frame))
+      {
+        ++m_cursor;
+      }
+      else
+      {
+        m_cursor = Seek(frame);
+      }
+    }
+    auto next = std::min(m_cursor + 1, count - 1);
+    return Segment{ m_keyframes[m_cursor], m_keyframes[next] };
   }
 
-  void SetKeyframes(std::vector<T>& src) { m_keyframes = src; }
+  void SetKeyframes(std::vector<T>&& src)
+  {
+    m_keyframes = std::move(src);
+    m_cursor = 0;
+    BuildSeekIndex();
+  }
+
+  uint32_t GetKeyframeCount() const { return uint32_t(m_keyframes.size()); }
+  const std::vector<T>& GetKeyframes() const { return m_keyframes; }
 private:
+  bool IsInSegment(uint32_t index, float frame) const
+  {
+    return m_keyframes[index].frame <= frame &&
+      (index + 1 == m_keyframes.size() || frame < m_keyframes[index + 1].frame);
+  }
+
+  uint32_t Seek(float frame) const
+  {
+    auto bucket = std::min(uint32_t(frame) / m_bucketFrames, uint32_t(m_bucketIndex.size() - 1));
+    auto index = m_bucketIndex[bucket];
+    while (index + 1 < m_keyframes.size() && m_keyframes[index + 1].frame <= frame)
+    {
+      ++index;
+    }
+    return index;
+  }
+
+  // 一定フレーム幅ごとに, その先頭フレームを含む区間の番号を記録しておく.
+  // 幅はキー 1 つあたりの平均間隔とし, バケット数はキー数程度に収める.
+  void BuildSeekIndex()
+  {
+    m_bucketIndex.clear();
+    if (m_keyframes.empty())
+    {
+      return;
+    }
+    const auto count = uint32_t(m_keyframes.size());
+    const auto lastFrame = m_keyframes.back().frame;
+    m_bucketFrames = std::max(1u, lastFrame / count + 1);
+
+    uint32_t index = 0;
+    for (uint64_t bucketFrame = 0; bucketFrame <= lastFrame; bucketFrame += m_bucketFrames)
+    {
+      while (index + 1 < count && m_keyframes[index + 1].frame <= bucketFrame)
+      {
+        ++index;
+      }
+      m_bucketIndex.push_back(index);
+    }
+  }
+
   std::vector<T> m_keyframes;
+  uint32_t m_cursor;
+  uint32_t m_bucketFrames;
+  std::vector<uint32_t> m_bucketIndex;
 };
 
 struct NodeAnimeFrame
@@ -44,10 +121,8 @@ struct NodeAnimeFrame
   uint32_t frame;
   glm::vec3 translation;
   glm::quat rotation;
-  glm::vec4 interpX;
-  glm::vec4 interpY;
-  glm::vec4 interpZ;
-  glm::vec4 interpR;
+  // X, Y, Z, 回転 の補間曲線 (BezierEasingTable の曲線番号).
+  uint32_t interpCurves[4];
 
   bool operator<(const NodeAnimeFrame& v) const
   {
@@ -69,6 +144,37 @@ class NodeAnimation : public Animation<NodeAnimeFrame>
 {
 public:
   NodeAnimation() { }
+
+  // frame を含む区間の両端のキーと, 成分ごとの補間率(移動量 X, Y, Z, 回転 の順)を求める.
+  // 補間する区間が無い場合は直前(先頭より前では先頭)のキーのみとなり, 補間率は 0 になる.
+  Segment FindBlend(float frame, const BezierEasingTable& easing, float rates[4])
+  {
+    auto segment = FindSegment(frame);
+    const auto& start = segment.start;
+    const auto& last = segment.last;
+    if (last.frame <= start.frame)
+    {
+      rates[0] = rates[1] = rates[2] = rates[3] = 0.0f;
+      return segment;
+    }
+    auto rate = (frame - float(start.frame)) / float(last.frame - start.frame);
+    for (int i = 0; i < 4; ++i)
+    {
+      rates[i] = easing.Evaluate(start.interpCurves[i], rate);
+    }
+    return segment;
+  }
+
+  // frame での移動量(キーフレームの値)と回転を求める.
+  void Evaluate(float frame, const BezierEasingTable& easing, glm::vec3& translation, glm::quat& rotation)
+  {
+    float rates[4];
+    auto segment = FindBlend(frame, easing, rates);
+    const auto& start = segment.start;
+    const auto& last = segment.last;
+    translation = start.translation + (last.translation - start.translation) * glm::vec3(rates[0], rates[1], rates[2]);
+    rotation = glm::slerp(start.rotation, last.rotation, rates[3]);
+  }
 };
 
 class MorphAnimation : public Animation<MorphAnimeFrame>
@@ -81,27 +187,109 @@ public:
 class Animator
 {
 public:
-  Animator() : m_model(nullptr), m_framePeriod(0) { }
+  Animator() : m_easingTable(std::make_shared<BezierEasingTable>()), m_model(nullptr), m_lodInterval(0.0f), m_lodPhase(0.0f), m_motionKey(0), m_bindingKey(0), m_framePeriod(0),
+    m_physicsEnabled(true), m_physicsRunning(false), m_physicsFrame(0.0f) { }
 
   void Prepare(const char* filename);
   void Cleanup();
 
-  void UpdateAnimation(uint32_t animeFrame);
+  // animeFrame は 30fps 単位のフレーム番号. 小数の場合はキーフレーム間を補間する.
+  void UpdateAnimation(float animeFrame);
 
   void Attach(Model* model);
+  Model* GetModel() const { return m_model; }
+
+  // 現在のモデルに合わせてボーンアニメーションを 1 フレームあたり samplesPerFrame 回で焼き込み,
+  // 以降の再生に使う. 同じモデルデータとモーションの組であれば, 戻り値を他の Animator と共有できる.
+  std::shared_ptr<const BakedClip> Bake(uint32_t samplesPerFrame = 1);
+  // nullptr の場合はキーフレームからの再生に戻す.
+  void SetBakedClip(std::shared_ptr<const BakedClip> clip);
+
+  // 現在のモデルに合わせてボーンアニメーションのキーフレームを圧縮し, 以降の再生に使う.
+  // settings.boneTolerances はモデルのボーン番号で指定する. 戻り値は Bake と同じく他の Animator と共有できる.
+  std::shared_ptr<const CompressedClip> Compress(const ClipCompressionSettings& settings);
+  // nullptr の場合は焼き込んだクリップ, またはキーフレームからの再生に戻す.
+  void SetCompressedClip(std::shared_ptr<const CompressedClip> clip);
+
+  // 以降の更新に使う LOD の段階. tickFrames はシミュレーションの 1 ティックあたりのフレーム数(30fps 単位).
+  // phase は AnimationLodSampler::Sample を参照. 既定は毎回の評価で, 表情モーフ, IK も更新する.
+  void SetLod(const AnimationLodLevel& level, float tickFrames, float phase = 0.0f);
+  const AnimationLodLevel& GetLod() const { return m_lodLevel; }
+
+  // キーフレームから評価する姿勢を cache で他の Animator と共有する. nullptr の場合は共有しない.
+  // 同じモーション(内容で判定する)を同じボーン並びのモデルで再生する Animator の間で共有される.
+  // 焼き込んだクリップ, 圧縮したクリップからの再生は評価が軽いため使わない.
+  void SetPoseCache(std::shared_ptr<PoseCache> cache) { m_poseCache = std::move(cache); }
+
+  // IK の後にモデルの剛体の物理演算(Model::GetRigidBodySolver)を進める. 既定は有効.
+  // 経過時間は前回の animeFrame との差から求め, 巻き戻しや大きく飛んだ場合は剛体をボーンの位置に戻す.
+  void EnablePhysics(bool enable) { m_physicsEnabled = enable; }
+  bool IsPhysicsEnabled() const { return m_physicsEnabled; }
 private:
-  void UpdateNodeAnimation(uint32_t animeFrame);
-  void UpdateMorthAnimation(uint32_t animeFrame);
+  void UpdateNodeAnimation(float animeFrame);
+  void SampleNodePose(float frame, AnimationPose& pose);
+  void SampleKeyframePose(float frame, AnimationPose& pose);
+  void EvaluateNodePose(float frame, AnimationPose& pose);
+  void ApplyNodePose(const AnimationPose& pose);
+  void UpdateMorthAnimation(float animeFrame);
   void UpdateIKchains();
-  void SolveIK(const PMDBoneIK&);
+  void UpdatePhysics(float animeFrame);
 
-  static float InterporateBezier(const glm::vec4& bezier, float x);
+  void BindTracks();
+  std::shared_ptr<const BakedClip> BuildBakedClip(uint32_t samplesPerFrame);
 
-  using NodeAnimationMap = std::unordered_map<std::string, NodeAnimation>;
-  using MorphAnimationMap = std::unordered_map<std::string, MorphAnimation>;
-  NodeAnimationMap m_nodeMap;
-  MorphAnimationMap m_morphMap;
+  // トラック名からトラック番号への対応. Attach 時の関連付けにのみ使用する.
+  using TrackIndexMap = std::unordered_map<std::string, uint32_t>;
+  std::vector<NodeAnimation> m_nodeAnimations;
+  std::vector<MorphAnimation> m_morphAnimations;
+  TrackIndexMap m_nodeMap;
+  TrackIndexMap m_morphMap;
+  // 圧縮したクリップと共有する.
+  std::shared_ptr<BezierEasingTable> m_easingTable;
   Model* m_model;
 
+  // モデル側の番号(ボーン/表情モーフ)とトラック番号の組.
+  // モデルに対応するトラックが無いものは含まない.
+  struct TrackBinding
+  {
+    uint32_t target;
+    uint32_t track;
+  };
+  std::vector<TrackBinding> m_nodeBindings;
+  std::vector<TrackBinding> m_morphBindings;
+  // m_nodeBindings の各ボーンの初期位置.
+  std::vector<glm::vec3> m_initialTranslations;
+
+  // 焼き込んだクリップ, 圧縮したクリップのボーン並びは m_nodeBindings と同じ.
+  std::shared_ptr<const BakedClip> m_bakedClip;
+  std::shared_ptr<const CompressedClip> m_compressedClip;
+
+  // LOD の段階と, 姿勢を評価する間隔(30fps 単位のフレーム数, 0 の場合は毎回評価する).
+  AnimationLodLevel m_lodLevel;
+  float m_lodInterval;
+  float m_lodPhase;
+  AnimationLodSampler m_lodSampler;
+
+  // PoseCache の鍵. モーションの内容と, トラックの割り当て(m_nodeBindings と初期位置)から求める.
+  std::shared_ptr<PoseCache> m_poseCache;
+  uint64_t m_motionKey;
+  uint64_t m_bindingKey;
+
+  // キーフレームから評価する際の区間の両端と補間率. ボーン並びは m_nodeBindings と同じ.
+  AnimationPose m_blendStart;
+  AnimationPose m_blendLast;
+  std::vector<float> m_blendRates;
+
   uint32_t m_framePeriod;
-};
\ No newline at end of file
+
+  // 物理演算を前回進めたか(LOD などで止めていた場合は剛体を戻してから進める)と, その animeFrame.
+  bool m_physicsEnabled;
+  bool m_physicsRunning;
+  float m_physicsFrame;
+};
+
+// 複数のキャラクター(Animator と Attach したモデルの組)を pool で並列に更新する.
+// キャラクターごとにノード・表情モーフ・IK を評価し, ボーン行列と頂点を各モデルのホスト側のバッファへ
+// 計算する(Model::UpdateHostData). 描画スレッドは戻った後に各モデルの Update で転送する.
+// animeFrames[i] は animators[i] の再生位置. モデルはキャラクターごとに別のものとすること.
+void UpdateAnimations(ThreadPool& pool, Animator* const* animators, const float* animeFrames, uint32_t count);
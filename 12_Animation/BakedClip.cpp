@@ -0,0 +1,74 @@
+﻿#include "BakedClip.h"
+#include "PoseKernel.h"
+
+#include <algorithm>
+
+void BakedClip::Build(uint32_t boneCount, uint32_t frameCount, uint32_t samplesPerFrame, const Sampler& sampler)
+{
+  AnimationPose pose(boneCount);
+  m_boneCount = boneCount;
+  m_stride = pose.GetStride();
+  m_samplesPerFrame = std::max(1u, samplesPerFrame);
+  m_sampleCount = frameCount * m_samplesPerFrame + 1;
+
+  const auto sampleSize = GetSampleSize();
+  m_samples.resize(sampleSize * m_sampleCount);
+  for (uint32_t i = 0; i < m_sampleCount; ++i)
+  {
+    sampler(float(i) / float(m_samplesPerFrame), pose);
+    auto dst = m_samples.data() + i * sampleSize;
+    std::copy(pose.GetData(), pose.GetData() + sampleSize, dst);
+    if (i == 0)
+    {
+      continue;
+    }
+
+    // 再生時に成分ごとの線形補間で済むよう, 前のサンプルと同じ半球側の回転にそろえる.
+    auto prev = dst - sampleSize;
+    auto rotation = AnimationPose::RotationX * m_stride;
+    for (uint32_t bone = 0; bone < m_boneCount; ++bone)
+    {
+      float dot = 0.0f;
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        dot += prev[rotation + c * m_stride + bone] * dst[rotation + c * m_stride + bone];
+      }
+      if (dot < 0.0f)
+      {
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+          dst[rotation + c * m_stride + bone] = -dst[rotation + c * m_stride + bone];
+        }
+      }
+    }
+  }
+}
+
+void BakedClip::ReadSample(uint32_t sample, AnimationPose& pose) const
+{
+  if (pose.GetBoneCount() != m_boneCount)
+  {
+    pose.Resize(m_boneCount);
+  }
+  auto src = GetSampleData(sample);
+  std::copy(src, src + GetSampleSize(), pose.GetData());
+}
+
+void BakedClip::Sample(float frame, AnimationPose& pose) const
+{
+  if (pose.GetBoneCount() != m_boneCount)
+  {
+    pose.Resize(m_boneCount);
+  }
+  if (m_sampleCount == 0)
+  {
+    return;
+  }
+
+  auto position = std::min(std::max(frame * float(m_samplesPerFrame), 0.0f), float(m_sampleCount - 1));
+  auto index = uint32_t(position);
+  auto next = std::min(index + 1, m_sampleCount - 1);
+  auto rate = position - float(index);
+
+  BlendPoses(GetSampleData(index), GetSampleData(next), nullptr, rate, false, m_stride, pose.GetData());
+}
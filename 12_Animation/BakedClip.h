@@ -0,0 +1,40 @@
+﻿#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "AnimationPose.h"
+
+// 一定間隔で再サンプリングしたボーンアニメーション.
+// 1 サンプル分の姿勢を AnimationPose と同じ配置で連続して格納し,
+// 再生時は隣接する 2 サンプルの線形補間と回転の正規化のみを行う.
+class BakedClip
+{
+public:
+  // frame 時点の姿勢を pose に書き込む.
+  using Sampler = std::function<void(float frame, AnimationPose& pose)>;
+
+  BakedClip() : m_boneCount(0), m_stride(0), m_sampleCount(0), m_samplesPerFrame(1) { }
+
+  // 0 から frameCount フレームまでを 1 フレームあたり samplesPerFrame 回サンプリングする.
+  void Build(uint32_t boneCount, uint32_t frameCount, uint32_t samplesPerFrame, const Sampler& sampler);
+
+  // frame は小数を含むフレーム番号. 範囲外の場合は端のサンプルになる.
+  void Sample(float frame, AnimationPose& pose) const;
+  // sample 番目のサンプルをそのまま pose に書き込む.
+  void ReadSample(uint32_t sample, AnimationPose& pose) const;
+
+  uint32_t GetBoneCount() const { return m_boneCount; }
+  uint32_t GetSampleCount() const { return m_sampleCount; }
+  uint32_t GetSamplesPerFrame() const { return m_samplesPerFrame; }
+  size_t GetMemorySize() const { return m_samples.size() * sizeof(float); }
+private:
+  size_t GetSampleSize() const { return size_t(AnimationPose::ChannelCount) * m_stride; }
+  const float* GetSampleData(uint32_t sample) const { return m_samples.data() + sample * GetSampleSize(); }
+
+  uint32_t m_boneCount;
+  uint32_t m_stride;
+  uint32_t m_sampleCount;
+  uint32_t m_samplesPerFrame;
+  std::vector<float> m_samples;
+};
@@ -0,0 +1,94 @@
+﻿#include "BezierEasing.h"
+
+#include <algorithm>
+#include <cmath>
+
+static float dFx(float ax, float ay, float t)
+{
+  float s = 1.0f - t;
+  float v = -6.0f * s * t * t * ax + 3.0f * s * s * ax - 3.0f * t * t * ay + 6.0f * s * t * ay + 3.0f * t * t;
+  return v;
+}
+static float fx(float ax, float ay, float t, float x0)
+{
+  float s = 1.0f - t;
+  return 3.0f * s * s * t * ax + 3.0f * s * t * t * ay + t * t * t - x0;
+}
+static float funcBezierY(glm::vec4 k, float t)
+{
+  float s = 1.0f - t;
+  return 3.0f * s * s * t * k.y + 3.0f * s * t * t * k.w + t * t * t;
+}
+
+float SolveBezierEasing(const glm::vec4& bezier, float x)
+{
+  float t = 0.5f;
+  float ft = fx(bezier.x, bezier.z, t, x);
+  for (int i = 0; i < 32; ++i)
+  {
+    auto dfx = dFx(bezier.x, bezier.z, t);
+    t = t - ft / dfx;
+    ft = fx(bezier.x, bezier.z, t, x);
+  }
+  t = std::min(std::max(0.0f, t), 1.0f);
+  float dy = funcBezierY(bezier, t);
+  return dy;
+}
+
+BezierEasingTable::BezierEasingTable()
+{
+  // 0 番は直線用に予約する. Evaluate では参照しない.
+  m_curves.resize(1);
+  for (uint32_t i = 0; i <= SampleCount; ++i)
+  {
+    m_curves[0].x[i] = m_curves[0].y[i] = float(i) / float(SampleCount);
+  }
+  for (uint32_t i = 0; i < SampleCount; ++i)
+  {
+    m_curves[0].bucketStart[i] = uint8_t(i);
+  }
+}
+
+uint32_t BezierEasingTable::Register(const glm::vec4& bezier)
+{
+  if (bezier.x == bezier.y && bezier.z == bezier.w)
+  {
+    return LinearCurve;
+  }
+
+  // 制御点は 0..127 の整数を正規化したものなので, 4 byte に詰めて識別する.
+  uint32_t key = 0;
+  for (int i = 0; i < 4; ++i)
+  {
+    key = (key << 8) | uint32_t(std::lround(glm::clamp(bezier[i], 0.0f, 1.0f) * 127.0f));
+  }
+  auto it = m_curveMap.find(key);
+  if (it != m_curveMap.end())
+  {
+    return it->second;
+  }
+
+  auto curve = GetCurveCount();
+  m_curveMap.emplace(key, curve);
+
+  Curve table;
+  for (uint32_t i = 0; i <= SampleCount; ++i)
+  {
+    float t = float(i) / float(SampleCount);
+    float s = 1.0f - t;
+    table.x[i] = 3.0f * s * s * t * bezier.x + 3.0f * s * t * t * bezier.z + t * t * t;
+    table.y[i] = 3.0f * s * s * t * bezier.y + 3.0f * s * t * t * bezier.w + t * t * t;
+  }
+  uint32_t index = 0;
+  for (uint32_t i = 0; i < SampleCount; ++i)
+  {
+    auto bucketX = float(i) / float(SampleCount);
+    while (index + 1 < SampleCount && table.x[index + 1] < bucketX)
+    {
+      ++index;
+    }
+    table.bucketStart[i] = uint8_t(index);
+  }
+  m_curves.push_back(table);
+  return curve;
+}
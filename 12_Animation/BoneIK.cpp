@@ -0,0 +1,187 @@
+﻿#include "BoneIK.h"
+
+#include <cmath>
+#include <string>
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+using namespace glm;
+
+namespace
+{
+  // 膝のボーン名 "ひざ" (ボーン名は Shift_JIS のまま保持している).
+  const char KneeBoneName[] = "\x82\xd0\x82\xb4";
+  // ターゲットとエフェクタの距離の 2 乗がこれ未満になれば解けたものとする.
+  const float Tolerance = 0.0001f;
+  // CCD で膝を曲げる角度の下限. 伸び切った膝が曲がる向きを決められなくなるのを防ぐ.
+  const float MinKneeAngle = 0.002f;
+
+  vec3 GetPosition(const mat4& m)
+  {
+    return vec3(m[3]);
+  }
+
+  // ボーンのワールド行列は回転と移動のみからなるので, 逆行列は回転の転置と移動の反転で求まる.
+  mat4 InverseRigid(const mat4& m)
+  {
+    auto rotation = transpose(mat3(m));
+    mat4 result(rotation);
+    result[3] = vec4(-(rotation * GetPosition(m)), 1.0f);
+    return result;
+  }
+
+  float WrapAngle(float angle)
+  {
+    const auto pi = glm::pi<float>();
+    if (angle > pi)
+    {
+      angle -= 2.0f * pi;
+    }
+    else if (angle <= -pi)
+    {
+      angle += 2.0f * pi;
+    }
+    return angle;
+  }
+
+  // 2 ボーンの脚を解析的に解く. 膝の回転軸が向きを決められない場合は false を返す.
+  bool SolveTwoBoneLeg(Skeleton& skeleton, const PMDBoneIK& boneIk)
+  {
+    const auto& chains = boneIk.GetChains();
+    const auto ankle = boneIk.GetTarget();
+    const auto knee = chains[0];
+    const auto hip = chains[1];
+
+    auto goalPos = GetPosition(skeleton.GetWorldMatrix(boneIk.GetEffector()));
+    auto hipPos = GetPosition(skeleton.GetWorldMatrix(hip));
+
+    // 膝の X 軸回りの角度 φ を, 股関節から足首までの距離が目標までの距離 d になるように決める.
+    // 股の空間で 股->膝 を k, 膝の空間で 膝->足首 を a とすると |k + Rx(φ) a|^2 = d^2 より
+    //   p cos φ + q sin φ = c
+    //   p = k.y a.y + k.z a.z,  q = k.z a.y - k.y a.z,  c = (d^2 - |k|^2 - |a|^2) / 2 - k.x a.x
+    const auto& k = skeleton.GetTranslation(knee);
+    const auto& a = skeleton.GetTranslation(ankle);
+    auto lengthK = length(k);
+    auto lengthA = length(a);
+    auto d = clamp(length(goalPos - hipPos), std::abs(lengthK - lengthA), lengthK + lengthA);
+    auto p = k.y * a.y + k.z * a.z;
+    auto q = k.z * a.y - k.y * a.z;
+    auto c = (d * d - lengthK * lengthK - lengthA * lengthA) * 0.5f - k.x * a.x;
+    auto r = std::sqrt(p * p + q * q);
+    if (r < 1.0e-6f)
+    {
+      return false;
+    }
+
+    // 解は 2 つあり, 膝が曲がる向き(X 軸回りに正)のものを使う.
+    auto alpha = std::atan2(q, p);
+    auto beta = std::acos(clamp(c / r, -1.0f, 1.0f));
+    auto angle = WrapAngle(alpha + beta);
+    if (angle < 0.0f)
+    {
+      angle = WrapAngle(alpha - beta);
+    }
+    angle = clamp(angle, 0.0f, glm::pi<float>());
+    skeleton.SetRotation(knee, angleAxis(angle, vec3(1.0f, 0.0f, 0.0f)));
+
+    // 股を回転させて, 足首を目標の方向へ向ける.
+    auto mtxInvHip = InverseRigid(skeleton.GetWorldMatrix(hip));
+    auto anklePos = vec3(mtxInvHip * vec4(GetPosition(skeleton.GetWorldMatrix(ankle)), 1.0f));
+    auto targetPos = vec3(mtxInvHip * vec4(goalPos, 1.0f));
+    if (dot(anklePos, anklePos) < Tolerance || dot(targetPos, targetPos) < Tolerance)
+    {
+      return true;
+    }
+    auto rotation = glm::rotation(normalize(anklePos), normalize(targetPos));
+    skeleton.SetRotation(hip, normalize(skeleton.GetRotation(hip) * rotation));
+    return true;
+  }
+}
+
+void PMDBoneIK::SetIkChains(const std::vector<uint32_t>& chains, const Skeleton& skeleton)
+{
+  m_ikChains = chains;
+  m_kneeFlags.resize(chains.size());
+  for (size_t i = 0; i < chains.size(); ++i)
+  {
+    m_kneeFlags[i] = skeleton.GetName(chains[i]).find(KneeBoneName) != std::string::npos;
+  }
+
+  m_twoBoneLeg = chains.size() == 2 && m_kneeFlags[0] && !m_kneeFlags[1] &&
+    skeleton.GetParent(m_target) == int32_t(chains[0]) &&
+    skeleton.GetParent(chains[0]) == int32_t(chains[1]);
+}
+
+void SolveBoneIK(Skeleton& skeleton, const PMDBoneIK& boneIk)
+{
+  if (boneIk.IsTwoBoneLeg() && SolveTwoBoneLeg(skeleton, boneIk))
+  {
+    return;
+  }
+  SolveBoneIKCCD(skeleton, boneIk);
+}
+
+void SolveBoneIKCCD(Skeleton& skeleton, const PMDBoneIK& boneIk)
+{
+  auto target = boneIk.GetTarget();
+  auto eff = boneIk.GetEffector();
+  auto limitAngle = boneIk.GetAngleWeight();
+
+  const auto& chains = boneIk.GetChains();
+  for (int ite = 0; ite < boneIk.GetIterationCount(); ++ite)
+  {
+    bool rotated = false;
+    for (uint32_t i = 0; i < chains.size(); ++i)
+    {
+      // 距離は剛体変換で変わらないので, ワールド空間で収束を判定する.
+      auto effectorWorld = GetPosition(skeleton.GetWorldMatrix(eff));
+      auto targetWorld = GetPosition(skeleton.GetWorldMatrix(target));
+      auto diff = targetWorld - effectorWorld;
+      if (dot(diff, diff) < Tolerance)
+      {
+        return;
+      }
+
+      // エフェクタとターゲットの位置を、現在ボーンでのローカル空間にする.
+      auto bone = chains[i];
+      auto mtxInvBone = InverseRigid(skeleton.GetWorldMatrix(bone));
+      auto effectorPos = vec3(mtxInvBone * vec4(effectorWorld, 1.0f));
+      auto targetPos = vec3(mtxInvBone * vec4(targetWorld, 1.0f));
+
+      // 現ボーンよりターゲットおよびエフェクタへ向かうベクトルを生成.
+      auto vecToEff = normalize(effectorPos);
+      auto vecToTarget = normalize(targetPos);
+
+      auto radian = std::acos(clamp(dot(vecToEff, vecToTarget), -1.0f, 1.0f));
+      radian = std::min(radian, limitAngle);
+      if (radian < 0.001f)
+      {
+        continue;
+      }
+
+      // 回転軸を求める.
+      auto axis = normalize(cross(vecToTarget, vecToEff));
+
+      quat rotation;
+      if (boneIk.IsKnee(i))
+      {
+        // 膝は X 軸回りの成分のみを使う.
+        auto angle = clamp(radian * axis.x, MinKneeAngle, glm::pi<float>());
+        rotation = angleAxis(angle, vec3(1.0f, 0.0f, 0.0f));
+      }
+      else
+      {
+        rotation = angleAxis(radian, axis);
+      }
+      skeleton.SetRotation(bone, normalize(skeleton.GetRotation(bone) * rotation));
+      rotated = true;
+    }
+
+    // どのボーンも回転しなければ, 以降の反復でも変わらない.
+    if (!rotated)
+    {
+      break;
+    }
+  }
+}
@@ -0,0 +1,45 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Skeleton.h"
+
+// PMD の IK 情報. ボーンはいずれも Skeleton のボーン番号.
+// ターゲット(足首など)がエフェクタ(IK ボーン)の位置に来るように, チェインのボーンを回転させる.
+// チェインはターゲットに近い方から並ぶ.
+class PMDBoneIK
+{
+public:
+  PMDBoneIK() : m_effector(0), m_target(0), m_angleLimit(0.0f), m_iteration(0), m_twoBoneLeg(false) { }
+  PMDBoneIK(uint32_t target, uint32_t eff) : m_effector(eff), m_target(target), m_angleLimit(0.0f), m_iteration(0), m_twoBoneLeg(false) { }
+
+  uint32_t GetEffector() const { return m_effector; }
+  uint32_t GetTarget() const { return m_target; }
+  float GetAngleWeight() const { return m_angleLimit; }
+  const std::vector<uint32_t>& GetChains() const { return m_ikChains; }
+  int GetIterationCount() const { return m_iteration; }
+
+  // 膝(X 軸回りにのみ曲がる)のボーンか. index は GetChains の番号.
+  bool IsKnee(uint32_t index) const { return m_kneeFlags[index] != 0; }
+  // 膝とその親の 2 ボーンからなり, ターゲットが膝の子である脚の IK か.
+  // この場合は反復せずに解析的に解く.
+  bool IsTwoBoneLeg() const { return m_twoBoneLeg; }
+
+  void SetAngleLimit(float angle) { m_angleLimit = angle; }
+  void SetIterationCount(int iterationCount) { m_iteration = iterationCount; }
+  // 膝の判定はボーン名で行うため, ここで 1 度だけ行う.
+  void SetIkChains(const std::vector<uint32_t>& chains, const Skeleton& skeleton);
+private:
+  uint32_t m_effector;
+  uint32_t m_target;
+  std::vector<uint32_t> m_ikChains;
+  std::vector<uint8_t> m_kneeFlags;
+  float m_angleLimit;
+  int   m_iteration;
+  bool  m_twoBoneLeg;
+};
+
+// チェインのボーンの回転を変更する. 脚の IK は解析的に, それ以外は CCD で解く.
+void SolveBoneIK(Skeleton& skeleton, const PMDBoneIK& boneIk);
+// 常に CCD で解く.
+void SolveBoneIKCCD(Skeleton& skeleton, const PMDBoneIK& boneIk);
@@ -0,0 +1,633 @@
+﻿#include "CompressedClip.h"
+#include "Animator.h"
+#include "PoseKernel.h"
+#include "SimdMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace
+{
+  const uint32_t ChunkSize = CompressedClip::ChunkSize;
+
+  // 最大成分以外の成分は ±1/√2 の範囲に収まる.
+  const float SmallestThreeRange = 0.70710678f;
+
+  // 最大成分を正にそろえ, 残り 3 成分を bits ビットに量子化する. 戻り値は最大成分の番号.
+  uint32_t EncodeSmallestThree(const glm::quat& rotation, uint32_t bits, uint32_t values[3])
+  {
+    float c[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+    uint32_t largest = 0;
+    for (uint32_t i = 1; i < 4; ++i)
+    {
+      if (std::abs(c[i]) > std::abs(c[largest]))
+      {
+        largest = i;
+      }
+    }
+    auto sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+    auto maxValue = float((1u << bits) - 1);
+    for (uint32_t i = 0, j = 0; i < 4; ++i)
+    {
+      if (i == largest)
+      {
+        continue;
+      }
+      auto v = (c[i] * sign + SmallestThreeRange) / (2.0f * SmallestThreeRange);
+      values[j++] = uint32_t(std::min(std::max(v, 0.0f), 1.0f) * maxValue + 0.5f);
+    }
+    return largest;
+  }
+
+  // 最大成分の番号ごとの, x, y, z, w それぞれの復元元. 復元元は量子化した 3 成分と, 最後に置いた最大成分.
+  const uint8_t SmallestThreeOrder[4][4] = {
+    { 3, 0, 1, 2 }, { 0, 3, 1, 2 }, { 0, 1, 3, 2 }, { 0, 1, 2, 3 },
+  };
+
+  // 3 成分と最大成分の番号から x, y, z, w を復元する.
+  inline void DecodeSmallestThree(uint32_t largest, float a, float b, float c, float q[4])
+  {
+    float v[4] = { a, b, c, std::sqrt(std::max(0.0f, 1.0f - a * a - b * b - c * c)) };
+    const auto& o = SmallestThreeOrder[largest];
+    q[0] = v[o[0]];
+    q[1] = v[o[1]];
+    q[2] = v[o[2]];
+    q[3] = v[o[3]];
+  }
+
+  inline float DequantizeRotation(uint32_t value, float scale)
+  {
+    return float(value) * scale - SmallestThreeRange;
+  }
+
+  float RotationScale(uint32_t bits)
+  {
+    return 2.0f * SmallestThreeRange / float((1u << bits) - 1);
+  }
+
+  uint32_t PackRotation32(uint32_t largest, const uint32_t v[3])
+  {
+    return (largest << 30) | (v[0] << 20) | (v[1] << 10) | v[2];
+  }
+
+  // 15bit の 3 成分の下位に最大成分の番号を 1bit ずつ入れる.
+  void PackRotation48(uint32_t largest, const uint32_t v[3], uint16_t packed[3])
+  {
+    packed[0] = uint16_t((v[0] << 1) | (largest & 1));
+    packed[1] = uint16_t((v[1] << 1) | (largest >> 1));
+    packed[2] = uint16_t(v[2] << 1);
+  }
+
+  glm::quat QuantizeRotation(const glm::quat& rotation, uint32_t bits)
+  {
+    uint32_t v[3];
+    auto largest = EncodeSmallestThree(rotation, bits, v);
+    auto scale = RotationScale(bits);
+    float q[4];
+    DecodeSmallestThree(largest,
+      DequantizeRotation(v[0], scale), DequantizeRotation(v[1], scale), DequantizeRotation(v[2], scale), q);
+    return glm::quat(q[3], q[0], q[1], q[2]);
+  }
+
+  // 2 つの回転の差の角度. 1 に近い内積の acos は精度が出ないため, 4 次元での弦の長さから求める.
+  double RotationError(const glm::quat& a, const glm::quat& b)
+  {
+    double dot = double(a.x) * b.x + double(a.y) * b.y + double(a.z) * b.z + double(a.w) * b.w;
+    double sign = dot < 0.0 ? -1.0 : 1.0;
+    double dx = a.x - sign * b.x, dy = a.y - sign * b.y, dz = a.z - sign * b.z, dw = a.w - sign * b.w;
+    double chord = std::sqrt(dx * dx + dy * dy + dz * dz + dw * dw);
+    return 4.0 * std::asin(std::min(chord * 0.5, 1.0));
+  }
+
+  // 全てのキーが先頭のキーから tolerance 以内. 区間内の補間も同じ範囲に収まる.
+  bool IsConstantRotation(const std::vector<glm::quat>& rotations, float tolerance)
+  {
+    for (const auto& rotation : rotations)
+    {
+      if (RotationError(rotations[0], rotation) > tolerance)
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // bits ビットに量子化したキーが, キーの位置と各区間の中間で tolerance を満たすか.
+  bool IsRotationWithinTolerance(const std::vector<glm::quat>& rotations, uint32_t bits, float tolerance)
+  {
+    glm::quat previous;
+    for (size_t i = 0; i < rotations.size(); ++i)
+    {
+      auto quantized = QuantizeRotation(rotations[i], bits);
+      if (RotationError(rotations[i], quantized) > tolerance)
+      {
+        return false;
+      }
+      if (i > 0 && RotationError(glm::slerp(rotations[i - 1], rotations[i], 0.5f), glm::slerp(previous, quantized, 0.5f)) > tolerance)
+      {
+        return false;
+      }
+      previous = quantized;
+    }
+    return true;
+  }
+
+  inline float QuantizeTranslation(float value, float minimum, float scale, float maxValue)
+  {
+    return scale > 0.0f ? std::floor(std::min(std::max((value - minimum) / scale + 0.5f, 0.0f), maxValue)) : 0.0f;
+  }
+
+  // 値の範囲を bits ビットに量子化したキーが tolerance を満たすか.
+  // 区間内は成分ごとに異なる補間率で補間するため, 両端の誤差の成分ごとの大きい方の長さで確かめる.
+  bool IsTranslationWithinTolerance(const std::vector<glm::vec3>& translations, const glm::vec3& minimum, const glm::vec3& scale,
+    uint32_t bits, float tolerance)
+  {
+    const auto maxValue = float((1u << bits) - 1);
+    glm::vec3 previous(0.0f);
+    for (size_t i = 0; i < translations.size(); ++i)
+    {
+      glm::vec3 error;
+      for (int c = 0; c < 3; ++c)
+      {
+        auto q = QuantizeTranslation(translations[i][c], minimum[c], scale[c], maxValue);
+        error[c] = std::abs(minimum[c] + scale[c] * q - translations[i][c]);
+      }
+      if (glm::length(glm::max(error, previous)) > tolerance)
+      {
+        return false;
+      }
+      previous = error;
+    }
+    return true;
+  }
+
+  template<class T>
+  void AppendValue(std::vector<uint8_t>& values, const T& value)
+  {
+    auto bytes = reinterpret_cast<const uint8_t*>(&value);
+    values.insert(values.end(), bytes, bytes + sizeof(T));
+  }
+
+  void AppendRotation(CompressedClip::TrackFormat format, const glm::quat& rotation, std::vector<uint8_t>& values)
+  {
+    uint32_t v[3];
+    switch (format)
+    {
+    case CompressedClip::Rotation32:
+    {
+      auto largest = EncodeSmallestThree(rotation, 10, v);
+      AppendValue(values, PackRotation32(largest, v));
+      break;
+    }
+    case CompressedClip::Rotation48:
+    {
+      auto largest = EncodeSmallestThree(rotation, 15, v);
+      uint16_t packed[3];
+      PackRotation48(largest, v, packed);
+      AppendValue(values, packed);
+      break;
+    }
+    default:
+    {
+      const float q[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+      AppendValue(values, q);
+      break;
+    }
+    }
+  }
+
+  void AppendTranslation(CompressedClip::TrackFormat format, const glm::vec3& translation,
+    const glm::vec3& minimum, const glm::vec3& scale, std::vector<uint8_t>& values)
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      switch (format)
+      {
+      case CompressedClip::Translation8:
+        AppendValue(values, uint8_t(QuantizeTranslation(translation[c], minimum[c], scale[c], 255.0f)));
+        break;
+      case CompressedClip::Translation16:
+        AppendValue(values, uint16_t(QuantizeTranslation(translation[c], minimum[c], scale[c], 65535.0f)));
+        break;
+      default:
+        AppendValue(values, translation[c]);
+        break;
+      }
+    }
+  }
+
+  // NodeAnimation::FindSegment と同じく, frame 以下で最後のキー(先頭より前では先頭)を求める.
+  // rate は次のキーまでの経過割合で, 次のキーが無い場合は 0.
+  uint32_t FindKey(const uint16_t* frames, uint32_t count, float frame, float& rate)
+  {
+    auto next = uint32_t(std::upper_bound(frames, frames + count, frame,
+      [](float f, uint16_t key) { return f < float(key); }) - frames);
+    rate = 0.0f;
+    if (next == 0)
+    {
+      return 0;
+    }
+    auto key = next - 1;
+    if (next < count)
+    {
+      rate = (frame - float(frames[key])) / float(frames[next] - frames[key]);
+    }
+    return key;
+  }
+
+  // 量子化した 3 成分 (quantized) と最大成分の番号から count 個の回転を復元し,
+  // rotation (x, y, z, w の順に ChunkSize 個ずつ) へ書き込む.
+  // 計算は最大成分を最後に置いた並びのまま Width 個ずつ行い, 書き込む際に並べ替える.
+  void DecodeSmallestThree(const float quantized[3][ChunkSize], const uint8_t* largest, float scale, uint32_t count, float* rotation)
+  {
+    alignas(32) float lanes[4][ChunkSize];
+    uint32_t k = 0;
+#if defined(SIMD_MATH_AVAILABLE)
+    using simd::Simd;
+    const auto vscale = Simd::Set(scale), range = Simd::Set(SmallestThreeRange);
+    for (; k + Simd::Width <= count; k += Simd::Width)
+    {
+      Simd::V q[3];
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        q[c] = Simd::Sub(Simd::Mul(Simd::Load(&quantized[c][k]), vscale), range);
+        Simd::Store(&lanes[c][k], q[c]);
+      }
+      auto squared = Simd::Add(Simd::Mul(q[0], q[0]), Simd::Add(Simd::Mul(q[1], q[1]), Simd::Mul(q[2], q[2])));
+      Simd::Store(&lanes[3][k], Simd::Sqrt(Simd::Max(Simd::Set(0.0f), Simd::Sub(Simd::Set(1.0f), squared))));
+    }
+#endif
+    for (; k < count; ++k)
+    {
+      float squared = 0.0f;
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        lanes[c][k] = quantized[c][k] * scale - SmallestThreeRange;
+        squared += lanes[c][k] * lanes[c][k];
+      }
+      lanes[3][k] = std::sqrt(std::max(0.0f, 1.0f - squared));
+    }
+    for (k = 0; k < count; ++k)
+    {
+      const auto& o = SmallestThreeOrder[largest[k]];
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        rotation[c * ChunkSize + k] = lanes[o[c]][k];
+      }
+    }
+  }
+
+  // format の values から keys の count 個の回転を rotation (x, y, z, w の順に ChunkSize 個ずつ) へ読み出す.
+  void ReadRotations(CompressedClip::TrackFormat format, const uint8_t* values, const uint32_t* keys, uint32_t count, float* rotation)
+  {
+    alignas(32) float quantized[3][ChunkSize];
+    uint8_t largest[ChunkSize];
+    switch (format)
+    {
+    case CompressedClip::Rotation32:
+      for (uint32_t k = 0; k < count; ++k)
+      {
+        uint32_t w;
+        std::memcpy(&w, values + sizeof(uint32_t) * keys[k], sizeof(w));
+        largest[k] = uint8_t(w >> 30);
+        quantized[0][k] = float((w >> 20) & 1023);
+        quantized[1][k] = float((w >> 10) & 1023);
+        quantized[2][k] = float(w & 1023);
+      }
+      DecodeSmallestThree(quantized, largest, RotationScale(10), count, rotation);
+      break;
+    case CompressedClip::Rotation48:
+      for (uint32_t k = 0; k < count; ++k)
+      {
+        uint16_t p[3];
+        std::memcpy(p, values + sizeof(p) * keys[k], sizeof(p));
+        largest[k] = uint8_t((p[0] & 1) | ((p[1] & 1) << 1));
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+          quantized[c][k] = float(p[c] >> 1);
+        }
+      }
+      DecodeSmallestThree(quantized, largest, RotationScale(15), count, rotation);
+      break;
+    default:
+      for (uint32_t k = 0; k < count; ++k)
+      {
+        float q[4];
+        std::memcpy(q, values + sizeof(q) * keys[k], sizeof(q));
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+          rotation[c * ChunkSize + k] = q[c];
+        }
+      }
+      break;
+    }
+  }
+
+  inline void ReadTranslation(CompressedClip::TrackFormat format, const uint8_t* values, uint32_t key,
+    const glm::vec3& minimum, const glm::vec3& scale, float t[3])
+  {
+    switch (format)
+    {
+    case CompressedClip::Translation8:
+      for (int c = 0; c < 3; ++c)
+      {
+        t[c] = minimum[c] + scale[c] * float(values[3 * key + c]);
+      }
+      break;
+    case CompressedClip::Translation16:
+    {
+      uint16_t q[3];
+      std::memcpy(q, values + sizeof(q) * key, sizeof(q));
+      for (int c = 0; c < 3; ++c)
+      {
+        t[c] = minimum[c] + scale[c] * float(q[c]);
+      }
+      break;
+    }
+    default:
+      std::memcpy(t, values + sizeof(float) * 3 * key, sizeof(float) * 3);
+      break;
+    }
+  }
+
+  // ChunkSize 本分の区間の両端と補間率. BlendPoses にそのまま渡す.
+  // 使わない側の成分(回転のトラックでの移動量など)は移動量 0, 回転なし, 補間率 0 のままにする.
+  struct BlendChunk
+  {
+    alignas(32) float start[AnimationPose::ChannelCount * ChunkSize];
+    alignas(32) float last[AnimationPose::ChannelCount * ChunkSize];
+    alignas(32) float rates[4 * ChunkSize];
+
+    BlendChunk()
+    {
+      std::fill(std::begin(start), std::end(start), 0.0f);
+      std::fill(std::begin(last), std::end(last), 0.0f);
+      std::fill(std::begin(rates), std::end(rates), 0.0f);
+      std::fill(start + AnimationPose::RotationW * ChunkSize, start + (AnimationPose::RotationW + 1) * ChunkSize, 1.0f);
+      std::fill(last + AnimationPose::RotationW * ChunkSize, last + (AnimationPose::RotationW + 1) * ChunkSize, 1.0f);
+    }
+  };
+}
+
+void CompressedClip::Build(const std::vector<const NodeAnimation*>& tracks, const std::vector<glm::vec3>& offsets,
+  std::shared_ptr<const BezierEasingTable> easing, const ClipCompressionSettings& settings)
+{
+  *this = CompressedClip();
+  m_boneCount = uint32_t(tracks.size());
+  m_easing = std::move(easing);
+
+  std::unordered_map<uint32_t, uint16_t> curveMap;
+  auto addCurve = [&](uint32_t curve) {
+    auto itr = curveMap.find(curve);
+    if (itr != curveMap.end())
+    {
+      return itr->second;
+    }
+    if (m_curves.size() > 0xffff)
+    {
+      throw std::runtime_error("CompressedClip: too many interpolation curves.");
+    }
+    auto index = uint16_t(m_curves.size());
+    m_curves.push_back(curve);
+    curveMap.emplace(curve, index);
+    return index;
+  };
+
+  std::vector<glm::quat> rotations;
+  std::vector<glm::vec3> translations;
+  for (uint32_t bone = 0; bone < m_boneCount; ++bone)
+  {
+    const auto& keys = tracks[bone]->GetKeyframes();
+    const auto& tolerance = settings.GetTolerance(bone);
+    const auto offset = bone < offsets.size() ? offsets[bone] : glm::vec3(0.0f);
+    if (keys.empty())
+    {
+      m_constantRotationBones.push_back(bone);
+      m_constantRotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+      m_constantTranslationBones.push_back(bone);
+      m_constantTranslations.push_back(offset);
+      continue;
+    }
+    if (keys.back().frame > 0xffff)
+    {
+      throw std::runtime_error("CompressedClip: key frame exceeds 65535.");
+    }
+    const auto keyCount = uint32_t(keys.size());
+    rotations.resize(keyCount);
+    translations.resize(keyCount);
+    for (uint32_t i = 0; i < keyCount; ++i)
+    {
+      rotations[i] = glm::normalize(keys[i].rotation);
+      translations[i] = keys[i].translation + offset;
+    }
+
+    // 回転. 許容誤差を満たす形式を選ぶ.
+    if (IsConstantRotation(rotations, tolerance.rotation))
+    {
+      m_constantRotationBones.push_back(bone);
+      m_constantRotations.push_back(rotations[0]);
+    }
+    else
+    {
+      auto format = IsRotationWithinTolerance(rotations, 10, tolerance.rotation) ? Rotation32 :
+        IsRotationWithinTolerance(rotations, 15, tolerance.rotation) ? Rotation48 : RotationRaw;
+      auto& set = m_trackSets[format];
+      set.tracks.push_back(Track{ bone, uint32_t(set.frames.size()), keyCount, glm::vec3(0.0f), glm::vec3(0.0f) });
+      for (uint32_t i = 0; i < keyCount; ++i)
+      {
+        set.frames.push_back(uint16_t(keys[i].frame));
+        set.curves.push_back(addCurve(keys[i].interpCurves[3]));
+        AppendRotation(format, rotations[i], set.values);
+      }
+    }
+
+    // 移動量. 定数とする場合の誤差は値の範囲の対角線の半分以下.
+    auto minimum = translations[0], maximum = translations[0];
+    for (const auto& translation : translations)
+    {
+      minimum = glm::min(minimum, translation);
+      maximum = glm::max(maximum, translation);
+    }
+    auto extent = maximum - minimum;
+    if (glm::length(extent) * 0.5f <= tolerance.translation)
+    {
+      m_constantTranslationBones.push_back(bone);
+      m_constantTranslations.push_back((minimum + maximum) * 0.5f);
+    }
+    else
+    {
+      auto format = TranslationRaw;
+      glm::vec3 scale(0.0f);
+      for (uint32_t bits : { 8u, 16u })
+      {
+        auto candidate = extent / float((1u << bits) - 1);
+        if (IsTranslationWithinTolerance(translations, minimum, candidate, bits, tolerance.translation))
+        {
+          format = bits == 8 ? Translation8 : Translation16;
+          scale = candidate;
+          break;
+        }
+      }
+      auto& set = m_trackSets[format];
+      set.tracks.push_back(Track{ bone, uint32_t(set.frames.size()), keyCount, minimum, scale });
+      for (uint32_t i = 0; i < keyCount; ++i)
+      {
+        set.frames.push_back(uint16_t(keys[i].frame));
+        for (int c = 0; c < 3; ++c)
+        {
+          set.curves.push_back(addCurve(keys[i].interpCurves[c]));
+        }
+        AppendTranslation(format, translations[i], minimum, scale, set.values);
+      }
+    }
+  }
+}
+
+void CompressedClip::Sample(float frame, AnimationPose& pose) const
+{
+  if (pose.GetBoneCount() != m_boneCount)
+  {
+    pose.Resize(m_boneCount);
+  }
+
+  for (size_t i = 0; i < m_constantRotationBones.size(); ++i)
+  {
+    pose.SetRotation(m_constantRotationBones[i], m_constantRotations[i]);
+  }
+  for (size_t i = 0; i < m_constantTranslationBones.size(); ++i)
+  {
+    pose.SetTranslation(m_constantTranslationBones[i], m_constantTranslations[i]);
+  }
+  for (auto format : { Rotation32, Rotation48, RotationRaw })
+  {
+    DecodeRotations(format, frame, pose);
+  }
+  for (auto format : { Translation8, Translation16, TranslationRaw })
+  {
+    DecodeTranslations(format, frame, pose);
+  }
+}
+
+void CompressedClip::DecodeRotations(TrackFormat format, float frame, AnimationPose& pose) const
+{
+  const auto& set = m_trackSets[format];
+  const auto trackCount = uint32_t(set.tracks.size());
+  if (trackCount == 0)
+  {
+    return;
+  }
+
+  float* const rotation[4] = {
+    pose.GetChannel(AnimationPose::RotationX), pose.GetChannel(AnimationPose::RotationY),
+    pose.GetChannel(AnimationPose::RotationZ), pose.GetChannel(AnimationPose::RotationW),
+  };
+  BlendChunk chunk;
+  uint32_t keys[2][ChunkSize];
+  for (uint32_t first = 0; first < trackCount; first += ChunkSize)
+  {
+    const auto count = std::min(ChunkSize, trackCount - first);
+    for (uint32_t k = 0; k < count; ++k)
+    {
+      const auto& track = set.tracks[first + k];
+      float rate;
+      auto key = track.firstKey + FindKey(&set.frames[track.firstKey], track.keyCount, frame, rate);
+      keys[0][k] = key;
+      keys[1][k] = rate > 0.0f ? key + 1 : key;
+      chunk.rates[3 * ChunkSize + k] = rate > 0.0f ? m_easing->Evaluate(m_curves[set.curves[key]], rate) : 0.0f;
+    }
+    ReadRotations(format, set.values.data(), keys[0], count, chunk.start + AnimationPose::RotationX * ChunkSize);
+    ReadRotations(format, set.values.data(), keys[1], count, chunk.last + AnimationPose::RotationX * ChunkSize);
+    BlendPoses(chunk.start, chunk.last, chunk.rates, 0.0f, true, ChunkSize, chunk.start);
+
+    for (uint32_t k = 0; k < count; ++k)
+    {
+      auto bone = set.tracks[first + k].bone;
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        rotation[c][bone] = chunk.start[(AnimationPose::RotationX + c) * ChunkSize + k];
+      }
+    }
+  }
+}
+
+void CompressedClip::DecodeTranslations(TrackFormat format, float frame, AnimationPose& pose) const
+{
+  const auto& set = m_trackSets[format];
+  const auto trackCount = uint32_t(set.tracks.size());
+  if (trackCount == 0)
+  {
+    return;
+  }
+
+  float* const translation[3] = {
+    pose.GetChannel(AnimationPose::TranslationX), pose.GetChannel(AnimationPose::TranslationY),
+    pose.GetChannel(AnimationPose::TranslationZ),
+  };
+  BlendChunk chunk;
+  for (uint32_t first = 0; first < trackCount; first += ChunkSize)
+  {
+    const auto count = std::min(ChunkSize, trackCount - first);
+    for (uint32_t k = 0; k < count; ++k)
+    {
+      const auto& track = set.tracks[first + k];
+      float rate;
+      auto key = track.firstKey + FindKey(&set.frames[track.firstKey], track.keyCount, frame, rate);
+      auto next = rate > 0.0f ? key + 1 : key;
+      float t[2][3];
+      ReadTranslation(format, set.values.data(), key, track.minimum, track.scale, t[0]);
+      ReadTranslation(format, set.values.data(), next, track.minimum, track.scale, t[1]);
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        chunk.start[c * ChunkSize + k] = t[0][c];
+        chunk.last[c * ChunkSize + k] = t[1][c];
+        chunk.rates[c * ChunkSize + k] = rate > 0.0f ? m_easing->Evaluate(m_curves[set.curves[3 * key + c]], rate) : 0.0f;
+      }
+    }
+    BlendPoses(chunk.start, chunk.last, chunk.rates, 0.0f, true, ChunkSize, chunk.start);
+
+    for (uint32_t k = 0; k < count; ++k)
+    {
+      auto bone = set.tracks[first + k].bone;
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        translation[c][bone] = chunk.start[c * ChunkSize + k];
+      }
+    }
+  }
+}
+
+uint32_t CompressedClip::GetKeyCount() const
+{
+  size_t count = 0;
+  for (const auto& set : m_trackSets)
+  {
+    count += set.frames.size();
+  }
+  return uint32_t(count);
+}
+
+size_t CompressedClip::GetMemorySize() const
+{
+  size_t size = (m_constantRotationBones.size() + m_constantTranslationBones.size()) * sizeof(uint32_t) +
+    m_constantRotations.size() * sizeof(glm::quat) +
+    m_constantTranslations.size() * sizeof(glm::vec3) +
+    m_curves.size() * sizeof(uint32_t);
+  for (const auto& set : m_trackSets)
+  {
+    size += set.tracks.size() * sizeof(Track) +
+      (set.frames.size() + set.curves.size()) * sizeof(uint16_t) + set.values.size();
+  }
+  return size;
+}
+
+uint32_t CompressedClip::GetTrackCount(TrackFormat format) const
+{
+  if (format == Constant)
+  {
+    return uint32_t(m_constantRotationBones.size() + m_constantTranslationBones.size());
+  }
+  return format < TrackFormatCount ? uint32_t(m_trackSets[format].tracks.size()) : 0;
+}
@@ -0,0 +1,112 @@
+﻿#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "AnimationPose.h"
+#include "BezierEasing.h"
+
+class NodeAnimation;
+
+// 圧縮時の許容誤差. 移動量はモデル座標での距離, 回転はラジアン.
+struct ClipCompressionSettings
+{
+  struct Tolerance
+  {
+    float translation;
+    float rotation;
+  };
+  Tolerance defaultTolerance = { 1.0e-3f, 1.0e-3f };
+  // ボーンごとの許容誤差. 範囲内のボーンは defaultTolerance の代わりにこちらを使う.
+  std::vector<Tolerance> boneTolerances;
+
+  const Tolerance& GetTolerance(uint32_t bone) const
+  {
+    return bone < boneTolerances.size() ? boneTolerances[bone] : defaultTolerance;
+  }
+};
+
+// ボーンアニメーションのキーフレームを量子化して保持する.
+//  - 許容誤差内で値が変化しないトラックは定数として 1 つだけ持ち, キーを捨てる.
+//  - 回転は最大成分を除いた 3 成分を量子化する(smallest three). 32bit(10bit x3) か 48bit(15bit x3).
+//    最大誤差は 32bit で 4.4e-3, 48bit で 1.4e-4 ラジアン程度.
+//  - 移動量はトラックごとの値の範囲で 8bit か 16bit に量子化する.
+// ビット幅はキーの位置と区間の中間で許容誤差を満たす小さい方を選び, どちらも満たさない場合は float のまま持つ.
+// キーのフレーム番号(0..65535)と補間曲線はそれぞれ 16bit で持ち, 曲線の表は元のモーションの BezierEasingTable を共有する.
+//
+// 再生は NodeAnimation::FindBlend と同じ区間と補間率で, Animator のキーフレームからの評価と同じく BlendPoses の slerp で補間する.
+// 同じ形式のトラックを ChunkSize 個ずつまとめて展開し, 回転の復元は PoseKernel と同じ命令セットで Width 個ずつ行う.
+// 再生位置を持たないため, 1 つのクリップを複数のスレッドから同時に使える.
+class CompressedClip
+{
+public:
+  enum TrackFormat
+  {
+    Constant,
+    Rotation32, Rotation48, RotationRaw,
+    Translation8, Translation16, TranslationRaw,
+    TrackFormatCount
+  };
+  static const uint32_t ChunkSize = 32;
+
+  CompressedClip() : m_boneCount(0) { }
+
+  // tracks[i] をクリップの i 番目のボーンとする. 移動量には offsets[i] を加える.
+  // 補間曲線の番号は easing のもの. フレーム番号が 65535 を超える場合, 曲線が 65536 種類を超える場合は例外を投げる.
+  void Build(const std::vector<const NodeAnimation*>& tracks, const std::vector<glm::vec3>& offsets,
+    std::shared_ptr<const BezierEasingTable> easing, const ClipCompressionSettings& settings);
+
+  // frame は 30fps 単位のフレーム番号(小数を含む).
+  void Sample(float frame, AnimationPose& pose) const;
+
+  uint32_t GetBoneCount() const { return m_boneCount; }
+  // 残したキーの数(回転と移動量の合計).
+  uint32_t GetKeyCount() const;
+  // 曲線の表(共有している BezierEasingTable)を含まない大きさ.
+  size_t GetMemorySize() const;
+
+  // 形式ごとのトラック数. Constant は回転と移動量の合計.
+  uint32_t GetTrackCount(TrackFormat format) const;
+private:
+  // 回転では minimum, scale は使わない.
+  struct Track
+  {
+    uint32_t bone;
+    uint32_t firstKey;
+    uint32_t keyCount;
+    glm::vec3 minimum;
+    glm::vec3 scale;
+  };
+  // 形式ごとのキー. Track::firstKey からの keyCount 個が 1 トラック分.
+  //   frames : キーのフレーム番号.
+  //   curves : m_curves の番号. 回転は 1 キーに 1 つ, 移動量は X, Y, Z の 3 つ.
+  //   values : 1 キーあたり Rotation32 は 4, Rotation48 は 6, RotationRaw は 16, Translation8 は 3,
+  //            Translation16 は 6, TranslationRaw は 12 バイト.
+  struct TrackSet
+  {
+    std::vector<Track> tracks;
+    std::vector<uint16_t> frames;
+    std::vector<uint16_t> curves;
+    std::vector<uint8_t> values;
+  };
+
+  void DecodeRotations(TrackFormat format, float frame, AnimationPose& pose) const;
+  void DecodeTranslations(TrackFormat format, float frame, AnimationPose& pose) const;
+
+  uint32_t m_boneCount;
+
+  // 定数トラック.
+  std::vector<uint32_t> m_constantRotationBones;
+  std::vector<glm::quat> m_constantRotations;
+  std::vector<uint32_t> m_constantTranslationBones;
+  std::vector<glm::vec3> m_constantTranslations;
+
+  // 形式ごとのトラック. Constant の要素は使わない.
+  TrackSet m_trackSets[TrackFormatCount];
+  // クリップで使う曲線の BezierEasingTable での番号.
+  std::vector<uint32_t> m_curves;
+  std::shared_ptr<const BezierEasingTable> m_easing;
+};
@@ -0,0 +1,219 @@
+﻿#include "FaceMorph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void CoalesceVertexRanges(std::vector<VertexRange>& ranges, uint32_t maxCount)
+{
+  if (ranges.empty())
+  {
+    return;
+  }
+  std::sort(ranges.begin(), ranges.end(), [](const VertexRange& a, const VertexRange& b) { return a.begin < b.begin; });
+
+  // 重なる範囲と隣接する範囲をまとめる.
+  size_t count = 1;
+  for (size_t i = 1; i < ranges.size(); ++i)
+  {
+    auto& last = ranges[count - 1];
+    if (ranges[i].begin <= last.end)
+    {
+      last.end = std::max(last.end, ranges[i].end);
+    }
+    else
+    {
+      ranges[count++] = ranges[i];
+    }
+  }
+  ranges.resize(count);
+
+  maxCount = std::max(maxCount, 1u);
+  if (count <= maxCount)
+  {
+    return;
+  }
+
+  // 間の狭い順に count - maxCount 箇所を併合する. 同じ幅の間は番号の小さい方から選ぶ.
+  std::vector<uint32_t> gaps(count - 1);
+  for (size_t i = 0; i < gaps.size(); ++i)
+  {
+    gaps[i] = ranges[i + 1].begin - ranges[i].end;
+  }
+  auto mergeCount = count - maxCount;
+  auto sortedGaps = gaps;
+  std::nth_element(sortedGaps.begin(), sortedGaps.begin() + (mergeCount - 1), sortedGaps.end());
+  auto threshold = sortedGaps[mergeCount - 1];
+  auto equalCount = mergeCount - size_t(std::count_if(gaps.begin(), gaps.end(), [threshold](uint32_t g) { return g < threshold; }));
+
+  size_t out = 0;
+  for (size_t i = 1; i < count; ++i)
+  {
+    auto gap = gaps[i - 1];
+    bool merge = gap < threshold;
+    if (gap == threshold && equalCount > 0)
+    {
+      merge = true;
+      --equalCount;
+    }
+    if (merge)
+    {
+      ranges[out].end = ranges[i].end;
+    }
+    else
+    {
+      ranges[++out] = ranges[i];
+    }
+  }
+  ranges.resize(out + 1);
+}
+
+void FaceMorph::Build(std::vector<uint32_t> baseIndices, std::vector<glm::vec3> basePositions, std::vector<Face> faces)
+{
+  if (baseIndices.size() != basePositions.size())
+  {
+    throw std::runtime_error("FaceMorph: base index and position counts differ.");
+  }
+  for (const auto& face : faces)
+  {
+    if (face.indices.size() != face.offsets.size())
+    {
+      throw std::runtime_error("FaceMorph: index and offset counts differ in " + face.name + ".");
+    }
+    for (auto index : face.indices)
+    {
+      if (index >= baseIndices.size())
+      {
+        throw std::runtime_error("FaceMorph: base vertex index out of range in " + face.name + ".");
+      }
+    }
+  }
+
+  m_baseIndices = std::move(baseIndices);
+  m_basePositions = std::move(basePositions);
+  m_faces = std::move(faces);
+  m_weights.assign(m_faces.size(), 0.0f);
+  m_appliedWeights = m_weights;
+  m_marks.assign(m_baseIndices.size(), 0);
+  m_touched.clear();
+}
+
+int FaceMorph::GetFaceIndex(const std::string& name) const
+{
+  for (uint32_t i = 0; i < m_faces.size(); ++i)
+  {
+    if (m_faces[i].name == name)
+    {
+      return int(i);
+    }
+  }
+  return -1;
+}
+
+void FaceMorph::Apply(float* positions, size_t stride, std::vector<VertexRange>& changed)
+{
+  auto position = [positions, stride](uint32_t vertex) -> glm::vec3& {
+    return *reinterpret_cast<glm::vec3*>(reinterpret_cast<char*>(positions) + stride * vertex);
+  };
+
+  // 重みが変わった表情が動かす頂点を集める.
+  m_touched.clear();
+  for (uint32_t faceIndex = 0; faceIndex < m_faces.size(); ++faceIndex)
+  {
+    if (m_weights[faceIndex] == m_appliedWeights[faceIndex])
+    {
+      continue;
+    }
+    for (auto baseIndex : m_faces[faceIndex].indices)
+    {
+      if (!m_marks[baseIndex])
+      {
+        m_marks[baseIndex] = 1;
+        m_touched.push_back(baseIndex);
+      }
+    }
+  }
+  m_appliedWeights = m_weights;
+  if (m_touched.empty())
+  {
+    return;
+  }
+
+  // 集めた頂点だけを表情ベースに戻し, 重みが 0 でない表情を足し直す.
+  for (auto baseIndex : m_touched)
+  {
+    position(m_baseIndices[baseIndex]) = m_basePositions[baseIndex];
+  }
+  for (uint32_t faceIndex = 0; faceIndex < m_faces.size(); ++faceIndex)
+  {
+    float w = m_weights[faceIndex];
+    if (w == 0.0f)
+    {
+      continue;
+    }
+    const auto& face = m_faces[faceIndex];
+    for (size_t i = 0; i < face.indices.size(); ++i)
+    {
+      auto baseIndex = face.indices[i];
+      if (m_marks[baseIndex])
+      {
+        position(m_baseIndices[baseIndex]) += face.offsets[i] * w;
+      }
+    }
+  }
+
+  // モデルでの頂点番号に直し, 連続する番号を 1 つの範囲にする.
+  for (auto& index : m_touched)
+  {
+    m_marks[index] = 0;
+    index = m_baseIndices[index];
+  }
+  std::sort(m_touched.begin(), m_touched.end());
+  VertexRange range{ m_touched.front(), m_touched.front() + 1 };
+  for (size_t i = 1; i < m_touched.size(); ++i)
+  {
+    auto vertex = m_touched[i];
+    if (vertex > range.end)
+    {
+      changed.push_back(range);
+      range.begin = vertex;
+    }
+    range.end = vertex + 1;
+  }
+  changed.push_back(range);
+}
+
+void FaceMorph::BuildVertexDeltas(uint32_t vertexCount, std::vector<uint32_t>& rowOffsets, std::vector<VertexDelta>& deltas) const
+{
+  for (auto index : m_baseIndices)
+  {
+    if (index >= vertexCount)
+    {
+      throw std::runtime_error("FaceMorph: vertex index out of range.");
+    }
+  }
+
+  // 頂点ごとの要素数を数えてから, 表情の順に詰める.
+  rowOffsets.assign(size_t(vertexCount) + 1, 0);
+  for (const auto& face : m_faces)
+  {
+    for (auto baseIndex : face.indices)
+    {
+      ++rowOffsets[m_baseIndices[baseIndex] + 1];
+    }
+  }
+  for (uint32_t i = 0; i < vertexCount; ++i)
+  {
+    rowOffsets[i + 1] += rowOffsets[i];
+  }
+  deltas.resize(rowOffsets.back());
+  std::vector<uint32_t> cursors(rowOffsets.begin(), rowOffsets.end() - 1);
+  for (uint32_t faceIndex = 0; faceIndex < m_faces.size(); ++faceIndex)
+  {
+    const auto& face = m_faces[faceIndex];
+    for (size_t i = 0; i < face.indices.size(); ++i)
+    {
+      auto vertex = m_baseIndices[face.indices[i]];
+      deltas[cursors[vertex]++] = VertexDelta{ face.offsets[i], faceIndex };
+    }
+  }
+}
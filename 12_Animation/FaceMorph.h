@@ -0,0 +1,77 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// 頂点番号の範囲 [begin, end).
+struct VertexRange
+{
+  uint32_t begin;
+  uint32_t end;
+};
+
+// ranges を並べ替えて重なりや隣接する範囲をまとめ, さらに間の狭いものから順に併合して maxCount 個以下にする.
+// 併合した範囲には変わっていない頂点も含まれるが, 転送の回数を抑えることを優先する.
+void CoalesceVertexRanges(std::vector<VertexRange>& ranges, uint32_t maxCount);
+
+// PMD の表情モーフ. 表情ベースの頂点位置に, オフセット表情の移動量へ重みを掛けて足す.
+// 前回の Apply から重みが変わった表情の頂点だけを計算し直し, 書き換えた頂点の範囲を返す.
+// 重みが 0 のまま変わらない表情は走査しない.
+class FaceMorph
+{
+public:
+  struct Face
+  {
+    std::string name;
+    std::vector<uint32_t> indices;    // 表情ベースでの頂点番号.
+    std::vector<glm::vec3> offsets;
+  };
+  // 頂点ごとにまとめた移動量の 1 要素. modelSkinningCS の MorphDelta と同じ並び.
+  struct VertexDelta
+  {
+    glm::vec3 offset;
+    uint32_t face;
+  };
+
+  // baseIndices は表情ベースの各頂点のモデルでの頂点番号. 重みは全て 0 になる.
+  // 表情ベースでの頂点番号が範囲外の場合は例外を投げる.
+  void Build(std::vector<uint32_t> baseIndices, std::vector<glm::vec3> basePositions, std::vector<Face> faces);
+
+  uint32_t GetFaceCount() const { return uint32_t(m_faces.size()); }
+  const Face& GetFace(uint32_t face) const { return m_faces[face]; }
+  // 見つからない場合は -1.
+  int GetFaceIndex(const std::string& name) const;
+  uint32_t GetBaseVertexCount() const { return uint32_t(m_baseIndices.size()); }
+  const std::vector<uint32_t>& GetBaseIndices() const { return m_baseIndices; }
+  const std::vector<glm::vec3>& GetBasePositions() const { return m_basePositions; }
+
+  void SetWeight(uint32_t face, float weight) { m_weights[face] = weight; }
+  float GetWeight(uint32_t face) const { return m_weights[face]; }
+  const std::vector<float>& GetWeights() const { return m_weights; }
+  // 前回の Apply から重みが変わった表情があるか.
+  bool IsDirty() const { return m_weights != m_appliedWeights; }
+
+  // 重みが変わった表情の頂点を計算し直し, positions から stride バイト間隔で並ぶ頂点位置へ書き込む.
+  // 書き換えた頂点の範囲を, 番号の昇順に連続する頂点をまとめて changed に追加する.
+  void Apply(float* positions, size_t stride, std::vector<VertexRange>& changed);
+
+  // 移動量をモデルの頂点ごとにまとめた CSR 形式にする. GPU で頂点ごとに表情モーフを適用するために使う.
+  // 頂点 v の移動量は deltas の [rowOffsets[v], rowOffsets[v + 1]) で, 表情の番号の昇順に並ぶ.
+  // 表情ベースの頂点位置は含まないため, 頂点の位置を表情ベースに合わせておくこと.
+  void BuildVertexDeltas(uint32_t vertexCount, std::vector<uint32_t>& rowOffsets, std::vector<VertexDelta>& deltas) const;
+
+private:
+  std::vector<uint32_t> m_baseIndices;
+  std::vector<glm::vec3> m_basePositions;
+  std::vector<Face> m_faces;
+  std::vector<float> m_weights;
+  // positions に反映済みの重み.
+  std::vector<float> m_appliedWeights;
+
+  // Apply の作業用. 計算し直す表情ベースの頂点の印と, その頂点のモデルでの番号.
+  std::vector<uint8_t> m_marks;
+  std::vector<uint32_t> m_touched;
+};
@@ -1,10 +1,18 @@
 #include "Model.h"
 #include "loader/PMDloader.h"
+#include "loader/PMDCooked.h"
 
 #include "VulkanAppBase.h"
 #include "VulkanBookUtil.h"
+#include "ThreadPool.h"
+#include "SkinningKernel.h"
 
+#include <algorithm>
 #include <fstream>
+#include <future>
+#include <limits>
+#include <memory>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
@@ -19,15 +27,19 @@ using namespace glm;
 
 
 
-inline Model::PMDVertex convertTo(const loader::PMDVertex& v)
-{
-  return Model::PMDVertex{
-    v.getPosition(), v.getNormal(), v.getUV(),
-    uvec2(v.getBoneIndex(0), v.getBoneIndex(1)),
-    vec2(v.getBoneWeight(0), v.getBoneWeight(1)),
-    v.getEdgeFlag(),
-  };
-}
+// modelSkinningCS  MorphDelta  std430  vec3  uint  16 oCg.
+static_assert(sizeof(FaceMorph::VertexDelta) == 16, "VertexDelta layout mismatch.");
+
+// [_[WJς݂̒_̂܂܎g, CAEgvĂKv.
+static_assert(sizeof(Model::PMDVertex) == sizeof(loader::PMDVertex), "PMDVertex layout mismatch.");
+static_assert(offsetof(Model::PMDVertex, boneIndices) == 32, "PMDVertex layout mismatch.");
+static_assert(offsetof(Model::PMDVertex, boneWeights) == 40, "PMDVertex layout mismatch.");
+static_assert(offsetof(Model::PMDVertex, edgeFlag) == 48, "PMDVertex layout mismatch.");
+// CPU ł̃XLjO͒_̂܂ SkinningVertex Ƃēǂ, ʂ SkinnedVertex Ƃď.
+static_assert(sizeof(Model::PMDVertex) == sizeof(SkinningVertex), "SkinningVertex layout mismatch.");
+static_assert(offsetof(Model::PMDVertex, boneIndices) == offsetof(SkinningVertex, boneIndices), "SkinningVertex layout mismatch.");
+static_assert(offsetof(Model::PMDVertex, boneWeights) == offsetof(SkinningVertex, boneWeights), "SkinningVertex layout mismatch.");
+static_assert(sizeof(Model::SkinnedVertex) == 8 * sizeof(float), "SkinnedVertex layout mismatch.");
 
 void Material::Update(VulkanAppBase* app)
 {
@@ -35,242 +47,364 @@ void Material::Update(VulkanAppBase* app)
   app->WriteToHostVisibleMemory(m_uniformBuffer.memory, bufferSize, &m_parameters );
 }
 
-void Bone::UpdateLocalMatrix()
+// fR[hς݂̃eNX`摜. f͔jƂ stbi_image_free ŉ.
+struct DecodedImage
 {
-  m_mtxLocal = glm::translate(m_translation) * glm::toMat4(m_rotation);
-}
+  int width;
+  int height;
+  std::unique_ptr<stbi_uc, void(*)(void*)> pixels{ nullptr, stbi_image_free };
+};
 
-void Bone::UpdateWorldMatrix()
+static DecodedImage DecodeImage(const std::string& fileName)
 {
-  UpdateLocalMatrix();
-  auto mtxParent = mat4(1.0f);
-  if (m_parent)
+  DecodedImage image{};
+  image.pixels.reset(stbi_load(fileName.c_str(), &image.width, &image.height, nullptr, 4));
+  if (image.pixels == nullptr)
   {
-    mtxParent = m_parent->GetWorldMatrix();
+    throw std::runtime_error("Failed to load texture. " + fileName);
   }
-  m_mtxWorld = mtxParent * m_mtxLocal;
+  return image;
 }
 
-
-void Bone::UpdateMatrices()
+// XR[v𔲂Ƃ func Ă. OŔꍇ̌nɎg.
+template<class Func>
+class ScopeExit
 {
-  UpdateWorldMatrix();
-  for (auto c : m_children)
+public:
+  explicit ScopeExit(Func func) : m_func(std::move(func)) { }
+  ~ScopeExit() { m_func(); }
+  ScopeExit(const ScopeExit&) = delete;
+  ScopeExit& operator=(const ScopeExit&) = delete;
+private:
+  Func m_func;
+};
+
+void Model::Load(const char* filename, VulkanAppBase* app, ThreadPool& pool)
+{
+  // ϊς݃f(.pmdc)̓t@Ĉ܂܎gp.
+  // PMD ̏ꍇ̓œ`֕ϊĂǂݍ.
+  auto mappedFile = std::make_shared<loader::MappedFile>(filename);
+  loader::PMDCookedFile loader;
+  if (IsCookedModelFile(filename))
   {
-    c->UpdateMatrices();
+    loader = loader::PMDCookedFile(mappedFile);
+  }
+  else
+  {
+    loader::PMDFile pmd(mappedFile);
+    loader = loader::PMDCookedFile(loader::cookPMD(pmd));
   }
-}
-
-void Model::Load(const char* filename, VulkanAppBase* app)
-{
-  ifstream infile(filename, std::ios::binary);
-  loader::PMDFile loader(infile);
   auto device = app->GetDevice();
 
-  auto vertexCount = loader.getVertexCount();
-  auto indexCount = loader.getIndexCount();
-  m_hostMemVertices.resize(vertexCount);
-  for (uint32_t i = 0; i < vertexCount; ++i)
+  // CPU ̏ pool ̃[J[Xbhŕɍs, Vulkan IuWFNg̐
+  // R}h̋L^̓CXbhōs. ]͍Ō 1 ŃTu~bg.
+
+  // eNX`̃fR[h. t@CQƂ}eA̓fR[hʂL.
+  const uint32_t materialCount = loader.getMaterialCount();
+  std::vector<int> materialTextures(materialCount, -1);
+  std::unordered_map<std::string, int> textureFiles;
+  std::vector<std::future<DecodedImage>> decodeTasks;
+  for (uint32_t i = 0; i < materialCount; ++i)
   {
-    m_hostMemVertices[i] = convertTo(loader.getVertex(i));
+    std::string textureFileName(loader::cooked::getName(loader.getMaterial(i).texture));
+    if (textureFileName.empty())
+    {
+      continue;
+    }
+    auto it = textureFiles.try_emplace(textureFileName, int(decodeTasks.size()));
+    if (it.second)
+    {
+      decodeTasks.push_back(pool.Submit([textureFileName]() { return DecodeImage(textureFileName); }));
+    }
+    materialTextures[i] = it.first->second;
+  }
+
+  // {[\z. eqOɗ悤ɕבւ, _ IK ̃{[ԍבւ̂̂ɂ.
+  uint32_t boneCount = loader.getBoneCount();
+  std::vector<Skeleton::BoneDesc> bones(boneCount);
+  for (uint32_t i = 0; i < boneCount; ++i)
+  {
+    const auto& boneSrc = loader.getBone(i);
+    bones[i] = Skeleton::BoneDesc{
+      std::string(loader::cooked::getName(boneSrc.name)), boneSrc.parent, boneSrc.translation, boneSrc.invBind
+    };
   }
-  std::vector<uint32_t> modelIndices(indexCount);
-  for (uint32_t i = 0; i < indexCount; ++i)
+  auto boneOrder = m_skeleton.Build(bones);
+  bool boneOrderChanged = false;
+  for (uint32_t i = 0; i < boneCount; ++i)
   {
-    auto& v = modelIndices[i];
-    v = loader.getIndices()[i];
+    boneOrderChanged |= (boneOrder[i] != i);
   }
 
+  // _ѕ\[t̃zXgf[^\z.
+  auto vertexCount = loader.getVertexCount();
+  std::vector<uint32_t> morphRowOffsets;
+  std::vector<FaceMorph::VertexDelta> morphDeltas;
+  auto geometryTask = pool.Submit([this, &loader, &boneOrder, boneOrderChanged, &morphRowOffsets, &morphDeltas]() {
+    m_hostMemVertices.resize(loader.getVertexCount());
+    memcpy(m_hostMemVertices.data(), loader.getVertexData(), loader.getVertexDataSize());
+    if (boneOrderChanged)
+    {
+      auto remap = [&boneOrder](uint32_t bone) { return bone < boneOrder.size() ? boneOrder[bone] : bone; };
+      for (auto& v : m_hostMemVertices)
+      {
+        v.boneIndices = glm::uvec2(remap(v.boneIndices.x), remap(v.boneIndices.y));
+      }
+    }
+
+    // _͂ޔ̒Sł_܂ł𔼌aƂ.
+    auto minPos = glm::vec3(std::numeric_limits<float>::max());
+    auto maxPos = -minPos;
+    for (const auto& v : m_hostMemVertices)
+    {
+      minPos = glm::min(minPos, v.position);
+      maxPos = glm::max(maxPos, v.position);
+    }
+    m_boundingCenter = m_hostMemVertices.empty() ? glm::vec3(0.0f) : (minPos + maxPos) * 0.5f;
+    m_boundingRadius = 0.0f;
+    for (const auto& v : m_hostMemVertices)
+    {
+      m_boundingRadius = std::max(m_boundingRadius, glm::length(v.position - m_boundingCenter));
+    }
+
+    // \x[XƃItZbg\[t.
+    auto baseCount = loader.getFaceBaseCount();
+    auto faceCount = loader.getFaceCount();
+    std::vector<FaceMorph::Face> faces(faceCount);
+    for (uint32_t i = 0; i < faceCount; ++i)
+    {
+      const auto& faceSrc = loader.getFace(i);
+      auto& face = faces[i];
+      face.name = loader::cooked::getName(faceSrc.name);
+
+      auto indices = loader.getFaceIndices(faceSrc);
+      auto offsets = loader.getFaceOffsets(faceSrc);
+      face.indices.assign(indices, indices + faceSrc.count);
+      face.offsets.assign(offsets, offsets + faceSrc.count);
+    }
+    m_faceMorph.Build(
+      std::vector<uint32_t>(loader.getFaceBaseIndices(), loader.getFaceBaseIndices() + baseCount),
+      std::vector<glm::vec3>(loader.getFaceBaseVertices(), loader.getFaceBaseVertices() + baseCount),
+      std::move(faces));
+    if (m_skinningMode == SKINNING_GPU && faceCount > MaxGpuFaceMorphCount)
+    {
+      throw std::runtime_error("Too many face morphs for GPU skinning.");
+    }
+
+    // _̈ʒu\x[Xɍ킹Ă, \[t͂̈ړʂƂēKp.
+    m_faceMorph.BuildVertexDeltas(uint32_t(m_hostMemVertices.size()), morphRowOffsets, morphDeltas);
+    const auto& baseIndices = m_faceMorph.GetBaseIndices();
+    const auto& basePositions = m_faceMorph.GetBasePositions();
+    for (size_t i = 0; i < baseIndices.size(); ++i)
+    {
+      m_hostMemVertices[baseIndices[i]].position = basePositions[i];
+    }
+    // ̃obt@͍Ȃ, \[tꍇ_~[ 1 u.
+    if (morphDeltas.empty())
+    {
+      morphDeltas.push_back(FaceMorph::VertexDelta{ glm::vec3(0.0f), 0 });
+    }
+  });
+  // OŔꍇ, ^XNQƂĂ郍[JϐjOɏÎ҂.
+  ScopeExit joinGeometryTask([&geometryTask]() {
+    if (geometryTask.valid())
+    {
+      geometryTask.wait();
+    }
+  });
+
+  auto indexCount = loader.getIndexCount();
   uint32_t bufferSizeIB = indexCount * sizeof(uint32_t);
   VkMemoryPropertyFlags stageMemProps = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
   const auto deviceLocal = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
   VkBufferUsageFlagBits stage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+  // Stageing => DeviceLocal ֓]. Xe[WOobt@ƃR}hobt@,
+  // OŔꍇ܂߂čŌɉ.
+  std::vector<VulkanAppBase::BufferObject> stagingBuffers;
+  auto command = app->CreateCommandBuffer();
+  ScopeExit releaseTransfer([&]() {
+    for (auto& buffer : stagingBuffers)
+    {
+      app->DestroyBuffer(buffer);
+    }
+    app->FreeCommandBuffer(command);
+  });
+
   auto stagingIB = app->CreateBuffer(bufferSizeIB, stage, stageMemProps);
+  stagingBuffers.push_back(stagingIB);
 
   m_indexBuffer = app->CreateBuffer(bufferSizeIB,
     VK_BUFFER_USAGE_INDEX_BUFFER_BIT  | VK_BUFFER_USAGE_TRANSFER_DST_BIT, deviceLocal );
 
-  app->WriteToHostVisibleMemory(stagingIB.memory, bufferSizeIB, modelIndices.data());
+  app->WriteToHostVisibleMemory(stagingIB.memory, bufferSizeIB, loader.getIndices());
 
-  // Stageing => DeviceLocal ֓].
-  auto command = app->CreateCommandBuffer();
   VkBufferCopy copyRegion{};
   copyRegion.size = bufferSizeIB;
   vkCmdCopyBuffer(command, stagingIB.buffer, m_indexBuffer.buffer, 1, &copyRegion);
-  app->FinishCommandBuffer(command);
-  app->DestroyBuffer(stagingIB);
 
   const uint32_t imageCount = app->GetSwapchain()->GetImageCount();
-  m_vertexBuffers.resize(imageCount);
-  uint32_t bufferSizeVB = vertexCount * sizeof(PMDVertex);
+  m_skinnedVertexBuffers.resize(imageCount);
+  m_mappedSkinnedVertices.assign(imageCount, nullptr);
+  m_morphedVertexRanges.assign(imageCount, std::vector<VertexRange>());
+  m_skinAllVertices.assign(imageCount, 1);
+  uint32_t bufferSizeSkinnedVB = vertexCount * sizeof(SkinnedVertex);
+  auto skinnedMemProps = m_skinningMode == SKINNING_CPU ? stageMemProps : deviceLocal;
   for (uint32_t i = 0; i < imageCount; ++i)
   {
-    m_vertexBuffers[i] = app->CreateBuffer(bufferSizeVB, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, stageMemProps);
+    m_skinnedVertexBuffers[i] = app->CreateBuffer(bufferSizeSkinnedVB, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, skinnedMemProps);
+    if (m_skinningMode == SKINNING_CPU)
+    {
+      void* p;
+      auto result = vkMapMemory(device, m_skinnedVertexBuffers[i].memory, 0, VK_WHOLE_SIZE, 0, &p);
+      ThrowIfFailed(result, "vkMapMemory Failed.");
+      m_mappedSkinnedVertices[i] = static_cast<SkinnedVertex*>(p);
+    }
   }
 
   // }eAǂݍ
-  const uint32_t materialCount = loader.getMaterialCount();
   for (uint32_t i = 0; i < materialCount; ++i)
   {
     const auto& src = loader.getMaterial(i);
     Material::MaterialParameters materialParams{};
-    materialParams.diffuse = vec4(src.getDiffuse(), src.getAlpha());
-    materialParams.ambient = vec4(src.getAmbient(), 0.0f);
-    materialParams.specular = vec4(src.getSpecular(), src.getShininess());
-    materialParams.useTexture.x = 0;
-    materialParams.edgeFlag.x = src.getEdgeFlag();
-
-    auto textureFileName = src.getTexture();
-    auto hasSphereMap = textureFileName.find('*');
-    if (hasSphereMap != std::string::npos)
-    {
-      textureFileName = textureFileName.substr(0, hasSphereMap);
-    }
-    if (!textureFileName.empty())
-    {
-      materialParams.useTexture.x = 1;
-    }
+    materialParams.diffuse = src.diffuse;
+    materialParams.ambient = src.ambient;
+    materialParams.specular = src.specular;
+    materialParams.useTexture.x = materialTextures[i] < 0 ? 0 : 1;
+    materialParams.edgeFlag.x = src.edgeFlag;
     Material material(materialParams);
     
     uint32_t bufferSize = uint32_t(sizeof(materialParams));
     auto uniformBuffers = app->CreateUniformBuffers(bufferSize, 1);
     material.SetUniformBuffer(uniformBuffers[0]);
-
-    if (materialParams.useTexture.x)
-    {
-      int width, height;
-      auto pImage = stbi_load(textureFileName.c_str(), &width, &height, nullptr, 4);
-      auto texture = app->CreateTexture(width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-      uint32_t bufferSize = width * height * sizeof(uint32_t);
-      auto bufferSrc = app->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-      app->WriteToHostVisibleMemory(bufferSrc.memory, bufferSize, pImage);
-
-      VkBufferImageCopy region{};
-      region.imageExtent = { uint32_t(width), uint32_t(height), 1 };
-      region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
-      app->TransferStageBufferToImage(bufferSrc, texture, &region);
-      stbi_image_free(pImage);
-      app->DestroyBuffer(bufferSrc);
-
-      material.SetTexture(texture);
-    }
-
     material.Update(app);
     m_materials.emplace_back(material);
-  }
-
-  // `pbV\z.
-  uint32_t startIndexOffset = 0;
-  for (uint32_t i = 0; i < materialCount; ++i) {
-    const auto& src = loader.getMaterial(i);
-    uint32_t indexCount = src.getNumberOfPolygons();
 
+    // `pbV\z.
     m_meshes.emplace_back(Mesh{
-      startIndexOffset, indexCount
+      src.indexOffset, src.indexCount
       });
-    startIndexOffset += indexCount;
   }
  
-  // {[\z.
-  uint32_t boneCount = loader.getBoneCount();
-  m_bones.reserve(boneCount);
-  for (uint32_t i = 0; i < boneCount; ++i)
+  // IK{[ǂݍ.
+  auto ikBoneCount = loader.getIkCount();
+  m_boneIkList.resize(ikBoneCount);
+  for (uint32_t i = 0; i < ikBoneCount; ++i)
   {
-    const auto& boneSrc = loader.getBone(i);
-    auto index = boneSrc.getParent();
-
-    auto bone = new Bone(boneSrc.getName());
-    auto translation = boneSrc.getPosition();
-    if (index != 0xFFFFu)
+    const auto& ik = loader.getIk(i);
+    auto& boneIk = m_boneIkList[i];
+    boneIk = PMDBoneIK(boneOrder[ik.target], boneOrder[ik.effector]);
+    boneIk.SetAngleLimit(ik.angleLimit);
+    boneIk.SetIterationCount(ik.iterations);
+
+    auto chains = loader.getIkChains(ik);
+    std::vector<uint32_t> ikChains;
+    ikChains.reserve(ik.chainCount);
+    for (uint32_t j = 0; j < ik.chainCount; ++j)
     {
-      const auto& parent = loader.getBone(boneSrc.getParent());
-      translation = translation - parent.getPosition();
+      ikChains.push_back(boneOrder[chains[j]]);
     }
-    bone->SetTranslation(translation);
-    bone->SetInitialTranslation(translation);
-
-    // oChtsO[oʒu苁߂.
-    auto invBind = glm::inverse(translate(boneSrc.getPosition()));
-    bone->SetInvBindMatrix(invBind);
+    boneIk.SetIkChains(ikChains, m_skeleton);
+  }
 
-    m_bones.push_back(bone);
+  // ̂ƃWCgǂݍ. ] X, Y, Z ̏ɓKpIC[p.
+  auto eulerToQuat = [](const vec3& r) {
+    return angleAxis(r.z, vec3(0, 0, 1)) * angleAxis(r.y, vec3(0, 1, 0)) * angleAxis(r.x, vec3(1, 0, 0));
+  };
+  auto rigidBodyCount = loader.getRigidBodyCount();
+  std::vector<RigidBodySolver::BodyDesc> rigidBodies(rigidBodyCount);
+  for (uint32_t i = 0; i < rigidBodyCount; ++i)
+  {
+    const auto& src = loader.getRigidBody(i);
+    auto& body = rigidBodies[i];
+    body.bone = (src.bone >= 0 && uint32_t(src.bone) < boneCount) ? int32_t(boneOrder[src.bone]) : -1;
+    body.shape = RigidBodySolver::Shape(src.shape);
+    body.type = RigidBodySolver::BodyType(src.type);
+    body.size = src.size;
+    body.position = src.position;
+    body.rotation = eulerToQuat(src.rotation);
+    body.mass = src.mass;
+    body.linearDamping = src.linearDamping;
+    body.angularDamping = src.angularDamping;
+    body.group = src.group;
+    body.groupMask = src.groupMask;
   }
-  for (uint32_t i = 0; i < boneCount; ++i)
+  auto jointCount = loader.getJointCount();
+  std::vector<RigidBodySolver::JointDesc> joints(jointCount);
+  for (uint32_t i = 0; i < jointCount; ++i)
   {
-    const auto& boneSrc = loader.getBone(i);
-    auto bone = m_bones[i];
-    uint32_t index = boneSrc.getParent();
-    if (index != 0xFFFFu)
-    {
-      bone->SetParent(m_bones[index]);
-    }
+    const auto& src = loader.getJoint(i);
+    auto& joint = joints[i];
+    joint.bodies[0] = src.bodies[0];
+    joint.bodies[1] = src.bodies[1];
+    joint.position = src.position;
+    joint.rotation = eulerToQuat(src.rotation);
+    joint.linearLower = src.linearLower;
+    joint.linearUpper = src.linearUpper;
+    joint.angularLower = src.angularLower;
+    joint.angularUpper = src.angularUpper;
+    joint.linearSpring = src.linearSpring;
+    joint.angularSpring = src.angularSpring;
   }
-  UpdateMatrices();
+  m_rigidBodySolver.Build(rigidBodies, joints, m_skeleton);
 
-
-  // \[tǂݍ.
+  // fR[hIeNX`]R}hL^.
+  std::vector<DecodedImage> images;
+  images.reserve(decodeTasks.size());
+  for (auto& task : decodeTasks)
   {
-    // \x[X.
-    auto baseFace = loader.getFaceBase();
-    auto vertexCount = baseFace.getVertexCount();
-    auto indexCount = baseFace.getIndexCount();
-    m_faceBaseInfo.verticesPos.resize(vertexCount);
-    m_faceBaseInfo.indices.resize(indexCount);
-    auto sizeVB = vertexCount * sizeof(glm::vec3);
-    auto sizeIB = indexCount * sizeof(uint32_t);
-    memcpy(m_faceBaseInfo.verticesPos.data(), baseFace.getFaceVertices(), sizeVB);
-    memcpy(m_faceBaseInfo.indices.data(), baseFace.getFaceIndices(), sizeIB);
-
-    // ItZbg\[t.
-    auto faceCount = loader.getFaceCount()-1;
-    m_faceOffsetInfo.resize(faceCount);
-    for (uint32_t i = 0; i < faceCount; ++i) // 1n߂̂ 0  base ̂.
-    {
-      auto faceSrc = loader.getFace(i+1);
-      auto& face = m_faceOffsetInfo[i];
-      face.name = faceSrc.getName();
-
-      indexCount = faceSrc.getIndexCount();
-      vertexCount = faceSrc.getVertexCount();
-      face.indices.resize(indexCount);
-      face.verticesOffset.resize(vertexCount);
-      sizeVB = vertexCount * sizeof(glm::vec3);
-      sizeIB = indexCount * sizeof(uint32_t);
-      memcpy(face.verticesOffset.data(), faceSrc.getFaceVertices(), sizeVB);
-      memcpy(face.indices.data(), faceSrc.getFaceIndices(), sizeIB);
-    }
-
-    m_faceMorphWeights.resize(faceCount);
+    images.push_back(task.get());
   }
-
-  // IK{[ǂݍ.
-  auto ikBoneCount = loader.getIkCount();
-  m_boneIkList.resize(ikBoneCount);
-  for (uint32_t i = 0; i < ikBoneCount; ++i)
+  for (uint32_t i = 0; i < materialCount; ++i)
   {
-    const auto& ik = loader.getIk(i);
-    auto& boneIk = m_boneIkList[i];
-    auto targetBone = m_bones[ik.getTargetBoneId()];
-    auto effectorBone = m_bones[ik.getBoneEff()];
-
-    boneIk = PMDBoneIK(targetBone, effectorBone);
-    boneIk.SetAngleLimit(ik.getAngleLimit());
-    boneIk.SetIterationCount(ik.getIterations());
-
-    auto chains = ik.getChains();
-    std::vector<Bone*> ikChains;
-    ikChains.reserve(chains.size());
-    for (auto& id : chains)
+    if (materialTextures[i] < 0)
     {
-      ikChains.push_back(m_bones[id]);
+      continue;
     }
-    boneIk.SetIkChains(ikChains);
+    const auto& image = images[materialTextures[i]];
+    auto width = uint32_t(image.width), height = uint32_t(image.height);
+    auto texture = app->CreateTexture(width, height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    uint32_t bufferSize = width * height * sizeof(uint32_t);
+    auto bufferSrc = app->CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, stageMemProps);
+    stagingBuffers.push_back(bufferSrc);
+    app->WriteToHostVisibleMemory(bufferSrc.memory, bufferSize, image.pixels.get());
+
+    VkBufferImageCopy region{};
+    region.imageExtent = { width, height, 1 };
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    app->RecordStageBufferToImage(command, bufferSrc, texture, &region);
+
+    m_materials[i].SetTexture(texture);
   }
-  
+  images.clear();
+
+  // _ƕ\[ẗړ. ȍ~͏Ȃ, foCX[J֓].
+  geometryTask.get();
+  auto uploadBuffer = [&](uint32_t size, const void* data, VkBufferUsageFlags usage) {
+    auto staging = app->CreateBuffer(size, stage, stageMemProps);
+    stagingBuffers.push_back(staging);
+    app->WriteToHostVisibleMemory(staging.memory, size, data);
+    auto buffer = app->CreateBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, deviceLocal);
+    VkBufferCopy region{};
+    region.size = size;
+    vkCmdCopyBuffer(command, staging.buffer, buffer.buffer, 1, &region);
+    return buffer;
+  };
+  m_vertexBuffer = uploadBuffer(uint32_t(vertexCount * sizeof(PMDVertex)), m_hostMemVertices.data(),
+    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_morphRowOffsetBuffer = uploadBuffer(uint32_t(morphRowOffsets.size() * sizeof(uint32_t)), morphRowOffsets.data(),
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_morphDeltaBuffer = uploadBuffer(uint32_t(morphDeltas.size() * sizeof(FaceMorph::VertexDelta)), morphDeltas.data(),
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+  app->FinishCommandBuffer(command);
+}
 
-  uint32_t sizeVB = sizeof(PMDVertex) * vertexCount;
-  app->WriteToHostVisibleMemory(m_vertexBuffers[0].memory, sizeVB, m_hostMemVertices.data());
-  app->WriteToHostVisibleMemory(m_vertexBuffers[1].memory, sizeVB, m_hostMemVertices.data());
+bool Model::IsCookedModelFile(const char* filename)
+{
+  std::string name(filename);
+  const std::string ext = ".pmdc";
+  return name.size() >= ext.size() && name.compare(name.size() - ext.size(), ext.size(), ext) == 0;
 }
 
 void Model::Prepare(VulkanAppBase* app)
@@ -320,41 +454,37 @@ void Model::Cleanup(VulkanAppBase* app)
   {
     app->DestroyBuffer(v);
   }
-  for (auto& v : m_vertexBuffers)
+  for (auto& v : m_morphWeightUBO)
   {
     app->DestroyBuffer(v);
   }
+  app->DestroyBuffer(m_vertexBuffer);
+  app->DestroyBuffer(m_morphRowOffsetBuffer);
+  app->DestroyBuffer(m_morphDeltaBuffer);
+  for (size_t i = 0; i < m_skinnedVertexBuffers.size(); ++i)
+  {
+    if (m_mappedSkinnedVertices[i] != nullptr)
+    {
+      vkUnmapMemory(device, m_skinnedVertexBuffers[i].memory);
+    }
+    app->DestroyBuffer(m_skinnedVertexBuffers[i]);
+  }
+  vkFreeDescriptorSets(device, app->GetDescriptorPool(), uint32_t(m_skinningDescriptorSets.size()), m_skinningDescriptorSets.data());
   app->DestroyBuffer(m_indexBuffer);
   app->DestroyImage(m_dummyTexture);
   vkDestroySampler(device, m_sampler, nullptr);
-
-  for (auto& b : m_bones)
-  {
-    delete b;
-  }
-  m_bones.clear();
 }
 
 int Model::GetFaceMorphIndex(const std::string& name) const
 {
-  int ret = -1;
-  for (uint32_t i = 0; i < m_faceOffsetInfo.size(); ++i)
-  {
-    const auto& face = m_faceOffsetInfo[i];
-    if (face.name == name)
-    {
-      ret = i;
-      break;
-    }
-  }
-  return ret;
+  return m_faceMorph.GetFaceIndex(name);
 }
 
 void Model::SetFaceMorphWeight(int index, float weight)
 {
   if (index < 0)
     return;
-  m_faceMorphWeights[index] = weight;
+  m_faceMorph.SetWeight(index, weight);
 }
 
 void Model::PrepareModelUniformBuffers(uint32_t count, VulkanAppBase* app)
@@ -363,6 +493,7 @@ void Model::PrepareModelUniformBuffers(uint32_t count, VulkanAppBase* app)
   auto boneParamSize = uint32_t(sizeof(BoneParameter));
   m_sceneParamUBO = app->CreateUniformBuffers(sceneParamSize, count);
   m_boneUBO = app->CreateUniformBuffers(boneParamSize, count);
+  m_morphWeightUBO = app->CreateUniformBuffers(uint32_t(sizeof(float) * MaxGpuFaceMorphCount), count);
 }
 
 Model::SecondaryCommandBuffers Model::GetCommandBuffers(uint32_t index)
@@ -381,21 +512,21 @@ Model::SecondaryCommandBuffers Model::GetCommandBuffersShadow(uint32_t index)
 void Model::PreparePipelines(VulkanAppBase* app)
 {
   auto device = app->GetDevice();
-  array<VkVertexInputAttributeDescription, 6> inputAttribs{ {
-    { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PMDVertex, position)},
-    { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(PMDVertex, normal)},
+  // ʒuƖ@̓XLjOς݂̒_(oCfBO 1), ȊO͌̒_(oCfBO 0)ǂ.
+  array<VkVertexInputAttributeDescription, 4> inputAttribs{ {
+    { 0, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(SkinnedVertex, position)},
+    { 1, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(SkinnedVertex, normal)},
     { 2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(PMDVertex, uv)},
-    { 3, 0, VK_FORMAT_R32G32_UINT, offsetof(PMDVertex, boneIndices)},
-    { 4, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(PMDVertex, boneWeights)},
     { 5, 0, VK_FORMAT_R32_UINT, offsetof(PMDVertex, edgeFlag)},
   } };
-  VkVertexInputBindingDescription vibDesc{
-    0, sizeof(PMDVertex), VK_VERTEX_INPUT_RATE_VERTEX
-  };
+  array<VkVertexInputBindingDescription, 2> vibDesc{ {
+    { 0, sizeof(PMDVertex), VK_VERTEX_INPUT_RATE_VERTEX },
+    { 1, sizeof(SkinnedVertex), VK_VERTEX_INPUT_RATE_VERTEX },
+  } };
   VkPipelineVertexInputStateCreateInfo pipelineVIS{
     VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
     nullptr, 0,
-    1, &vibDesc,
+    uint32_t(vibDesc.size()), vibDesc.data(),
     uint32_t(inputAttribs.size()), inputAttribs.data()
   };
 
@@ -483,6 +614,22 @@ void Model::PreparePipelines(VulkanAppBase* app)
   book_util::DestroyShaderModules(device, shaderStages);
   book_util::DestroyShaderModules(device, shaderStagesOutline);
   book_util::DestroyShaderModules(device, shaderStagesShadow);
+
+  // XLjǑvZpCvC.
+  ShaderStageInfo shaderStagesSkinning{
+    book_util::LoadShader(device, "modelSkinningCS.spv", VK_SHADER_STAGE_COMPUTE_BIT)
+  };
+  VkComputePipelineCreateInfo computePipelineCI{
+    VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+    nullptr, 0,
+    shaderStagesSkinning[0],
+    app->GetPipelineLayout("modelSkinning"),
+    VK_NULL_HANDLE, 0
+  };
+  result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCI, nullptr, &pipeline);
+  ThrowIfFailed(result, "vkCreateComputePipelines Failed.");
+  m_pipelines["skinning"] = pipeline;
+  book_util::DestroyShaderModules(device, shaderStagesSkinning);
 }
 
 void Model::PrepareDescriptorSets(VulkanAppBase* app)
@@ -542,18 +689,75 @@ void Model::PrepareDescriptorSets(VulkanAppBase* app)
     }
     material.SetDescriptorSet(descriptorSets);
   }
+
+  // XLjǑvZVF[_[p. C[WƂ̃{[sƕ\[t̏d݂, o͂̒_obt@\[ẗړʂƑgɂ.
+  auto skinningLayout = app->GetDescriptorSetLayout("modelSkinning");
+  std::vector<VkDescriptorSetLayout> skinningLayouts(imageCount, skinningLayout);
+  VkDescriptorSetAllocateInfo skinningSetAI{
+    VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+    nullptr, app->GetDescriptorPool(),
+    uint32_t(skinningLayouts.size()), skinningLayouts.data()
+  };
+  m_skinningDescriptorSets.resize(imageCount);
+  auto result = vkAllocateDescriptorSets(device, &skinningSetAI, m_skinningDescriptorSets.data());
+  ThrowIfFailed(result, "vkAllocateDescriptorSets Failed.");
+  for (uint32_t i = 0; i < imageCount; ++i)
+  {
+    VkDescriptorBufferInfo boneUBO{ m_boneUBO[i].buffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo inputVertices{ m_vertexBuffer.buffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo outputVertices{ m_skinnedVertexBuffers[i].buffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo morphRowOffsets{ m_morphRowOffsetBuffer.buffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo morphDeltas{ m_morphDeltaBuffer.buffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo morphWeightUBO{ m_morphWeightUBO[i].buffer, 0, VK_WHOLE_SIZE };
+    std::array<VkWriteDescriptorSet, 6> writeDescriptors{
+      book_util::CreateWriteDescriptorSet(m_skinningDescriptorSets[i], 0, &boneUBO),
+      book_util::CreateWriteDescriptorSet(m_skinningDescriptorSets[i], 1, &inputVertices),
+      book_util::CreateWriteDescriptorSet(m_skinningDescriptorSets[i], 2, &outputVertices),
+      book_util::CreateWriteDescriptorSet(m_skinningDescriptorSets[i], 3, &morphRowOffsets),
+      book_util::CreateWriteDescriptorSet(m_skinningDescriptorSets[i], 4, &morphDeltas),
+      book_util::CreateWriteDescriptorSet(m_skinningDescriptorSets[i], 5, &morphWeightUBO),
+    };
+    for (uint32_t binding = 1; binding <= 4; ++binding)
+    {
+      writeDescriptors[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
+    vkUpdateDescriptorSets(device, uint32_t(writeDescriptors.size()), writeDescriptors.data(), 0, nullptr);
+  }
 }
 
-void Model::UpdateMatrices()
+void Model::UpdateHostData()
 {
-  // {[̍sXV.
-  for (auto& v : m_bones)
+  // {[s. O񂩂ς{[̂݌vZ.
+  bool bonesChanged = false;
+  m_skeleton.FlushChangedBones([this, &bonesChanged](uint32_t i) {
+    m_boneMatrices.bone[i] = m_skeleton.GetWorldMatrix(i) * m_skeleton.GetInvBindMatrix(i);
+    bonesChanged = true;
+  });
+  if (m_skinningMode != SKINNING_CPU)
   {
-    if (v->GetParent())
+    return;
+  }
+  if (bonesChanged)
+  {
+    std::fill(m_skinAllVertices.begin(), m_skinAllVertices.end(), uint8_t(1));
+  }
+
+  // CPU ŃXLjOꍇ̂, \[tKp_vZ. d݂ς\̒_̂݌vZ.
+  // GPU ̏ꍇ Update ŏd݂], vZVF[_[œKp.
+  if (m_faceMorph.IsDirty())
+  {
+    std::vector<VertexRange> changed;
+    m_faceMorph.Apply(&m_hostMemVertices[0].position.x, sizeof(PMDVertex), changed);
+    // S_XLjOC[WȊO, ς͈͂ς.
+    for (size_t i = 0; i < m_morphedVertexRanges.size(); ++i)
     {
-      continue;
+      if (!m_skinAllVertices[i])
+      {
+        auto& ranges = m_morphedVertexRanges[i];
+        ranges.insert(ranges.end(), changed.begin(), changed.end());
+        CoalesceVertexRanges(ranges, MaxMorphedRangeCount);
+      }
     }
-    v->UpdateMatrices();
   }
 }
 
@@ -562,46 +766,74 @@ void Model::Update(uint32_t imageIndex, VulkanAppBase* app)
   app->WriteToHostVisibleMemory(m_sceneParamUBO[imageIndex].memory, sizeof(SceneParameter), &m_sceneParams);
 
   // {[sjtH[obt@֏.
-  for (uint32_t i = 0; i < m_bones.size(); ++i)
-  {
-    auto bone = m_bones[i];
-    auto mtx = bone->GetWorldMatrix() * bone->GetInvBindMatrix();
-    m_boneMatrices.bone[i] = mtx;
-  }
   app->WriteToHostVisibleMemory(m_boneUBO[imageIndex].memory, sizeof(BoneParameter), &m_boneMatrices);
 
+  // \[t̏d. vZVF[_[_Ƃ̈ړʂɊ|đ.
+  auto faceCount = m_faceMorph.GetFaceCount();
+  if (m_skinningMode == SKINNING_GPU && faceCount > 0)
+  {
+    app->WriteToHostVisibleMemory(m_morphWeightUBO[imageIndex].memory, uint32_t(sizeof(float) * faceCount), m_faceMorph.GetWeights().data());
+  }
 
-  // _obt@̍XV.
+  // CPU ł̃XLjO. \[tKp_, }bv܂܂̒_obt@֒ڏ.
+  // ̃C[WpɑOXLjOĂ{[s񂪕ςĂȂ, \[tŕς͈͂̂ݏ.
+  if (m_skinningMode == SKINNING_CPU)
   {
-    auto vertexCount = m_faceBaseInfo.verticesPos.size();
-    for (uint32_t i = 0; i < vertexCount; ++i)
+    auto vertices = reinterpret_cast<const SkinningVertex*>(m_hostMemVertices.data());
+    auto dst = m_mappedSkinnedVertices[imageIndex];
+    auto& ranges = m_morphedVertexRanges[imageIndex];
+    if (m_skinAllVertices[imageIndex])
     {
-      auto offsetIndex = m_faceBaseInfo.indices[i];
-      m_hostMemVertices[offsetIndex].position = m_faceBaseInfo.verticesPos[i];
+      SkinVerticesParallel(m_skinningPool, vertices, uint32_t(m_hostMemVertices.size()), &m_boneMatrices.bone[0][0][0], &dst->position.x);
     }
-
-    // EFCgɉĒ_ύX.
-    for (uint32_t faceIndex = 0; faceIndex < m_faceOffsetInfo.size(); ++faceIndex)
+    else
     {
-      const auto& face = m_faceOffsetInfo[faceIndex];
-      float w = m_faceMorphWeights[faceIndex];
-
-      for(uint32_t i=0;i<face.indices.size();++i)
+      for (const auto& range : ranges)
       {
-        auto baseVertexIndex = face.indices[i];
-        auto displacement = face.verticesOffset[i];
-
-        auto offsetIndex = m_faceBaseInfo.indices[baseVertexIndex];
-        m_hostMemVertices[offsetIndex].position += displacement * w;
+        SkinVerticesParallel(m_skinningPool, vertices + range.begin, range.end - range.begin,
+          &m_boneMatrices.bone[0][0][0], &dst[range.begin].position.x);
       }
     }
+    m_skinAllVertices[imageIndex] = 0;
+    ranges.clear();
+  }
+}
 
-    auto bufferSize = sizeof(PMDVertex) * m_hostMemVertices.size();
-    app->WriteToHostVisibleMemory(
-      m_vertexBuffers[imageIndex].memory,
-      uint32_t(bufferSize),
-      m_hostMemVertices.data());
+void Model::RecordSkinning(VkCommandBuffer command, uint32_t imageIndex, VulkanAppBase* app)
+{
+  if (m_skinningMode == SKINNING_CPU)
+  {
+    return;
   }
+  // 1 Xbh 1 _(modelSkinningCS  local_size_x ƍ킹).
+  const uint32_t groupSize = 64;
+  auto vertexCount = uint32_t(m_hostMemVertices.size());
+  auto pipelineLayout = app->GetPipelineLayout("modelSkinning");
+  auto descriptorSet = m_skinningDescriptorSets[imageIndex];
+  vkCmdBindPipeline(command, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelines["skinning"]);
+  vkCmdBindDescriptorSets(command, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+  vkCmdPushConstants(command, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(vertexCount), &vertexCount);
+  vkCmdDispatch(command, (vertexCount + groupSize - 1) / groupSize, 1, 1);
+
+  // ݂IĂ璸_͂Ƃēǂ.
+  VkBufferMemoryBarrier bufferBarrier{
+    VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+    nullptr,
+    VK_ACCESS_SHADER_WRITE_BIT,
+    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+    VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+    m_skinnedVertexBuffers[imageIndex].buffer,
+    0, VK_WHOLE_SIZE
+  };
+  vkCmdPipelineBarrier(
+    command,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+    0,
+    0, nullptr,
+    1, &bufferBarrier,
+    0, nullptr
+  );
 }
 
 void Model::PrepareDummyTexture(VulkanAppBase* app)
@@ -663,7 +895,7 @@ void Model::PrepareCommandBuffers(uint32_t count, VulkanAppBase* app)
     buffers.resize(materialCount);
     app->AllocateCommandBufferSecondary(materialCount, buffers.data());
 
-    auto vertexBuffer = m_vertexBuffers[index];
+    std::array<VkBuffer, 2> vertexBuffers{ m_vertexBuffer.buffer, m_skinnedVertexBuffers[index].buffer };
     VkPipeline usePipeline = m_pipelines["normalDraw"];
     for (uint32_t i = 0; i < materialCount; ++i)
     {
@@ -673,10 +905,10 @@ void Model::PrepareCommandBuffers(uint32_t count, VulkanAppBase* app)
       auto command = buffers[i];
 
       vkBeginCommandBuffer(command, &beginInfo);
-      VkDeviceSize offsets[] = { 0 };
+      VkDeviceSize offsets[] = { 0, 0 };
       vkCmdBindPipeline(command, VK_PIPELINE_BIND_POINT_GRAPHICS, usePipeline);
       vkCmdBindIndexBuffer(command, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-      vkCmdBindVertexBuffers(command, 0, 1, &vertexBuffer.buffer, offsets);
+      vkCmdBindVertexBuffers(command, 0, uint32_t(vertexBuffers.size()), vertexBuffers.data(), offsets);
       vkCmdBindDescriptorSets(command, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
       vkCmdDrawIndexed(command, mesh.indexCount, 1, mesh.startIndexOffset, 0, 0);
       vkEndCommandBuffer(command);
@@ -691,7 +923,7 @@ void Model::PrepareCommandBuffers(uint32_t count, VulkanAppBase* app)
     buffers.resize(materialCount);
     app->AllocateCommandBufferSecondary(materialCount, buffers.data());
 
-    auto vertexBuffer = m_vertexBuffers[index];
+    std::array<VkBuffer, 2> vertexBuffers{ m_vertexBuffer.buffer, m_skinnedVertexBuffers[index].buffer };
     VkPipeline usePipeline = m_pipelines["outlineDraw"];
     uint32_t commandIndex = 0;
     for (uint32_t i = 0; i < materialCount; ++i)
@@ -707,10 +939,10 @@ void Model::PrepareCommandBuffers(uint32_t count, VulkanAppBase* app)
       auto command = buffers[commandIndex++];
 
       vkBeginCommandBuffer(command, &beginInfo);
-      VkDeviceSize offsets[] = { 0 };
+      VkDeviceSize offsets[] = { 0, 0 };
       vkCmdBindPipeline(command, VK_PIPELINE_BIND_POINT_GRAPHICS, usePipeline);
       vkCmdBindIndexBuffer(command, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-      vkCmdBindVertexBuffers(command, 0, 1, &vertexBuffer.buffer, offsets);
+      vkCmdBindVertexBuffers(command, 0, uint32_t(vertexBuffers.size()), vertexBuffers.data(), offsets);
       vkCmdBindDescriptorSets(command, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
       vkCmdDrawIndexed(command, mesh.indexCount, 1, mesh.startIndexOffset, 0, 0);
       vkEndCommandBuffer(command);
@@ -727,7 +959,7 @@ void Model::PrepareCommandBuffers(uint32_t count, VulkanAppBase* app)
     buffers.resize(materialCount);
     app->AllocateCommandBufferSecondary(materialCount, buffers.data());
 
-    auto vertexBuffer = m_vertexBuffers[index];
+    std::array<VkBuffer, 2> vertexBuffers{ m_vertexBuffer.buffer, m_skinnedVertexBuffers[index].buffer };
     VkPipeline usePipeline = m_pipelines["shadow"];
     for (uint32_t i = 0; i < materialCount; ++i)
     {
@@ -737,10 +969,10 @@ void Model::PrepareCommandBuffers(uint32_t count, VulkanAppBase* app)
       auto command = buffers[i];
 
       vkBeginCommandBuffer(command, &beginInfo);
-      VkDeviceSize offsets[] = { 0 };
+      VkDeviceSize offsets[] = { 0, 0 };
       vkCmdBindPipeline(command, VK_PIPELINE_BIND_POINT_GRAPHICS, usePipeline);
       vkCmdBindIndexBuffer(command, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-      vkCmdBindVertexBuffers(command, 0, 1, &vertexBuffer.buffer, offsets);
+      vkCmdBindVertexBuffers(command, 0, uint32_t(vertexBuffers.size()), vertexBuffers.data(), offsets);
       vkCmdBindDescriptorSets(command, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
       vkCmdDrawIndexed(command, mesh.indexCount, 1, mesh.startIndexOffset, 0, 0);
       vkEndCommandBuffer(command);
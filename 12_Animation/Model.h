@@ -4,6 +4,13 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include "Skeleton.h"
+#include "BoneIK.h"
+#include "RigidBodySolver.h"
+#include "FaceMorph.h"
+
+class ThreadPool;
+
 class Material
 {
 public:
@@ -39,88 +46,33 @@ private:
   std::vector<VkDescriptorSet> m_descriptorSets;
 };
 
-class Bone
+class Model
 {
 public:
-  Bone() : m_rotation(1.0f, 0.0f, 0.0f, 0.0f), m_parent(nullptr), m_mtxInvBind(1.0f){ }
-  Bone(const std::string& name) : m_name(name), m_rotation(1.0f, 0.0f, 0.0f, 0.0f), m_parent(nullptr), m_mtxInvBind(1.0f) {  }
-
-  void SetTranslation(const glm::vec3& trans) { m_translation = trans; }
-  void SetRotation(const glm::quat& rot) { m_rotation = rot; }
-
-  glm::vec3 GetTranslation() const { return m_translation; }
-  glm::quat GetRotation() const { return m_rotation; }
-
-  const std::string& GetName() const { return m_name; }
-  glm::mat4 GetLocalMatrix() const { return m_mtxLocal; }
-  glm::mat4 GetWorldMatrix() const { return m_mtxWorld; }
-  glm::mat4 GetInvBindMatrix() const { return m_mtxInvBind; }
-
-  void UpdateLocalMatrix();
-  void UpdateWorldMatrix();
-  void UpdateMatrices();
-
-  void SetInitialTranslation(const glm::vec3& trans) { m_initialTranslation = trans; }
+  using SecondaryCommandBuffers = std::vector<VkCommandBuffer>;
 
-  void SetParent(Bone* parent)
-  {
-    m_parent = parent;
-    if (m_parent != nullptr)
-    {
-      m_parent->AddChild(this);
-    }
-  }
-  Bone* GetParent() const
+  // XLjOsꏊ. ̏ꍇ`pX̃VF[_[̓XLjOς݂̒_̂܂܎g.
+  enum SkinningMode
   {
-    return m_parent;
-  }
-  glm::vec3 GetInitialTranslation() const { return m_initialTranslation; }
-
-  void SetInvBindMatrix(const glm::mat4& mtxInvBind) { m_mtxInvBind = mtxInvBind; }
-private:
-  void AddChild(Bone* bone) { m_children.push_back(bone); }
-  std::string m_name;
-
-  glm::vec3 m_translation;
-  glm::quat m_rotation;
-  glm::vec3 m_initialTranslation;
+    SKINNING_GPU = 0,   // vZVF[_[(modelSkinningCS). RecordSkinning ŋL^. \[tvZVF[_[œKp.
+    SKINNING_CPU = 1,   // Update  CPU (SkinVerticesParallel) ɂvZ, _obt@֒ڏ.
+  };
 
-  Bone* m_parent;
-  std::vector<Bone*> m_children;
+  // SKINNING_GPU ň\[t̐. modelSkinningCS  MorphWeights ƍ킹.
+  static const uint32_t MaxGpuFaceMorphCount = 1024;
+  // SKINNING_CPU ŕ\[t݂̂ςꍇ, _͈̔͂̐ȉɂ܂Ƃ߂ĂXLjO.
+  static const uint32_t MaxMorphedRangeCount = 16;
 
-  glm::mat4 m_mtxLocal;
-  glm::mat4 m_mtxWorld;
-  glm::mat4 m_mtxInvBind;
-};
-class PMDBoneIK
-{
-public:
-  PMDBoneIK() : m_effector(nullptr), m_target(nullptr), m_angleLimit(0.0f), m_iteration(0) { }
-  PMDBoneIK(Bone* target, Bone* eff) : m_effector(eff), m_target(target) { }
-
-  Bone* GetEffector() const { return m_effector; }
-  Bone* GetTarget() const { return m_target; }
-  float GetAngleWeight() const { return m_angleLimit; }
-  const std::vector<Bone*>& GetChains() const { return m_ikChains; }
-  int GetIterationCount() const { return m_iteration; }
-
-  void SetAngleLimit(float angle) { m_angleLimit = angle; }
-  void SetIterationCount(int iterationCount) { m_iteration = iterationCount; }
-  void SetIkChains(std::vector<Bone*>& chains) { m_ikChains = chains; }
-private:
-  Bone* m_effector;
-  Bone* m_target;
-  std::vector<Bone*> m_ikChains;
-  float m_angleLimit;
-  int   m_iteration;
-};
+  Model() : m_skinningMode(SKINNING_GPU), m_skinningPool(nullptr) { }
 
-class Model
-{
-public:
-  using SecondaryCommandBuffers = std::vector<VkCommandBuffer>;
+  // Load OɌĂԂ. CPU ̏ꍇ pool ŕɌvZ(nullptr ̏ꍇ Update Ă񂾃Xbĥ).
+  // GPU ̖(\tgEFA Vulkan Ȃ)Œ_VF[_[EvZVF[_[ׂ̕邽߂Ɏg.
+  void SetSkinningMode(SkinningMode mode, ThreadPool* pool = nullptr) { m_skinningMode = mode; m_skinningPool = pool; }
+  SkinningMode GetSkinningMode() const { return m_skinningMode; }
 
-  void Load(const char* fileName, VulkanAppBase* app);
+  // .pmd ܂͕ϊς݂ .pmdc ǂݍ.
+  // ǂݍ݂ CPU ̏(eNX`̃fR[hȂ) pool ŕɍs.
+  void Load(const char* fileName, VulkanAppBase* app, ThreadPool& pool);
   void Prepare(VulkanAppBase* app);
   void Cleanup(VulkanAppBase* app);
 
@@ -138,6 +90,13 @@ public:
     glm::vec2 boneWeights;
     uint32_t  edgeFlag;
   };
+  // XLjOς݂̒_. SĂ̕`pX͂𒸓_obt@ 2 Ԗڂ̃oCfBOǂ.
+  // @͐KȂ(֊s̓XLjOς݂̈ʒuɖ@𑫂_牟o߂).
+  struct SkinnedVertex
+  {
+    glm::vec4 position;
+    glm::vec4 normal;
+  };
   struct SceneParameter
   {
     glm::mat4 view;
@@ -155,8 +114,15 @@ public:
 
   void SetSceneParameter(const SceneParameter& params) { m_sceneParams = params; }
   
-  void UpdateMatrices();
+  // {[szXg̃obt@ɌvZ. SKINNING_CPU ̏ꍇ͕\[tKp_vZ.
+  // Vulkan ̃IuWFNgɂ͐GȂ, fƂłΕ`XbhȊOɌĂł悢.
+  void UpdateHostData();
+  // UpdateHostData ŌvZʂƃV[p[^ imageIndex p̃obt@֓].
+  // SKINNING_CPU ̏ꍇ̓XLjOōs. {[s񂪕ςĂȂ, \[tŕς_̂݌vZ.
   void Update(uint32_t imageIndex, VulkanAppBase* app);
+  // imageIndex p̒_XLjOvZVF[_[̃R}hL^. SKINNING_CPU ̏ꍇ͉Ȃ.
+  // `pX(VhEpX܂)O, `ƓR}hobt@֋L^邱.
+  void RecordSkinning(VkCommandBuffer command, uint32_t imageIndex, VulkanAppBase* app);
 
   SecondaryCommandBuffers GetCommandBuffers(uint32_t index);
   SecondaryCommandBuffers GetCommandBuffersOutline(uint32_t index);
@@ -165,20 +131,31 @@ public:
   void SetShadowMap(VulkanAppBase::ImageObject shadowMap) { m_shadowMap = shadowMap; }
 
   // {[
-  uint32_t GetBoneCount() const { return uint32_t(m_bones.size()); }
-  const Bone* GetBone(int idx) const { return m_bones[idx]; }
-  Bone* GetBone(int idx) { return m_bones[idx]; }
+  // {[̔ԍ̓g|WJɕבւ̂, _̃{[ԍ IK ɍ킹Ă.
+  uint32_t GetBoneCount() const { return m_skeleton.GetBoneCount(); }
+  const Skeleton& GetSkeleton() const { return m_skeleton; }
+  Skeleton& GetSkeleton() { return m_skeleton; }
 
   // \[t.
-  uint32_t GetFaceMorphCount() const { return uint32_t(m_faceOffsetInfo.size()); }
+  uint32_t GetFaceMorphCount() const { return m_faceMorph.GetFaceCount(); }
   int GetFaceMorphIndex(const std::string& faceName) const;
+  //  UpdateHostData , d݂ς\̒_݂̂vZ.
   void SetFaceMorphWeight(int index, float weight);
 
+  // pőS_܂ދ. LOD ̑IȂǂɎg.
+  const glm::vec3& GetBoundingCenter() const { return m_boundingCenter; }
+  float GetBoundingRadius() const { return m_boundingRadius; }
+
   // IK
   uint32_t GetBoneIKCount() const { return uint32_t(m_boneIkList.size()); }
   const PMDBoneIK& GetBoneIK(int idx) const { return m_boneIkList[idx]; }
 
+  // ̂ƃWCgɂ镨Z. ̂fł GetBodyCount  0 ɂȂ.
+  const RigidBodySolver& GetRigidBodySolver() const { return m_rigidBodySolver; }
+  RigidBodySolver& GetRigidBodySolver() { return m_rigidBodySolver; }
+
 private:
+  static bool IsCookedModelFile(const char* filename);
   void PrepareModelUniformBuffers(uint32_t count, VulkanAppBase* app);
   void PreparePipelines(VulkanAppBase* app);
   void PrepareDescriptorSets(VulkanAppBase* app);
@@ -193,8 +170,24 @@ private:
 
   using UniformBuffers = std::vector<VulkanAppBase::BufferObject>;
 
-  std::vector<VulkanAppBase::BufferObject> m_vertexBuffers;
+  // \x[Ẍʒuɂ_(PMDVertex). e͕ςȂ, foCX[J 1 .
+  VulkanAppBase::BufferObject m_vertexBuffer;
+  // \[ẗړ(FaceMorph::BuildVertexDeltas  CSR `). SKINNING_GPU ̌vZVF[_[œKp.
+  VulkanAppBase::BufferObject m_morphRowOffsetBuffer;
+  VulkanAppBase::BufferObject m_morphDeltaBuffer;
+  // SKINNING_CPU ŃC[WƂ, OXLjOĂ\[tŕς_͈̔.
+  // {[s񂪕ςꍇ m_skinAllVertices 𗧂, ͈͂ɂ炸S_XLjO.
+  std::vector<std::vector<VertexRange>> m_morphedVertexRanges;
+  std::vector<uint8_t> m_skinAllVertices;
+  // XLjO_(SkinnedVertex). Xbv`FC̃C[WƂɎ.
+  // SKINNING_CPU ̏ꍇ̓zXg猩郁ɒu, Ƀ}bvĂ.
+  std::vector<VulkanAppBase::BufferObject> m_skinnedVertexBuffers;
+  std::vector<SkinnedVertex*> m_mappedSkinnedVertices;
+  std::vector<VkDescriptorSet> m_skinningDescriptorSets;
+  SkinningMode m_skinningMode;
+  ThreadPool* m_skinningPool;
   UniformBuffers m_boneUBO;
+  UniformBuffers m_morphWeightUBO;
   UniformBuffers m_sceneParamUBO;
   
   VulkanAppBase::BufferObject m_indexBuffer;
@@ -208,25 +201,15 @@ private:
   VkSampler m_sampler;
 
   std::unordered_map<std::string, VkPipeline> m_pipelines;
-  std::vector<Bone*> m_bones;
+  Skeleton m_skeleton;
   
 
-  // \[tx[X_.
-  struct PMDFaceBaseInfo
-  {
-    std::vector<uint32_t> indices;
-    std::vector<glm::vec3> verticesPos;
-  } m_faceBaseInfo;
-  
-  // \[tItZbg_.
-  struct PMDFaceInfo
-  {
-    std::string name;
-    std::vector<uint32_t> indices;
-    std::vector<glm::vec3> verticesOffset;
-  };
-  std::vector<PMDFaceInfo> m_faceOffsetInfo;
-  std::vector<float> m_faceMorphWeights;
+  // \[t.
+  FaceMorph m_faceMorph;
+
+  glm::vec3 m_boundingCenter;
+  float m_boundingRadius;
 
   std::vector<PMDBoneIK> m_boneIkList;
+  RigidBodySolver m_rigidBodySolver;
 };
@@ -0,0 +1,85 @@
+﻿#include "PoseCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+PoseCache::PoseCache(size_t capacity, float timeQuantum)
+  : m_capacity(std::max(capacity, size_t(1))), m_timeQuantum(timeQuantum > 0.0f ? timeQuantum : 1.0f / 64.0f),
+  m_hitCount(0), m_missCount(0)
+{
+}
+
+size_t PoseCache::KeyHash::operator()(const Key& key) const
+{
+  // 64bit の値を FNV-1a と同じ要領で混ぜる.
+  uint64_t hash = 14695981039346656037ull;
+  for (auto value : { key.clip, key.skeleton, uint64_t(key.time) })
+  {
+    hash = (hash ^ value) * 1099511628211ull;
+    hash ^= hash >> 29;
+  }
+  return size_t(hash);
+}
+
+std::shared_ptr<const AnimationPose> PoseCache::Get(uint64_t clip, uint64_t skeleton, float frame, const Sampler& sampler)
+{
+  Key key{ clip, skeleton, int64_t(std::llround(double(frame) / m_timeQuantum)) };
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto itr = m_index.find(key);
+    if (itr != m_index.end())
+    {
+      m_entries.splice(m_entries.begin(), m_entries, itr->second);
+      ++m_hitCount;
+      return itr->second->pose;
+    }
+    ++m_missCount;
+  }
+
+  // 評価は時間がかかるので, ロックの外で行う.
+  auto pose = std::make_shared<AnimationPose>();
+  sampler(float(double(key.time) * m_timeQuantum), *pose);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto itr = m_index.find(key);
+  if (itr != m_index.end())
+  {
+    m_entries.splice(m_entries.begin(), m_entries, itr->second);
+    return itr->second->pose;
+  }
+  m_entries.push_front(Entry{ key, pose });
+  m_index[key] = m_entries.begin();
+  while (m_entries.size() > m_capacity)
+  {
+    m_index.erase(m_entries.back().key);
+    m_entries.pop_back();
+  }
+  return pose;
+}
+
+void PoseCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries.clear();
+  m_index.clear();
+  m_hitCount = 0;
+  m_missCount = 0;
+}
+
+size_t PoseCache::GetSize() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_entries.size();
+}
+
+uint64_t PoseCache::GetHitCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_hitCount;
+}
+
+uint64_t PoseCache::GetMissCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_missCount;
+}
@@ -0,0 +1,65 @@
+﻿#pragma once
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "AnimationPose.h"
+
+// 同じモーションを同じ時刻で再生するキャラクター間で, 評価したローカル姿勢を共有する.
+// (クリップ, 骨格, 量子化した時刻) を鍵とし, 容量を超えた場合は最も長く使われていないものから捨てる.
+// 複数のスレッドから呼んでよい. 同じ鍵を同時に評価する場合は両方が評価し, 先に追加した方が残る.
+class PoseCache
+{
+public:
+  // frame 時点の姿勢を pose に書き込む.
+  using Sampler = std::function<void(float frame, AnimationPose& pose)>;
+
+  // timeQuantum は時刻を量子化する単位(30fps 単位のフレーム数).
+  explicit PoseCache(size_t capacity = 256, float timeQuantum = 1.0f / 64.0f);
+
+  // clip と skeleton は呼び出し側で決める識別値で, 同じ値の組は同じモーションを同じボーン並びで評価するものとする.
+  // 鍵に対応する姿勢が無ければ, 量子化した時刻で sampler を呼んで評価し, 追加する.
+  // 戻り値は捨てられた後も有効.
+  std::shared_ptr<const AnimationPose> Get(uint64_t clip, uint64_t skeleton, float frame, const Sampler& sampler);
+
+  void Clear();
+
+  size_t GetCapacity() const { return m_capacity; }
+  float GetTimeQuantum() const { return m_timeQuantum; }
+  size_t GetSize() const;
+  uint64_t GetHitCount() const;
+  uint64_t GetMissCount() const;
+private:
+  struct Key
+  {
+    uint64_t clip;
+    uint64_t skeleton;
+    int64_t time;
+    bool operator==(const Key& other) const
+    {
+      return clip == other.clip && skeleton == other.skeleton && time == other.time;
+    }
+  };
+  struct KeyHash
+  {
+    size_t operator()(const Key& key) const;
+  };
+  struct Entry
+  {
+    Key key;
+    std::shared_ptr<const AnimationPose> pose;
+  };
+
+  size_t m_capacity;
+  float m_timeQuantum;
+
+  // 先頭ほど最近使われたもの.
+  std::list<Entry> m_entries;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_index;
+  uint64_t m_hitCount;
+  uint64_t m_missCount;
+  mutable std::mutex m_mutex;
+};
@@ -0,0 +1,170 @@
+﻿#include "PoseKernel.h"
+#include "AnimationPose.h"
+#include "SimdMath.h"
+
+#include <cmath>
+
+namespace
+{
+  const uint32_t Rotation = AnimationPose::RotationX;
+
+  // slerp を近似するための nlerp の補間率の補正. d は 2 つの回転の内積(0 以上).
+  //   t' = t + t (t - 0.5) (t - 1) k,  k = A (t - 0.5)^2 + B
+  // A, B は d の多項式で近似する. glm::slerp との差の上限は BlendPosesSlerpMaxError.
+  const float SlerpA[4] = { 1.0904f, -3.2452f, 3.55645f, -1.43519f };
+  const float SlerpB[3] = { 0.848013f, -1.06021f, 0.215638f };
+
+#if defined(SIMD_MATH_AVAILABLE)
+  using simd::Simd;
+
+  template<class S>
+  void BlendPosesSimd(const float* a, const float* b, const float* rates, float rate, bool slerp, uint32_t stride, float* dst)
+  {
+    using V = typename S::V;
+    const V uniformRate = S::Set(rate);
+    const V signMask = S::Set(-0.0f);
+    const V half = S::Set(0.5f);
+    const V one = S::Set(1.0f);
+
+    for (uint32_t i = 0; i < stride; i += S::Width)
+    {
+      // 移動量の線形補間.
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        auto offset = c * stride + i;
+        auto t = rates ? S::Load(rates + offset) : uniformRate;
+        auto va = S::Load(a + offset);
+        auto vb = S::Load(b + offset);
+        S::Store(dst + offset, S::Add(va, S::Mul(S::Sub(vb, va), t)));
+      }
+
+      // 回転. b の符号を内積の符号に合わせて a 側の半球にそろえる.
+      V qa[4], qb[4];
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        qa[c] = S::Load(a + (Rotation + c) * stride + i);
+        qb[c] = S::Load(b + (Rotation + c) * stride + i);
+      }
+      auto dot = S::Add(S::Add(S::Mul(qa[0], qb[0]), S::Mul(qa[1], qb[1])), S::Add(S::Mul(qa[2], qb[2]), S::Mul(qa[3], qb[3])));
+      auto sign = S::And(dot, signMask);
+      dot = S::Xor(dot, sign);
+
+      auto t = rates ? S::Load(rates + 3 * stride + i) : uniformRate;
+      if (slerp)
+      {
+        auto A = S::Add(S::Set(SlerpA[0]), S::Mul(dot, S::Add(S::Set(SlerpA[1]), S::Mul(dot, S::Add(S::Set(SlerpA[2]), S::Mul(dot, S::Set(SlerpA[3])))))));
+        auto B = S::Add(S::Set(SlerpB[0]), S::Mul(dot, S::Add(S::Set(SlerpB[1]), S::Mul(dot, S::Set(SlerpB[2])))));
+        auto u = S::Sub(t, half);
+        auto k = S::Add(S::Mul(A, S::Mul(u, u)), B);
+        t = S::Add(t, S::Mul(S::Mul(t, u), S::Mul(S::Sub(t, one), k)));
+      }
+
+      V q[4];
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        q[c] = S::Add(qa[c], S::Mul(S::Sub(S::Xor(qb[c], sign), qa[c]), t));
+      }
+      auto length = S::Sqrt(S::Add(S::Add(S::Mul(q[0], q[0]), S::Mul(q[1], q[1])), S::Add(S::Mul(q[2], q[2]), S::Mul(q[3], q[3]))));
+      auto invLength = S::Div(one, length);
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        S::Store(dst + (Rotation + c) * stride + i, S::Mul(q[c], invLength));
+      }
+    }
+  }
+
+  template<class S>
+  void NormalizePoseRotationsSimd(float* pose, uint32_t stride)
+  {
+    using V = typename S::V;
+    const V one = S::Set(1.0f);
+    for (uint32_t i = 0; i < stride; i += S::Width)
+    {
+      V q[4];
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        q[c] = S::Load(pose + (Rotation + c) * stride + i);
+      }
+      auto length = S::Sqrt(S::Add(S::Add(S::Mul(q[0], q[0]), S::Mul(q[1], q[1])), S::Add(S::Mul(q[2], q[2]), S::Mul(q[3], q[3]))));
+      auto invLength = S::Div(one, length);
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        S::Store(pose + (Rotation + c) * stride + i, S::Mul(q[c], invLength));
+      }
+    }
+  }
+#endif
+
+  glm::quat LoadRotation(const float* pose, uint32_t stride, uint32_t bone)
+  {
+    const float* r = pose + Rotation * stride + bone;
+    return glm::quat(r[3 * stride], r[0], r[stride], r[2 * stride]);
+  }
+
+  void StoreRotation(float* pose, uint32_t stride, uint32_t bone, const glm::quat& q)
+  {
+    float* r = pose + Rotation * stride + bone;
+    r[0] = q.x;
+    r[stride] = q.y;
+    r[2 * stride] = q.z;
+    r[3 * stride] = q.w;
+  }
+}
+
+void BlendPosesScalar(const float* a, const float* b, const float* rates, float rate, bool slerp, uint32_t stride, float* dst)
+{
+  for (uint32_t i = 0; i < stride; ++i)
+  {
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+      auto offset = c * stride + i;
+      auto t = rates ? rates[offset] : rate;
+      dst[offset] = a[offset] + (b[offset] - a[offset]) * t;
+    }
+
+    auto qa = LoadRotation(a, stride, i);
+    auto qb = LoadRotation(b, stride, i);
+    if (glm::dot(qa, qb) < 0.0f)
+    {
+      qb = -qb;
+    }
+    auto t = rates ? rates[3 * stride + i] : rate;
+    auto q = slerp ? glm::slerp(qa, qb, t) : qa * (1.0f - t) + qb * t;
+    StoreRotation(dst, stride, i, glm::normalize(q));
+  }
+}
+
+void NormalizePoseRotationsScalar(float* pose, uint32_t stride)
+{
+  for (uint32_t i = 0; i < stride; ++i)
+  {
+    StoreRotation(pose, stride, i, glm::normalize(LoadRotation(pose, stride, i)));
+  }
+}
+
+void BlendPoses(const float* a, const float* b, const float* rates, float rate, bool slerp, uint32_t stride, float* dst)
+{
+#if defined(SIMD_MATH_AVAILABLE)
+  BlendPosesSimd<Simd>(a, b, rates, rate, slerp, stride, dst);
+#else
+  BlendPosesScalar(a, b, rates, rate, slerp, stride, dst);
+#endif
+}
+
+void NormalizePoseRotations(float* pose, uint32_t stride)
+{
+#if defined(SIMD_MATH_AVAILABLE)
+  NormalizePoseRotationsSimd<Simd>(pose, stride);
+#else
+  NormalizePoseRotationsScalar(pose, stride);
+#endif
+}
+
+const char* GetPoseKernelName()
+{
+#if defined(SIMD_MATH_AVAILABLE)
+  return Simd::Name();
+#else
+  return "Scalar";
+#endif
+}
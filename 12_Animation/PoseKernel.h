@@ -0,0 +1,27 @@
+﻿#pragma once
+#include <cstdint>
+
+// AnimationPose と同じ SoA 配置の姿勢を, 複数ボーンまとめて処理する.
+// stride は AnimationPose::Alignment の倍数とし, stride 個全てを処理する.
+// 命令セットはビルド時に AVX2 (8 ボーン), SSE2 (4 ボーン), AArch64 NEON (4 ボーン) の順で選び,
+// いずれも使えない場合はスカラー版になる.
+
+// 姿勢 a, b を補間して dst に書き込む. dst は a または b と同じでもよい.
+// rates が nullptr でなければ成分ごと・ボーンごとの補間率(移動量 X, Y, Z, 回転 の順に stride 個ずつ)を,
+// nullptr の場合は全て rate を使う. 回転は a 側の半球にそろえて補間し, 正規化する.
+// slerp が true の場合は nlerp の補間率を補正して slerp に近づける. 誤差は BlendPosesSlerpMaxError 以下.
+void BlendPoses(const float* a, const float* b, const float* rates, float rate, bool slerp, uint32_t stride, float* dst);
+
+// BlendPoses の slerp の近似と glm::slerp の差の上限(ラジアン). 2 つの回転の間の角度と補間率を掃引して求めた
+// 最大値は 7.7e-4 (角度が 180 度に近く, 補間率が 0.62 付近). 角度が 90 度以下では 7.3e-5 以下になる.
+const float BlendPosesSlerpMaxError = 8.0e-4f;
+
+// 回転を正規化する.
+void NormalizePoseRotations(float* pose, uint32_t stride);
+
+// 基準となるスカラー実装. slerp の場合は glm::slerp を使う.
+void BlendPosesScalar(const float* a, const float* b, const float* rates, float rate, bool slerp, uint32_t stride, float* dst);
+void NormalizePoseRotationsScalar(float* pose, uint32_t stride);
+
+// ビルド時に選ばれた命令セットの名前.
+const char* GetPoseKernelName();
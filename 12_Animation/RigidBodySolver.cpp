@@ -0,0 +1,835 @@
+﻿#include "RigidBodySolver.h"
+#include "SimdMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace
+{
+  // 線分の入力(ClosestSegmentPoints の segments)の行.
+  enum SegmentRow { A0 = 0, DA = 3, B0 = 6, DB = 9, SegmentRowCount = 12 };
+  const float SegmentEpsilon = 1.0e-8f;
+  // 接触を検出する際に, 刻みの間に動く距離に加えて半径に足す余裕.
+  const float ContactMargin = 0.05f;
+
+  glm::vec3 Axis(uint32_t axis)
+  {
+    glm::vec3 v(0.0f);
+    v[axis] = 1.0f;
+    return v;
+  }
+
+  // 回転 q を回転ベクトル delta だけ(微小回転として)回す.
+  glm::quat ApplyAngularDelta(const glm::quat& q, const glm::vec3& delta)
+  {
+    auto d = glm::quat(0.0f, delta.x, delta.y, delta.z) * q;
+    return glm::normalize(glm::quat(q.w + 0.5f * d.w, q.x + 0.5f * d.x, q.y + 0.5f * d.y, q.z + 0.5f * d.z));
+  }
+
+  // w >= 0 の側で表した回転ベクトル.
+  glm::vec3 ToRotationVector(const glm::quat& q)
+  {
+    auto sign = q.w < 0.0f ? -1.0f : 1.0f;
+    glm::vec3 v(q.x * sign, q.y * sign, q.z * sign);
+    auto s = glm::length(v);
+    if (s < 1.0e-7f)
+    {
+      return v * 2.0f;
+    }
+    return v * (2.0f * std::atan2(s, q.w * sign) / s);
+  }
+
+  // 下限が上限より大きい軸は制限しない.
+  glm::vec3 ClampRange(const glm::vec3& v, const glm::vec3& lower, const glm::vec3& upper)
+  {
+    glm::vec3 result = v;
+    for (int i = 0; i < 3; ++i)
+    {
+      if (lower[i] <= upper[i])
+      {
+        result[i] = std::min(std::max(v[i], lower[i]), upper[i]);
+      }
+    }
+    return result;
+  }
+
+  // 線分 a0 + s * da と b0 + t * db の最近点の媒介変数. ClosestSegmentPoints と同じ手順で求める.
+  void ClosestSegmentParameters(const glm::vec3& a0, const glm::vec3& da, const glm::vec3& b0, const glm::vec3& db, float& s, float& t)
+  {
+    auto clamp01 = [](float v) { return std::min(std::max(v, 0.0f), 1.0f); };
+    auto r = a0 - b0;
+    auto a = glm::dot(da, da), e = glm::dot(db, db), b = glm::dot(da, db), c = glm::dot(da, r), f = glm::dot(db, r);
+    auto denom = a * e - b * b;
+    s = denom > SegmentEpsilon ? clamp01((b * f - c * e) / denom) : 0.0f;
+    t = clamp01((b * s + f) / std::max(e, SegmentEpsilon));
+    s = clamp01((b * t - c) / std::max(a, SegmentEpsilon));
+  }
+
+  glm::quat ExtractRotation(const glm::mat4& m)
+  {
+    return glm::normalize(glm::quat_cast(glm::mat3(m)));
+  }
+
+#if defined(SIMD_MATH_AVAILABLE)
+  using simd::Simd;
+
+  template<class S>
+  void ClosestSegmentPointsSimd(const float* segments, uint32_t stride, float* result)
+  {
+    using V = typename S::V;
+    const V zero = S::Set(0.0f);
+    const V one = S::Set(1.0f);
+    const V epsilon = S::Set(SegmentEpsilon);
+    auto dot = [](const V* x, const V* y) { return S::Add(S::Add(S::Mul(x[0], y[0]), S::Mul(x[1], y[1])), S::Mul(x[2], y[2])); };
+    auto clamp01 = [&](V v) { return S::Min(S::Max(v, zero), one); };
+
+    for (uint32_t i = 0; i < stride; i += S::Width)
+    {
+      V a0[3], da[3], b0[3], db[3], r[3];
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        a0[c] = S::Load(segments + (A0 + c) * stride + i);
+        da[c] = S::Load(segments + (DA + c) * stride + i);
+        b0[c] = S::Load(segments + (B0 + c) * stride + i);
+        db[c] = S::Load(segments + (DB + c) * stride + i);
+        r[c] = S::Sub(a0[c], b0[c]);
+      }
+      auto a = dot(da, da), e = dot(db, db), b = dot(da, db), c = dot(da, r), f = dot(db, r);
+
+      // 直線同士の最近点から s を求め, s に対する t を範囲内に収めてから, t に対する s を求め直す.
+      // 平行な場合は s = 0 から始める. 長さ 0 の線分(球)では対応する媒介変数は 0 になる.
+      auto denom = S::Sub(S::Mul(a, e), S::Mul(b, b));
+      auto s = S::Select(S::Less(epsilon, denom), clamp01(S::Div(S::Sub(S::Mul(b, f), S::Mul(c, e)), S::Max(denom, epsilon))), zero);
+      auto t = clamp01(S::Div(S::Add(S::Mul(b, s), f), S::Max(e, epsilon)));
+      s = clamp01(S::Div(S::Sub(S::Mul(b, t), c), S::Max(a, epsilon)));
+
+      V distSq = zero;
+      for (uint32_t k = 0; k < 3; ++k)
+      {
+        auto d = S::Sub(S::Add(r[k], S::Mul(da[k], s)), S::Mul(db[k], t));
+        distSq = S::Add(distSq, S::Mul(d, d));
+      }
+      S::Store(result + i, s);
+      S::Store(result + stride + i, t);
+      S::Store(result + 2 * stride + i, distSq);
+    }
+  }
+#endif
+}
+
+RigidBodySolver::RigidBodySolver()
+  : m_gravity(0.0f, -98.0f, 0.0f), m_timeStep(1.0f / 60.0f), m_accumulator(0.0f), m_maxSubSteps(3), m_iterationCount(4),
+  m_initialized(false)
+{
+}
+
+void RigidBodySolver::Build(const std::vector<BodyDesc>& bodies, const std::vector<JointDesc>& joints, const Skeleton& skeleton)
+{
+  m_bodies.clear();
+  m_joints.clear();
+  m_pairs.clear();
+  m_contacts.clear();
+  m_writeOrder.clear();
+  m_accumulator = 0.0f;
+  m_initialized = false;
+
+  const auto boneCount = int32_t(skeleton.GetBoneCount());
+  m_bodies.reserve(bodies.size());
+  for (const auto& desc : bodies)
+  {
+    if (desc.bone >= boneCount)
+    {
+      throw std::runtime_error("RigidBodySolver: bone index is out of range.");
+    }
+    Body body{};
+    body.bone = desc.bone;
+    body.type = desc.type;
+
+    // 初期姿勢でのボーンに対する相対位置.
+    glm::vec3 bonePosition(0.0f);
+    glm::quat boneRotation(1.0f, 0.0f, 0.0f, 0.0f);
+    if (desc.bone >= 0)
+    {
+      auto bind = glm::inverse(skeleton.GetInvBindMatrix(desc.bone));
+      bonePosition = glm::vec3(bind[3]);
+      boneRotation = ExtractRotation(bind);
+    }
+    auto invBoneRotation = glm::inverse(boneRotation);
+    auto rotation = glm::normalize(desc.rotation);
+    body.offset = invBoneRotation * (desc.position - bonePosition);
+    body.offsetRotation = glm::normalize(invBoneRotation * rotation);
+    body.position = body.prevPosition = body.kinematicStart = body.kinematicEnd = desc.position;
+    body.rotation = body.prevRotation = body.kinematicStartRotation = body.kinematicEndRotation = rotation;
+    body.velocity = body.angularVelocity = glm::vec3(0.0f);
+
+    // 衝突判定の線分. 箱は最も長い軸に沿い, 残りの軸の大きい方を半径とするカプセルで近似する.
+    float inertia = 0.0f;
+    const auto mass = desc.mass > 0.0f ? desc.mass : 1.0f;
+    switch (desc.shape)
+    {
+    case SHAPE_SPHERE:
+      body.axis = 1;
+      body.radius = desc.size.x;
+      body.halfLength = 0.0f;
+      inertia = 0.4f * mass * body.radius * body.radius;
+      break;
+    case SHAPE_BOX:
+    {
+      body.axis = uint8_t(desc.size.x >= desc.size.y && desc.size.x >= desc.size.z ? 0 : (desc.size.y >= desc.size.z ? 1 : 2));
+      body.radius = std::max(desc.size[(body.axis + 1) % 3], desc.size[(body.axis + 2) % 3]);
+      body.halfLength = std::max(desc.size[body.axis] - body.radius, 0.0f);
+      inertia = mass * 2.0f / 9.0f * glm::dot(desc.size, desc.size);
+      break;
+    }
+    default:
+    {
+      body.axis = 1;
+      body.radius = desc.size.x;
+      body.halfLength = 0.5f * desc.size.y;
+      // 円柱として求めた主軸の慣性モーメントの平均.
+      auto length = desc.size.y + 2.0f * body.radius;
+      auto r2 = body.radius * body.radius;
+      inertia = mass * (2.0f * (3.0f * r2 + length * length) / 12.0f + 0.5f * r2) / 3.0f;
+      break;
+    }
+    }
+    body.radius = std::max(body.radius, 0.0f);
+
+    const bool dynamic = desc.type != BODY_KINEMATIC;
+    body.invMass = dynamic ? 1.0f / mass : 0.0f;
+    body.invInertia = dynamic ? 1.0f / std::max(inertia, 1.0e-6f) : 0.0f;
+    body.linearDamping = std::min(std::max(desc.linearDamping, 0.0f), 1.0f);
+    body.angularDamping = std::min(std::max(desc.angularDamping, 0.0f), 1.0f);
+    m_bodies.push_back(body);
+    if (dynamic && desc.bone >= 0)
+    {
+      m_writeOrder.push_back(uint32_t(m_bodies.size() - 1));
+    }
+  }
+  std::stable_sort(m_writeOrder.begin(), m_writeOrder.end(), [this](uint32_t a, uint32_t b) { return m_bodies[a].bone < m_bodies[b].bone; });
+  // 親ボーンを先に書き戻す剛体. 同じボーンの剛体が複数ある場合は最後に書き戻すもの.
+  std::vector<int32_t> lastWrite(skeleton.GetBoneCount(), -1);
+  m_writeParents.assign(m_writeOrder.size(), -1);
+  m_writeTransforms.resize(m_writeOrder.size());
+  for (size_t i = 0; i < m_writeOrder.size(); ++i)
+  {
+    auto bone = uint32_t(m_bodies[m_writeOrder[i]].bone);
+    auto parent = skeleton.GetParent(bone);
+    m_writeParents[i] = parent >= 0 ? lastWrite[parent] : -1;
+    lastWrite[bone] = int32_t(i);
+  }
+  UpdateDecay();
+
+  // ジョイント. 両方がボーン追従の場合は解く必要が無いので除く.
+  const auto bodyCount = uint32_t(m_bodies.size());
+  std::unordered_set<uint64_t> jointedPairs;
+  for (const auto& desc : joints)
+  {
+    if (desc.bodies[0] >= bodyCount || desc.bodies[1] >= bodyCount)
+    {
+      throw std::runtime_error("RigidBodySolver: body index is out of range.");
+    }
+    auto a = desc.bodies[0], b = desc.bodies[1];
+    jointedPairs.insert(uint64_t(std::min(a, b)) << 32 | std::max(a, b));
+    const auto& bodyA = m_bodies[a];
+    const auto& bodyB = m_bodies[b];
+    if (bodyA.invMass == 0.0f && bodyB.invMass == 0.0f)
+    {
+      continue;
+    }
+    auto rotation = glm::normalize(desc.rotation);
+    auto invA = glm::inverse(bodyA.rotation), invB = glm::inverse(bodyB.rotation);
+    Joint joint{};
+    joint.a = a;
+    joint.b = b;
+    joint.localA = invA * (desc.position - bodyA.position);
+    joint.rotationA = glm::normalize(invA * rotation);
+    joint.localB = invB * (desc.position - bodyB.position);
+    joint.rotationB = glm::normalize(invB * rotation);
+    joint.linearLower = desc.linearLower;
+    joint.linearUpper = desc.linearUpper;
+    joint.angularLower = desc.angularLower;
+    joint.angularUpper = desc.angularUpper;
+    joint.linearLocked = desc.linearLower == glm::vec3(0.0f) && desc.linearUpper == glm::vec3(0.0f);
+    for (int i = 0; i < 3; ++i)
+    {
+      joint.linearCompliance[i] = desc.linearSpring[i] > 0.0f ? 1.0f / desc.linearSpring[i] : -1.0f;
+      joint.angularCompliance[i] = desc.angularSpring[i] > 0.0f ? 1.0f / desc.angularSpring[i] : -1.0f;
+    }
+    m_joints.push_back(joint);
+  }
+  // 物理演算の剛体を共有するジョイント同士の順序を保ったまま, 共有しないもの(別のチェインなど)を交互に並べる.
+  // 続けて解くジョイントが互いに依存しなくなり, 結果を変えずに命令を並列に実行しやすくなる.
+  std::vector<uint32_t> bodyLevels(bodyCount, 0), jointLevels;
+  for (const auto& joint : m_joints)
+  {
+    auto level = std::max(m_bodies[joint.a].invMass > 0.0f ? bodyLevels[joint.a] : 0u,
+      m_bodies[joint.b].invMass > 0.0f ? bodyLevels[joint.b] : 0u) + 1;
+    bodyLevels[joint.a] = bodyLevels[joint.b] = level;
+    jointLevels.push_back(level);
+  }
+  std::vector<uint32_t> jointOrder(m_joints.size());
+  for (uint32_t i = 0; i < jointOrder.size(); ++i)
+  {
+    jointOrder[i] = i;
+  }
+  std::stable_sort(jointOrder.begin(), jointOrder.end(), [&](uint32_t a, uint32_t b) { return jointLevels[a] < jointLevels[b]; });
+  std::vector<Joint> sortedJoints;
+  sortedJoints.reserve(m_joints.size());
+  for (auto index : jointOrder)
+  {
+    sortedJoints.push_back(m_joints[index]);
+  }
+  m_joints.swap(sortedJoints);
+
+  // 衝突判定を行う組. 互いのマスクに相手のグループが含まれるものに限る.
+  for (uint32_t a = 0; a < bodyCount; ++a)
+  {
+    for (uint32_t b = a + 1; b < bodyCount; ++b)
+    {
+      const auto& descA = bodies[a];
+      const auto& descB = bodies[b];
+      if (m_bodies[a].invMass == 0.0f && m_bodies[b].invMass == 0.0f)
+      {
+        continue;
+      }
+      if ((descA.groupMask & (1u << (descB.group & 15))) == 0 || (descB.groupMask & (1u << (descA.group & 15))) == 0)
+      {
+        continue;
+      }
+      if (jointedPairs.count(uint64_t(a) << 32 | b) != 0)
+      {
+        continue;
+      }
+      m_pairs.push_back(Pair{ a, b });
+    }
+  }
+  auto stride = (uint32_t(m_pairs.size()) + SegmentPairAlignment - 1) / SegmentPairAlignment * SegmentPairAlignment;
+  m_segments.assign(size_t(SegmentRowCount) * stride, 0.0f);
+  m_closest.assign(size_t(3) * stride, 0.0f);
+
+  // 初期姿勢で重なっている組は, モデル側で衝突させない意図のものとして除く.
+  DetectContacts(false);
+  if (!m_contacts.empty())
+  {
+    std::unordered_set<uint64_t> overlapped;
+    for (const auto& contact : m_contacts)
+    {
+      overlapped.insert(uint64_t(contact.a) << 32 | contact.b);
+    }
+    m_pairs.erase(std::remove_if(m_pairs.begin(), m_pairs.end(),
+      [&](const Pair& pair) { return overlapped.count(uint64_t(pair.a) << 32 | pair.b) != 0; }), m_pairs.end());
+    m_contacts.clear();
+  }
+}
+
+void RigidBodySolver::SetTimeStep(float timeStep)
+{
+  m_timeStep = std::max(timeStep, 1.0e-4f);
+  UpdateDecay();
+}
+
+void RigidBodySolver::SetIterationCount(uint32_t count)
+{
+  m_iterationCount = std::max(count, 1u);
+  UpdateDecay();
+}
+
+void RigidBodySolver::UpdateDecay()
+{
+  const auto h = m_timeStep / float(m_iterationCount);
+  for (auto& body : m_bodies)
+  {
+    body.linearDecay = std::pow(1.0f - body.linearDamping, h);
+    body.angularDecay = std::pow(1.0f - body.angularDamping, h);
+  }
+}
+
+void RigidBodySolver::Reset(Skeleton& skeleton)
+{
+  ComputeBoneTargets(skeleton, true);
+  for (auto& body : m_bodies)
+  {
+    body.position = body.prevPosition = body.kinematicStart = body.kinematicEnd;
+    body.rotation = body.prevRotation = body.kinematicStartRotation = body.kinematicEndRotation;
+    body.velocity = body.angularVelocity = glm::vec3(0.0f);
+  }
+  m_contacts.clear();
+  m_accumulator = 0.0f;
+  m_initialized = true;
+}
+
+void RigidBodySolver::Update(Skeleton& skeleton, float deltaTime)
+{
+  if (m_bodies.empty())
+  {
+    return;
+  }
+  if (!m_initialized)
+  {
+    Reset(skeleton);
+  }
+  else
+  {
+    ComputeBoneTargets(skeleton, false);
+  }
+
+  m_accumulator += std::max(deltaTime, 0.0f);
+  auto steps = uint32_t(m_accumulator / m_timeStep);
+  if (steps > m_maxSubSteps)
+  {
+    steps = m_maxSubSteps;
+    m_accumulator = 0.0f;
+  }
+  else
+  {
+    m_accumulator -= float(steps) * m_timeStep;
+  }
+  if (steps > 0)
+  {
+    // ボーン追従の剛体は, 前回から今回のボーンの位置までを刻みごとに補間して動かす.
+    for (uint32_t i = 0; i < steps; ++i)
+    {
+      Step(float(i) / float(steps), float(i + 1) / float(steps));
+    }
+    for (auto& body : m_bodies)
+    {
+      body.kinematicStart = body.kinematicEnd;
+      body.kinematicStartRotation = body.kinematicEndRotation;
+    }
+  }
+
+  // 数値が発散した場合は現在のボーンの位置からやり直す.
+  for (const auto& body : m_bodies)
+  {
+    if (!std::isfinite(body.position.x + body.position.y + body.position.z + body.rotation.w))
+    {
+      Reset(skeleton);
+      break;
+    }
+  }
+  WriteBack(skeleton);
+}
+
+void RigidBodySolver::ComputeBoneTargets(Skeleton& skeleton, bool dynamicBodies)
+{
+  for (auto& body : m_bodies)
+  {
+    if (body.bone < 0 || (!dynamicBodies && body.invMass > 0.0f))
+    {
+      continue;
+    }
+    const auto& world = skeleton.GetWorldMatrix(uint32_t(body.bone));
+    auto rotation = ExtractRotation(world);
+    body.kinematicEnd = glm::vec3(world[3]) + rotation * body.offset;
+    body.kinematicEndRotation = glm::normalize(rotation * body.offsetRotation);
+  }
+}
+
+void RigidBodySolver::Step(float alphaStart, float alphaEnd)
+{
+  // 接触する可能性のある組は刻みの始めに 1 度だけ, 刻みの間に動く距離の分の余裕を持たせて検出する.
+  // 分割した刻みの中では, それらの組が実際に重なっている場合のみ押し戻す.
+  m_bodyMargins.resize(m_bodies.size());
+  for (size_t i = 0; i < m_bodies.size(); ++i)
+  {
+    const auto& body = m_bodies[i];
+    auto target = glm::mix(body.kinematicStart, body.kinematicEnd, alphaEnd);
+    auto distance = body.invMass == 0.0f ? glm::length(target - body.position) : glm::length(body.velocity) * m_timeStep;
+    m_bodyMargins[i] = ContactMargin + distance;
+  }
+  DetectContacts(true);
+
+  const float h = m_timeStep / float(m_iterationCount);
+  const float invH = 1.0f / h;
+  for (uint32_t iteration = 0; iteration < m_iterationCount; ++iteration)
+  {
+    auto alpha = alphaStart + (alphaEnd - alphaStart) * float(iteration + 1) / float(m_iterationCount);
+    for (auto& body : m_bodies)
+    {
+      body.prevPosition = body.position;
+      body.prevRotation = body.rotation;
+      if (body.invMass == 0.0f)
+      {
+        body.position = glm::mix(body.kinematicStart, body.kinematicEnd, alpha);
+        body.rotation = glm::slerp(body.kinematicStartRotation, body.kinematicEndRotation, alpha);
+        continue;
+      }
+      body.velocity = (body.velocity + m_gravity * h) * body.linearDecay;
+      body.angularVelocity = body.angularVelocity * body.angularDecay;
+      body.position += body.velocity * h;
+      body.rotation = ApplyAngularDelta(body.rotation, body.angularVelocity * h);
+    }
+
+    for (const auto& joint : m_joints)
+    {
+      SolveJoint(joint, h);
+    }
+    for (auto& contact : m_contacts)
+    {
+      SolveContact(contact);
+    }
+
+    for (auto& body : m_bodies)
+    {
+      if (body.invMass == 0.0f)
+      {
+        continue;
+      }
+      body.velocity = (body.position - body.prevPosition) * invH;
+      // 分割した刻みの間の回転は小さいため, 回転ベクトルを四元数の虚部の 2 倍で近似する(XPBD の論文と同じ).
+      auto delta = body.rotation * glm::conjugate(body.prevRotation);
+      auto scale = (delta.w < 0.0f ? -2.0f : 2.0f) * invH;
+      body.angularVelocity = glm::vec3(delta.x, delta.y, delta.z) * scale;
+    }
+    // 押し戻した分が離れる向きの速度として残ると跳ね返り続けるため, 取り除く(反発係数 0).
+    for (const auto& contact : m_contacts)
+    {
+      if (contact.pushed)
+      {
+        RemoveSeparatingVelocity(contact);
+      }
+    }
+  }
+}
+
+void RigidBodySolver::RemoveSeparatingVelocity(const Contact& contact)
+{
+  auto& a = m_bodies[contact.a];
+  auto& b = m_bodies[contact.b];
+  auto pa = GetSegmentPoint(a, contact.s);
+  auto pb = GetSegmentPoint(b, contact.t);
+  auto d = pb - pa;
+  auto dist = glm::length(d);
+  if (dist < 1.0e-6f)
+  {
+    return;
+  }
+  auto n = d / dist;
+  auto ra = pa - a.position, rb = pb - b.position;
+  auto relative = b.velocity + glm::cross(b.angularVelocity, rb) - a.velocity - glm::cross(a.angularVelocity, ra);
+  auto normalVelocity = glm::dot(relative, n);
+  if (normalVelocity <= 0.0f)
+  {
+    return;
+  }
+  auto rna = glm::cross(ra, n), rnb = glm::cross(rb, n);
+  auto w = a.invMass + a.invInertia * glm::dot(rna, rna) + b.invMass + b.invInertia * glm::dot(rnb, rnb);
+  if (w <= 0.0f)
+  {
+    return;
+  }
+  auto impulse = normalVelocity / w;
+  a.velocity += n * (impulse * a.invMass);
+  a.angularVelocity += rna * (impulse * a.invInertia);
+  b.velocity -= n * (impulse * b.invMass);
+  b.angularVelocity -= rnb * (impulse * b.invInertia);
+}
+
+void RigidBodySolver::DetectContacts(bool useMargins)
+{
+  m_contacts.clear();
+  const auto pairCount = uint32_t(m_pairs.size());
+  if (pairCount == 0)
+  {
+    return;
+  }
+  // 剛体ごとに線分と, 中心からの届く範囲(線分の長さの半分と半径の和)を求める.
+  m_bodySegments.resize(m_bodies.size() * 2);
+  m_bodyReaches.resize(m_bodies.size());
+  for (size_t i = 0; i < m_bodies.size(); ++i)
+  {
+    const auto& body = m_bodies[i];
+    auto direction = GetSegmentDirection(body);
+    m_bodySegments[2 * i] = body.position - 0.5f * direction;
+    m_bodySegments[2 * i + 1] = direction;
+    m_bodyReaches[i] = body.radius + body.halfLength + (useMargins ? m_bodyMargins[i] : 0.0f);
+  }
+
+  // 中心間の距離が届く範囲の和より小さい組のみを詰めて並べ, 最近点を求める.
+  m_candidates.clear();
+  for (uint32_t i = 0; i < pairCount; ++i)
+  {
+    const auto& pair = m_pairs[i];
+    auto d = m_bodies[pair.b].position - m_bodies[pair.a].position;
+    auto reach = m_bodyReaches[pair.a] + m_bodyReaches[pair.b];
+    if (glm::dot(d, d) < reach * reach)
+    {
+      m_candidates.push_back(i);
+    }
+  }
+  const auto candidateCount = uint32_t(m_candidates.size());
+  if (candidateCount == 0)
+  {
+    return;
+  }
+  const auto stride = (candidateCount + SegmentPairAlignment - 1) / SegmentPairAlignment * SegmentPairAlignment;
+  auto write = [&](uint32_t row, uint32_t i, const glm::vec3& v) {
+    m_segments[size_t(row) * stride + i] = v.x;
+    m_segments[size_t(row + 1) * stride + i] = v.y;
+    m_segments[size_t(row + 2) * stride + i] = v.z;
+  };
+  for (uint32_t i = 0; i < candidateCount; ++i)
+  {
+    const auto& pair = m_pairs[m_candidates[i]];
+    write(A0, i, m_bodySegments[2 * pair.a]);
+    write(DA, i, m_bodySegments[2 * pair.a + 1]);
+    write(B0, i, m_bodySegments[2 * pair.b]);
+    write(DB, i, m_bodySegments[2 * pair.b + 1]);
+  }
+  // 詰めた後の余りの要素は前回の値のままで, 結果は使わない.
+  ClosestSegmentPoints(m_segments.data(), stride, m_closest.data());
+
+  const float* distSq = m_closest.data() + 2 * size_t(stride);
+  for (uint32_t i = 0; i < candidateCount; ++i)
+  {
+    const auto& pair = m_pairs[m_candidates[i]];
+    auto radius = m_bodies[pair.a].radius + m_bodies[pair.b].radius;
+    if (useMargins)
+    {
+      radius += m_bodyMargins[pair.a] + m_bodyMargins[pair.b];
+    }
+    if (distSq[i] < radius * radius)
+    {
+      m_contacts.push_back(Contact{ pair.a, pair.b, m_closest[i], m_closest[stride + i], false });
+    }
+  }
+}
+
+void RigidBodySolver::SolveJoint(const Joint& joint, float h)
+{
+  auto& a = m_bodies[joint.a];
+  auto& b = m_bodies[joint.b];
+
+  // 移動量. 剛体 A 側のジョイント空間で範囲に収め, 範囲内ではばねで 0 に近づける.
+  // 全ての軸で範囲が 0 の場合は, ジョイント空間に移さずに差をそのまま解消する.
+  auto ra = a.rotation * joint.localA;
+  auto rb = b.rotation * joint.localB;
+  auto separation = b.position + rb - a.position - ra;
+  if (joint.linearLocked)
+  {
+    ApplyPositionCorrection(a, b, ra, rb, separation, 0.0f);
+  }
+  else
+  {
+    auto frameA = a.rotation * joint.rotationA;
+    auto local = glm::conjugate(frameA) * separation;
+    auto limited = ClampRange(local, joint.linearLower, joint.linearUpper);
+    ApplyPositionCorrection(a, b, ra, rb, frameA * (local - limited), 0.0f);
+    for (int i = 0; i < 3; ++i)
+    {
+      if (joint.linearCompliance[i] >= 0.0f && limited[i] != 0.0f)
+      {
+        frameA = a.rotation * joint.rotationA;
+        ApplyPositionCorrection(a, b, a.rotation * joint.localA, b.rotation * joint.localB, frameA * (Axis(i) * limited[i]), joint.linearCompliance[i] / (h * h));
+      }
+    }
+  }
+
+  // 回転. 剛体 A 側のジョイント空間から見た剛体 B 側のジョイント空間の回転を, 回転ベクトルで扱う.
+  // 慣性テンソルが等方的なので各軸の補正は独立で, 範囲を超えた分とばねの分をまとめて 1 度に補正できる.
+  auto frameA = a.rotation * joint.rotationA;
+  auto frameB = b.rotation * joint.rotationB;
+  auto angles = ToRotationVector(glm::conjugate(frameA) * frameB);
+  auto limitedAngles = ClampRange(angles, joint.angularLower, joint.angularUpper);
+  auto correction = angles - limitedAngles;
+  auto w = a.invInertia + b.invInertia;
+  for (int i = 0; i < 3; ++i)
+  {
+    if (joint.angularCompliance[i] >= 0.0f)
+    {
+      correction[i] += limitedAngles[i] * w / (w + joint.angularCompliance[i] / (h * h));
+    }
+  }
+  ApplyRotationCorrection(a, b, frameA * correction, 0.0f);
+}
+
+void RigidBodySolver::SolveContact(Contact& contact)
+{
+  contact.pushed = false;
+  auto& a = m_bodies[contact.a];
+  auto& b = m_bodies[contact.b];
+  auto radius = a.radius + b.radius;
+  // 中心間の距離が線分の長さの半分と半径の和以上なら, 最近点を求めるまでもなく離れている.
+  auto reach = radius + a.halfLength + b.halfLength;
+  auto centers = b.position - a.position;
+  if (glm::dot(centers, centers) >= reach * reach)
+  {
+    return;
+  }
+  // 剛体が回ると最近点の位置が変わるため, 接触した組についてのみ求め直す.
+  auto da = GetSegmentDirection(a), db = GetSegmentDirection(b);
+  auto a0 = a.position - 0.5f * da, b0 = b.position - 0.5f * db;
+  ClosestSegmentParameters(a0, da, b0, db, contact.s, contact.t);
+  auto pa = a0 + da * contact.s;
+  auto pb = b0 + db * contact.t;
+  auto d = pb - pa;
+  auto distSq = glm::dot(d, d);
+  if (distSq >= radius * radius)
+  {
+    return;
+  }
+  auto dist = std::sqrt(distSq);
+  auto normal = dist > 1.0e-6f ? d / dist : glm::vec3(0.0f, 1.0f, 0.0f);
+  contact.pushed = true;
+  ApplyPositionCorrection(a, b, pa - a.position, pb - b.position, normal * (dist - radius), 0.0f);
+}
+
+// correction は A 側の点から B 側の点への差のうち, 解消したい量. A を correction の向きに, B を逆向きに動かす.
+// compliance はばねの強さの逆数を刻みの 2 乗で割ったもの.
+void RigidBodySolver::ApplyPositionCorrection(Body& a, Body& b, const glm::vec3& ra, const glm::vec3& rb, const glm::vec3& correction, float compliance)
+{
+  auto c = glm::length(correction);
+  if (c < 1.0e-7f)
+  {
+    return;
+  }
+  auto n = correction / c;
+  auto rna = glm::cross(ra, n);
+  auto rnb = glm::cross(rb, n);
+  auto w = a.invMass + a.invInertia * glm::dot(rna, rna) + b.invMass + b.invInertia * glm::dot(rnb, rnb);
+  w += compliance;
+  if (w <= 0.0f)
+  {
+    return;
+  }
+  auto lambda = c / w;
+  a.position += n * (lambda * a.invMass);
+  b.position -= n * (lambda * b.invMass);
+  if (a.invInertia > 0.0f)
+  {
+    a.rotation = ApplyAngularDelta(a.rotation, rna * (lambda * a.invInertia));
+  }
+  if (b.invInertia > 0.0f)
+  {
+    b.rotation = ApplyAngularDelta(b.rotation, rnb * (-lambda * b.invInertia));
+  }
+}
+
+// correction は A に対する B の回転(回転ベクトル)の, 解消したい量.
+void RigidBodySolver::ApplyRotationCorrection(Body& a, Body& b, const glm::vec3& correction, float compliance)
+{
+  auto c = glm::length(correction);
+  if (c < 1.0e-7f)
+  {
+    return;
+  }
+  auto w = a.invInertia + b.invInertia + compliance;
+  if (w <= 0.0f)
+  {
+    return;
+  }
+  auto lambda = c / w;
+  auto n = correction / c;
+  if (a.invInertia > 0.0f)
+  {
+    a.rotation = ApplyAngularDelta(a.rotation, n * (lambda * a.invInertia));
+  }
+  if (b.invInertia > 0.0f)
+  {
+    b.rotation = ApplyAngularDelta(b.rotation, n * (-lambda * b.invInertia));
+  }
+}
+
+void RigidBodySolver::WriteBack(Skeleton& skeleton)
+{
+  // 親が先に書き換わるよう, ボーン番号の昇順に処理する.
+  // 親ボーンも書き戻した場合は, ワールド行列を計算し直して回転を取り出す代わりに, 書き戻した位置と回転を使う.
+  for (size_t i = 0; i < m_writeOrder.size(); ++i)
+  {
+    auto& body = m_bodies[m_writeOrder[i]];
+    auto bone = uint32_t(body.bone);
+    auto boneRotation = glm::normalize(body.rotation * glm::conjugate(body.offsetRotation));
+    auto parent = skeleton.GetParent(bone);
+    glm::vec3 parentPosition(0.0f);
+    glm::quat parentRotation(1.0f, 0.0f, 0.0f, 0.0f);
+    if (m_writeParents[i] >= 0)
+    {
+      parentPosition = m_writeTransforms[m_writeParents[i]].position;
+      parentRotation = m_writeTransforms[m_writeParents[i]].rotation;
+    }
+    else if (parent >= 0)
+    {
+      const auto& parentWorld = skeleton.GetWorldMatrix(uint32_t(parent));
+      parentPosition = glm::vec3(parentWorld[3]);
+      parentRotation = ExtractRotation(parentWorld);
+    }
+    auto invParentRotation = glm::conjugate(parentRotation);
+    skeleton.SetRotation(bone, glm::normalize(invParentRotation * boneRotation));
+    glm::vec3 bonePosition;
+    if (body.type == BODY_DYNAMIC)
+    {
+      bonePosition = body.position - boneRotation * body.offset;
+      skeleton.SetTranslation(bone, invParentRotation * (bonePosition - parentPosition));
+    }
+    else
+    {
+      // 位置はボーンに合わせる.
+      bonePosition = parentPosition + parentRotation * skeleton.GetTranslation(bone);
+      body.position = bonePosition + boneRotation * body.offset;
+    }
+    m_writeTransforms[i] = WriteTransform{ bonePosition, boneRotation };
+  }
+}
+
+glm::vec3 RigidBodySolver::GetSegmentPoint(const Body& body, float s) const
+{
+  return body.position + GetSegmentDirection(body) * (s - 0.5f);
+}
+
+glm::vec3 RigidBodySolver::GetSegmentDirection(const Body& body) const
+{
+  if (body.halfLength == 0.0f)
+  {
+    return glm::vec3(0.0f);
+  }
+  return body.rotation * (Axis(body.axis) * (2.0f * body.halfLength));
+}
+
+void RigidBodySolver::GetBodySegment(uint32_t index, glm::vec3& p0, glm::vec3& p1, float& radius) const
+{
+  const auto& body = m_bodies[index];
+  p0 = GetSegmentPoint(body, 0.0f);
+  p1 = GetSegmentPoint(body, 1.0f);
+  radius = body.radius;
+}
+
+float RigidBodySolver::GetJointSeparation(uint32_t index) const
+{
+  const auto& joint = m_joints[index];
+  const auto& a = m_bodies[joint.a];
+  const auto& b = m_bodies[joint.b];
+  return glm::length((b.position + b.rotation * joint.localB) - (a.position + a.rotation * joint.localA));
+}
+
+void ClosestSegmentPointsScalar(const float* segments, uint32_t stride, float* result)
+{
+  for (uint32_t i = 0; i < stride; ++i)
+  {
+    glm::vec3 a0, da, b0, db;
+    for (uint32_t c = 0; c < 3; ++c)
+    {
+      a0[c] = segments[(A0 + c) * stride + i];
+      da[c] = segments[(DA + c) * stride + i];
+      b0[c] = segments[(B0 + c) * stride + i];
+      db[c] = segments[(DB + c) * stride + i];
+    }
+    float s, t;
+    ClosestSegmentParameters(a0, da, b0, db, s, t);
+    auto d = a0 - b0 + da * s - db * t;
+    result[i] = s;
+    result[stride + i] = t;
+    result[2 * stride + i] = glm::dot(d, d);
+  }
+}
+
+void ClosestSegmentPoints(const float* segments, uint32_t stride, float* result)
+{
+#if defined(SIMD_MATH_AVAILABLE)
+  ClosestSegmentPointsSimd<Simd>(segments, stride, result);
+#else
+  ClosestSegmentPointsScalar(segments, stride, result);
+#endif
+}
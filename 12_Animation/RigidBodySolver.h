@@ -0,0 +1,221 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Skeleton.h"
+
+// PMD の剛体とジョイントによる揺れもの(髪, スカートなど)の物理演算.
+// 位置ベースの解法(XPBD)を固定の時間刻みで進め, 結果をボーンの回転と移動量に書き戻す.
+// 剛体の位置と回転はモデル空間で持ち, ボーンは Skeleton のボーン番号で指定する. 描画には依存しない.
+//
+// 衝突判定は球とカプセルの組で行い, 箱は最も長い軸に沿ったカプセルで近似する.
+// 衝突する組はグループとマスクから構築時に決めておき, ジョイントでつながった組, 両方がボーン追従の組,
+// 初期姿勢で既に重なっている組は除く.
+// 各組は中心間の距離で絞り込んでから, 最近点を SIMD でまとめて求める(ClosestSegmentPoints).
+class RigidBodySolver
+{
+public:
+  enum Shape
+  {
+    SHAPE_SPHERE = 0,
+    SHAPE_BOX = 1,
+    SHAPE_CAPSULE = 2,
+  };
+  enum BodyType
+  {
+    BODY_KINEMATIC = 0,         // ボーンに追従する.
+    BODY_DYNAMIC = 1,           // 物理演算の結果でボーンの回転と移動量を上書きする.
+    BODY_DYNAMIC_ROTATION = 2,  // 物理演算の結果でボーンの回転のみ上書きする.
+  };
+  struct BodyDesc
+  {
+    int32_t bone;             // 関連ボーン. 無い場合は -1 で, 初期位置に固定される(ボーン追従の場合).
+    Shape shape;
+    BodyType type;
+    glm::vec3 size;           // 球は x が半径, 箱は各軸の半分の長さ, カプセルは x が半径, y が Y 軸方向の高さ(半球を除く).
+    glm::vec3 position;       // 初期姿勢でのモデル空間の位置.
+    glm::quat rotation;       // 初期姿勢でのモデル空間の回転.
+    float mass;
+    float linearDamping;      // 1 秒あたりに失う速度の割合 [0, 1].
+    float angularDamping;
+    uint32_t group;           // 0..15.
+    uint32_t groupMask;       // 衝突するグループのビット.
+  };
+  struct JointDesc
+  {
+    uint32_t bodies[2];
+    glm::vec3 position;       // 初期姿勢でのモデル空間の位置.
+    glm::quat rotation;       // 初期姿勢でのモデル空間の回転.
+    // ジョイント空間での, 剛体 A に対する剛体 B の移動量と回転(回転ベクトルで近似する)の範囲.
+    // 下限が上限より大きい軸は制限しない.
+    glm::vec3 linearLower;
+    glm::vec3 linearUpper;
+    glm::vec3 angularLower;
+    glm::vec3 angularUpper;
+    // 範囲内で初期姿勢に戻すばねの強さ. 0 の軸はばねを使わない.
+    glm::vec3 linearSpring;
+    glm::vec3 angularSpring;
+  };
+
+  RigidBodySolver();
+
+  // skeleton の初期姿勢(GetInvBindMatrix の逆行列)を基準に, 剛体とボーンの相対位置を求めて構築する.
+  // ボーン, 剛体の番号が範囲外の場合は例外を投げる.
+  void Build(const std::vector<BodyDesc>& bodies, const std::vector<JointDesc>& joints, const Skeleton& skeleton);
+
+  // 全ての剛体を現在のボーンの位置に置き, 速度を 0 にする.
+  void Reset(Skeleton& skeleton);
+  // deltaTime 秒進め, 物理演算の剛体のボーンを書き換える. ボーン追従の剛体は現在のボーンの位置に合わせる.
+  // 時間は固定の刻みで進め, 1 回の呼び出しで進める回数は GetMaxSubSteps までとする(超えた分は捨てる).
+  void Update(Skeleton& skeleton, float deltaTime);
+
+  void SetGravity(const glm::vec3& gravity) { m_gravity = gravity; }
+  const glm::vec3& GetGravity() const { return m_gravity; }
+  // 1 刻みの秒数. 減衰率も合わせて計算し直す.
+  void SetTimeStep(float timeStep);
+  float GetTimeStep() const { return m_timeStep; }
+  void SetMaxSubSteps(uint32_t count) { m_maxSubSteps = count; }
+  uint32_t GetMaxSubSteps() const { return m_maxSubSteps; }
+  // 1 刻みを分割して拘束を解く回数. 分割した刻みごとに速度も更新する(XPBD の小さな刻み).
+  void SetIterationCount(uint32_t count);
+  uint32_t GetIterationCount() const { return m_iterationCount; }
+
+  uint32_t GetBodyCount() const { return uint32_t(m_bodies.size()); }
+  uint32_t GetJointCount() const { return uint32_t(m_joints.size()); }
+  // 衝突判定を行う剛体の組の数.
+  uint32_t GetCollisionPairCount() const { return uint32_t(m_pairs.size()); }
+  // 最後の刻みで検出した接触の数(余裕を持たせて検出したものを含む).
+  uint32_t GetContactCount() const { return uint32_t(m_contacts.size()); }
+
+  // 剛体の現在のモデル空間の位置と回転.
+  const glm::vec3& GetBodyPosition(uint32_t body) const { return m_bodies[body].position; }
+  const glm::quat& GetBodyRotation(uint32_t body) const { return m_bodies[body].rotation; }
+  // 物理演算の剛体の, 最後に分割した刻みでの速度. ボーン追従の剛体は 0.
+  const glm::vec3& GetBodyVelocity(uint32_t body) const { return m_bodies[body].velocity; }
+  bool IsDynamic(uint32_t body) const { return m_bodies[body].invMass > 0.0f; }
+  // 衝突判定に使う線分(両端)と半径. 球は両端が同じ点になる.
+  void GetBodySegment(uint32_t body, glm::vec3& p0, glm::vec3& p1, float& radius) const;
+  // ジョイントの両側の剛体から求めた位置の差(モデル空間の長さ).
+  float GetJointSeparation(uint32_t joint) const;
+  // 衝突判定を行う組.
+  void GetCollisionPair(uint32_t pair, uint32_t& bodyA, uint32_t& bodyB) const { bodyA = m_pairs[pair].a; bodyB = m_pairs[pair].b; }
+private:
+  struct Body
+  {
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 prevPosition;
+    glm::quat prevRotation;
+    glm::vec3 velocity;
+    glm::vec3 angularVelocity;
+    // ボーン追従の剛体の, 前回と今回の Update でのボーンに合わせた位置.
+    glm::vec3 kinematicStart;
+    glm::quat kinematicStartRotation;
+    glm::vec3 kinematicEnd;
+    glm::quat kinematicEndRotation;
+    // 関連ボーンに対する相対位置と回転.
+    glm::vec3 offset;
+    glm::quat offsetRotation;
+    float invMass;            // ボーン追従の剛体は 0.
+    float invInertia;         // 慣性テンソルは等方的なものとして近似する.
+    float linearDamping;
+    float angularDamping;
+    float linearDecay;        // 分割した 1 刻みあたりの減衰率.
+    float angularDecay;
+    float radius;
+    float halfLength;         // 線分の長さの半分.
+    uint8_t axis;             // 線分の向き(剛体空間の軸).
+    int32_t bone;
+    BodyType type;
+  };
+  struct Joint
+  {
+    uint32_t a;
+    uint32_t b;
+    // 各剛体の空間でのジョイントの位置と回転.
+    glm::vec3 localA;
+    glm::quat rotationA;
+    glm::vec3 localB;
+    glm::quat rotationB;
+    glm::vec3 linearLower;
+    glm::vec3 linearUpper;
+    glm::vec3 angularLower;
+    glm::vec3 angularUpper;
+    glm::vec3 linearCompliance;   // ばねの強さの逆数. ばねを使わない軸は負の値.
+    glm::vec3 angularCompliance;
+    bool linearLocked;            // 移動量の範囲が全ての軸で 0.
+  };
+  struct Pair
+  {
+    uint32_t a;
+    uint32_t b;
+  };
+  struct Contact
+  {
+    uint32_t a;
+    uint32_t b;
+    float s;                  // 各線分上の最近点の媒介変数 [0, 1].
+    float t;
+    bool pushed;              // 直前の SolveContact で押し戻したか.
+  };
+  struct WriteTransform
+  {
+    glm::vec3 position;
+    glm::quat rotation;
+  };
+
+  // ボーンに合わせた位置を kinematicEnd に求める. dynamicBodies が false の場合はボーン追従の剛体のみ.
+  void ComputeBoneTargets(Skeleton& skeleton, bool dynamicBodies);
+  void UpdateDecay();
+  // ボーン追従の剛体は, 前回と今回のボーンに合わせた位置の間を alphaStart から alphaEnd まで動かす.
+  void Step(float alphaStart, float alphaEnd);
+  // useMargins が true の場合は, 半径に m_bodyMargins を加えて判定する.
+  void DetectContacts(bool useMargins);
+  void SolveJoint(const Joint& joint, float h);
+  void SolveContact(Contact& contact);
+  void RemoveSeparatingVelocity(const Contact& contact);
+  void ApplyPositionCorrection(Body& a, Body& b, const glm::vec3& ra, const glm::vec3& rb, const glm::vec3& correction, float compliance);
+  void ApplyRotationCorrection(Body& a, Body& b, const glm::vec3& correction, float compliance);
+  void WriteBack(Skeleton& skeleton);
+  glm::vec3 GetSegmentPoint(const Body& body, float s) const;
+  // 線分の始点から終点への差. 球は 0.
+  glm::vec3 GetSegmentDirection(const Body& body) const;
+
+  std::vector<Body> m_bodies;
+  std::vector<Joint> m_joints;
+  std::vector<Pair> m_pairs;
+  std::vector<Contact> m_contacts;
+  // 書き戻す剛体. ボーン番号の昇順(親が先)に並べる.
+  // m_writeParents は親ボーンを書き戻す m_writeOrder の要素の番号(無い場合は -1),
+  // m_writeTransforms は書き戻したボーンのモデル空間の位置と回転.
+  std::vector<uint32_t> m_writeOrder;
+  std::vector<int32_t> m_writeParents;
+  std::vector<WriteTransform> m_writeTransforms;
+  // ClosestSegmentPoints の入出力と, 剛体ごとの線分(始点と向きの組)と中心から届く範囲.
+  // 入出力は中心間の距離で絞り込んだ組(m_candidates)の分だけ詰めて使う.
+  std::vector<float> m_segments;
+  std::vector<glm::vec3> m_bodySegments;
+  std::vector<float> m_bodyReaches;
+  std::vector<float> m_bodyMargins;
+  std::vector<uint32_t> m_candidates;
+  std::vector<float> m_closest;
+
+  glm::vec3 m_gravity;
+  float m_timeStep;
+  float m_accumulator;
+  uint32_t m_maxSubSteps;
+  uint32_t m_iterationCount;
+  bool m_initialized;
+};
+
+// 線分の組ごとに最近点を求める. 線分 A は a0 + s * da, 線分 B は b0 + t * db (s, t は [0, 1]).
+// segments は a0.x, a0.y, a0.z, da.x, da.y, da.z, b0.x, b0.y, b0.z, db.x, db.y, db.z の順に stride 個ずつ並べたもの.
+// result には s, t, 最近点間の距離の 2 乗を stride 個ずつ書き込む.
+// stride は SegmentPairAlignment の倍数とし, stride 個全てを処理する. 命令セットは PoseKernel と同じく選ぶ.
+const uint32_t SegmentPairAlignment = 8;
+void ClosestSegmentPoints(const float* segments, uint32_t stride, float* result);
+// 基準となるスカラー実装.
+void ClosestSegmentPointsScalar(const float* segments, uint32_t stride, float* result);
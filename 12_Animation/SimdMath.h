@@ -0,0 +1,96 @@
+﻿#pragma once
+#include <cstdint>
+
+// float を Simd::Width 個ずつまとめて処理するための薄いラッパー.
+// 命令セットはビルド時に AVX2 (8 要素), SSE2 (4 要素), AArch64 NEON (4 要素) の順で選ぶ.
+// いずれも使えない場合は SIMD_MATH_AVAILABLE を定義しないので, 使う側でスカラー版に切り替える.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_MATH_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_MATH_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SIMD_MATH_NEON
+#endif
+
+namespace simd
+{
+  // And, Xor, Select のマスクは比較の結果(全ビット 1 か 0)を使う.
+#if defined(SIMD_MATH_AVX2)
+  struct Simd
+  {
+    using V = __m256;
+    static const uint32_t Width = 8;
+    static V Load(const float* p) { return _mm256_loadu_ps(p); }
+    static void Store(float* p, V v) { _mm256_storeu_ps(p, v); }
+    static V Set(float v) { return _mm256_set1_ps(v); }
+    static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    static V Div(V a, V b) { return _mm256_div_ps(a, b); }
+    static V Sqrt(V a) { return _mm256_sqrt_ps(a); }
+    static V Min(V a, V b) { return _mm256_min_ps(a, b); }
+    static V Max(V a, V b) { return _mm256_max_ps(a, b); }
+    static V And(V a, V b) { return _mm256_and_ps(a, b); }
+    static V Xor(V a, V b) { return _mm256_xor_ps(a, b); }
+    static V Less(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static V Select(V mask, V a, V b) { return _mm256_blendv_ps(b, a, mask); }
+    static uint32_t MoveMask(V a) { return uint32_t(_mm256_movemask_ps(a)); }
+    static const char* Name() { return "AVX2"; }
+  };
+#elif defined(SIMD_MATH_SSE2)
+  struct Simd
+  {
+    using V = __m128;
+    static const uint32_t Width = 4;
+    static V Load(const float* p) { return _mm_loadu_ps(p); }
+    static void Store(float* p, V v) { _mm_storeu_ps(p, v); }
+    static V Set(float v) { return _mm_set1_ps(v); }
+    static V Add(V a, V b) { return _mm_add_ps(a, b); }
+    static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+    static V Div(V a, V b) { return _mm_div_ps(a, b); }
+    static V Sqrt(V a) { return _mm_sqrt_ps(a); }
+    static V Min(V a, V b) { return _mm_min_ps(a, b); }
+    static V Max(V a, V b) { return _mm_max_ps(a, b); }
+    static V And(V a, V b) { return _mm_and_ps(a, b); }
+    static V Xor(V a, V b) { return _mm_xor_ps(a, b); }
+    static V Less(V a, V b) { return _mm_cmplt_ps(a, b); }
+    static V Select(V mask, V a, V b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+    static uint32_t MoveMask(V a) { return uint32_t(_mm_movemask_ps(a)); }
+    static const char* Name() { return "SSE2"; }
+  };
+#elif defined(SIMD_MATH_NEON)
+  struct Simd
+  {
+    using V = float32x4_t;
+    static const uint32_t Width = 4;
+    static V Load(const float* p) { return vld1q_f32(p); }
+    static void Store(float* p, V v) { vst1q_f32(p, v); }
+    static V Set(float v) { return vdupq_n_f32(v); }
+    static V Add(V a, V b) { return vaddq_f32(a, b); }
+    static V Sub(V a, V b) { return vsubq_f32(a, b); }
+    static V Mul(V a, V b) { return vmulq_f32(a, b); }
+    static V Div(V a, V b) { return vdivq_f32(a, b); }
+    static V Sqrt(V a) { return vsqrtq_f32(a); }
+    static V Min(V a, V b) { return vminq_f32(a, b); }
+    static V Max(V a, V b) { return vmaxq_f32(a, b); }
+    static V And(V a, V b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+    static V Xor(V a, V b) { return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+    static V Less(V a, V b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+    static V Select(V mask, V a, V b) { return vbslq_f32(vreinterpretq_u32_f32(mask), a, b); }
+    static uint32_t MoveMask(V a)
+    {
+      const uint32x4_t bits = { 1, 2, 4, 8 };
+      return vaddvq_u32(vandq_u32(vshrq_n_u32(vreinterpretq_u32_f32(a), 31), bits));
+    }
+    static const char* Name() { return "NEON"; }
+  };
+#endif
+}
+
+#if defined(SIMD_MATH_AVX2) || defined(SIMD_MATH_SSE2) || defined(SIMD_MATH_NEON)
+#define SIMD_MATH_AVAILABLE
+#endif
@@ -0,0 +1,165 @@
+﻿#include "Skeleton.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+std::vector<uint32_t> Skeleton::Build(const std::vector<BoneDesc>& bones)
+{
+  const auto count = uint32_t(bones.size());
+
+  // 子の一覧を親ごとに連続して並べる. 親が無いボーンは番号 count の仮の親の子として扱う.
+  std::vector<uint32_t> childOffsets(count + 3, 0);
+  for (const auto& bone : bones)
+  {
+    if (bone.parent >= int32_t(count))
+    {
+      throw std::runtime_error("bone parent index out of range.");
+    }
+    auto parent = bone.parent >= 0 ? uint32_t(bone.parent) : count;
+    ++childOffsets[parent + 2];
+  }
+  for (uint32_t i = 2; i < count + 3; ++i)
+  {
+    childOffsets[i] += childOffsets[i - 1];
+  }
+  std::vector<uint32_t> children(count);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    auto parent = bones[i].parent >= 0 ? uint32_t(bones[i].parent) : count;
+    children[childOffsets[parent + 1]++] = i;
+  }
+
+  // 深さ優先で行きがけ順に並べる. 根から辿れないボーンは循環の中にある.
+  std::vector<uint32_t> order(count);
+  std::vector<uint32_t> sorted;
+  sorted.reserve(count);
+  std::vector<uint32_t> stack;
+  for (auto i = childOffsets[count + 1]; i > childOffsets[count]; --i)
+  {
+    stack.push_back(children[i - 1]);
+  }
+  while (!stack.empty())
+  {
+    auto bone = stack.back();
+    stack.pop_back();
+    order[bone] = uint32_t(sorted.size());
+    sorted.push_back(bone);
+    for (auto i = childOffsets[bone + 1]; i > childOffsets[bone]; --i)
+    {
+      stack.push_back(children[i - 1]);
+    }
+  }
+  if (sorted.size() != count)
+  {
+    throw std::runtime_error("bone hierarchy has a cycle.");
+  }
+
+  m_names.resize(count);
+  m_parents.resize(count);
+  m_initialTranslations.resize(count);
+  m_invBindMatrices.resize(count);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    const auto& src = bones[sorted[i]];
+    m_names[i] = src.name;
+    m_parents[i] = src.parent >= 0 ? int32_t(order[src.parent]) : -1;
+    m_initialTranslations[i] = src.translation;
+    m_invBindMatrices[i] = src.invBind;
+  }
+  // 子孫は直後に並ぶので, 後ろから親へ範囲の終端を伝える.
+  m_subtreeEnds.resize(count);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    m_subtreeEnds[i] = i + 1;
+  }
+  for (auto i = count; i > 0; --i)
+  {
+    auto parent = m_parents[i - 1];
+    if (parent >= 0)
+    {
+      m_subtreeEnds[parent] = std::max(m_subtreeEnds[parent], m_subtreeEnds[i - 1]);
+    }
+  }
+
+  m_translations = m_initialTranslations;
+  m_rotations.assign(count, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+  m_worldMatrices.assign(count, glm::mat4(1.0f));
+  m_dirty.assign(count, 1);
+  m_changed.assign(count, 0);
+  UpdateWorldMatrices();
+  return order;
+}
+
+void Skeleton::SetTranslation(uint32_t bone, const glm::vec3& trans)
+{
+  if (m_translations[bone] != trans)
+  {
+    m_translations[bone] = trans;
+    Invalidate(bone);
+  }
+}
+
+void Skeleton::SetRotation(uint32_t bone, const glm::quat& rot)
+{
+  if (m_rotations[bone] != rot)
+  {
+    m_rotations[bone] = rot;
+    Invalidate(bone);
+  }
+}
+
+void Skeleton::Invalidate(uint32_t bone)
+{
+  // 既に更新が必要なボーンは子孫も全て更新が必要な状態になっている.
+  if (!m_dirty[bone])
+  {
+    std::fill(m_dirty.begin() + bone, m_dirty.begin() + m_subtreeEnds[bone], uint8_t(1));
+  }
+}
+
+glm::mat4 Skeleton::GetLocalMatrix(uint32_t bone) const
+{
+  // translate(t) * toMat4(q) と同じ.
+  glm::mat4 m = glm::mat4_cast(m_rotations[bone]);
+  m[3] = glm::vec4(m_translations[bone], 1.0f);
+  return m;
+}
+
+void Skeleton::ComputeWorldMatrix(uint32_t bone)
+{
+  auto parent = m_parents[bone];
+  m_worldMatrices[bone] = parent < 0 ? GetLocalMatrix(bone) : m_worldMatrices[parent] * GetLocalMatrix(bone);
+  m_dirty[bone] = 0;
+  m_changed[bone] = 1;
+}
+
+void Skeleton::UpdateWorldMatrix(uint32_t bone)
+{
+  // 更新が必要な祖先のうち最も上のものを探し, そこから bone までの間にある祖先を順に計算する.
+  // 行きがけ順なので, i が bone の祖先であることは bone < GetSubtreeEnd(i) で判定できる.
+  auto top = bone;
+  while (m_parents[top] >= 0 && m_dirty[m_parents[top]])
+  {
+    top = uint32_t(m_parents[top]);
+  }
+  for (auto i = top; i <= bone; ++i)
+  {
+    if (m_dirty[i] && bone < m_subtreeEnds[i])
+    {
+      ComputeWorldMatrix(i);
+    }
+  }
+}
+
+void Skeleton::UpdateWorldMatrices()
+{
+  // 親は必ず先に計算される.
+  const auto count = GetBoneCount();
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    if (m_dirty[i])
+    {
+      ComputeWorldMatrix(i);
+    }
+  }
+}
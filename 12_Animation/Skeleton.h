@@ -0,0 +1,93 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// ボーン階層.
+// ボーンは深さ優先の行きがけ順に並べ, 親は番号で持つ. 親は必ず子より前に来て,
+// 各ボーンの子孫はその直後に連続して並ぶ.
+// 移動量, 回転, ワールド行列はそれぞれ連続した配列で持つ.
+//
+// ワールド行列は必要になるまで計算しない. 移動量か回転が変わるとそのボーン以下の範囲を
+// 更新が必要な状態にし, GetWorldMatrix で読まれたボーンとその祖先のうち必要なものだけを計算する.
+// 更新が必要なボーンの子孫は全て更新が必要な状態になっている.
+class Skeleton
+{
+public:
+  struct BoneDesc
+  {
+    std::string name;
+    int32_t parent;           // 親が無い場合は -1.
+    glm::vec3 translation;    // 親ボーンからの相対位置.
+    glm::mat4 invBind;
+  };
+
+  // bones を行きがけ順に並べ替えて構築する. 兄弟の順序は bones での順序のまま.
+  // 戻り値は bones での番号から並べ替え後の番号への対応.
+  // 親の番号が範囲外, または階層が循環している場合は例外を投げる.
+  std::vector<uint32_t> Build(const std::vector<BoneDesc>& bones);
+
+  uint32_t GetBoneCount() const { return uint32_t(m_parents.size()); }
+  const std::string& GetName(uint32_t bone) const { return m_names[bone]; }
+  int32_t GetParent(uint32_t bone) const { return m_parents[bone]; }
+  // bone とその子孫の番号の範囲 [bone, GetSubtreeEnd(bone)).
+  uint32_t GetSubtreeEnd(uint32_t bone) const { return m_subtreeEnds[bone]; }
+
+  // 値が変わった場合のみ, bone 以下のワールド行列を更新が必要な状態にする.
+  void SetTranslation(uint32_t bone, const glm::vec3& trans);
+  void SetRotation(uint32_t bone, const glm::quat& rot);
+  const glm::vec3& GetTranslation(uint32_t bone) const { return m_translations[bone]; }
+  const glm::quat& GetRotation(uint32_t bone) const { return m_rotations[bone]; }
+  const glm::vec3& GetInitialTranslation(uint32_t bone) const { return m_initialTranslations[bone]; }
+
+  // 必要であれば祖先を含めて計算してから返す.
+  const glm::mat4& GetWorldMatrix(uint32_t bone)
+  {
+    if (m_dirty[bone])
+    {
+      UpdateWorldMatrix(bone);
+    }
+    return m_worldMatrices[bone];
+  }
+  const glm::mat4& GetInvBindMatrix(uint32_t bone) const { return m_invBindMatrices[bone]; }
+
+  // 更新が必要な全てのボーンのワールド行列を計算する.
+  void UpdateWorldMatrices();
+
+  // 前回の呼び出し以降にワールド行列が変わったボーンについて, 番号の昇順に func(bone) を呼ぶ.
+  // 更新が必要なボーンは先に計算する.
+  template<class Func>
+  void FlushChangedBones(Func func)
+  {
+    UpdateWorldMatrices();
+    for (uint32_t i = 0; i < GetBoneCount(); ++i)
+    {
+      if (m_changed[i])
+      {
+        m_changed[i] = 0;
+        func(i);
+      }
+    }
+  }
+private:
+  glm::mat4 GetLocalMatrix(uint32_t bone) const;
+  void ComputeWorldMatrix(uint32_t bone);
+  void UpdateWorldMatrix(uint32_t bone);
+  void Invalidate(uint32_t bone);
+
+  std::vector<std::string> m_names;
+  std::vector<int32_t> m_parents;
+  std::vector<uint32_t> m_subtreeEnds;
+  std::vector<glm::vec3> m_initialTranslations;
+  std::vector<glm::vec3> m_translations;
+  std::vector<glm::quat> m_rotations;
+  std::vector<glm::mat4> m_worldMatrices;
+  std::vector<glm::mat4> m_invBindMatrices;
+
+  // ワールド行列の更新が必要か, 前回の FlushChangedBones 以降に変わったか.
+  std::vector<uint8_t> m_dirty;
+  std::vector<uint8_t> m_changed;
+};
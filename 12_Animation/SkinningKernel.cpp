@@ -0,0 +1,143 @@
+﻿#include "SkinningKernel.h"
+#include "SimdMath.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+// ボーン行列をウェイトで混ぜてから頂点を変換する. 線形なのでボーンごとに変換してから混ぜる場合と同じ値になる.
+namespace
+{
+#if defined(SIMD_MATH_AVX2)
+  void SkinVerticesSimd(const SkinningVertex* vertices, uint32_t count, const float* palette, float* dst)
+  {
+    // 下位 4 要素で位置, 上位 4 要素で法線を計算する. 平行移動は位置にのみ加える.
+    const __m256 translationMask = _mm256_setr_ps(1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      const auto& v = vertices[i];
+      const float* m0 = palette + 16 * size_t(v.boneIndices[0]);
+      const float* m1 = palette + 16 * size_t(v.boneIndices[1]);
+      const __m256 w0 = _mm256_set1_ps(v.boneWeights[0]);
+      const __m256 w1 = _mm256_set1_ps(v.boneWeights[1]);
+      __m256 columns[4];
+      for (int c = 0; c < 4; ++c)
+      {
+        columns[c] = _mm256_add_ps(
+          _mm256_mul_ps(_mm256_broadcast_ps(reinterpret_cast<const __m128*>(m0 + 4 * c)), w0),
+          _mm256_mul_ps(_mm256_broadcast_ps(reinterpret_cast<const __m128*>(m1 + 4 * c)), w1));
+      }
+      auto x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(v.position[0])), _mm_set1_ps(v.normal[0]), 1);
+      auto y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(v.position[1])), _mm_set1_ps(v.normal[1]), 1);
+      auto z = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(v.position[2])), _mm_set1_ps(v.normal[2]), 1);
+      auto result = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(columns[0], x), _mm256_mul_ps(columns[1], y)),
+        _mm256_add_ps(_mm256_mul_ps(columns[2], z), _mm256_mul_ps(columns[3], translationMask)));
+      _mm256_storeu_ps(dst + 8 * size_t(i), result);
+    }
+  }
+#elif defined(SIMD_MATH_SSE2)
+  void SkinVerticesSimd(const SkinningVertex* vertices, uint32_t count, const float* palette, float* dst)
+  {
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      const auto& v = vertices[i];
+      const float* m0 = palette + 16 * size_t(v.boneIndices[0]);
+      const float* m1 = palette + 16 * size_t(v.boneIndices[1]);
+      const __m128 w0 = _mm_set1_ps(v.boneWeights[0]);
+      const __m128 w1 = _mm_set1_ps(v.boneWeights[1]);
+      __m128 columns[4];
+      for (int c = 0; c < 4; ++c)
+      {
+        columns[c] = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m0 + 4 * c), w0), _mm_mul_ps(_mm_loadu_ps(m1 + 4 * c), w1));
+      }
+      auto position = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(v.position[0])), _mm_mul_ps(columns[1], _mm_set1_ps(v.position[1]))),
+        _mm_add_ps(_mm_mul_ps(columns[2], _mm_set1_ps(v.position[2])), columns[3]));
+      auto normal = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(columns[0], _mm_set1_ps(v.normal[0])), _mm_mul_ps(columns[1], _mm_set1_ps(v.normal[1]))),
+        _mm_mul_ps(columns[2], _mm_set1_ps(v.normal[2])));
+      _mm_storeu_ps(dst + 8 * size_t(i), position);
+      _mm_storeu_ps(dst + 8 * size_t(i) + 4, normal);
+    }
+  }
+#elif defined(SIMD_MATH_NEON)
+  void SkinVerticesSimd(const SkinningVertex* vertices, uint32_t count, const float* palette, float* dst)
+  {
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      const auto& v = vertices[i];
+      const float* m0 = palette + 16 * size_t(v.boneIndices[0]);
+      const float* m1 = palette + 16 * size_t(v.boneIndices[1]);
+      float32x4_t columns[4];
+      for (int c = 0; c < 4; ++c)
+      {
+        columns[c] = vaddq_f32(vmulq_n_f32(vld1q_f32(m0 + 4 * c), v.boneWeights[0]), vmulq_n_f32(vld1q_f32(m1 + 4 * c), v.boneWeights[1]));
+      }
+      auto position = vaddq_f32(
+        vaddq_f32(vmulq_n_f32(columns[0], v.position[0]), vmulq_n_f32(columns[1], v.position[1])),
+        vaddq_f32(vmulq_n_f32(columns[2], v.position[2]), columns[3]));
+      auto normal = vaddq_f32(
+        vaddq_f32(vmulq_n_f32(columns[0], v.normal[0]), vmulq_n_f32(columns[1], v.normal[1])),
+        vmulq_n_f32(columns[2], v.normal[2]));
+      vst1q_f32(dst + 8 * size_t(i), position);
+      vst1q_f32(dst + 8 * size_t(i) + 4, normal);
+    }
+  }
+#endif
+}
+
+void SkinVerticesScalar(const SkinningVertex* vertices, uint32_t count, const float* palette, float* dst)
+{
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    const auto& v = vertices[i];
+    float* out = dst + 8 * size_t(i);
+    std::fill(out, out + 8, 0.0f);
+    for (int b = 0; b < 2; ++b)
+    {
+      const float* m = palette + 16 * size_t(v.boneIndices[b]);
+      const float w = v.boneWeights[b];
+      for (int r = 0; r < 4; ++r)
+      {
+        out[r] += (m[r] * v.position[0] + m[4 + r] * v.position[1] + m[8 + r] * v.position[2] + m[12 + r]) * w;
+      }
+      for (int r = 0; r < 3; ++r)
+      {
+        out[4 + r] += (m[r] * v.normal[0] + m[4 + r] * v.normal[1] + m[8 + r] * v.normal[2]) * w;
+      }
+    }
+  }
+}
+
+void SkinVertices(const SkinningVertex* vertices, uint32_t count, const float* palette, float* dst)
+{
+#if defined(SIMD_MATH_AVAILABLE)
+  SkinVerticesSimd(vertices, count, palette, dst);
+#else
+  SkinVerticesScalar(vertices, count, palette, dst);
+#endif
+}
+
+void SkinVerticesParallel(ThreadPool* pool, const SkinningVertex* vertices, uint32_t count, const float* palette, float* dst)
+{
+  const uint32_t blockCount = (count + SkinningBlockSize - 1) / SkinningBlockSize;
+  if (pool == nullptr || blockCount <= 1)
+  {
+    SkinVertices(vertices, count, palette, dst);
+    return;
+  }
+  pool->ParallelFor(blockCount, [&](uint32_t block) {
+    const uint32_t start = block * SkinningBlockSize;
+    const uint32_t blockVertices = std::min(SkinningBlockSize, count - start);
+    SkinVertices(vertices + start, blockVertices, palette, dst + 8 * size_t(start));
+  });
+}
+
+const char* GetSkinningKernelName()
+{
+#if defined(SIMD_MATH_AVAILABLE)
+  return simd::Simd::Name();
+#else
+  return "Scalar";
+#endif
+}
@@ -0,0 +1,34 @@
+﻿#pragma once
+#include <cstdint>
+
+class ThreadPool;
+
+// CPU での 2 ボーンの線形ブレンドスキニング. 描画には依存しない.
+// 結果は modelSkinningCS の出力と同じ並びで, 頂点ごとに位置(w はウェイトの和)と
+// 正規化しない法線(w = 0)の 8 個の float (Model::SkinnedVertex) を書き込む.
+// 命令セットは PoseKernel と同じく選ぶ. AVX2 では 1 頂点の位置と法線を 8 要素でまとめて計算する.
+
+// Model::PMDVertex と同じ並びの頂点.
+struct SkinningVertex
+{
+  float position[3];
+  float normal[3];
+  float uv[2];
+  uint32_t boneIndices[2];
+  float boneWeights[2];
+  uint32_t edgeFlag;
+};
+
+// 1 スレッドで続けて処理する頂点数. SkinVerticesParallel はこの単位で分ける.
+const uint32_t SkinningBlockSize = 2048;
+
+// palette はボーン行列(列優先の 4x4 を 16 個の float)で, 頂点のボーン番号は範囲内であること.
+void SkinVertices(const SkinningVertex* vertices, uint32_t count, const float* palette, float* dst);
+// pool で SkinningBlockSize 頂点ずつ並列に処理する. pool が nullptr の場合は呼び出したスレッドのみで処理する.
+void SkinVerticesParallel(ThreadPool* pool, const SkinningVertex* vertices, uint32_t count, const float* palette, float* dst);
+
+// 基準となるスカラー実装. modelSkinningCS と同じく, ボーンごとに変換してからウェイトで足し合わせる.
+void SkinVerticesScalar(const SkinningVertex* vertices, uint32_t count, const float* palette, float* dst);
+
+// ビルド時に選ばれた命令セットの名前.
+const char* GetSkinningKernelName();
@@ -6,6 +6,7 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <cwchar>
 
 #include "VulkanBookUtil.h"
 
@@ -87,7 +88,6 @@ static void WindowResizeCallback(GLFWwindow* window, int width, int height)
 int __stdcall wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nCmdShow)
 {
   UNREFERENCED_PARAMETER(hPrevInstance);
-  UNREFERENCED_PARAMETER(lpCmdLine);
   glfwInit();
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
   glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
@@ -103,6 +103,11 @@ int __stdcall wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCm
 
   RenderPMDApp theApp;
   glfwSetWindowUserPointer(window, &theApp);
+  // GPU ̖, --cpu-skinning ŃXLjO CPU ōs.
+  if (lpCmdLine != nullptr && wcsstr(lpCmdLine, L"--cpu-skinning") != nullptr)
+  {
+    theApp.SetSkinningMode(Model::SKINNING_CPU);
+  }
 
   try
   {
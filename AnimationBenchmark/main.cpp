@@ -0,0 +1,1944 @@
+﻿#include "AnimationLod.h"
+#include "Animator.h"
+#include "BakedClip.h"
+#include "BezierEasing.h"
+#include "BoneIK.h"
+#include "CompressedClip.h"
+#include "FaceMorph.h"
+#include "PoseCache.h"
+#include "PoseKernel.h"
+#include "RigidBodySolver.h"
+#include "SkinningKernel.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// アニメーション処理の計測.
+//   AnimationBenchmark [bezier] [baked] [compressed] [kernel] [ik] [parallel] [lod] [cache] [physics] [skinning] [morph] [--iterations N] [--seed N] [options]
+//   計測項目を省略した場合は全て実行する.
+//     bezier : VMD ベジェ補間の評価. ニュートン法と BezierEasingTable の速度と最大誤差を比べる.
+//              誤差は制御点 0..127 を --step 刻みで掃引し, 二分法で求めた値との差で求める.
+//     baked  : 同じモーションを再生する --characters 体分の姿勢計算. キーフレームからの評価と
+//              BakedClip (1 フレームあたり --samples-per-frame 回) からの補間を比べる.
+//              モーションは --bones 本のボーン, 各 --keys 個のキー, --frames フレームの長さで生成する.
+//     compressed : キーフレーム, BakedClip, CompressedClip (既定の許容誤差) のメモリ量, 展開速度を比べる.
+//              モーションは baked と同じ大きさで, 移動や回転が変化しないボーンを含めて生成する.
+//              キーフレームからの評価との差が許容誤差を超えた場合はエラーで終了する.
+//     kernel : BlendPoses の SIMD 版とスカラー版の速度を比べ, 結果が許容誤差内にあることを確認する.
+//              slerp は回転の間の角度 0..180 度と補間率を掃引し, glm::slerp との差が BlendPosesSlerpMaxError 以下であることも確認する.
+//              許容誤差を超えた場合はエラーで終了する.
+//     ik     : 脚の IK を CCD と 2 ボーンの解析解で解き, 速度と足首の目標からの誤差を比べる.
+//              目標は脚の届く範囲に --characters x 16 組生成し, 解析解が目標に届かない場合はエラーで終了する.
+//     parallel : --characters 体分のノードアニメーション, 脚の IK, ボーン行列, 表情モーフの更新を
+//              ThreadPool::ParallelFor でスレッド数を変えて実行し, スループットと 1 スレッドに対する速度向上を比べる.
+//              骨格は --bones 本. スレッド数によって結果が変わった場合はエラーで終了する.
+//     lod    : カメラからの距離を変えて並べた --characters 体を, AnimationLodPolicy で選んだ LOD で更新し,
+//              毎ティック全て更新した場合との速度とボーン位置の誤差(画面上のピクセル数を含む)を比べる.
+//              毎ティック評価する段階の結果が一致しない場合はエラーで終了する.
+//     cache  : --characters 体を 4 組に分けて同じモーションを再生する場合と, 再生位置を往復させる場合について,
+//              PoseCache の有無による速度とヒット率を比べる. 結果が変わった場合はエラーで終了する.
+//     physics : 髪とスカートの揺れものを持つ 20 体を RigidBodySolver で 60Hz 更新し, 1 ティックあたりの時間を
+//              2ms の予算と比べる. 最近点の SIMD 版とスカラー版の不一致, 衝突判定の組の数の不一致, 数値の発散, 剛体の速さが
+//              エネルギーから求めた上限を超えた場合, ジョイントの離れやめり込みが 1 刻みの移動量から求めた許容値を超えた場合,
+//              ボーンが剛体に追従しない場合はエラーで終了する.
+//     skinning : --vertices 頂点, --bones 本のボーンのメッシュを CPU でスキニングし, スカラー版, SIMD 版,
+//              SIMD 版をスレッド数を変えて並列に実行した場合の 1 フレームあたりの時間とスループットを比べる.
+//              SIMD 版, 並列版の結果がスカラー版と許容誤差を超えて異なる場合はエラーで終了する.
+//     morph  : --vertices 頂点のモデルで瞬き, 口の開閉, 表情の切り替えを 3 枚のスワップチェインのイメージへ描く場合について,
+//              毎ティック全ての表情を適用して頂点全体を転送する場合と, FaceMorph で変わった頂点のみを計算し
+//              書き換えた範囲のみを転送する場合の時間と転送量を比べる. 転送後の頂点が一致しない場合はエラーで終了する.
+//              GPU で適用する場合の CSR 形式の移動量の大きさも表示し, modelSkinningCS と同じ手順で CPU 上で適用した結果が
+//              FaceMorph と一致しない場合もエラーで終了する. さらにボーン行列が変わらない場合について, 変わった範囲のみを
+//              スキニングし直す場合と全頂点をスキニングする場合の時間を比べ, 結果が一致しない場合もエラーで終了する.
+
+namespace
+{
+  struct Options
+  {
+    uint32_t iterations = 10;
+    uint32_t step = 9;
+    uint32_t seed = 1;
+    uint32_t bones = 128;
+    uint32_t keys = 300;
+    uint32_t frames = 3600;
+    uint32_t characters = 64;
+    uint32_t samplesPerFrame = 1;
+    uint32_t vertices = 100000;
+    std::vector<std::string> benchmarks;
+  };
+
+  Options ParseOptions(int argc, char* argv[])
+  {
+    Options options;
+    std::map<std::string, std::function<void(uint32_t)>> values{
+      { "--iterations", [&](uint32_t v) { options.iterations = std::max(v, 1u); } },
+      { "--step", [&](uint32_t v) { options.step = std::max(v, 1u); } },
+      { "--seed", [&](uint32_t v) { options.seed = v; } },
+      { "--bones", [&](uint32_t v) { options.bones = std::max(v, 1u); } },
+      { "--keys", [&](uint32_t v) { options.keys = std::max(v, 2u); } },
+      { "--frames", [&](uint32_t v) { options.frames = std::max(v, 1u); } },
+      { "--characters", [&](uint32_t v) { options.characters = std::max(v, 1u); } },
+      { "--samples-per-frame", [&](uint32_t v) { options.samplesPerFrame = std::max(v, 1u); } },
+      { "--vertices", [&](uint32_t v) { options.vertices = std::max(v, 1u); } },
+    };
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      if (arg.compare(0, 2, "--") != 0)
+      {
+        options.benchmarks.push_back(arg);
+        continue;
+      }
+      if (values.count(arg) == 0)
+      {
+        throw std::runtime_error("Unknown option " + arg);
+      }
+      if (i + 1 >= argc)
+      {
+        throw std::runtime_error(arg + " requires a number.");
+      }
+      values[arg](uint32_t(std::stoul(argv[++i])));
+    }
+    return options;
+  }
+
+  // 計測した時間の中央値(秒).
+  double MeasureSeconds(uint32_t iterations, const std::function<void()>& func)
+  {
+    func();
+    std::vector<double> samples(iterations);
+    for (auto& sample : samples)
+    {
+      auto start = std::chrono::steady_clock::now();
+      func();
+      auto end = std::chrono::steady_clock::now();
+      sample = std::chrono::duration<double>(end - start).count();
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+  }
+
+  // 誤差評価用の基準値. x(t) は単調増加なので二分法で t を求める.
+  double ReferenceBezierEasing(const glm::vec4& k, double x)
+  {
+    double lo = 0.0, hi = 1.0;
+    for (int i = 0; i < 80; ++i)
+    {
+      double t = (lo + hi) * 0.5, s = 1.0 - t;
+      double xt = 3.0 * s * s * t * k.x + 3.0 * s * t * t * k.z + t * t * t;
+      (xt < x ? lo : hi) = t;
+    }
+    double t = (lo + hi) * 0.5, s = 1.0 - t;
+    return 3.0 * s * s * t * k.y + 3.0 * s * t * t * k.w + t * t * t;
+  }
+
+  // 2 つの回転の差の角度. 1 に近い内積の acos では精度が出ないため弦の長さから求める.
+  float RotationAngle(const glm::quat& a, const glm::quat& b)
+  {
+    double dot = double(a.x) * b.x + double(a.y) * b.y + double(a.z) * b.z + double(a.w) * b.w;
+    double sign = dot < 0.0 ? -1.0 : 1.0;
+    double dx = a.x - sign * b.x, dy = a.y - sign * b.y, dz = a.z - sign * b.z, dw = a.w - sign * b.w;
+    return float(4.0 * std::asin(std::min(std::sqrt(dx * dx + dy * dy + dz * dz + dw * dw) * 0.5, 1.0)));
+  }
+
+  glm::vec4 ControlPoints(int x1, int y1, int x2, int y2)
+  {
+    return glm::vec4(float(x1), float(y1), float(x2), float(y2)) / 127.0f;
+  }
+
+  void BenchmarkBezierEasing(const Options& options)
+  {
+    // 速度. 乱数の制御点と x の組をまとめて評価する.
+    const uint32_t CurveCount = 1024;
+    const uint32_t EvalCount = 1 << 20;
+    std::mt19937 engine(options.seed);
+    std::uniform_int_distribution<int> control(0, 127);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    BezierEasingTable table;
+    std::vector<glm::vec4> curves(CurveCount);
+    std::vector<uint32_t> curveIds(CurveCount);
+    for (uint32_t i = 0; i < CurveCount; ++i)
+    {
+      curves[i] = ControlPoints(control(engine), control(engine), control(engine), control(engine));
+      curveIds[i] = table.Register(curves[i]);
+    }
+    std::vector<uint32_t> evalCurves(EvalCount);
+    std::vector<float> evalX(EvalCount);
+    for (uint32_t i = 0; i < EvalCount; ++i)
+    {
+      evalCurves[i] = engine() % CurveCount;
+      evalX[i] = unit(engine);
+    }
+
+    volatile float sink = 0.0f;
+    auto newtonSeconds = MeasureSeconds(options.iterations, [&]() {
+      float sum = 0.0f;
+      for (uint32_t i = 0; i < EvalCount; ++i)
+      {
+        sum += SolveBezierEasing(curves[evalCurves[i]], evalX[i]);
+      }
+      sink = sum;
+    });
+    auto tableSeconds = MeasureSeconds(options.iterations, [&]() {
+      float sum = 0.0f;
+      for (uint32_t i = 0; i < EvalCount; ++i)
+      {
+        sum += table.Evaluate(curveIds[evalCurves[i]], evalX[i]);
+      }
+      sink = sum;
+    });
+
+    // 誤差. 制御点を掃引する.
+    double newtonMax = 0.0, tableMax = 0.0, newtonSum = 0.0, tableSum = 0.0;
+    glm::vec4 newtonWorst(0.0f), tableWorst(0.0f);
+    uint64_t sampleCount = 0;
+    BezierEasingTable sweepTable;
+    for (int x1 = 0; x1 < 128; x1 += options.step)
+    for (int y1 = 0; y1 < 128; y1 += options.step)
+    for (int x2 = 0; x2 < 128; x2 += options.step)
+    for (int y2 = 0; y2 < 128; y2 += options.step)
+    {
+      auto k = ControlPoints(x1, y1, x2, y2);
+      auto id = sweepTable.Register(k);
+      for (int i = 0; i <= 200; ++i)
+      {
+        auto x = float(i) / 200.0f;
+        auto reference = ReferenceBezierEasing(k, x);
+        auto newtonError = std::abs(double(SolveBezierEasing(k, x)) - reference);
+        auto tableError = std::abs(double(sweepTable.Evaluate(id, x)) - reference);
+        if (!(newtonError <= 1.0))
+        {
+          newtonError = 1.0;  // 発散した場合.
+        }
+        if (newtonError > newtonMax)
+        {
+          newtonMax = newtonError;
+          newtonWorst = k * 127.0f;
+        }
+        if (tableError > tableMax)
+        {
+          tableMax = tableError;
+          tableWorst = k * 127.0f;
+        }
+        newtonSum += newtonError;
+        tableSum += tableError;
+        ++sampleCount;
+      }
+    }
+
+    std::cout << "bezier easing (" << EvalCount << " evaluations, " << CurveCount << " curves, median of " << options.iterations << ")" << std::endl;
+    printf("  %-8s %10s %12s %12s  %s\n", "method", "ns/eval", "max error", "mean error", "worst control points");
+    printf("  %-8s %10.2f %12.3e %12.3e  (%g, %g, %g, %g)\n", "newton", newtonSeconds / EvalCount * 1.0e9,
+      newtonMax, newtonSum / sampleCount, newtonWorst.x, newtonWorst.y, newtonWorst.z, newtonWorst.w);
+    printf("  %-8s %10.2f %12.3e %12.3e  (%g, %g, %g, %g)\n", "table", tableSeconds / EvalCount * 1.0e9,
+      tableMax, tableSum / sampleCount, tableWorst.x, tableWorst.y, tableWorst.z, tableWorst.w);
+    printf("  error sweep: %llu curves (step %u), %llu samples\n\n",
+      (unsigned long long)sweepTable.GetCurveCount(), options.step, (unsigned long long)sampleCount);
+  }
+
+  // VMD 相当のボーントラックを乱数で作る. 先頭キーは 0 フレーム, 末尾キーは frames フレーム.
+  std::vector<NodeAnimation> GenerateNodeAnimations(const Options& options, BezierEasingTable& easing)
+  {
+    std::mt19937 engine(options.seed);
+    std::uniform_int_distribution<int> control(0, 127);
+    std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+    const auto keyCount = std::min(options.keys, options.frames + 1);
+
+    std::vector<NodeAnimation> tracks(options.bones);
+    for (auto& track : tracks)
+    {
+      std::vector<uint32_t> keyFrames{ 0, options.frames };
+      while (keyFrames.size() < keyCount)
+      {
+        keyFrames.push_back(engine() % (options.frames + 1));
+        std::sort(keyFrames.begin(), keyFrames.end());
+        keyFrames.erase(std::unique(keyFrames.begin(), keyFrames.end()), keyFrames.end());
+      }
+
+      std::vector<NodeAnimeFrame> frames(keyFrames.size());
+      for (size_t i = 0; i < frames.size(); ++i)
+      {
+        auto& dst = frames[i];
+        dst.frame = keyFrames[i];
+        // 隣接キー間の変化は実際のモーション程度(回転は 0.5 ラジアン以内)にする.
+        auto axis = glm::normalize(glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+        auto step = glm::angleAxis(0.5f * signedUnit(engine), axis);
+        dst.translation = (i == 0 ? glm::vec3(0.0f) : frames[i - 1].translation) + 0.1f * glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine));
+        dst.rotation = glm::normalize((i == 0 ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : frames[i - 1].rotation) * step);
+        for (int k = 0; k < 4; ++k)
+        {
+          dst.interpCurves[k] = easing.Register(ControlPoints(control(engine), control(engine), control(engine), control(engine)));
+        }
+      }
+      track.SetKeyframes(std::move(frames));
+    }
+    return tracks;
+  }
+
+  // compressed で使うボーントラック. GenerateNodeAnimations は全てのボーンの移動と回転が変化し続けるため,
+  // 定数のトラックや移動の量子化の効果が表れない. ここでは実際のモーションに近づけて,
+  // 移動するのは 16 本に 1 本のボーンのみ, 4 本に 1 本は回転も先頭キーから変化しない(指など)ものとする.
+  // 補間曲線も実際の VMD と同じく少数の種類(直線と CurvePaletteSize 種類)から選ぶ.
+  // キーの位置, 1 キーあたりの回転量は GenerateNodeAnimations と同じ.
+  const uint32_t CurvePaletteSize = 32;
+  std::vector<NodeAnimation> GenerateSparseNodeAnimations(const Options& options, BezierEasingTable& easing)
+  {
+    std::mt19937 engine(options.seed);
+    std::uniform_int_distribution<int> control(0, 127);
+    std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+    const auto keyCount = std::min(options.keys, options.frames + 1);
+    std::vector<uint32_t> palette{ easing.Register(ControlPoints(20, 20, 107, 107)) };
+    while (palette.size() <= CurvePaletteSize)
+    {
+      palette.push_back(easing.Register(ControlPoints(control(engine), control(engine), control(engine), control(engine))));
+    }
+
+    std::vector<NodeAnimation> tracks(options.bones);
+    for (uint32_t bone = 0; bone < options.bones; ++bone)
+    {
+      const bool isMoving = bone % 16 == 0;
+      const bool isStatic = bone % 4 == 3;
+      std::vector<uint32_t> keyFrames{ 0, options.frames };
+      while (keyFrames.size() < keyCount)
+      {
+        keyFrames.push_back(engine() % (options.frames + 1));
+        std::sort(keyFrames.begin(), keyFrames.end());
+        keyFrames.erase(std::unique(keyFrames.begin(), keyFrames.end()), keyFrames.end());
+      }
+
+      std::vector<NodeAnimeFrame> frames(keyFrames.size());
+      for (size_t i = 0; i < frames.size(); ++i)
+      {
+        auto& dst = frames[i];
+        dst.frame = keyFrames[i];
+        auto axis = glm::normalize(glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+        auto step = glm::angleAxis(isStatic && i > 0 ? 0.0f : 0.5f * signedUnit(engine), axis);
+        auto move = isMoving ? 0.1f * glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine)) : glm::vec3(0.0f);
+        dst.translation = (i == 0 ? glm::vec3(0.0f) : frames[i - 1].translation) + move;
+        dst.rotation = glm::normalize((i == 0 ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : frames[i - 1].rotation) * step);
+        for (int k = 0; k < 4; ++k)
+        {
+          dst.interpCurves[k] = palette[engine() % palette.size()];
+        }
+      }
+      tracks[bone].SetKeyframes(std::move(frames));
+    }
+    return tracks;
+  }
+
+  void BenchmarkBakedClip(const Options& options)
+  {
+    BezierEasingTable easing;
+    auto tracks = GenerateNodeAnimations(options, easing);
+    const auto boneCount = options.bones;
+    auto sampler = [&](float frame, AnimationPose& pose) {
+      for (uint32_t i = 0; i < boneCount; ++i)
+      {
+        glm::vec3 translation;
+        glm::quat rotation;
+        tracks[i].Evaluate(frame, easing, translation, rotation);
+        pose.SetTranslation(i, translation);
+        pose.SetRotation(i, rotation);
+      }
+    };
+
+    BakedClip clip;
+    auto bakeSeconds = MeasureSeconds(1, [&]() { clip.Build(boneCount, options.frames, options.samplesPerFrame, sampler); });
+
+    // キャラクターごとに再生位置をずらし, 一定フレーム数を順方向に再生する.
+    // キーフレーム評価は Animator と同じくキャラクターごとにトラックを持つ.
+    const uint32_t TickCount = 240;
+    const auto characterCount = options.characters;
+    std::vector<std::vector<NodeAnimation>> characterTracks(characterCount, tracks);
+    std::vector<AnimationPose> poses(characterCount, AnimationPose(boneCount));
+    auto frameOf = [&](uint32_t character, uint32_t tick) {
+      return float((character * 997u + tick) % (options.frames + 1));
+    };
+
+    volatile float sink = 0.0f;
+    auto sparseSeconds = MeasureSeconds(options.iterations, [&]() {
+      for (uint32_t tick = 0; tick < TickCount; ++tick)
+      {
+        for (uint32_t c = 0; c < characterCount; ++c)
+        {
+          auto frame = frameOf(c, tick);
+          auto& pose = poses[c];
+          for (uint32_t i = 0; i < boneCount; ++i)
+          {
+            glm::vec3 translation;
+            glm::quat rotation;
+            characterTracks[c][i].Evaluate(frame, easing, translation, rotation);
+            pose.SetTranslation(i, translation);
+            pose.SetRotation(i, rotation);
+          }
+        }
+      }
+      sink = poses[0].GetData()[0];
+    });
+    auto bakedSeconds = MeasureSeconds(options.iterations, [&]() {
+      for (uint32_t tick = 0; tick < TickCount; ++tick)
+      {
+        for (uint32_t c = 0; c < characterCount; ++c)
+        {
+          clip.Sample(frameOf(c, tick), poses[c]);
+        }
+      }
+      sink = poses[0].GetData()[0];
+    });
+
+    // フレームの中間でのキーフレーム評価との差.
+    AnimationPose reference(boneCount), baked(boneCount);
+    float maxTranslationError = 0.0f, maxRotationError = 0.0f;
+    for (uint32_t frame = 0; frame < options.frames; ++frame)
+    {
+      auto time = float(frame) + 0.5f;
+      sampler(time, reference);
+      clip.Sample(time, baked);
+      for (uint32_t i = 0; i < boneCount; ++i)
+      {
+        auto translationError = glm::length(reference.GetTranslation(i) - baked.GetTranslation(i));
+        maxTranslationError = std::max(maxTranslationError, translationError);
+        maxRotationError = std::max(maxRotationError, RotationAngle(reference.GetRotation(i), baked.GetRotation(i)));
+      }
+    }
+
+    size_t keyCount = 0;
+    for (const auto& track : tracks)
+    {
+      keyCount += track.GetKeyframeCount();
+    }
+    const double boneSamples = double(TickCount) * characterCount * boneCount;
+    std::cout << "baked clip (" << characterCount << " characters, " << boneCount << " bones, " << options.frames
+      << " frames, " << keyCount << " keys, median of " << options.iterations << ")" << std::endl;
+    printf("  %-10s %12s %14s\n", "method", "ns/bone", "memory (KB)");
+    printf("  %-10s %12.2f %14.1f  (per character)\n", "keyframes", sparseSeconds / boneSamples * 1.0e9,
+      keyCount * sizeof(NodeAnimeFrame) / 1024.0);
+    printf("  %-10s %12.2f %14.1f  (shared)\n", "baked", bakedSeconds / boneSamples * 1.0e9,
+      clip.GetMemorySize() / 1024.0);
+    printf("  bake: %.2f ms, %u samples/frame\n", bakeSeconds * 1.0e3, clip.GetSamplesPerFrame());
+    printf("  error at half frames: translation %.3e, rotation %.3e rad\n\n", maxTranslationError, maxRotationError);
+  }
+
+  void BenchmarkCompressedClip(const Options& options)
+  {
+    auto easing = std::make_shared<BezierEasingTable>();
+    auto tracks = GenerateSparseNodeAnimations(options, *easing);
+    const auto boneCount = options.bones;
+    auto sampler = [&](float frame, AnimationPose& pose) {
+      for (uint32_t i = 0; i < boneCount; ++i)
+      {
+        glm::vec3 translation;
+        glm::quat rotation;
+        tracks[i].Evaluate(frame, *easing, translation, rotation);
+        pose.SetTranslation(i, translation);
+        pose.SetRotation(i, rotation);
+      }
+    };
+    BakedClip baked;
+    baked.Build(boneCount, options.frames, options.samplesPerFrame, sampler);
+
+    ClipCompressionSettings settings;
+    CompressedClip compressed;
+    std::vector<const NodeAnimation*> trackPointers;
+    for (const auto& track : tracks)
+    {
+      trackPointers.push_back(&track);
+    }
+    const std::vector<glm::vec3> offsets(boneCount, glm::vec3(0.0f));
+    auto compressSeconds = MeasureSeconds(1, [&]() { compressed.Build(trackPointers, offsets, easing, settings); });
+
+    // キーフレームからの評価(glm::slerp)との, フレームの位置と中間での差.
+    // 再生時の補間は BlendPoses の slerp の近似のため, 回転の誤差はその分を加えた値まで許す.
+    const float RoundingTolerance = 1.0e-5f;
+    AnimationPose reference(boneCount), decoded(boneCount);
+    float maxTranslationError = 0.0f, maxRotationError = 0.0f;
+    for (uint32_t frame = 0; frame <= options.frames; ++frame)
+    {
+      for (auto offset : { 0.0f, 0.5f })
+      {
+        auto time = float(frame) + offset;
+        sampler(time, reference);
+        compressed.Sample(time, decoded);
+        for (uint32_t i = 0; i < boneCount; ++i)
+        {
+          auto translationError = glm::length(reference.GetTranslation(i) - decoded.GetTranslation(i));
+          maxTranslationError = std::max(maxTranslationError, translationError);
+          maxRotationError = std::max(maxRotationError, RotationAngle(reference.GetRotation(i), decoded.GetRotation(i)));
+        }
+      }
+    }
+
+    // 再生位置の異なるキャラクター分をまとめて展開する.
+    // キーフレーム評価は Animator と同じくキャラクターごとにトラックを持つ.
+    const uint32_t TickCount = 240;
+    const auto characterCount = options.characters;
+    std::vector<std::vector<NodeAnimation>> characterTracks(characterCount, tracks);
+    std::vector<AnimationPose> poses(characterCount, AnimationPose(boneCount));
+    auto frameOf = [&](uint32_t character, uint32_t tick) {
+      return float((character * 997u + tick) % (options.frames + 1)) + 0.5f;
+    };
+    volatile float sink = 0.0f;
+    auto keyframeSeconds = MeasureSeconds(options.iterations, [&]() {
+      for (uint32_t tick = 0; tick < TickCount; ++tick)
+      {
+        for (uint32_t c = 0; c < characterCount; ++c)
+        {
+          auto frame = frameOf(c, tick);
+          auto& pose = poses[c];
+          for (uint32_t i = 0; i < boneCount; ++i)
+          {
+            glm::vec3 translation;
+            glm::quat rotation;
+            characterTracks[c][i].Evaluate(frame, *easing, translation, rotation);
+            pose.SetTranslation(i, translation);
+            pose.SetRotation(i, rotation);
+          }
+        }
+      }
+      sink = poses[0].GetData()[0];
+    });
+    auto bakedSeconds = MeasureSeconds(options.iterations, [&]() {
+      for (uint32_t tick = 0; tick < TickCount; ++tick)
+      {
+        for (uint32_t c = 0; c < characterCount; ++c)
+        {
+          baked.Sample(frameOf(c, tick), poses[c]);
+        }
+      }
+      sink = poses[0].GetData()[0];
+    });
+    auto compressedSeconds = MeasureSeconds(options.iterations, [&]() {
+      for (uint32_t tick = 0; tick < TickCount; ++tick)
+      {
+        for (uint32_t c = 0; c < characterCount; ++c)
+        {
+          compressed.Sample(frameOf(c, tick), poses[c]);
+        }
+      }
+      sink = poses[0].GetData()[0];
+    });
+
+    // メモリ量は曲線の表(キーフレームと圧縮したクリップで共有する)を含まない.
+    size_t keyCount = 0;
+    for (const auto& track : tracks)
+    {
+      keyCount += track.GetKeyframeCount();
+    }
+    const auto keyframeSize = keyCount * sizeof(NodeAnimeFrame);
+    const double boneSamples = double(TickCount) * characterCount * boneCount;
+    std::cout << "compressed clip (" << boneCount << " bones, " << options.frames << " frames, " << keyCount << " keys, tolerance "
+      << settings.defaultTolerance.translation << " / " << settings.defaultTolerance.rotation << " rad, median of "
+      << options.iterations << ")" << std::endl;
+    printf("  %-10s %12s %14s %12s\n", "format", "ns/bone", "memory (KB)", "keys/size");
+    printf("  %-10s %12.2f %14.1f %12.2f\n", "keyframes", keyframeSeconds / boneSamples * 1.0e9, keyframeSize / 1024.0, 1.0);
+    printf("  %-10s %12.2f %14.1f %12.2f\n", "baked", bakedSeconds / boneSamples * 1.0e9, baked.GetMemorySize() / 1024.0,
+      double(keyframeSize) / baked.GetMemorySize());
+    printf("  %-10s %12.2f %14.1f %12.2f\n", "compressed", compressedSeconds / boneSamples * 1.0e9,
+      compressed.GetMemorySize() / 1024.0, double(keyframeSize) / compressed.GetMemorySize());
+    printf("  tracks: constant %u, rotation32 %u, rotation48 %u, rotation raw %u, translation8 %u, translation16 %u, translation raw %u\n",
+      compressed.GetTrackCount(CompressedClip::Constant),
+      compressed.GetTrackCount(CompressedClip::Rotation32), compressed.GetTrackCount(CompressedClip::Rotation48),
+      compressed.GetTrackCount(CompressedClip::RotationRaw),
+      compressed.GetTrackCount(CompressedClip::Translation8), compressed.GetTrackCount(CompressedClip::Translation16),
+      compressed.GetTrackCount(CompressedClip::TranslationRaw));
+    printf("  keys: %u of %zu, easing curves: %u (shared)\n", compressed.GetKeyCount(), keyCount, easing->GetCurveCount());
+    printf("  compress: %.2f ms\n", compressSeconds * 1.0e3);
+    printf("  error against keyframes at whole and half frames: translation %.3e, rotation %.3e rad\n\n", maxTranslationError, maxRotationError);
+
+    if (!(maxTranslationError <= settings.defaultTolerance.translation + RoundingTolerance))
+    {
+      throw std::runtime_error("compressed: translation error exceeds the tolerance.");
+    }
+    if (!(maxRotationError <= settings.defaultTolerance.rotation + BlendPosesSlerpMaxError + RoundingTolerance))
+    {
+      throw std::runtime_error("compressed: rotation error exceeds the tolerance.");
+    }
+  }
+
+  void BenchmarkPoseKernel(const Options& options)
+  {
+    std::mt19937 engine(options.seed);
+    std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // 端数の出るボーン数も含めて確認する.
+    const float TranslationTolerance = 1.0e-5f;
+    const float NlerpTolerance = 1.0e-5f;
+    const float SlerpTolerance = BlendPosesSlerpMaxError;
+    float maxTranslationError = 0.0f, maxNlerpError = 0.0f, maxSlerpError = 0.0f;
+    for (uint32_t boneCount : { 1u, 7u, 8u, 13u, options.bones })
+    {
+      AnimationPose a(boneCount), b(boneCount), simd(boneCount), scalar(boneCount);
+      for (uint32_t i = 0; i < boneCount; ++i)
+      {
+        a.SetTranslation(i, glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine)));
+        b.SetTranslation(i, glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine)));
+        a.SetRotation(i, glm::normalize(glm::quat(signedUnit(engine), signedUnit(engine), signedUnit(engine), signedUnit(engine))));
+        b.SetRotation(i, glm::normalize(glm::quat(signedUnit(engine), signedUnit(engine), signedUnit(engine), signedUnit(engine))));
+      }
+      const auto stride = a.GetStride();
+      std::vector<float> rates(4 * stride);
+      for (auto& rate : rates)
+      {
+        rate = unit(engine);
+      }
+
+      for (bool slerp : { false, true })
+      {
+        for (bool perBone : { false, true })
+        {
+          auto rate = unit(engine);
+          BlendPoses(a.GetData(), b.GetData(), perBone ? rates.data() : nullptr, rate, slerp, stride, simd.GetData());
+          BlendPosesScalar(a.GetData(), b.GetData(), perBone ? rates.data() : nullptr, rate, slerp, stride, scalar.GetData());
+          for (uint32_t i = 0; i < boneCount; ++i)
+          {
+            auto rotationError = RotationAngle(simd.GetRotation(i), scalar.GetRotation(i));
+            maxTranslationError = std::max(maxTranslationError, glm::length(simd.GetTranslation(i) - scalar.GetTranslation(i)));
+            (slerp ? maxSlerpError : maxNlerpError) = std::max(slerp ? maxSlerpError : maxNlerpError, rotationError);
+          }
+        }
+      }
+    }
+
+    // slerp の近似の誤差は 2 つの回転の間の角度と補間率で決まるため, 乱数の姿勢に加えて
+    // 角度 0..180 度と補間率 0..1 を掃引し, glm::slerp との差が BlendPosesSlerpMaxError 以下であることを確認する.
+    float maxSweepError = 0.0f, worstAngle = 0.0f, worstRate = 0.0f;
+    {
+      const uint32_t AngleCount = 1024, RateCount = 255;
+      AnimationPose a(RateCount + 1), b(RateCount + 1), simd(RateCount + 1), scalar(RateCount + 1);
+      const auto stride = a.GetStride();
+      std::vector<float> rates(4 * stride, 0.0f);
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        for (uint32_t k = 0; k <= RateCount; ++k)
+        {
+          rates[c * stride + k] = float(k) / float(RateCount);
+        }
+      }
+      for (uint32_t j = 0; j < AngleCount; ++j)
+      {
+        auto angle = glm::pi<float>() * float(j) / float(AngleCount);
+        auto axis = glm::normalize(glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+        auto base = glm::normalize(glm::quat(signedUnit(engine), signedUnit(engine), signedUnit(engine), signedUnit(engine)));
+        for (uint32_t k = 0; k <= RateCount; ++k)
+        {
+          a.SetRotation(k, base);
+          b.SetRotation(k, glm::normalize(base * glm::angleAxis(angle, axis)));
+        }
+        BlendPoses(a.GetData(), b.GetData(), rates.data(), 0.0f, true, stride, simd.GetData());
+        BlendPosesScalar(a.GetData(), b.GetData(), rates.data(), 0.0f, true, stride, scalar.GetData());
+        for (uint32_t k = 0; k <= RateCount; ++k)
+        {
+          auto error = RotationAngle(simd.GetRotation(k), scalar.GetRotation(k));
+          if (error > maxSweepError)
+          {
+            maxSweepError = error;
+            worstAngle = angle;
+            worstRate = rates[k];
+          }
+        }
+      }
+    }
+
+    // 速度. --characters 体分の姿勢を補間する.
+    const uint32_t boneCount = options.bones;
+    std::vector<AnimationPose> starts(options.characters, AnimationPose(boneCount));
+    std::vector<AnimationPose> lasts(options.characters, AnimationPose(boneCount));
+    std::vector<AnimationPose> poses(options.characters, AnimationPose(boneCount));
+    for (uint32_t c = 0; c < options.characters; ++c)
+    {
+      for (uint32_t i = 0; i < boneCount; ++i)
+      {
+        starts[c].SetRotation(i, glm::normalize(glm::quat(signedUnit(engine), signedUnit(engine), signedUnit(engine), signedUnit(engine))));
+        lasts[c].SetRotation(i, glm::normalize(glm::quat(signedUnit(engine), signedUnit(engine), signedUnit(engine), signedUnit(engine))));
+      }
+    }
+    const auto stride = poses[0].GetStride();
+    std::vector<float> rates(4 * stride, 0.3f);
+    const uint32_t RepeatCount = 100;
+    auto measure = [&](decltype(&BlendPoses) blend, bool slerp) {
+      return MeasureSeconds(options.iterations, [&]() {
+        for (uint32_t r = 0; r < RepeatCount; ++r)
+        {
+          for (uint32_t c = 0; c < options.characters; ++c)
+          {
+            blend(starts[c].GetData(), lasts[c].GetData(), rates.data(), 0.0f, slerp, stride, poses[c].GetData());
+          }
+        }
+      });
+    };
+    const double boneSamples = double(RepeatCount) * options.characters * boneCount;
+    std::cout << "pose kernel (" << GetPoseKernelName() << ", " << options.characters << " characters, " << boneCount
+      << " bones, median of " << options.iterations << ")" << std::endl;
+    printf("  %-8s %14s %14s\n", "mode", "scalar ns/bone", "simd ns/bone");
+    printf("  %-8s %14.2f %14.2f\n", "nlerp", measure(BlendPosesScalar, false) / boneSamples * 1.0e9, measure(BlendPoses, false) / boneSamples * 1.0e9);
+    printf("  %-8s %14.2f %14.2f\n", "slerp", measure(BlendPosesScalar, true) / boneSamples * 1.0e9, measure(BlendPoses, true) / boneSamples * 1.0e9);
+    printf("  error against scalar: translation %.3e (<= %.0e), nlerp %.3e rad (<= %.0e), slerp %.3e rad (<= %.0e)\n",
+      maxTranslationError, TranslationTolerance, maxNlerpError, NlerpTolerance, maxSlerpError, SlerpTolerance);
+    printf("  slerp sweep against glm::slerp: %.3e rad (<= %.0e) at %.1f deg, rate %.3f\n\n",
+      maxSweepError, SlerpTolerance, worstAngle / glm::pi<float>() * 180.0f, worstRate);
+
+    if (maxTranslationError > TranslationTolerance || maxNlerpError > NlerpTolerance ||
+      maxSlerpError > SlerpTolerance || maxSweepError > SlerpTolerance)
+    {
+      throw std::runtime_error("pose kernel: SIMD result exceeds the tolerance.");
+    }
+  }
+
+  // センター -> 下半身 -> 足 -> ひざ -> 足首 の左右の脚と, センターの子の足 IK からなる骨格.
+  // 上半身や指の代わりに, extraBones 本のボーンを既存のボーンの子として乱数で追加する.
+  // 膝の判定はボーン名で行うため, ひざのボーン名は Shift_JIS で与える.
+  const float ThighLength = 4.0f, ShinLength = 4.0f;
+  const uint32_t LegRigBoneCount = 10;
+  struct LegRig
+  {
+    Skeleton skeleton;
+    std::vector<uint32_t> order;    // 生成したボーンの番号から Skeleton のボーン番号への対応.
+    std::vector<PMDBoneIK> iks;
+  };
+
+  LegRig BuildLegRig(uint32_t extraBones, std::mt19937& engine)
+  {
+    std::vector<Skeleton::BoneDesc> bones{
+      { "center", -1, glm::vec3(0.0f, 9.0f, 0.0f), glm::mat4(1.0f) },
+      { "lower body", 0, glm::vec3(0.0f, 0.5f, 0.0f), glm::mat4(1.0f) },
+      { "left leg", 1, glm::vec3(1.0f, -1.0f, 0.0f), glm::mat4(1.0f) },
+      { "\x8d\xb6\x82\xd0\x82\xb4", 2, glm::vec3(0.0f, -ThighLength, 0.0f), glm::mat4(1.0f) },  // 左ひざ.
+      { "left ankle", 3, glm::vec3(0.0f, -ShinLength, 0.0f), glm::mat4(1.0f) },
+      { "right leg", 1, glm::vec3(-1.0f, -1.0f, 0.0f), glm::mat4(1.0f) },
+      { "\x89\x45\x82\xd0\x82\xb4", 5, glm::vec3(0.0f, -ThighLength, 0.0f), glm::mat4(1.0f) },  // 右ひざ.
+      { "right ankle", 6, glm::vec3(0.0f, -ShinLength, 0.0f), glm::mat4(1.0f) },
+      { "left leg IK", 0, glm::vec3(1.0f, -8.5f, 0.0f), glm::mat4(1.0f) },
+      { "right leg IK", 0, glm::vec3(-1.0f, -8.5f, 0.0f), glm::mat4(1.0f) },
+    };
+    std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+    for (uint32_t i = 0; i < extraBones; ++i)
+    {
+      auto parent = int32_t(engine() % bones.size());
+      bones.push_back({ "extra " + std::to_string(i), parent, glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine)), glm::mat4(1.0f) });
+    }
+
+    LegRig rig;
+    rig.order = rig.skeleton.Build(bones);
+    auto makeIk = [&](uint32_t ankle, uint32_t knee, uint32_t leg, uint32_t ik) {
+      PMDBoneIK boneIk(rig.order[ankle], rig.order[ik]);
+      boneIk.SetIterationCount(40);
+      boneIk.SetAngleLimit(0.5f * glm::pi<float>());
+      boneIk.SetIkChains({ rig.order[knee], rig.order[leg] }, rig.skeleton);
+      return boneIk;
+    };
+    rig.iks = { makeIk(4, 3, 2, 8), makeIk(7, 6, 5, 9) };
+    return rig;
+  }
+
+  void BenchmarkBoneIK(const Options& options)
+  {
+    std::mt19937 engine(options.seed);
+    auto rig = BuildLegRig(0, engine);
+    auto& skeleton = rig.skeleton;
+    const auto& order = rig.order;
+    const auto& iks = rig.iks;
+    for (const auto& boneIk : iks)
+    {
+      if (!boneIk.IsTwoBoneLeg())
+      {
+        throw std::runtime_error("bone ik: leg chain was not detected as a two-bone leg.");
+      }
+    }
+
+    // 脚の付け根から届く範囲の目標と, アニメーションによる脚の回転を生成する.
+    std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> reach(0.3f, 0.95f);
+    struct Pose
+    {
+      glm::quat legRotations[2];
+      glm::vec3 goals[2];
+    };
+    std::vector<Pose> poses(std::max(options.characters, 1u) * 16);
+    for (auto& pose : poses)
+    {
+      for (uint32_t side = 0; side < 2; ++side)
+      {
+        auto leg = order[side == 0 ? 2 : 5];
+        auto legRoot = glm::vec3(skeleton.GetWorldMatrix(skeleton.GetParent(leg))[3]) + skeleton.GetInitialTranslation(leg);
+        auto direction = glm::normalize(glm::vec3(signedUnit(engine), -1.5f + 0.5f * signedUnit(engine), signedUnit(engine)));
+        auto ikRoot = glm::vec3(skeleton.GetWorldMatrix(0)[3]);
+        pose.goals[side] = legRoot + direction * (ThighLength + ShinLength) * reach(engine) - ikRoot;
+        pose.legRotations[side] = glm::normalize(glm::quat(1.0f, 0.2f * signedUnit(engine), 0.2f * signedUnit(engine), 0.2f * signedUnit(engine)));
+      }
+    }
+
+    auto apply = [&](const Pose& pose) {
+      for (uint32_t side = 0; side < 2; ++side)
+      {
+        const auto& chains = iks[side].GetChains();
+        skeleton.SetRotation(chains[1], pose.legRotations[side]);
+        skeleton.SetRotation(chains[0], glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+        skeleton.SetTranslation(iks[side].GetEffector(), pose.goals[side]);
+      }
+    };
+    auto solve = [&](decltype(&SolveBoneIK) solver, float& maxError) {
+      return MeasureSeconds(options.iterations, [&]() {
+        maxError = 0.0f;
+        for (const auto& pose : poses)
+        {
+          apply(pose);
+          for (const auto& boneIk : iks)
+          {
+            solver(skeleton, boneIk);
+            auto target = glm::vec3(skeleton.GetWorldMatrix(boneIk.GetTarget())[3]);
+            auto goal = glm::vec3(skeleton.GetWorldMatrix(boneIk.GetEffector())[3]);
+            maxError = std::max(maxError, glm::length(target - goal));
+          }
+        }
+      });
+    };
+
+    const float Tolerance = 1.0e-3f;
+    float ccdError = 0.0f, analyticError = 0.0f;
+    auto ccdSeconds = solve(SolveBoneIKCCD, ccdError);
+    auto analyticSeconds = solve(SolveBoneIK, analyticError);
+    const double solveCount = double(poses.size()) * 2;
+    std::cout << "bone ik (" << poses.size() * 2 << " leg solves, median of " << options.iterations << ")" << std::endl;
+    printf("  %-10s %12s %14s\n", "solver", "us/solve", "max error");
+    printf("  %-10s %12.3f %14.3e\n", "ccd", ccdSeconds / solveCount * 1.0e6, ccdError);
+    printf("  %-10s %12.3f %14.3e\n", "two-bone", analyticSeconds / solveCount * 1.0e6, analyticError);
+    printf("  two-bone error tolerance %.0e\n\n", Tolerance);
+
+    if (analyticError > Tolerance)
+    {
+      throw std::runtime_error("bone ik: two-bone solver did not reach the goal.");
+    }
+  }
+
+  // parallel, lod, cache で使う複数キャラクター.
+  // Animator と Model の組と同じく, キャラクターごとに骨格, キーフレーム(再生カーソルを持つ),
+  // ボーン行列と頂点の出力先を持つ. モーション, 補間曲線, モーフのデータは共有する.
+  struct Crowd
+  {
+    static const uint32_t VertexCount = 8192, MorphCount = 16, MorphVertexCount = 512;
+    struct Character
+    {
+      LegRig rig;
+      std::vector<NodeAnimation> tracks;
+      AnimationLodSampler lodSampler;
+      std::vector<glm::mat4> palette;
+      std::vector<glm::vec3> vertices;
+    };
+
+    explicit Crowd(const Options& options)
+    {
+      tracks = GenerateNodeAnimations(options, easing);
+      const auto extraBones = options.bones > LegRigBoneCount ? options.bones - LegRigBoneCount : 0;
+
+      std::mt19937 engine(options.seed);
+      std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+      baseVertices.resize(VertexCount);
+      for (auto& v : baseVertices)
+      {
+        v = glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine));
+      }
+      morphIndices.assign(MorphCount, std::vector<uint32_t>(MorphVertexCount));
+      morphOffsets.assign(MorphCount, std::vector<glm::vec3>(MorphVertexCount));
+      for (uint32_t m = 0; m < MorphCount; ++m)
+      {
+        for (uint32_t i = 0; i < MorphVertexCount; ++i)
+        {
+          morphIndices[m][i] = engine() % VertexCount;
+          morphOffsets[m][i] = 0.01f * glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine));
+        }
+      }
+
+      characters.resize(options.characters);
+      for (auto& character : characters)
+      {
+        std::mt19937 rigEngine(options.seed);
+        character.rig = BuildLegRig(extraBones, rigEngine);
+        character.tracks = tracks;
+        character.palette.resize(character.rig.skeleton.GetBoneCount());
+        character.vertices.resize(VertexCount);
+      }
+      boundCount = std::min(uint32_t(tracks.size()), characters[0].rig.skeleton.GetBoneCount());
+    }
+
+    // Animator::UpdateAnimation と Model::UpdateHostData に相当する更新.
+    // interval, phase は AnimationLodSampler::Sample と同じ. level に従って表情モーフと IK を省く.
+    void Update(uint32_t c, float frame, const AnimationLodLevel& level, float interval, float phase)
+    {
+      auto& character = characters[c];
+      auto& skeleton = character.rig.skeleton;
+      auto evaluate = [&](float sampleFrame, AnimationPose& pose) {
+        if (pose.GetBoneCount() != boundCount)
+        {
+          pose.Resize(boundCount);
+        }
+        for (uint32_t i = 0; i < boundCount; ++i)
+        {
+          glm::vec3 translation;
+          glm::quat rotation;
+          character.tracks[i].Evaluate(sampleFrame, easing, translation, rotation);
+          pose.SetTranslation(i, translation);
+          pose.SetRotation(i, rotation);
+        }
+      };
+      // 全キャラクターが同じモーションと骨格なので, 鍵は固定値でよい.
+      const auto& pose = character.lodSampler.Sample(frame, interval, phase, [&](float sampleFrame, AnimationPose& pose) {
+        if (poseCache)
+        {
+          pose = *poseCache->Get(1, 1, sampleFrame, evaluate);
+        }
+        else
+        {
+          evaluate(sampleFrame, pose);
+        }
+      });
+      for (uint32_t i = 0; i < boundCount; ++i)
+      {
+        auto bone = character.rig.order[i];
+        skeleton.SetTranslation(bone, skeleton.GetInitialTranslation(bone) + pose.GetTranslation(i));
+        skeleton.SetRotation(bone, pose.GetRotation(i));
+      }
+      if (level.updateIK)
+      {
+        for (const auto& boneIk : character.rig.iks)
+        {
+          SolveBoneIK(skeleton, boneIk);
+        }
+      }
+      skeleton.FlushChangedBones([&](uint32_t i) {
+        character.palette[i] = skeleton.GetWorldMatrix(i) * skeleton.GetInvBindMatrix(i);
+      });
+
+      if (level.updateMorphs)
+      {
+        std::copy(baseVertices.begin(), baseVertices.end(), character.vertices.begin());
+        for (uint32_t m = 0; m < MorphCount; ++m)
+        {
+          auto weight = 0.5f + 0.5f * std::sin(frame * 0.1f + float(m));
+          for (uint32_t i = 0; i < MorphVertexCount; ++i)
+          {
+            character.vertices[morphIndices[m][i]] += morphOffsets[m][i] * weight;
+          }
+        }
+      }
+    }
+    void Update(uint32_t c, float frame)
+    {
+      Update(c, frame, AnimationLodLevel(), 0.0f, 0.0f);
+    }
+
+    BezierEasingTable easing;
+    std::vector<NodeAnimation> tracks;
+    uint32_t boundCount;
+    PoseCache* poseCache = nullptr;
+    std::vector<glm::vec3> baseVertices;
+    std::vector<std::vector<uint32_t>> morphIndices;
+    std::vector<std::vector<glm::vec3>> morphOffsets;
+    std::vector<Character> characters;
+  };
+
+  void BenchmarkParallelUpdate(const Options& options)
+  {
+    Crowd crowd(options);
+    auto& characters = crowd.characters;
+    auto update = [&](uint32_t c, uint32_t tick) {
+      crowd.Update(c, float((c * 997u + tick) % (options.frames + 1)) + 0.5f);
+    };
+
+    // 1 スレッドは呼び出し元のみで順に処理し, 2 スレッド以上は ThreadPool::ParallelFor で
+    // (呼び出し元を含めて)そのスレッド数で処理する.
+    const uint32_t TickCount = 60;
+    auto measure = [&](uint32_t threadCount) {
+      std::unique_ptr<ThreadPool> pool;
+      if (threadCount > 1)
+      {
+        pool.reset(new ThreadPool(threadCount - 1));
+      }
+      return MeasureSeconds(options.iterations, [&]() {
+        for (uint32_t tick = 0; tick < TickCount; ++tick)
+        {
+          if (pool)
+          {
+            pool->ParallelFor(options.characters, [&](uint32_t c) { update(c, tick); });
+          }
+          else
+          {
+            for (uint32_t c = 0; c < options.characters; ++c)
+            {
+              update(c, tick);
+            }
+          }
+        }
+      });
+    };
+
+    const auto hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> threadCounts{ 1 };
+    for (uint32_t n = 2; n < hardwareThreads; n *= 2)
+    {
+      threadCounts.push_back(n);
+    }
+    threadCounts.push_back(std::max(hardwareThreads, 2u));
+
+    std::cout << "parallel update (" << options.characters << " characters, " << characters[0].rig.skeleton.GetBoneCount()
+      << " bones, 2 leg IK, " << Crowd::MorphCount << " morphs, " << hardwareThreads << " hardware threads, median of "
+      << options.iterations << ")" << std::endl;
+    printf("  %-8s %10s %16s %9s %11s\n", "threads", "ms/tick", "characters/s", "speedup", "efficiency");
+    std::vector<std::vector<glm::mat4>> referencePalettes;
+    std::vector<std::vector<glm::vec3>> referenceVertices;
+    double serialSeconds = 0.0;
+    bool mismatch = false;
+    for (auto threadCount : threadCounts)
+    {
+      auto seconds = measure(threadCount);
+      if (threadCount == 1)
+      {
+        serialSeconds = seconds;
+        for (const auto& character : characters)
+        {
+          referencePalettes.push_back(character.palette);
+          referenceVertices.push_back(character.vertices);
+        }
+      }
+      else
+      {
+        // 各キャラクターの結果はスレッド数によらず同じになる.
+        for (uint32_t c = 0; c < options.characters; ++c)
+        {
+          mismatch |= characters[c].palette != referencePalettes[c] || characters[c].vertices != referenceVertices[c];
+        }
+      }
+      auto speedup = serialSeconds / seconds;
+      printf("  %-8u %10.3f %16.0f %9.2f %10.0f%%\n", threadCount, seconds / TickCount * 1.0e3,
+        double(TickCount) * options.characters / seconds, speedup, speedup / std::min(threadCount, hardwareThreads) * 100.0);
+    }
+    // ハードウェアスレッドが少ない環境では, スレッド数を増やした場合の伸びは確かめられない.
+    if (hardwareThreads < 4)
+    {
+      printf("  note: only %u hardware thread(s); parallel scaling is not measured, run on 4 or more cores to check it.\n", hardwareThreads);
+    }
+    printf("\n");
+
+    if (mismatch)
+    {
+      throw std::runtime_error("parallel update: results differ from the single-threaded update.");
+    }
+  }
+
+  void BenchmarkAnimationLod(const Options& options)
+  {
+    // --characters 体を, カメラからの距離が 10 から 1000 まで等比になるように並べ,
+    // AnimationLodPolicy の既定の段階で LOD を選ぶ. モデルの大きさは PMD の人型に合わせる.
+    const float Radius = 10.0f;
+    const float ProjScaleY = 1.0f / std::tan(glm::radians(22.5f));
+    const float TickFrames = 0.5f;      // 60Hz のティックで 30fps のモーションを再生する.
+    const float ScreenHeight = 1080.0f;
+    const uint32_t TickCount = 240;
+    AnimationLodPolicy policy;
+
+    Crowd reference(options), crowd(options);
+    const auto characterCount = options.characters;
+    std::vector<float> distances(characterCount), phases(characterCount), startFrames(characterCount);
+    std::vector<uint32_t> levels(characterCount);
+    for (uint32_t c = 0; c < characterCount; ++c)
+    {
+      distances[c] = 10.0f * std::pow(100.0f, (float(c) + 0.5f) / float(characterCount));
+      auto screenSize = AnimationLodPolicy::ComputeScreenSize(Radius, distances[c], ProjScaleY);
+      levels[c] = policy.Select(distances[c], screenSize, 0);
+      // 評価するティックが同じ段階のキャラクターで重ならないようにずらす.
+      phases[c] = std::fmod(float(c) * 0.618034f, 1.0f);
+      startFrames[c] = float((c * 997u) % options.frames);
+    }
+    auto updateLod = [&](uint32_t c, uint32_t tick) {
+      const auto& level = policy.GetLevel(levels[c]);
+      auto interval = level.tickInterval > 1 ? float(level.tickInterval) * TickFrames : 0.0f;
+      crowd.Update(c, startFrames[c] + float(tick) * TickFrames, level, interval, phases[c]);
+    };
+
+    // 毎ティック全て更新した場合に対する, ボーン位置の誤差とその画面上の大きさ.
+    std::vector<uint32_t> levelCharacters(policy.GetLevelCount());
+    std::vector<float> maxErrors(policy.GetLevelCount()), maxPixels(policy.GetLevelCount());
+    for (uint32_t tick = 0; tick < TickCount; ++tick)
+    {
+      for (uint32_t c = 0; c < characterCount; ++c)
+      {
+        reference.Update(c, startFrames[c] + float(tick) * TickFrames);
+        updateLod(c, tick);
+        auto& expected = reference.characters[c].rig.skeleton;
+        auto& actual = crowd.characters[c].rig.skeleton;
+        float error = 0.0f;
+        for (uint32_t i = 0; i < actual.GetBoneCount(); ++i)
+        {
+          error = std::max(error, glm::length(glm::vec3(actual.GetWorldMatrix(i)[3]) - glm::vec3(expected.GetWorldMatrix(i)[3])));
+        }
+        auto& maxError = maxErrors[levels[c]];
+        maxError = std::max(maxError, error);
+        auto& maxPixel = maxPixels[levels[c]];
+        maxPixel = std::max(maxPixel, error * ProjScaleY / distances[c] * ScreenHeight * 0.5f);
+      }
+    }
+    for (auto level : levels)
+    {
+      ++levelCharacters[level];
+    }
+
+    auto measure = [&](const std::function<void(uint32_t, uint32_t)>& update) {
+      return MeasureSeconds(options.iterations, [&]() {
+        for (uint32_t tick = 0; tick < TickCount; ++tick)
+        {
+          for (uint32_t c = 0; c < characterCount; ++c)
+          {
+            update(c, tick);
+          }
+        }
+      });
+    };
+    auto fullSeconds = measure([&](uint32_t c, uint32_t tick) { reference.Update(c, startFrames[c] + float(tick) * TickFrames); });
+    auto lodSeconds = measure(updateLod);
+
+    std::cout << "animation lod (" << characterCount << " characters at distance 10-1000, " << reference.characters[0].rig.skeleton.GetBoneCount()
+      << " bones, " << TickCount << " ticks, median of " << options.iterations << ")" << std::endl;
+    printf("  %-6s %9s %4s %7s %11s %12s %15s\n", "level", "interval", "ik", "morphs", "characters", "max error", "max px(1080p)");
+    for (uint32_t i = 0; i < policy.GetLevelCount(); ++i)
+    {
+      const auto& level = policy.GetLevel(i);
+      printf("  %-6u %9u %4s %7s %11u %12.3e %15.2f\n", i, level.tickInterval, level.updateIK ? "on" : "off",
+        level.updateMorphs ? "on" : "off", levelCharacters[i], maxErrors[i], maxPixels[i]);
+    }
+    printf("  %-12s %10.3f ms/tick\n", "full rate", fullSeconds / TickCount * 1.0e3);
+    printf("  %-12s %10.3f ms/tick (%.2fx)\n\n", "lod", lodSeconds / TickCount * 1.0e3, fullSeconds / lodSeconds);
+
+    // 毎ティック評価する段階は補間を通さないので, 全て更新した場合と一致する.
+    if (levelCharacters[0] > 0 && maxErrors[0] != 0.0f)
+    {
+      throw std::runtime_error("animation lod: full-rate characters differ from the reference update.");
+    }
+  }
+
+  void BenchmarkPoseCache(const Options& options)
+  {
+    // crowd : キャラクターを 4 組に分け, 組ごとに同じ位置から再生する.
+    // scrub : 全キャラクターで 120 フレームの範囲を行き来する. 2 往復目以降は全て再利用できる.
+    const uint32_t GroupCount = 4, TickCount = 240;
+    const float TickFrames = 0.5f;
+    const size_t Capacity = 256;
+    struct Scenario
+    {
+      const char* name;
+      std::function<float(uint32_t c, uint32_t tick)> frame;
+    };
+    const std::vector<Scenario> scenarios{
+      { "crowd", [&](uint32_t c, uint32_t tick) { return float(((c % GroupCount) * 997u) % options.frames) + float(tick) * TickFrames; } },
+      { "scrub", [&](uint32_t, uint32_t tick) { auto t = tick % 480; return 100.0f + float(t < 240 ? t : 480 - t) * TickFrames; } },
+    };
+
+    Crowd uncached(options), cached(options);
+    PoseCache cache(Capacity);
+    cached.poseCache = &cache;
+    std::cout << "pose cache (" << options.characters << " characters, " << cached.characters[0].rig.skeleton.GetBoneCount()
+      << " bones, capacity " << Capacity << ", median of " << options.iterations << ")" << std::endl;
+    printf("  %-8s %10s %10s %9s %9s\n", "scenario", "uncached", "cached", "speedup", "hit rate");
+    printf("  %-8s %10s %10s\n", "", "ms/tick", "ms/tick");
+    bool mismatch = false;
+    for (const auto& scenario : scenarios)
+    {
+      // scrub は 2 往復させるため 4 倍のティック数を回す.
+      const auto tickCount = scenario.name == std::string("scrub") ? TickCount * 4 : TickCount;
+      auto run = [&](Crowd& crowd) {
+        return MeasureSeconds(options.iterations, [&]() {
+          cache.Clear();
+          for (uint32_t tick = 0; tick < tickCount; ++tick)
+          {
+            for (uint32_t c = 0; c < options.characters; ++c)
+            {
+              crowd.Update(c, scenario.frame(c, tick));
+            }
+          }
+        });
+      };
+      auto uncachedSeconds = run(uncached);
+      auto cachedSeconds = run(cached);
+      auto hits = double(cache.GetHitCount());
+      auto total = hits + double(cache.GetMissCount());
+      printf("  %-8s %10.3f %10.3f %9.2f %8.1f%%\n", scenario.name, uncachedSeconds / tickCount * 1.0e3,
+        cachedSeconds / tickCount * 1.0e3, uncachedSeconds / cachedSeconds, total > 0.0 ? hits / total * 100.0 : 0.0);
+
+      // 再生位置はいずれも量子化の単位の倍数なので, 共有した姿勢でも結果は変わらない.
+      for (uint32_t c = 0; c < options.characters; ++c)
+      {
+        mismatch |= uncached.characters[c].palette != cached.characters[c].palette;
+      }
+    }
+    printf("\n");
+
+    if (mismatch)
+    {
+      throw std::runtime_error("pose cache: cached results differ from the uncached update.");
+    }
+  }
+
+  // 頭, 上半身, 下半身, 両脚の剛体(ボーン追従)に, 髪とスカートのチェイン(物理演算)を加えた骨格と剛体.
+  // 髪は頭から下がる 6 本 x 5 剛体, スカートは下半身から広がる 8 本 x 3 剛体で, 各剛体はチェインのボーンに付く.
+  // グループは体 0, 髪 1, スカート 2 とし, 髪は体とのみ, スカートは体とスカートと衝突する.
+  struct PhysicsRig
+  {
+    static const uint32_t HairChains = 6, HairLength = 5, SkirtChains = 8, SkirtLength = 3;
+    enum Bone { Center, UpperBody, Head, LowerBody, LeftLeg, RightLeg };
+
+    PhysicsRig()
+    {
+      std::vector<Skeleton::BoneDesc> bones;
+      std::vector<glm::vec3> worlds;
+      auto addBone = [&](const std::string& name, int32_t parent, const glm::vec3& world) {
+        glm::mat4 invBind(1.0f);
+        invBind[3] = glm::vec4(-world, 1.0f);
+        bones.push_back({ name, parent, parent < 0 ? world : world - worlds[parent], invBind });
+        worlds.push_back(world);
+        return int32_t(bones.size() - 1);
+      };
+      addBone("center", -1, glm::vec3(0.0f, 10.0f, 0.0f));
+      addBone("upper body", Center, glm::vec3(0.0f, 11.0f, 0.0f));
+      addBone("head", UpperBody, glm::vec3(0.0f, 16.0f, 0.0f));
+      addBone("lower body", Center, glm::vec3(0.0f, 9.5f, 0.0f));
+      addBone("left leg", LowerBody, glm::vec3(0.6f, 9.0f, 0.0f));
+      addBone("right leg", LowerBody, glm::vec3(-0.6f, 9.0f, 0.0f));
+
+      const glm::quat identity(1.0f, 0.0f, 0.0f, 0.0f);
+      auto addBody = [&](int32_t bone, RigidBodySolver::Shape shape, RigidBodySolver::BodyType type, const glm::vec3& size,
+        const glm::vec3& position, const glm::quat& rotation, uint32_t group, uint32_t mask, uint32_t root) {
+        bodies.push_back({ bone, shape, type, size, position, rotation, 1.0f, 0.5f, 0.5f, group, mask });
+        roots.push_back(root);
+        return uint32_t(bodies.size() - 1);
+      };
+      const auto kinematic = RigidBodySolver::BODY_KINEMATIC;
+      const uint32_t all = 0xFFFF;
+      addBody(Head, RigidBodySolver::SHAPE_SPHERE, kinematic, glm::vec3(1.5f, 0.0f, 0.0f), glm::vec3(0.0f, 16.0f, 0.0f), identity, 0, all, 0);
+      addBody(UpperBody, RigidBodySolver::SHAPE_CAPSULE, kinematic, glm::vec3(1.0f, 4.0f, 0.0f), glm::vec3(0.0f, 12.5f, 0.0f), identity, 0, all, 1);
+      addBody(LowerBody, RigidBodySolver::SHAPE_SPHERE, kinematic, glm::vec3(1.2f, 0.0f, 0.0f), glm::vec3(0.0f, 9.0f, 0.0f), identity, 0, all, 2);
+      addBody(LeftLeg, RigidBodySolver::SHAPE_BOX, kinematic, glm::vec3(0.4f, 2.0f, 0.5f), glm::vec3(0.6f, 7.0f, 0.0f), identity, 0, all, 3);
+      addBody(RightLeg, RigidBodySolver::SHAPE_BOX, kinematic, glm::vec3(0.4f, 2.0f, 0.5f), glm::vec3(-0.6f, 7.0f, 0.0f), identity, 0, all, 4);
+
+      // 各チェインは根元の剛体(ボーン追従)から, 線分に沿ったカプセルをジョイントでつなぐ.
+      auto addChain = [&](int32_t parentBone, uint32_t rootBody, glm::vec3 start, const glm::vec3& step, uint32_t length,
+        float radius, uint32_t group, uint32_t mask) {
+        const glm::vec3 up(0.0f, 1.0f, 0.0f);
+        auto direction = glm::normalize(step);
+        auto rotation = glm::angleAxis(std::acos(glm::dot(up, direction)), glm::normalize(glm::cross(up, direction)));
+        auto previous = rootBody;
+        for (uint32_t i = 0; i < length; ++i)
+        {
+          parentBone = addBone("chain " + std::to_string(bones.size()), parentBone, start);
+          auto body = addBody(parentBone, RigidBodySolver::SHAPE_CAPSULE, RigidBodySolver::BODY_DYNAMIC,
+            glm::vec3(radius, glm::length(step) - 2.0f * radius, 0.0f), start + step * 0.5f, rotation, group, mask, rootBody);
+          RigidBodySolver::JointDesc joint{};
+          joint.bodies[0] = previous;
+          joint.bodies[1] = body;
+          joint.position = start;
+          joint.rotation = identity;
+          joint.angularLower = glm::vec3(-0.6f);
+          joint.angularUpper = glm::vec3(0.6f);
+          joint.angularSpring = glm::vec3(20.0f);
+          joints.push_back(joint);
+          previous = body;
+          start += step;
+        }
+      };
+      const float Pi = glm::pi<float>();
+      for (uint32_t i = 0; i < HairChains; ++i)
+      {
+        auto angle = Pi * (0.25f + 1.5f * float(i) / float(HairChains - 1));
+        auto radial = glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+        addChain(Head, 0, glm::vec3(0.0f, 16.0f, 0.0f) + radial * 2.0f, glm::vec3(0.0f, -1.0f, 0.0f) + radial * 0.1f,
+          HairLength, 0.3f, 1, 1u << 0);
+      }
+      for (uint32_t i = 0; i < SkirtChains; ++i)
+      {
+        auto angle = 2.0f * Pi * float(i) / float(SkirtChains);
+        auto radial = glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+        addChain(LowerBody, 2, glm::vec3(0.0f, 9.0f, 0.0f) + radial * 1.6f, glm::vec3(0.0f, -1.3f, 0.0f) + radial * 0.45f,
+          SkirtLength, 0.35f, 2, (1u << 0) | (1u << 2));
+      }
+
+      order = skeleton.Build(bones);
+      for (auto& body : bodies)
+      {
+        body.bone = int32_t(order[body.bone]);
+      }
+      solver.Build(bodies, joints, skeleton);
+    }
+
+    // 体の動きの振幅と角振動数(ラジアン/秒). 前後の移動, センターの左右のひねり, 上半身の傾き, 脚の振り.
+    static constexpr float SwayAmplitude = 2.0f, SwayRate = 1.7f, TwistAmplitude = 0.8f, TwistRate = 2.3f;
+    static constexpr float LeanAmplitude = 0.3f, LeanRate = 3.1f, LegAmplitude = 0.6f, LegRate = 4.0f;
+
+    // 時刻 t (秒) での体の動き. 前後に動きながら左右にひねり, 脚を振る.
+    void Animate(float t)
+    {
+      const glm::vec3 x(1.0f, 0.0f, 0.0f), y(0.0f, 1.0f, 0.0f), z(0.0f, 0.0f, 1.0f);
+      skeleton.SetTranslation(order[Center], glm::vec3(0.0f, 10.0f, SwayAmplitude * std::sin(SwayRate * t)));
+      skeleton.SetRotation(order[Center], glm::angleAxis(TwistAmplitude * std::sin(TwistRate * t), y));
+      skeleton.SetRotation(order[UpperBody], glm::angleAxis(LeanAmplitude * std::sin(LeanRate * t), z));
+      skeleton.SetRotation(order[LeftLeg], glm::angleAxis(LegAmplitude * std::sin(LegRate * t), x));
+      skeleton.SetRotation(order[RightLeg], glm::angleAxis(-LegAmplitude * std::sin(LegRate * t), x));
+    }
+
+    // 回転の中心(センターと上半身)から reach 以内の点が Animate で動く速さの上限.
+    static float MaxAnimatedSpeed(float reach)
+    {
+      return SwayAmplitude * SwayRate + (TwistAmplitude * TwistRate + LeanAmplitude * LeanRate) * reach;
+    }
+
+    Skeleton skeleton;
+    std::vector<uint32_t> order;
+    std::vector<RigidBodySolver::BodyDesc> bodies;
+    std::vector<RigidBodySolver::JointDesc> joints;
+    std::vector<uint32_t> roots;    // 各剛体のチェインの根元の剛体.
+    RigidBodySolver solver;
+  };
+
+  // 線分 a0-a1, b0-b1 の最近点間の距離.
+  float SegmentDistance(const glm::vec3& a0, const glm::vec3& a1, const glm::vec3& b0, const glm::vec3& b1)
+  {
+    float segments[12], result[3];
+    const glm::vec3 values[4] = { a0, a1 - a0, b0, b1 - b0 };
+    for (uint32_t i = 0; i < 12; ++i)
+    {
+      segments[i] = values[i / 3][i % 3];
+    }
+    ClosestSegmentPointsScalar(segments, 1, result);
+    return std::sqrt(result[2]);
+  }
+
+  void BenchmarkPhysics(const Options& options)
+  {
+    const uint32_t CharacterCount = 20, TickCount = 300;
+    const float TickSeconds = 1.0f / 60.0f;
+    const double BudgetMs = 2.0;
+
+    // SIMD 版とスカラー版の最近点. 長さ 0 の線分(球)と平行な線分を含める.
+    const uint32_t PairCount = 1024;
+    std::mt19937 engine(options.seed);
+    std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+    std::vector<float> segments(12 * PairCount);
+    for (uint32_t i = 0; i < PairCount; ++i)
+    {
+      for (uint32_t row = 0; row < 12; ++row)
+      {
+        segments[row * PairCount + i] = 4.0f * signedUnit(engine);
+      }
+      for (uint32_t c = 0; c < 3; ++c)
+      {
+        auto& da = segments[(3 + c) * PairCount + i];
+        auto& db = segments[(9 + c) * PairCount + i];
+        da = i % 4 == 1 ? 0.0f : da;
+        db = i % 5 == 2 ? 0.0f : (i % 7 == 3 ? da * -0.5f : db);
+      }
+    }
+    std::vector<float> simdResult(3 * PairCount), scalarResult(3 * PairCount);
+    ClosestSegmentPoints(segments.data(), PairCount, simdResult.data());
+    ClosestSegmentPointsScalar(segments.data(), PairCount, scalarResult.data());
+    float maxKernelError = 0.0f;
+    for (uint32_t i = 0; i < PairCount; ++i)
+    {
+      maxKernelError = std::max(maxKernelError, std::abs(std::sqrt(simdResult[2 * PairCount + i]) - std::sqrt(scalarResult[2 * PairCount + i])));
+    }
+    auto kernelSeconds = MeasureSeconds(options.iterations, [&]() {
+      for (uint32_t repeat = 0; repeat < 100; ++repeat)
+      {
+        ClosestSegmentPoints(segments.data(), PairCount, simdResult.data());
+      }
+    });
+    auto scalarSeconds = MeasureSeconds(options.iterations, [&]() {
+      for (uint32_t repeat = 0; repeat < 100; ++repeat)
+      {
+        ClosestSegmentPointsScalar(segments.data(), PairCount, scalarResult.data());
+      }
+    });
+
+    // 衝突判定の組を, グループ, ジョイント, 初期姿勢の重なりから数え直す.
+    std::vector<PhysicsRig> rigs(CharacterCount);
+    auto& solver0 = rigs[0].solver;
+    const auto& bodies = rigs[0].bodies;
+    uint32_t expectedPairs = 0;
+    for (uint32_t a = 0; a < bodies.size(); ++a)
+    {
+      for (uint32_t b = a + 1; b < bodies.size(); ++b)
+      {
+        bool jointed = false;
+        for (const auto& joint : rigs[0].joints)
+        {
+          jointed |= (joint.bodies[0] == a && joint.bodies[1] == b) || (joint.bodies[0] == b && joint.bodies[1] == a);
+        }
+        glm::vec3 a0, a1, b0, b1;
+        float ra, rb;
+        solver0.GetBodySegment(a, a0, a1, ra);
+        solver0.GetBodySegment(b, b0, b1, rb);
+        if ((solver0.IsDynamic(a) || solver0.IsDynamic(b)) && !jointed &&
+          (bodies[a].groupMask & (1u << bodies[b].group)) != 0 && (bodies[b].groupMask & (1u << bodies[a].group)) != 0 &&
+          SegmentDistance(a0, a1, b0, b1) >= ra + rb)
+        {
+          ++expectedPairs;
+        }
+      }
+    }
+
+    // 全キャラクターを更新しながら, ジョイントの離れ, 剛体同士のめり込み, ボーンへの書き戻しを調べる.
+    bool finite = true;
+    float maxSeparation = 0.0f, maxPenetration = 0.0f, maxWriteBackError = 0.0f, maxSwing = 0.0f, maxSpeed = 0.0f;
+    uint32_t maxContacts = 0;
+    auto tick = [&](uint32_t t) {
+      for (uint32_t c = 0; c < CharacterCount; ++c)
+      {
+        auto& rig = rigs[c];
+        rig.Animate(float(t) * TickSeconds + float(c) * 0.37f);
+        rig.solver.Update(rig.skeleton, TickSeconds);
+        rig.skeleton.UpdateWorldMatrices();
+      }
+    };
+    for (uint32_t t = 0; t < TickCount; ++t)
+    {
+      tick(t);
+      for (auto& rig : rigs)
+      {
+        auto& solver = rig.solver;
+        maxContacts = std::max(maxContacts, solver.GetContactCount());
+        for (uint32_t i = 0; i < solver.GetBodyCount(); ++i)
+        {
+          const auto& position = solver.GetBodyPosition(i);
+          finite &= std::isfinite(position.x) && std::isfinite(position.y) && std::isfinite(position.z);
+          if (!solver.IsDynamic(i))
+          {
+            continue;
+          }
+          // 剛体の位置は, 書き戻したボーンで初期位置を動かしたものと一致する.
+          const auto& desc = rig.bodies[i];
+          auto bone = uint32_t(desc.bone);
+          auto expected = glm::vec3(rig.skeleton.GetWorldMatrix(bone) * rig.skeleton.GetInvBindMatrix(bone) * glm::vec4(desc.position, 1.0f));
+          maxWriteBackError = std::max(maxWriteBackError, glm::length(expected - position));
+          // チェインの根元に固定した場合の位置からの揺れ.
+          const auto& rootDesc = rig.bodies[rig.roots[i]];
+          auto fixed = solver.GetBodyPosition(rig.roots[i]) + solver.GetBodyRotation(rig.roots[i]) * (desc.position - rootDesc.position);
+          maxSwing = std::max(maxSwing, glm::length(fixed - position));
+          maxSpeed = std::max(maxSpeed, glm::length(solver.GetBodyVelocity(i)));
+        }
+        for (uint32_t i = 0; i < solver.GetJointCount(); ++i)
+        {
+          maxSeparation = std::max(maxSeparation, solver.GetJointSeparation(i));
+        }
+        for (uint32_t i = 0; i < solver.GetCollisionPairCount(); ++i)
+        {
+          uint32_t a, b;
+          solver.GetCollisionPair(i, a, b);
+          glm::vec3 a0, a1, b0, b1;
+          float ra, rb;
+          solver.GetBodySegment(a, a0, a1, ra);
+          solver.GetBodySegment(b, b0, b1, rb);
+          maxPenetration = std::max(maxPenetration, ra + rb - SegmentDistance(a0, a1, b0, b1));
+        }
+      }
+    }
+    uint32_t nextTick = TickCount;
+    auto seconds = MeasureSeconds(options.iterations, [&]() {
+      for (uint32_t t = 0; t < TickCount; ++t)
+      {
+        tick(nextTick++);
+      }
+    });
+    auto msPerTick = seconds / TickCount * 1.0e3;
+
+    // 剛体の速さの上限. チェインの剛体は, 根元が Animate で動く速さに, チェインの長さの 2 倍(真上から真下まで)を
+    // 自由落下した速さを加えた値を超えない. 回転の中心からの距離は, 根元の剛体までの距離にチェインの長さを加えたもの.
+    auto bindPosition = [&](uint32_t bone) { return -glm::vec3(rigs[0].skeleton.GetInvBindMatrix(rigs[0].order[bone])[3]); };
+    const glm::vec3 pivots[2] = { bindPosition(PhysicsRig::Center), bindPosition(PhysicsRig::UpperBody) };
+    float maxReach = 0.0f, maxChainLength = 0.0f;
+    for (uint32_t i = 0; i < bodies.size(); ++i)
+    {
+      if (!solver0.IsDynamic(i))
+      {
+        continue;
+      }
+      const auto& root = bodies[rigs[0].roots[i]].position;
+      auto length = glm::length(bodies[i].position - root) + 0.5f * bodies[i].size.y + bodies[i].size.x;
+      maxChainLength = std::max(maxChainLength, length);
+      for (const auto& pivot : pivots)
+      {
+        maxReach = std::max(maxReach, glm::length(root - pivot) + length);
+      }
+    }
+    const float SpeedBound = PhysicsRig::MaxAnimatedSpeed(maxReach) + std::sqrt(2.0f * glm::length(solver0.GetGravity()) * 2.0f * maxChainLength);
+
+    // XPBD では各ジョイントと接触を分割した刻み h ごとに 1 度ずつ解き, 同じ刻みの中で後から解く拘束が崩す量は,
+    // 両側の剛体の相対的な移動量 2 * v * h を超えない(v は剛体の速さの最大値). 離れとめり込みの許容値はこの移動量とする.
+    const float SubStep = solver0.GetTimeStep() / float(solver0.GetIterationCount());
+    const float SeparationTolerance = 2.0f * maxSpeed * SubStep, PenetrationTolerance = SeparationTolerance;
+    const float WriteBackTolerance = 1.0e-3f, MinSwing = 0.5f;
+    std::cout << "physics (" << CharacterCount << " characters, " << solver0.GetBodyCount() << " bodies, " << solver0.GetJointCount()
+      << " joints, " << solver0.GetCollisionPairCount() << " collision pairs, " << TickCount << " ticks at 60Hz, median of "
+      << options.iterations << ")" << std::endl;
+    printf("  segment kernel (%s)  %.2f ns/pair, scalar %.2f ns/pair, max distance error %.3e\n", GetPoseKernelName(),
+      kernelSeconds / (100.0 * PairCount) * 1.0e9, scalarSeconds / (100.0 * PairCount) * 1.0e9, maxKernelError);
+    printf("  update             %.3f ms/tick (budget %.1f ms, %s), max contacts %u\n", msPerTick, BudgetMs,
+      msPerTick <= BudgetMs ? "within" : "over", maxContacts);
+    printf("  max body speed     %.2f (<= %.2f), max motion per substep 2 * v * h = %.3f\n", maxSpeed, SpeedBound, SeparationTolerance);
+    printf("  max joint separation %.3e (<= %.3f), max penetration %.3e (<= %.3f)\n", maxSeparation, SeparationTolerance,
+      maxPenetration, PenetrationTolerance);
+    printf("  max write-back error %.3e (<= %.0e), max chain swing %.3f (>= %.1f)\n\n", maxWriteBackError, WriteBackTolerance,
+      maxSwing, MinSwing);
+
+    if (maxKernelError > 1.0e-4f)
+    {
+      throw std::runtime_error("physics: SIMD segment kernel differs from the scalar kernel.");
+    }
+    if (solver0.GetCollisionPairCount() != expectedPairs)
+    {
+      throw std::runtime_error("physics: collision pair filter mismatch (" + std::to_string(solver0.GetCollisionPairCount()) +
+        " != " + std::to_string(expectedPairs) + ").");
+    }
+    if (!finite)
+    {
+      throw std::runtime_error("physics: body position is not finite.");
+    }
+    if (maxSpeed > SpeedBound)
+    {
+      throw std::runtime_error("physics: bodies move faster than the rig can drive them.");
+    }
+    if (maxSeparation > SeparationTolerance || maxPenetration > PenetrationTolerance)
+    {
+      throw std::runtime_error("physics: constraints exceed the tolerance.");
+    }
+    if (maxWriteBackError > WriteBackTolerance || maxSwing < MinSwing)
+    {
+      throw std::runtime_error("physics: bones do not follow the simulated bodies.");
+    }
+  }
+
+  void BenchmarkSkinning(const Options& options)
+  {
+    std::mt19937 engine(options.seed);
+    std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // ボーン行列は回転と移動, 頂点は 2 本のボーンとウェイトを乱数で決める.
+    const uint32_t boneCount = options.bones, vertexCount = options.vertices;
+    std::vector<glm::mat4> palette(boneCount);
+    for (auto& m : palette)
+    {
+      auto rotation = glm::normalize(glm::quat(signedUnit(engine), signedUnit(engine), signedUnit(engine), signedUnit(engine)));
+      m = glm::translate(glm::mat4(1.0f), glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine)) * 10.0f) * glm::mat4_cast(rotation);
+    }
+    std::vector<SkinningVertex> vertices(vertexCount);
+    for (auto& v : vertices)
+    {
+      auto normal = glm::normalize(glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine)));
+      auto weight = unit(engine);
+      v = SkinningVertex{
+        { signedUnit(engine) * 10.0f, unit(engine) * 20.0f, signedUnit(engine) * 10.0f },
+        { normal.x, normal.y, normal.z },
+        { unit(engine), unit(engine) },
+        { uint32_t(engine() % boneCount), uint32_t(engine() % boneCount) },
+        { weight, 1.0f - weight },
+        uint32_t(engine() % 2u)
+      };
+    }
+    const float* paletteData = &palette[0][0][0];
+    std::vector<float> reference(8 * size_t(vertexCount)), result(8 * size_t(vertexCount));
+    SkinVerticesScalar(vertices.data(), vertexCount, paletteData, reference.data());
+
+    // 位置は 10 程度の大きさなので, 誤差は大きさに対する比で見る.
+    const float Tolerance = 1.0e-5f;
+    float maxError = 0.0f;
+    auto check = [&]() {
+      for (size_t i = 0; i < reference.size(); ++i)
+      {
+        maxError = std::max(maxError, std::abs(result[i] - reference[i]) / std::max(1.0f, std::abs(reference[i])));
+      }
+    };
+
+    const auto hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t n = 2; n < hardwareThreads; n *= 2)
+    {
+      threadCounts.push_back(n);
+    }
+    threadCounts.push_back(std::max(hardwareThreads, 2u));
+
+    std::cout << "skinning (" << GetSkinningKernelName() << ", " << vertexCount << " vertices, " << boneCount << " bones, "
+      << hardwareThreads << " hardware threads, median of " << options.iterations << ")" << std::endl;
+    printf("  %-14s %10s %12s %14s %9s\n", "mode", "ms/frame", "ns/vertex", "Mvertices/s", "speedup");
+    double scalarSeconds = 0.0;
+    auto print = [&](const std::string& name, double seconds) {
+      printf("  %-14s %10.3f %12.2f %14.1f %9.2f\n", name.c_str(), seconds * 1.0e3, seconds / vertexCount * 1.0e9,
+        vertexCount / seconds * 1.0e-6, scalarSeconds / seconds);
+    };
+    scalarSeconds = MeasureSeconds(options.iterations, [&]() { SkinVerticesScalar(vertices.data(), vertexCount, paletteData, result.data()); });
+    print("scalar", scalarSeconds);
+    auto simdSeconds = MeasureSeconds(options.iterations, [&]() { SkinVertices(vertices.data(), vertexCount, paletteData, result.data()); });
+    check();
+    print("simd", simdSeconds);
+    for (auto threadCount : threadCounts)
+    {
+      ThreadPool pool(threadCount - 1);
+      std::fill(result.begin(), result.end(), 0.0f);
+      auto seconds = MeasureSeconds(options.iterations, [&]() { SkinVerticesParallel(&pool, vertices.data(), vertexCount, paletteData, result.data()); });
+      check();
+      print("simd x" + std::to_string(threadCount), seconds);
+    }
+    printf("  max relative error against scalar %.3e (<= %.0e)\n\n", maxError, Tolerance);
+
+    if (!(maxError <= Tolerance))
+    {
+      throw std::runtime_error("skinning: SIMD result exceeds the tolerance.");
+    }
+  }
+
+  void BenchmarkFaceMorph(const Options& options)
+  {
+    std::mt19937 engine(options.seed);
+    std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+
+    // 頭部を想定した先頭の頂点から表情ベースを選ぶ. 表情は目や口のように, 表情ベースの中の近い頂点をまとめて動かす.
+    const uint32_t FaceCount = 64, ImageCount = 3, TickCount = 240;
+    // Model と同じく, 1 イメージあたりの転送はこの数の範囲にまとめる.
+    const uint32_t MaxUploadRanges = 8;
+    const uint32_t vertexCount = options.vertices;
+    const uint32_t headCount = std::min(vertexCount, 16000u);
+    const uint32_t baseCount = std::max(headCount / 4, 1u);
+    const uint32_t faceVertexCount = std::min(baseCount, 200u);
+
+    std::vector<SkinningVertex> vertices(vertexCount);
+    for (auto& v : vertices)
+    {
+      v = SkinningVertex{ { signedUnit(engine), signedUnit(engine), signedUnit(engine) }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f }, { 0, 0 }, { 1.0f, 0.0f }, 0 };
+    }
+    auto position = [](SkinningVertex& v) -> glm::vec3& { return *reinterpret_cast<glm::vec3*>(v.position); };
+
+    std::vector<uint32_t> order(headCount);
+    for (uint32_t i = 0; i < headCount; ++i)
+    {
+      order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), engine);
+    std::vector<uint32_t> baseIndices(order.begin(), order.begin() + baseCount);
+    std::sort(baseIndices.begin(), baseIndices.end());
+    std::vector<glm::vec3> basePositions(baseCount);
+    for (uint32_t i = 0; i < baseCount; ++i)
+    {
+      basePositions[i] = position(vertices[baseIndices[i]]);
+    }
+    std::vector<FaceMorph::Face> faces(FaceCount);
+    const uint32_t windowSize = std::min(baseCount, faceVertexCount * 3);
+    order.resize(windowSize);
+    for (uint32_t f = 0; f < FaceCount; ++f)
+    {
+      auto windowBegin = engine() % (baseCount - windowSize + 1);
+      for (uint32_t i = 0; i < windowSize; ++i)
+      {
+        order[i] = windowBegin + i;
+      }
+      std::shuffle(order.begin(), order.end(), engine);
+      faces[f].name = "face " + std::to_string(f);
+      faces[f].indices.assign(order.begin(), order.begin() + faceVertexCount);
+      faces[f].offsets.resize(faceVertexCount);
+      for (auto& offset : faces[f].offsets)
+      {
+        offset = 0.05f * glm::vec3(signedUnit(engine), signedUnit(engine), signedUnit(engine));
+      }
+    }
+
+    // 表情 0 は 120 ティックごとの瞬き, 表情 1 は口の開閉で毎ティック変わり, 残りは 60 ティックごとに 1 つだけ有効にする.
+    auto weightOf = [FaceCount](uint32_t face, uint32_t tick) {
+      if (face == 0)
+      {
+        auto t = tick % 120;
+        return t < 10 ? 1.0f - std::abs(float(t) - 5.0f) / 5.0f : 0.0f;
+      }
+      if (face == 1)
+      {
+        return 0.5f + 0.5f * std::sin(float(tick) * 0.3f);
+      }
+      return face == 2 + (tick / 60) % (FaceCount - 2) ? 1.0f : 0.0f;
+    };
+
+    struct MorphState
+    {
+      std::vector<SkinningVertex> host;
+      std::vector<std::vector<SkinningVertex>> images;
+      FaceMorph morph;
+      std::vector<std::vector<VertexRange>> pending;
+      std::vector<VertexRange> changed;
+      uint32_t tick = 0;
+      uint64_t uploadedBytes = 0;
+      uint64_t copies = 0;
+      uint64_t ticks = 0;
+    };
+    auto makeState = [&]() {
+      std::unique_ptr<MorphState> state(new MorphState());
+      state->host = vertices;
+      state->images.assign(ImageCount, vertices);
+      state->morph.Build(baseIndices, basePositions, faces);
+      state->pending.resize(ImageCount);
+      return state;
+    };
+    const auto vertexBytes = sizeof(SkinningVertex) * size_t(vertexCount);
+
+    // 変更前の Model と同じく, 全ての表情ベースの頂点を戻して全ての表情を足し, 頂点全体を転送する.
+    auto updateFull = [&](MorphState& state) {
+      for (uint32_t i = 0; i < baseCount; ++i)
+      {
+        position(state.host[baseIndices[i]]) = basePositions[i];
+      }
+      for (uint32_t f = 0; f < FaceCount; ++f)
+      {
+        float w = weightOf(f, state.tick);
+        const auto& face = faces[f];
+        for (uint32_t i = 0; i < faceVertexCount; ++i)
+        {
+          position(state.host[baseIndices[face.indices[i]]]) += face.offsets[i] * w;
+        }
+      }
+      memcpy(state.images[state.tick % ImageCount].data(), state.host.data(), vertexBytes);
+      state.uploadedBytes += vertexBytes;
+      ++state.copies;
+      ++state.ticks;
+      ++state.tick;
+    };
+    auto updateSparse = [&](MorphState& state) {
+      for (uint32_t f = 0; f < FaceCount; ++f)
+      {
+        state.morph.SetWeight(f, weightOf(f, state.tick));
+      }
+      if (state.morph.IsDirty())
+      {
+        state.changed.clear();
+        state.morph.Apply(state.host[0].position, sizeof(SkinningVertex), state.changed);
+        for (auto& pending : state.pending)
+        {
+          pending.insert(pending.end(), state.changed.begin(), state.changed.end());
+          CoalesceVertexRanges(pending, MaxUploadRanges);
+        }
+      }
+      auto& pending = state.pending[state.tick % ImageCount];
+      auto& image = state.images[state.tick % ImageCount];
+      for (const auto& range : pending)
+      {
+        auto bytes = sizeof(SkinningVertex) * (range.end - range.begin);
+        memcpy(&image[range.begin], &state.host[range.begin], bytes);
+        state.uploadedBytes += bytes;
+        ++state.copies;
+      }
+      pending.clear();
+      ++state.ticks;
+      ++state.tick;
+    };
+
+    // GPU で適用する場合の頂点ごとの移動量. 頂点の位置は表情ベースのまま変えない.
+    std::vector<uint32_t> rowOffsets;
+    std::vector<FaceMorph::VertexDelta> deltas;
+    makeState()->morph.BuildVertexDeltas(vertexCount, rowOffsets, deltas);
+    auto gatherMorph = [&](uint32_t vertex, const std::vector<float>& weights) {
+      auto p = position(vertices[vertex]);
+      for (auto i = rowOffsets[vertex]; i < rowOffsets[vertex + 1]; ++i)
+      {
+        p += deltas[i].offset * weights[deltas[i].face];
+      }
+      return p;
+    };
+
+    // 毎ティック, 転送したイメージの頂点位置を全て更新した場合と比べる. GPU での適用はホスト側の頂点と比べる.
+    float maxError = 0.0f, maxGpuError = 0.0f;
+    {
+      auto full = makeState(), sparse = makeState();
+      for (uint32_t t = 0; t < TickCount * 2; ++t)
+      {
+        auto imageIndex = t % ImageCount;
+        updateFull(*full);
+        updateSparse(*sparse);
+        for (uint32_t i = 0; i < vertexCount; ++i)
+        {
+          auto d = glm::abs(position(sparse->images[imageIndex][i]) - position(full->images[imageIndex][i]));
+          maxError = std::max(maxError, std::max(d.x, std::max(d.y, d.z)));
+          d = glm::abs(gatherMorph(i, sparse->morph.GetWeights()) - position(sparse->host[i]));
+          maxGpuError = std::max(maxGpuError, std::max(d.x, std::max(d.y, d.z)));
+        }
+      }
+    }
+
+    std::cout << "morph (" << vertexCount << " vertices, " << baseCount << " base vertices, " << FaceCount << " morphs x "
+      << faceVertexCount << " vertices, " << ImageCount << " images, " << TickCount << " ticks, median of " << options.iterations << ")" << std::endl;
+    printf("  %-8s %10s %12s %12s %9s\n", "mode", "us/tick", "KB/tick", "copies/tick", "speedup");
+    double fullSeconds = 0.0;
+    auto measure = [&](const std::string& name, const std::function<void(MorphState&)>& update) {
+      auto state = makeState();
+      auto seconds = MeasureSeconds(options.iterations, [&]() {
+        for (uint32_t t = 0; t < TickCount; ++t)
+        {
+          update(*state);
+        }
+      }) / TickCount;
+      if (fullSeconds == 0.0)
+      {
+        fullSeconds = seconds;
+      }
+      printf("  %-8s %10.2f %12.2f %12.2f %9.2f\n", name.c_str(), seconds * 1.0e6,
+        double(state->uploadedBytes) / state->ticks / 1024.0, double(state->copies) / state->ticks, fullSeconds / seconds);
+    };
+    measure("full", updateFull);
+    measure("sparse", updateSparse);
+    printf("  gpu: %.2f KB of weights per tick, CSR deltas %.1f KB uploaded once\n", sizeof(float) * FaceCount / 1024.0,
+      (rowOffsets.size() * sizeof(uint32_t) + deltas.size() * sizeof(FaceMorph::VertexDelta)) / 1024.0);
+    printf("  max error against full update %.3e, gpu gather against FaceMorph %.3e\n", maxError, maxGpuError);
+
+    // SKINNING_CPU の Model と同じく, ボーン行列が変わらない間は表情モーフで変わった範囲のみをスキニングし直す場合と,
+    // 毎ティック全頂点をスキニングし直す場合を比べる. ボーン行列は単位行列のまま変えない.
+    const uint32_t MaxMorphedRanges = 16;
+    const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    struct SkinState
+    {
+      std::unique_ptr<MorphState> morph;
+      std::vector<std::vector<float>> images;
+      std::vector<uint8_t> skinAll;
+      uint64_t skinnedVertices = 0;
+    };
+    auto makeSkinState = [&]() {
+      SkinState state;
+      state.morph = makeState();
+      state.images.assign(ImageCount, std::vector<float>(8 * size_t(vertexCount)));
+      state.skinAll.assign(ImageCount, 1);
+      return state;
+    };
+    auto skin = [&](SkinState& state, bool ranges) {
+      auto& morph = *state.morph;
+      auto imageIndex = morph.tick % ImageCount;
+      for (uint32_t f = 0; f < FaceCount; ++f)
+      {
+        morph.morph.SetWeight(f, weightOf(f, morph.tick));
+      }
+      if (morph.morph.IsDirty())
+      {
+        morph.changed.clear();
+        morph.morph.Apply(morph.host[0].position, sizeof(SkinningVertex), morph.changed);
+        for (uint32_t i = 0; i < ImageCount; ++i)
+        {
+          morph.pending[i].insert(morph.pending[i].end(), morph.changed.begin(), morph.changed.end());
+          CoalesceVertexRanges(morph.pending[i], MaxMorphedRanges);
+        }
+      }
+      auto dst = state.images[imageIndex].data();
+      if (!ranges || state.skinAll[imageIndex])
+      {
+        SkinVertices(morph.host.data(), vertexCount, identity, dst);
+        state.skinnedVertices += vertexCount;
+      }
+      else
+      {
+        for (const auto& range : morph.pending[imageIndex])
+        {
+          SkinVertices(morph.host.data() + range.begin, range.end - range.begin, identity, dst + 8 * size_t(range.begin));
+          state.skinnedVertices += range.end - range.begin;
+        }
+      }
+      state.skinAll[imageIndex] = 0;
+      morph.pending[imageIndex].clear();
+      ++morph.ticks;
+      ++morph.tick;
+    };
+    float maxSkinError = 0.0f;
+    {
+      auto full = makeSkinState(), ranged = makeSkinState();
+      for (uint32_t t = 0; t < TickCount * 2; ++t)
+      {
+        auto imageIndex = t % ImageCount;
+        skin(full, false);
+        skin(ranged, true);
+        const auto& a = full.images[imageIndex];
+        const auto& b = ranged.images[imageIndex];
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+          maxSkinError = std::max(maxSkinError, std::abs(a[i] - b[i]));
+        }
+      }
+    }
+    double skinSeconds[2];
+    uint64_t skinnedVertices[2];
+    for (int ranges = 0; ranges < 2; ++ranges)
+    {
+      auto state = makeSkinState();
+      skinSeconds[ranges] = MeasureSeconds(options.iterations, [&]() {
+        for (uint32_t t = 0; t < TickCount; ++t)
+        {
+          skin(state, ranges != 0);
+        }
+      }) / TickCount;
+      skinnedVertices[ranges] = state.skinnedVertices / state.morph->ticks;
+    }
+    printf("  cpu skinning with static bones: all vertices %.2f us/tick, morphed ranges %.2f us/tick (%.2fx, %llu vertices/tick)\n",
+      skinSeconds[0] * 1.0e6, skinSeconds[1] * 1.0e6, skinSeconds[0] / skinSeconds[1], (unsigned long long)skinnedVertices[1]);
+    printf("  max error of morphed range skinning %.3e\n\n", maxSkinError);
+
+    if (!(maxError <= 1.0e-6f))
+    {
+      throw std::runtime_error("morph: uploaded vertices differ from the full update.");
+    }
+    if (!(maxGpuError <= 1.0e-6f))
+    {
+      throw std::runtime_error("morph: CSR deltas differ from FaceMorph.");
+    }
+    if (!(maxSkinError == 0.0f))
+    {
+      throw std::runtime_error("morph: skinning the morphed ranges differs from skinning all vertices.");
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    auto options = ParseOptions(argc, argv);
+    std::map<std::string, std::function<void(const Options&)>> benchmarks{
+      { "bezier", BenchmarkBezierEasing },
+      { "baked", BenchmarkBakedClip },
+      { "compressed", BenchmarkCompressedClip },
+      { "kernel", BenchmarkPoseKernel },
+      { "ik", BenchmarkBoneIK },
+      { "parallel", BenchmarkParallelUpdate },
+      { "lod", BenchmarkAnimationLod },
+      { "cache", BenchmarkPoseCache },
+      { "physics", BenchmarkPhysics },
+      { "skinning", BenchmarkSkinning },
+      { "morph", BenchmarkFaceMorph },
+    };
+    if (options.benchmarks.empty())
+    {
+      options.benchmarks = { "bezier", "baked", "compressed", "kernel", "ik", "parallel", "lod", "cache", "physics", "skinning", "morph" };
+    }
+    for (const auto& name : options.benchmarks)
+    {
+      if (benchmarks.count(name) == 0)
+      {
+        throw std::runtime_error("Unknown benchmark " + name);
+      }
+      benchmarks[name](options);
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,324 @@
+﻿#include "SyntheticData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <numeric>
+#include <random>
+
+namespace
+{
+  // リトルエンディアンのバイト列を組み立てる.
+  class ByteWriter
+  {
+  public:
+    template<class T>
+    void Put(T value)
+    {
+      auto offset = m_data.size();
+      m_data.resize(offset + sizeof(T));
+      memcpy(m_data.data() + offset, &value, sizeof(T));
+    }
+    void PutFloats(std::initializer_list<float> values)
+    {
+      for (auto v : values)
+      {
+        Put(v);
+      }
+    }
+    // 固定長の名前フィールド. 余りは 0 で埋める.
+    void PutName(const std::string& name, size_t length)
+    {
+      auto offset = m_data.size();
+      m_data.resize(offset + length, 0);
+      memcpy(m_data.data() + offset, name.data(), std::min(name.size(), length));
+    }
+    void PutBytes(const void* data, size_t size)
+    {
+      auto offset = m_data.size();
+      m_data.resize(offset + size);
+      memcpy(m_data.data() + offset, data, size);
+    }
+
+    void BeginSection(const std::string& name)
+    {
+      m_sections.push_back(SyntheticSection{ name, 0, m_data.size() });
+    }
+    void EndSection(uint64_t records)
+    {
+      auto& section = m_sections.back();
+      section.records = records;
+      section.bytes = m_data.size() - section.bytes;
+    }
+
+    SyntheticFile Finish()
+    {
+      return SyntheticFile{ std::move(m_data), std::move(m_sections) };
+    }
+  private:
+    std::vector<char> m_data;
+    std::vector<SyntheticSection> m_sections;
+  };
+
+  class Random
+  {
+  public:
+    explicit Random(uint32_t seed) : m_engine(seed) { }
+
+    float Float(float minValue, float maxValue)
+    {
+      return std::uniform_real_distribution<float>(minValue, maxValue)(m_engine);
+    }
+    // [0, count) の整数. count が 0 の場合は 0.
+    uint32_t Index(uint32_t count)
+    {
+      return count > 0 ? std::uniform_int_distribution<uint32_t>(0, count - 1)(m_engine) : 0;
+    }
+    std::mt19937& GetEngine() { return m_engine; }
+  private:
+    std::mt19937 m_engine;
+  };
+
+  // 固定長レコードの並びを書き込む. shuffle 指定時はレコードの順序を入れ替える.
+  void PutRecords(ByteWriter& writer, const std::vector<char>& records, size_t recordSize, bool shuffle, Random& random)
+  {
+    auto count = records.size() / recordSize;
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), size_t(0));
+    if (shuffle)
+    {
+      std::shuffle(order.begin(), order.end(), random.GetEngine());
+    }
+    for (auto i : order)
+    {
+      writer.PutBytes(records.data() + i * recordSize, recordSize);
+    }
+  }
+
+  std::string NumberedName(const char* prefix, uint32_t number)
+  {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s%03u", prefix, number);
+    return buf;
+  }
+}
+
+SyntheticFile GenerateSyntheticPMD(const SyntheticPMDParams& params)
+{
+  ByteWriter writer;
+  Random random(params.seed);
+  const uint32_t boneCount = std::min(params.boneCount, 0xFFFFu);
+  const uint32_t ikCount = std::min(params.ikCount, 0xFFFFu);
+  const uint32_t ikChainLength = std::min(params.ikChainLength, 0xFFu);
+  const uint32_t vertexCount = params.vertexCount;
+  const uint32_t indexCount = params.indexCount / 3 * 3;
+  const uint32_t morphBaseCount = params.morphCount > 0 ? std::max(params.morphBaseVertexCount, 1u) : params.morphBaseVertexCount;
+  const uint32_t faceCount = (params.morphCount > 0 || morphBaseCount > 0) ? std::min(params.morphCount + 1, 0xFFFFu) : 0;
+
+  // ヘッダ.
+  writer.PutBytes("Pmd", 3);
+  writer.Put(1.0f);
+  writer.PutName("synthetic", 20);
+  writer.PutName("LoaderBenchmark synthetic model", 256);
+
+  writer.BeginSection("vertices");
+  writer.Put(vertexCount);
+  for (uint32_t i = 0; i < vertexCount; ++i)
+  {
+    writer.PutFloats({ random.Float(-10.0f, 10.0f), random.Float(0.0f, 20.0f), random.Float(-10.0f, 10.0f) });
+    writer.PutFloats({ random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f) });
+    writer.PutFloats({ random.Float(0.0f, 1.0f), random.Float(0.0f, 1.0f) });
+    writer.Put(uint16_t(random.Index(boneCount)));
+    writer.Put(uint16_t(random.Index(boneCount)));
+    writer.Put(uint8_t(random.Index(101)));
+    writer.Put(uint8_t(random.Index(2)));
+  }
+  writer.EndSection(vertexCount);
+
+  writer.BeginSection("indices");
+  writer.Put(indexCount);
+  for (uint32_t i = 0; i < indexCount; ++i)
+  {
+    writer.Put(uint16_t(random.Index(std::min(vertexCount, 0x10000u))));
+  }
+  writer.EndSection(indexCount);
+
+  // マテリアルごとのインデックス数は 3 の倍数で, 合計がインデックス数と一致するように割り振る.
+  writer.BeginSection("materials");
+  writer.Put(params.materialCount);
+  for (uint32_t i = 0; i < params.materialCount; ++i)
+  {
+    auto triangles = indexCount / 3;
+    auto count = triangles / params.materialCount + (i < triangles % params.materialCount ? 1 : 0);
+    writer.PutFloats({ random.Float(0.0f, 1.0f), random.Float(0.0f, 1.0f), random.Float(0.0f, 1.0f), 1.0f });
+    writer.PutFloats({ random.Float(1.0f, 50.0f) });
+    writer.PutFloats({ random.Float(0.0f, 1.0f), random.Float(0.0f, 1.0f), random.Float(0.0f, 1.0f) });
+    writer.PutFloats({ random.Float(0.0f, 1.0f), random.Float(0.0f, 1.0f), random.Float(0.0f, 1.0f) });
+    writer.Put(uint8_t(i % 10));
+    writer.Put(uint8_t(1));
+    writer.Put(uint32_t(count * 3));
+    writer.PutName(i % 4 == 0 ? "" : (i % 4 == 1 ? NumberedName("tex", i) + ".png" : NumberedName("tex", i) + ".bmp*s.sph"), 20);
+  }
+  writer.EndSection(params.materialCount);
+
+  writer.BeginSection("bones");
+  writer.Put(uint16_t(boneCount));
+  for (uint32_t i = 0; i < boneCount; ++i)
+  {
+    writer.PutName(NumberedName("bone", i), 20);
+    writer.Put(uint16_t(i == 0 ? 0xFFFFu : random.Index(i)));
+    writer.Put(uint16_t(0));
+    writer.Put(uint8_t(0));
+    writer.Put(uint16_t(0));
+    writer.PutFloats({ random.Float(-5.0f, 5.0f), random.Float(0.0f, 20.0f), random.Float(-5.0f, 5.0f) });
+  }
+  writer.EndSection(boneCount);
+
+  writer.BeginSection("iks");
+  writer.Put(uint16_t(ikCount));
+  for (uint32_t i = 0; i < ikCount; ++i)
+  {
+    writer.Put(uint16_t(random.Index(boneCount)));
+    writer.Put(uint16_t(random.Index(boneCount)));
+    writer.Put(uint8_t(ikChainLength));
+    writer.Put(uint16_t(40));
+    writer.Put(random.Float(0.1f, 1.0f));
+    for (uint32_t j = 0; j < ikChainLength; ++j)
+    {
+      writer.Put(uint16_t(random.Index(boneCount)));
+    }
+  }
+  writer.EndSection(ikCount);
+
+  // 表情. 0 番目はベース表情で頂点番号を, 以降はベース表情内の番号を持つ.
+  writer.BeginSection("morphs");
+  uint64_t morphRecords = 0;
+  writer.Put(uint16_t(faceCount));
+  for (uint32_t i = 0; i < faceCount; ++i)
+  {
+    auto isBase = i == 0;
+    auto count = isBase ? morphBaseCount : params.morphVertexCount;
+    writer.PutName(isBase ? std::string("base") : NumberedName("morph", i - 1), 20);
+    writer.Put(count);
+    writer.Put(uint8_t(isBase ? 0 : 1 + i % 4));
+    for (uint32_t j = 0; j < count; ++j)
+    {
+      writer.Put(isBase ? random.Index(vertexCount) : random.Index(morphBaseCount));
+      writer.PutFloats({ random.Float(-0.1f, 0.1f), random.Float(-0.1f, 0.1f), random.Float(-0.1f, 0.1f) });
+    }
+    morphRecords += count;
+  }
+  writer.EndSection(morphRecords);
+
+  // 表示枠.
+  auto faceDispCount = std::min(faceCount > 0 ? faceCount - 1 : 0, 0xFFu);
+  writer.Put(uint8_t(faceDispCount));
+  for (uint32_t i = 0; i < faceDispCount; ++i)
+  {
+    writer.Put(uint16_t(i + 1));
+  }
+  writer.Put(uint8_t(0));
+  writer.Put(uint32_t(0));
+
+  // 英語名.
+  writer.Put(uint8_t(1));
+  writer.PutName("synthetic", 20);
+  writer.PutName("synthetic model", 256);
+  for (uint32_t i = 0; i < boneCount; ++i)
+  {
+    writer.PutName(NumberedName("bone", i), 20);
+  }
+  for (uint32_t i = 1; i < faceCount; ++i)
+  {
+    writer.PutName(NumberedName("morph", i - 1), 20);
+  }
+
+  // トゥーンテクスチャ.
+  for (uint32_t i = 0; i < 10; ++i)
+  {
+    writer.PutName(NumberedName("toon", i) + ".bmp", 100);
+  }
+
+  writer.BeginSection("rigid bodies");
+  writer.Put(params.rigidBodyCount);
+  for (uint32_t i = 0; i < params.rigidBodyCount; ++i)
+  {
+    writer.PutName(NumberedName("rigid", i), 20);
+    writer.Put(uint16_t(random.Index(boneCount)));
+    writer.Put(uint8_t(i % 16));
+    writer.Put(uint16_t(0xFFFF));
+    writer.Put(uint8_t(i % 3));
+    writer.PutFloats({ random.Float(0.1f, 1.0f), random.Float(0.1f, 1.0f), random.Float(0.1f, 1.0f) });
+    writer.PutFloats({ random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f) });
+    writer.PutFloats({ random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f) });
+    writer.PutFloats({ 1.0f, 0.5f, 0.5f, 0.0f, 0.5f });
+    writer.Put(uint8_t(i % 3));
+  }
+  writer.EndSection(params.rigidBodyCount);
+
+  writer.BeginSection("joints");
+  writer.Put(params.jointCount);
+  for (uint32_t i = 0; i < params.jointCount; ++i)
+  {
+    writer.PutName(NumberedName("joint", i), 20);
+    writer.Put(random.Index(params.rigidBodyCount));
+    writer.Put(random.Index(params.rigidBodyCount));
+    for (int j = 0; j < 24; ++j)
+    {
+      writer.Put(random.Float(-1.0f, 1.0f));
+    }
+  }
+  writer.EndSection(params.jointCount);
+
+  return writer.Finish();
+}
+
+SyntheticFile GenerateSyntheticVMD(const SyntheticVMDParams& params)
+{
+  ByteWriter writer;
+  Random random(params.seed);
+
+  writer.PutName("Vocaloid Motion Data 0002", 30);
+  writer.PutName("synthetic", 20);
+
+  // キーはトラックに順番に割り当てるため, 各トラック内のフレーム番号は単調増加になる.
+  // ボーン名は GenerateSyntheticPMD のボーンと一致する.
+  const size_t MotionRecordSize = 111;
+  const uint32_t boneTrackCount = std::max(params.boneTrackCount, 1u);
+  ByteWriter motions;
+  for (uint32_t i = 0; i < params.boneKeyCount; ++i)
+  {
+    motions.PutName(NumberedName("bone", i % boneTrackCount), 15);
+    motions.Put(uint32_t(i / boneTrackCount * 2));
+    motions.PutFloats({ random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f) });
+    float q[4] = { random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), random.Float(0.1f, 1.0f) };
+    auto length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    motions.PutFloats({ q[0] / length, q[1] / length, q[2] / length, q[3] / length });
+    for (int j = 0; j < 64; ++j)
+    {
+      motions.Put(uint8_t(random.Index(128)));
+    }
+  }
+  writer.BeginSection("bone keys");
+  writer.Put(params.boneKeyCount);
+  PutRecords(writer, motions.Finish().data, MotionRecordSize, params.shuffle, random);
+  writer.EndSection(params.boneKeyCount);
+
+  const size_t MorphRecordSize = 23;
+  const uint32_t morphTrackCount = std::max(params.morphTrackCount, 1u);
+  ByteWriter morphs;
+  for (uint32_t i = 0; i < params.morphKeyCount; ++i)
+  {
+    morphs.PutName(NumberedName("morph", i % morphTrackCount), 15);
+    morphs.Put(uint32_t(i / morphTrackCount * 2));
+    morphs.Put(random.Float(0.0f, 1.0f));
+  }
+  writer.BeginSection("morph keys");
+  writer.Put(params.morphKeyCount);
+  PutRecords(writer, morphs.Finish().data, MorphRecordSize, params.shuffle, random);
+  writer.EndSection(params.morphKeyCount);
+
+  return writer.Finish();
+}
@@ -0,0 +1,50 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ベンチマーク用に, 形式として正しい PMD / VMD のバイト列を乱数で生成する.
+// 参照関係(親ボーン, IK チェイン, 表情の頂点番号など)は範囲内に収まるように作る.
+
+// 生成したファイル中の 1 セクション分の情報.
+struct SyntheticSection
+{
+  std::string name;
+  uint64_t records;   // レコード数.
+  uint64_t bytes;     // 個数フィールドを含むバイト数.
+};
+
+struct SyntheticFile
+{
+  std::vector<char> data;
+  std::vector<SyntheticSection> sections;
+};
+
+struct SyntheticPMDParams
+{
+  uint32_t vertexCount = 100000;
+  uint32_t indexCount = 300000;
+  uint32_t materialCount = 32;
+  uint32_t boneCount = 256;
+  uint32_t ikCount = 16;
+  uint32_t ikChainLength = 4;
+  uint32_t morphCount = 64;         // ベース表情を除く表情の数.
+  uint32_t morphBaseVertexCount = 2000;
+  uint32_t morphVertexCount = 200;  // 各表情が動かす頂点数.
+  uint32_t rigidBodyCount = 64;
+  uint32_t jointCount = 48;
+  uint32_t seed = 1;
+};
+
+struct SyntheticVMDParams
+{
+  uint32_t boneTrackCount = 128;
+  uint32_t boneKeyCount = 200000;   // 全トラック合計.
+  uint32_t morphTrackCount = 32;
+  uint32_t morphKeyCount = 50000;   // 全トラック合計.
+  bool shuffle = false;             // キーフレームを時刻順に並べない.
+  uint32_t seed = 1;
+};
+
+SyntheticFile GenerateSyntheticPMD(const SyntheticPMDParams& params);
+SyntheticFile GenerateSyntheticVMD(const SyntheticVMDParams& params);
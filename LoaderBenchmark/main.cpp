@@ -0,0 +1,336 @@
+﻿#include "loader/PMDloader.h"
+#include "loader/PMDCooked.h"
+#include "SyntheticData.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// ローダーの読み込み速度を計測する.
+//   LoaderBenchmark [options]
+//     合成データを生成し, セクションごとの読み込み速度(MB/s, records/s)を表示する.
+//     各セクションは「そのセクションだけを持つファイル」と「空のファイル」の読み込み時間の差で求める.
+//   LoaderBenchmark --generate-pmd <output.pmd> [options]
+//   LoaderBenchmark --generate-vmd <output.vmd> [options]
+//     合成データをファイルへ書き出す.
+//   LoaderBenchmark --file <input.pmd|input.vmd|input.pmdc> [--iterations N]
+//     既存ファイル全体の読み込み速度を表示する.
+//
+// options:
+//   --vertices N --indices N --materials N --bones N --iks N --ik-chain N
+//   --morphs N --morph-base N --morph-vertices N --rigid-bodies N --joints N
+//   --bone-tracks N --bone-keys N --morph-tracks N --morph-keys N --shuffle
+//   --seed N --iterations N
+
+namespace fs = std::filesystem;
+
+namespace
+{
+  struct Options
+  {
+    std::string mode;
+    std::string path;
+    uint32_t iterations = 10;
+    SyntheticPMDParams pmd;
+    SyntheticVMDParams vmd;
+  };
+
+  Options ParseOptions(int argc, char* argv[])
+  {
+    Options options;
+    std::map<std::string, std::function<void(uint32_t)>> counts{
+      { "--vertices", [&](uint32_t v) { options.pmd.vertexCount = v; } },
+      { "--indices", [&](uint32_t v) { options.pmd.indexCount = v; } },
+      { "--materials", [&](uint32_t v) { options.pmd.materialCount = v; } },
+      { "--bones", [&](uint32_t v) { options.pmd.boneCount = v; } },
+      { "--iks", [&](uint32_t v) { options.pmd.ikCount = v; } },
+      { "--ik-chain", [&](uint32_t v) { options.pmd.ikChainLength = v; } },
+      { "--morphs", [&](uint32_t v) { options.pmd.morphCount = v; } },
+      { "--morph-base", [&](uint32_t v) { options.pmd.morphBaseVertexCount = v; } },
+      { "--morph-vertices", [&](uint32_t v) { options.pmd.morphVertexCount = v; } },
+      { "--rigid-bodies", [&](uint32_t v) { options.pmd.rigidBodyCount = v; } },
+      { "--joints", [&](uint32_t v) { options.pmd.jointCount = v; } },
+      { "--bone-tracks", [&](uint32_t v) { options.vmd.boneTrackCount = v; } },
+      { "--bone-keys", [&](uint32_t v) { options.vmd.boneKeyCount = v; } },
+      { "--morph-tracks", [&](uint32_t v) { options.vmd.morphTrackCount = v; } },
+      { "--morph-keys", [&](uint32_t v) { options.vmd.morphKeyCount = v; } },
+      { "--seed", [&](uint32_t v) { options.pmd.seed = options.vmd.seed = v; } },
+      { "--iterations", [&](uint32_t v) { options.iterations = std::max(v, 1u); } },
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string arg = argv[i];
+      if (arg == "--generate-pmd" || arg == "--generate-vmd" || arg == "--file")
+      {
+        if (i + 1 >= argc)
+        {
+          throw std::runtime_error(arg + " requires a file name.");
+        }
+        options.mode = arg;
+        options.path = argv[++i];
+      }
+      else if (arg == "--shuffle")
+      {
+        options.vmd.shuffle = true;
+      }
+      else if (counts.count(arg) > 0)
+      {
+        if (i + 1 >= argc)
+        {
+          throw std::runtime_error(arg + " requires a number.");
+        }
+        counts[arg](uint32_t(std::stoul(argv[++i])));
+      }
+      else
+      {
+        throw std::runtime_error("Unknown option " + arg);
+      }
+    }
+    return options;
+  }
+
+  void WriteFile(const fs::path& path, const std::vector<char>& data)
+  {
+    std::ofstream outfile(path, std::ios::binary);
+    outfile.write(data.data(), data.size());
+    if (!outfile)
+    {
+      throw std::runtime_error("Write failed " + path.string());
+    }
+  }
+
+  // 計測した時間の中央値(秒).
+  double MeasureSeconds(uint32_t iterations, const std::function<void()>& func)
+  {
+    // 1 回目はページキャッシュやアロケータを温めるために捨てる.
+    func();
+    std::vector<double> samples(iterations);
+    for (auto& sample : samples)
+    {
+      auto start = std::chrono::steady_clock::now();
+      func();
+      auto end = std::chrono::steady_clock::now();
+      sample = std::chrono::duration<double>(end - start).count();
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+  }
+
+  void LoadPMD(const fs::path& path)
+  {
+    auto mappedFile = std::make_shared<loader::MappedFile>(path.string().c_str());
+    loader::PMDFile pmd(mappedFile);
+  }
+  void LoadCookedPMD(const fs::path& path)
+  {
+    auto mappedFile = std::make_shared<loader::MappedFile>(path.string().c_str());
+    loader::PMDCookedFile cooked(mappedFile);
+  }
+  void LoadVMD(const fs::path& path)
+  {
+    std::ifstream infile(path, std::ios::binary);
+    loader::VMDFile vmd(infile);
+  }
+
+  void PrintHeader(const std::string& title)
+  {
+    std::cout << title << std::endl;
+    printf("  %-16s %12s %12s %10s %10s %10s\n", "section", "records", "bytes", "time[ms]", "MB/s", "Mrec/s");
+  }
+  void PrintRow(const std::string& name, uint64_t records, uint64_t bytes, double seconds)
+  {
+    // 差分が計測誤差に埋もれた場合は速度を表示しない.
+    if (seconds <= 0.0)
+    {
+      printf("  %-16s %12llu %12llu %10s %10s %10s\n", name.c_str(),
+        (unsigned long long)records, (unsigned long long)bytes, "-", "-", "-");
+      return;
+    }
+    printf("  %-16s %12llu %12llu %10.3f %10.1f %10.2f\n", name.c_str(),
+      (unsigned long long)records, (unsigned long long)bytes, seconds * 1000.0,
+      bytes / seconds / 1.0e6, records / seconds / 1.0e6);
+  }
+
+  // PMD の各セクションを 1 つだけ持つファイルを作り, 空ファイルとの差を計測する.
+  void BenchmarkPMD(const Options& options, const fs::path& workDir)
+  {
+    SyntheticPMDParams empty = options.pmd;
+    empty.vertexCount = empty.indexCount = empty.materialCount = 0;
+    empty.boneCount = empty.ikCount = 0;
+    empty.morphCount = empty.morphBaseVertexCount = 0;
+    empty.rigidBodyCount = empty.jointCount = 0;
+
+    auto emptyPath = workDir / "empty.pmd";
+    WriteFile(emptyPath, GenerateSyntheticPMD(empty).data);
+    auto emptySeconds = MeasureSeconds(options.iterations, [&]() { LoadPMD(emptyPath); });
+
+    const std::pair<const char*, std::function<void(SyntheticPMDParams&)>> sections[] = {
+      { "vertices", [&](SyntheticPMDParams& p) { p.vertexCount = options.pmd.vertexCount; } },
+      { "indices", [&](SyntheticPMDParams& p) { p.indexCount = options.pmd.indexCount; } },
+      { "materials", [&](SyntheticPMDParams& p) { p.materialCount = options.pmd.materialCount; } },
+      { "bones", [&](SyntheticPMDParams& p) { p.boneCount = options.pmd.boneCount; } },
+      { "iks", [&](SyntheticPMDParams& p) { p.ikCount = options.pmd.ikCount; } },
+      { "morphs", [&](SyntheticPMDParams& p) {
+        p.morphCount = options.pmd.morphCount;
+        p.morphBaseVertexCount = options.pmd.morphBaseVertexCount;
+      } },
+      { "rigid bodies", [&](SyntheticPMDParams& p) { p.rigidBodyCount = options.pmd.rigidBodyCount; } },
+      { "joints", [&](SyntheticPMDParams& p) { p.jointCount = options.pmd.jointCount; } },
+    };
+
+    auto full = GenerateSyntheticPMD(options.pmd);
+    PrintHeader("PMD (loader::PMDFile, " + std::to_string(full.data.size()) + " bytes, median of " + std::to_string(options.iterations) + ")");
+    for (const auto& section : sections)
+    {
+      auto params = empty;
+      section.second(params);
+      auto file = GenerateSyntheticPMD(params);
+      auto path = workDir / "section.pmd";
+      WriteFile(path, file.data);
+      auto seconds = MeasureSeconds(options.iterations, [&]() { LoadPMD(path); }) - emptySeconds;
+
+      auto it = std::find_if(file.sections.begin(), file.sections.end(), [&](const auto& s) { return s.name == section.first; });
+      PrintRow(section.first, it->records, it->bytes, seconds);
+    }
+
+    // ファイル全体. 空ファイルとの差は取らない.
+    auto fullPath = workDir / "full.pmd";
+    WriteFile(fullPath, full.data);
+    uint64_t records = 0;
+    for (const auto& s : full.sections)
+    {
+      records += s.records;
+    }
+    PrintRow("total", records, full.data.size(), MeasureSeconds(options.iterations, [&]() { LoadPMD(fullPath); }));
+
+    // 同じモデルを変換済み形式で読み込んだ場合.
+    auto cookedPath = workDir / "full.pmdc";
+    WriteFile(cookedPath, loader::cookPMD(loader::PMDFile(std::make_shared<loader::MappedFile>(fullPath.string().c_str()))));
+    PrintRow("total (.pmdc)", records, fs::file_size(cookedPath), MeasureSeconds(options.iterations, [&]() { LoadCookedPMD(cookedPath); }));
+    std::cout << std::endl;
+  }
+
+  void BenchmarkVMD(const Options& options, const fs::path& workDir)
+  {
+    SyntheticVMDParams empty = options.vmd;
+    empty.boneKeyCount = empty.morphKeyCount = 0;
+
+    auto emptyPath = workDir / "empty.vmd";
+    WriteFile(emptyPath, GenerateSyntheticVMD(empty).data);
+    auto emptySeconds = MeasureSeconds(options.iterations, [&]() { LoadVMD(emptyPath); });
+
+    const std::pair<const char*, std::function<void(SyntheticVMDParams&)>> sections[] = {
+      { "bone keys", [&](SyntheticVMDParams& p) { p.boneKeyCount = options.vmd.boneKeyCount; } },
+      { "morph keys", [&](SyntheticVMDParams& p) { p.morphKeyCount = options.vmd.morphKeyCount; } },
+    };
+
+    auto full = GenerateSyntheticVMD(options.vmd);
+    PrintHeader(std::string("VMD (loader::VMDFile, ") + (options.vmd.shuffle ? "shuffled, " : "") +
+      std::to_string(full.data.size()) + " bytes, median of " + std::to_string(options.iterations) + ")");
+    for (const auto& section : sections)
+    {
+      auto params = empty;
+      section.second(params);
+      auto file = GenerateSyntheticVMD(params);
+      auto path = workDir / "section.vmd";
+      WriteFile(path, file.data);
+      auto seconds = MeasureSeconds(options.iterations, [&]() { LoadVMD(path); }) - emptySeconds;
+
+      auto it = std::find_if(file.sections.begin(), file.sections.end(), [&](const auto& s) { return s.name == section.first; });
+      PrintRow(section.first, it->records, it->bytes, seconds);
+    }
+
+    auto fullPath = workDir / "full.vmd";
+    WriteFile(fullPath, full.data);
+    PrintRow("total", uint64_t(options.vmd.boneKeyCount) + options.vmd.morphKeyCount, full.data.size(),
+      MeasureSeconds(options.iterations, [&]() { LoadVMD(fullPath); }));
+    std::cout << std::endl;
+  }
+
+  void BenchmarkFile(const Options& options)
+  {
+    fs::path path = options.path;
+    auto ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return char(tolower(c)); });
+
+    std::function<void()> load;
+    if (ext == ".pmd")
+    {
+      load = [&]() { LoadPMD(path); };
+    }
+    else if (ext == ".pmdc")
+    {
+      load = [&]() { LoadCookedPMD(path); };
+    }
+    else if (ext == ".vmd")
+    {
+      load = [&]() { LoadVMD(path); };
+    }
+    else
+    {
+      throw std::runtime_error("Unsupported file type " + path.string());
+    }
+
+    uint64_t records = 0;
+    if (ext == ".vmd")
+    {
+      std::ifstream infile(path, std::ios::binary);
+      loader::VMDFile vmd(infile);
+      records = uint64_t(vmd.getNodeKeyCount()) + vmd.getMorphKeyCount();
+    }
+    else if (ext == ".pmd")
+    {
+      loader::PMDFile pmd(std::make_shared<loader::MappedFile>(path.string().c_str()));
+      records = uint64_t(pmd.getVertexCount()) + pmd.getIndexCount() + pmd.getMaterialCount() + pmd.getBoneCount() +
+        pmd.getIkCount() + pmd.getFaceCount() + pmd.getRigidBodyCount() + pmd.getJointCount();
+    }
+
+    PrintHeader(path.string() + " (median of " + std::to_string(options.iterations) + ")");
+    PrintRow("total", records, fs::file_size(path), MeasureSeconds(options.iterations, load));
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    auto options = ParseOptions(argc, argv);
+    if (options.mode == "--generate-pmd")
+    {
+      WriteFile(options.path, GenerateSyntheticPMD(options.pmd).data);
+      std::cout << options.path << " (" << fs::file_size(options.path) << " bytes)" << std::endl;
+    }
+    else if (options.mode == "--generate-vmd")
+    {
+      WriteFile(options.path, GenerateSyntheticVMD(options.vmd).data);
+      std::cout << options.path << " (" << fs::file_size(options.path) << " bytes)" << std::endl;
+    }
+    else if (options.mode == "--file")
+    {
+      BenchmarkFile(options);
+    }
+    else
+    {
+      auto workDir = fs::temp_directory_path() / "LoaderBenchmark";
+      fs::create_directories(workDir);
+      BenchmarkPMD(options, workDir);
+      BenchmarkVMD(options, workDir);
+      fs::remove_all(workDir);
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
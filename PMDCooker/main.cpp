@@ -0,0 +1,59 @@
+﻿#include "loader/PMDloader.h"
+#include "loader/PMDCooked.h"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+// PMD を描画用に変換済みの .pmdc 形式へ書き出す.
+//   PMDCooker <input.pmd> [output.pmdc]
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "Usage: PMDCooker <input.pmd> [output.pmdc]" << std::endl;
+    return 1;
+  }
+  std::string inputFile = argv[1];
+  std::string outputFile = argc > 2 ? argv[2] : inputFile + "c";
+
+  try
+  {
+    auto mappedFile = std::make_shared<loader::MappedFile>(inputFile.c_str());
+    loader::PMDFile pmd(mappedFile);
+    auto blob = loader::cookPMD(pmd);
+
+    // 書き出す前に読み込めることを確認しておく.
+    loader::PMDCookedFile cooked{ std::vector<char>(blob) };
+
+    std::ofstream outfile(outputFile, std::ios::binary);
+    if (!outfile)
+    {
+      std::cerr << "Cannot open " << outputFile << std::endl;
+      return 1;
+    }
+    outfile.write(blob.data(), blob.size());
+    if (!outfile)
+    {
+      std::cerr << "Write failed " << outputFile << std::endl;
+      return 1;
+    }
+
+    std::cout << inputFile << " => " << outputFile << " (" << blob.size() << " bytes)" << std::endl;
+    std::cout << "  vertices : " << cooked.getVertexCount() << std::endl;
+    std::cout << "  indices  : " << cooked.getIndexCount() << std::endl;
+    std::cout << "  materials: " << cooked.getMaterialCount() << std::endl;
+    std::cout << "  bones    : " << cooked.getBoneCount() << std::endl;
+    std::cout << "  iks      : " << cooked.getIkCount() << std::endl;
+    std::cout << "  faces    : " << cooked.getFaceCount() << std::endl;
+    std::cout << "  rigids   : " << cooked.getRigidBodyCount() << std::endl;
+    std::cout << "  joints   : " << cooked.getJointCount() << std::endl;
+  }
+  catch (std::exception& e)
+  {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
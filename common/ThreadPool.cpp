@@ -0,0 +1,146 @@
+﻿#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+ThreadPool::ThreadPool(uint32_t threadCount) : m_isStopping(false)
+{
+  if (threadCount == 0)
+  {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  m_workers.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; ++i)
+  {
+    m_workers.emplace_back([this]() { WorkerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopping = true;
+  }
+  m_condition.notify_all();
+  for (auto& worker : m_workers)
+  {
+    worker.join();
+  }
+}
+
+void ThreadPool::WorkerLoop()
+{
+  for (;;)
+  {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [this]() { return m_isStopping || !m_tasks.empty(); });
+      // 停止要求があっても積まれているタスクは全て実行する.
+      if (m_tasks.empty())
+      {
+        return;
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    task();
+  }
+}
+
+void ThreadPool::Enqueue(std::function<void()> task)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.emplace_back(std::move(task));
+  }
+  m_condition.notify_one();
+}
+
+namespace
+{
+  // ParallelFor の状態. 遅れて始まったワーカーのタスクからも参照されるため共有で持つ.
+  struct ParallelForState
+  {
+    struct Range
+    {
+      std::atomic<uint32_t> next;
+      uint32_t end;
+    };
+
+    ParallelForState(uint32_t count, uint32_t rangeCount, const std::function<void(uint32_t)>& func)
+      : ranges(rangeCount), func(func), count(count), completed(0)
+    {
+      for (uint32_t i = 0; i < rangeCount; ++i)
+      {
+        ranges[i].next = uint32_t(uint64_t(count) * i / rangeCount);
+        ranges[i].end = uint32_t(uint64_t(count) * (i + 1) / rangeCount);
+      }
+    }
+
+    // 自分の区間から順に, 残っている項目を取り出して処理する.
+    // 取り出せる項目が無くなった後は func を参照しない.
+    void Run(uint32_t participant)
+    {
+      const auto rangeCount = uint32_t(ranges.size());
+      for (uint32_t r = 0; r < rangeCount; ++r)
+      {
+        auto& range = ranges[(participant + r) % rangeCount];
+        for (auto i = range.next.fetch_add(1); i < range.end; i = range.next.fetch_add(1))
+        {
+          try
+          {
+            func(i);
+          }
+          catch (...)
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+            {
+              error = std::current_exception();
+            }
+          }
+          if (completed.fetch_add(1) + 1 == count)
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            condition.notify_all();
+          }
+        }
+      }
+    }
+
+    std::vector<Range> ranges;
+    const std::function<void(uint32_t)>& func;
+    const uint32_t count;
+    std::atomic<uint32_t> completed;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::exception_ptr error;
+  };
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func)
+{
+  if (count == 0)
+  {
+    return;
+  }
+  const auto workerCount = std::min(uint32_t(m_workers.size()), count - 1);
+  auto state = std::make_shared<ParallelForState>(count, workerCount + 1, func);
+  for (uint32_t i = 0; i < workerCount; ++i)
+  {
+    Enqueue([state, i]() { state->Run(i); });
+  }
+  state->Run(workerCount);
+
+  {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->condition.wait(lock, [&]() { return state->completed == count; });
+  }
+  if (state->error)
+  {
+    std::rethrow_exception(state->error);
+  }
+}
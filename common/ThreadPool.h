@@ -0,0 +1,50 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+// 固定数のワーカースレッドでタスクを実行する.
+// Submit したタスクの結果は std::future で受け取る.
+class ThreadPool
+{
+public:
+  // threadCount が 0 の場合はハードウェアスレッド数.
+  explicit ThreadPool(uint32_t threadCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  template<class Func>
+  auto Submit(Func&& func) -> std::future<decltype(func())>
+  {
+    using Result = decltype(func());
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+    auto result = task->get_future();
+    Enqueue([task]() { (*task)(); });
+    return result;
+  }
+
+  // [0, count) の各 i について func(i) を並列に呼び, 全て終わるまで待つ. 呼び出したスレッドも処理に加わる.
+  // 範囲は参加するスレッドごとに連続した区間へ分けておき, 自分の区間を終えたスレッドは
+  // 他のスレッドの区間の残りを取って処理する. func が例外を投げた場合は最初のものを呼び出し元で再送出する.
+  // 呼び出し元は取り出された項目の完了のみを待つため, ワーカーのタスクから呼んでも止まらない.
+  void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func);
+
+  uint32_t GetThreadCount() const { return uint32_t(m_workers.size()); }
+private:
+  void WorkerLoop();
+  void Enqueue(std::function<void()> task);
+
+  std::vector<std::thread> m_workers;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_isStopping;
+};
@@ -357,6 +357,11 @@ void VulkanAppBase::FinishCommandBuffer(VkCommandBuffer command)
   vkDestroyFence(m_device, fence, nullptr);
 }
 
+void VulkanAppBase::FreeCommandBuffer(VkCommandBuffer command)
+{
+  vkFreeCommandBuffers(m_device, m_commandPool, 1, &command);
+}
+
 VkRect2D VulkanAppBase::GetSwapchainRenderArea() const
 {
   return VkRect2D{
@@ -402,6 +407,14 @@ void VulkanAppBase::FreeCommandBufferSecondary(uint32_t count, VkCommandBuffer*
 
 void VulkanAppBase::TransferStageBufferToImage(
   const BufferObject& srcBuffer, const ImageObject& dstImage, const VkBufferImageCopy* region)
+{
+  auto command = CreateCommandBuffer();
+  RecordStageBufferToImage(command, srcBuffer, dstImage, region);
+  FinishCommandBuffer(command);
+}
+
+void VulkanAppBase::RecordStageBufferToImage(VkCommandBuffer command,
+  const BufferObject& srcBuffer, const ImageObject& dstImage, const VkBufferImageCopy* region)
 { 
   VkImageMemoryBarrier imb{
     VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr,
@@ -413,7 +426,6 @@ void VulkanAppBase::TransferStageBufferToImage(
   };
 
   // Staging ].
-  auto command = CreateCommandBuffer();
   vkCmdPipelineBarrier(command,
     VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
     0, 0, nullptr,
@@ -432,7 +444,6 @@ void VulkanAppBase::TransferStageBufferToImage(
     0, 0, nullptr,
     0, nullptr,
     1, &imb);
-  FinishCommandBuffer(command);
 }
 
 void VulkanAppBase::CreateInstance()
@@ -546,6 +557,7 @@ void VulkanAppBase::CreateDescriptorPool()
   VkDescriptorPoolSize poolSize[] = {
     { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000 },
     { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000 },
   };
   VkDescriptorPoolCreateInfo descPoolCI{
     VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
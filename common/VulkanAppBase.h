@@ -98,6 +98,8 @@ public:
 
   VkCommandBuffer CreateCommandBuffer();
   void FinishCommandBuffer(VkCommandBuffer command);
+  // CreateCommandBuffer ō쐬R}hobt@.
+  void FreeCommandBuffer(VkCommandBuffer command);
 
   VkRect2D GetSwapchainRenderArea() const;
 
@@ -112,6 +114,8 @@ public:
   void FreeCommandBufferSecondary(uint32_t count, VkCommandBuffer* pCommands);
 
   void TransferStageBufferToImage(const BufferObject& srcBuffer, const ImageObject& dstImage, const VkBufferImageCopy* region);
+  // ]R}h̋L^̂ݍs. ̓] 1 ̃Tu~bgɂ܂Ƃ߂ꍇɎgp.
+  void RecordStageBufferToImage(VkCommandBuffer command, const BufferObject& srcBuffer, const ImageObject& dstImage, const VkBufferImageCopy* region);
 private:
   void CreateInstance();
   void SelectGraphicsQueue();
@@ -0,0 +1,112 @@
+﻿#include "MappedFile.h"
+
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace loader
+{
+#if defined(_WIN32)
+  MappedFile::MappedFile(const char* fileName) : m_data(nullptr), m_size(0), m_fileHandle(nullptr), m_mappingHandle(nullptr)
+  {
+    auto file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+      throw std::runtime_error(std::string("MappedFile: cannot open ") + fileName);
+    }
+    m_fileHandle = file;
+
+    LARGE_INTEGER fileSize{};
+    GetFileSizeEx(file, &fileSize);
+    m_size = size_t(fileSize.QuadPart);
+    if (m_size == 0)
+    {
+      close();
+      throw std::runtime_error(std::string("MappedFile: empty file ") + fileName);
+    }
+
+    m_mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mappingHandle == nullptr)
+    {
+      close();
+      throw std::runtime_error(std::string("MappedFile: CreateFileMapping failed ") + fileName);
+    }
+    m_data = static_cast<const char*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (m_data == nullptr)
+    {
+      close();
+      throw std::runtime_error(std::string("MappedFile: MapViewOfFile failed ") + fileName);
+    }
+  }
+
+  void MappedFile::close()
+  {
+    if (m_data)
+    {
+      UnmapViewOfFile(m_data);
+    }
+    if (m_mappingHandle)
+    {
+      CloseHandle(m_mappingHandle);
+    }
+    if (m_fileHandle)
+    {
+      CloseHandle(m_fileHandle);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_mappingHandle = nullptr;
+    m_fileHandle = nullptr;
+  }
+#else
+  MappedFile::MappedFile(const char* fileName) : m_data(nullptr), m_size(0), m_fileHandle(nullptr), m_mappingHandle(nullptr)
+  {
+    int fd = ::open(fileName, O_RDONLY);
+    if (fd < 0)
+    {
+      throw std::runtime_error(std::string("MappedFile: cannot open ") + fileName);
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+      ::close(fd);
+      throw std::runtime_error(std::string("MappedFile: empty file ") + fileName);
+    }
+    auto ptr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED)
+    {
+      throw std::runtime_error(std::string("MappedFile: mmap failed ") + fileName);
+    }
+    // 先頭から順に一度だけ読むため先読みを促す.
+    madvise(ptr, size_t(st.st_size), MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(ptr);
+    m_size = size_t(st.st_size);
+  }
+
+  void MappedFile::close()
+  {
+    if (m_data)
+    {
+      munmap(const_cast<char*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+  }
+#endif
+
+  MappedFile::~MappedFile()
+  {
+    close();
+  }
+}
@@ -0,0 +1,30 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace loader
+{
+    // ファイルを読み込み専用でメモリマップする.
+    // マップした領域はこのオブジェクトが破棄されるまで有効.
+    class MappedFile
+    {
+    public:
+        MappedFile() : m_data(nullptr), m_size(0), m_fileHandle(nullptr), m_mappingHandle(nullptr) { }
+        explicit MappedFile(const char* fileName);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+        bool isOpen() const { return m_data != nullptr; }
+    private:
+        void close();
+
+        const char* m_data;
+        size_t  m_size;
+        void*   m_fileHandle;
+        void*   m_mappingHandle;
+    };
+}
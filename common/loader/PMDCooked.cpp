@@ -0,0 +1,343 @@
+﻿#include "PMDCooked.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace loader
+{
+  namespace cooked
+  {
+    std::string_view getName(const char(&name)[20])
+    {
+      auto end = static_cast<const char*>(memchr(name, '\0', sizeof(name)));
+      return std::string_view(name, end ? size_t(end - name) : sizeof(name));
+    }
+
+    template<size_t N>
+    void setName(char(&dst)[N], std::string_view src)
+    {
+      memset(dst, 0, N);
+      memcpy(dst, src.data(), std::min(src.size(), N));
+    }
+
+    // セクションを 16 byte 境界に揃えて書き込む.
+    class BlobWriter
+    {
+    public:
+      BlobWriter() : m_blob(sizeof(Header)), m_header{}
+      {
+        memcpy(m_header.magic, "PMDC", 4);
+        m_header.version = Version;
+        m_header.byteOrder = ByteOrderMark;
+        m_header.sectionCount = SECTION_COUNT;
+      }
+
+      template<class T>
+      void write(SectionId id, const T* data, size_t count)
+      {
+        auto offset = (m_blob.size() + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+        auto size = count * sizeof(T);
+        m_blob.resize(offset + size);
+        if (size > 0)
+        {
+          memcpy(m_blob.data() + offset, data, size);
+        }
+        auto& section = m_header.sections[id];
+        section.offset = uint32_t(offset);
+        section.size = uint32_t(size);
+        section.count = uint32_t(count);
+      }
+      template<class T>
+      void write(SectionId id, const std::vector<T>& data) { write(id, data.data(), data.size()); }
+
+      std::vector<char> finish()
+      {
+        memcpy(m_blob.data(), &m_header, sizeof(m_header));
+        return std::move(m_blob);
+      }
+    private:
+      std::vector<char> m_blob;
+      Header m_header;
+    };
+  }
+
+  std::vector<char> cookPMD(const PMDFile& pmd)
+  {
+    cooked::BlobWriter writer;
+
+    // 頂点・インデックスはローダーで描画用に展開済み.
+    writer.write(cooked::SECTION_VERTICES, pmd.getVertex(), pmd.getVertexCount());
+    writer.write(cooked::SECTION_INDICES, pmd.getIndices(), pmd.getIndexCount());
+
+    // マテリアル.
+    std::vector<cooked::Material> materials(pmd.getMaterialCount());
+    uint32_t indexOffset = 0;
+    for (uint32_t i = 0; i < pmd.getMaterialCount(); ++i)
+    {
+      const auto& src = pmd.getMaterial(i);
+      auto& dst = materials[i];
+      dst.diffuse = glm::vec4(src.getDiffuse(), src.getAlpha());
+      dst.ambient = glm::vec4(src.getAmbient(), 0.0f);
+      dst.specular = glm::vec4(src.getSpecular(), src.getShininess());
+      dst.edgeFlag = src.getEdgeFlag();
+      dst.indexOffset = indexOffset;
+      dst.indexCount = src.getNumberOfPolygons();
+      indexOffset += dst.indexCount;
+
+      auto textureFileName = src.getTexture();
+      auto hasSphereMap = textureFileName.find('*');
+      if (hasSphereMap != std::string_view::npos)
+      {
+        textureFileName = textureFileName.substr(0, hasSphereMap);
+      }
+      cooked::setName(dst.texture, textureFileName);
+    }
+    writer.write(cooked::SECTION_MATERIALS, materials);
+
+    // ボーン. 親からの相対位置とバインド逆行列をここで求めておく.
+    std::vector<cooked::Bone> bones(pmd.getBoneCount());
+    for (uint32_t i = 0; i < pmd.getBoneCount(); ++i)
+    {
+      const auto& src = pmd.getBone(i);
+      auto& dst = bones[i];
+      auto translation = src.getPosition();
+      dst.parent = -1;
+      if (src.getParent() != 0xFFFFu)
+      {
+        dst.parent = src.getParent();
+        translation = translation - pmd.getBone(src.getParent()).getPosition();
+      }
+      dst.translation = translation;
+      dst.invBind = glm::inverse(glm::translate(glm::mat4(1.0f), src.getPosition()));
+      cooked::setName(dst.name, src.getName());
+    }
+    writer.write(cooked::SECTION_BONES, bones);
+
+    // IK.
+    std::vector<cooked::Ik> iks(pmd.getIkCount());
+    std::vector<uint32_t> ikChains;
+    for (uint32_t i = 0; i < pmd.getIkCount(); ++i)
+    {
+      const auto& src = pmd.getIk(i);
+      auto& dst = iks[i];
+      dst.target = src.getTargetBoneId();
+      dst.effector = src.getBoneEff();
+      dst.iterations = src.getIterations();
+      dst.angleLimit = src.getAngleLimit();
+      auto chains = src.getChains();
+      dst.chainOffset = uint32_t(ikChains.size());
+      dst.chainCount = uint32_t(chains.size());
+      ikChains.insert(ikChains.end(), chains.begin(), chains.end());
+    }
+    writer.write(cooked::SECTION_IKS, iks);
+    writer.write(cooked::SECTION_IK_CHAINS, ikChains);
+
+    // 表情モーフ. 0 番目はベース表情.
+    std::vector<cooked::Face> faces;
+    std::vector<uint32_t> faceIndices;
+    std::vector<glm::vec3> faceOffsets;
+    if (pmd.getFaceCount() > 0)
+    {
+      const auto& baseFace = pmd.getFaceBase();
+      writer.write(cooked::SECTION_FACE_BASE_INDICES, baseFace.getFaceIndices(), baseFace.getIndexCount());
+      writer.write(cooked::SECTION_FACE_BASE_VERTICES, baseFace.getFaceVertices(), baseFace.getVertexCount());
+
+      faces.resize(pmd.getFaceCount() - 1);
+      for (uint32_t i = 0; i < uint32_t(faces.size()); ++i)
+      {
+        const auto& src = pmd.getFace(i + 1);
+        auto& dst = faces[i];
+        cooked::setName(dst.name, src.getName());
+        dst.offset = uint32_t(faceIndices.size());
+        dst.count = src.getIndexCount();
+        faceIndices.insert(faceIndices.end(), src.getFaceIndices(), src.getFaceIndices() + src.getIndexCount());
+        faceOffsets.insert(faceOffsets.end(), src.getFaceVertices(), src.getFaceVertices() + src.getVertexCount());
+      }
+    }
+    else
+    {
+      writer.write(cooked::SECTION_FACE_BASE_INDICES, faceIndices);
+      writer.write(cooked::SECTION_FACE_BASE_VERTICES, faceOffsets);
+    }
+    writer.write(cooked::SECTION_FACES, faces);
+    writer.write(cooked::SECTION_FACE_INDICES, faceIndices);
+    writer.write(cooked::SECTION_FACE_OFFSETS, faceOffsets);
+
+    // 剛体. 位置は関連ボーンからの相対位置をモデル空間へ直しておく.
+    // 関連ボーンが無い剛体は 0 番目のボーン(センター)に従うものとする.
+    std::vector<cooked::RigidBody> rigidBodies(pmd.getRigidBodyCount());
+    for (uint32_t i = 0; i < pmd.getRigidBodyCount(); ++i)
+    {
+      const auto& src = pmd.getRigidBody(i);
+      auto& dst = rigidBodies[i];
+      dst.bone = src.getBoneId() < pmd.getBoneCount() ? int32_t(src.getBoneId()) : (pmd.getBoneCount() > 0 ? 0 : -1);
+      dst.position = src.getPosition() + (dst.bone >= 0 ? pmd.getBone(dst.bone).getPosition() : glm::vec3(0.0f));
+      dst.rotation = src.getRotation();
+      dst.size = src.getShapeSize();
+      dst.mass = src.getMass();
+      dst.linearDamping = src.getLinearDamping();
+      dst.angularDamping = src.getAngularDamping();
+      dst.restitution = src.getRestitution();
+      dst.friction = src.getFriction();
+      dst.shape = src.getShapeType();
+      dst.type = src.getBodyType();
+      dst.group = src.getGroupId();
+      dst.groupMask = src.getGroupMask();
+      cooked::setName(dst.name, src.getName());
+    }
+    writer.write(cooked::SECTION_RIGID_BODIES, rigidBodies);
+
+    // ジョイント. 剛体の番号が範囲外のものは除く.
+    std::vector<cooked::Joint> joints;
+    for (uint32_t i = 0; i < pmd.getJointCount(); ++i)
+    {
+      const auto& src = pmd.getJoint(i);
+      if (src.getRigidBodyA() >= pmd.getRigidBodyCount() || src.getRigidBodyB() >= pmd.getRigidBodyCount() ||
+        src.getRigidBodyA() == src.getRigidBodyB())
+      {
+        continue;
+      }
+      cooked::Joint dst{};
+      dst.position = src.getPosition();
+      dst.rotation = src.getRotation();
+      dst.linearLower = src.getLinearLower();
+      dst.linearUpper = src.getLinearUpper();
+      dst.angularLower = src.getAngularLower();
+      dst.angularUpper = src.getAngularUpper();
+      dst.linearSpring = src.getLinearSpring();
+      dst.angularSpring = src.getAngularSpring();
+      dst.bodies[0] = src.getRigidBodyA();
+      dst.bodies[1] = src.getRigidBodyB();
+      cooked::setName(dst.name, src.getName());
+      joints.push_back(dst);
+    }
+    writer.write(cooked::SECTION_JOINTS, joints);
+
+    return writer.finish();
+  }
+
+  PMDCookedFile::PMDCookedFile(std::shared_ptr<const MappedFile> file)
+  {
+    m_storage = file;
+    m_data = file->data();
+    m_size = file->size();
+    validate();
+  }
+
+  PMDCookedFile::PMDCookedFile(std::vector<char>&& blob)
+  {
+    auto storage = std::make_shared<std::vector<char>>(std::move(blob));
+    m_storage = storage;
+    m_data = storage->data();
+    m_size = storage->size();
+    validate();
+  }
+
+  void PMDCookedFile::validate()
+  {
+    m_header = reinterpret_cast<const cooked::Header*>(m_data);
+    if (m_size < sizeof(cooked::Header) || memcmp(m_header->magic, "PMDC", 4) != 0)
+    {
+      throw std::runtime_error("PMDCookedFile: invalid file.");
+    }
+    if (m_header->version != cooked::Version || m_header->byteOrder != cooked::ByteOrderMark || m_header->sectionCount != cooked::SECTION_COUNT)
+    {
+      throw std::runtime_error("PMDCookedFile: unsupported version. Re-cook the model.");
+    }
+    const uint32_t recordSizes[cooked::SECTION_COUNT] = {
+      sizeof(PMDVertex), sizeof(uint32_t), sizeof(cooked::Material), sizeof(cooked::Bone),
+      sizeof(cooked::Ik), sizeof(uint32_t), sizeof(uint32_t), sizeof(glm::vec3),
+      sizeof(cooked::Face), sizeof(uint32_t), sizeof(glm::vec3), sizeof(cooked::RigidBody),
+      sizeof(cooked::Joint),
+    };
+    for (uint32_t i = 0; i < cooked::SECTION_COUNT; ++i)
+    {
+      const auto& section = m_header->sections[i];
+      if (section.offset % cooked::SectionAlignment != 0 || uint64_t(section.offset) + section.size > m_size ||
+        uint64_t(section.count) * recordSizes[i] != section.size)
+      {
+        throw std::runtime_error("PMDCookedFile: broken section.");
+      }
+    }
+    // 対になるセクションは要素数が一致している必要がある.
+    if (m_header->sections[cooked::SECTION_FACE_BASE_INDICES].count != m_header->sections[cooked::SECTION_FACE_BASE_VERTICES].count ||
+      m_header->sections[cooked::SECTION_FACE_INDICES].count != m_header->sections[cooked::SECTION_FACE_OFFSETS].count)
+    {
+      throw std::runtime_error("PMDCookedFile: broken section.");
+    }
+
+    // 他のセクションを指す番号. 読み込み側はこれらを確認せずに配列の添字として使う.
+    auto check = [](bool valid, const char* name) {
+      if (!valid)
+      {
+        throw std::runtime_error(std::string("PMDCookedFile: ") + name + " out of range.");
+      }
+    };
+    const auto vertexCount = count(cooked::SECTION_VERTICES);
+    const auto indexCount = count(cooked::SECTION_INDICES);
+    const auto boneCount = count(cooked::SECTION_BONES);
+    auto vertices = section<PMDVertex>(cooked::SECTION_VERTICES);
+    for (uint32_t i = 0; i < vertexCount; ++i)
+    {
+      check(vertices[i].getBoneIndex(0) < boneCount && vertices[i].getBoneIndex(1) < boneCount, "vertex bone index");
+    }
+    auto indices = section<uint32_t>(cooked::SECTION_INDICES);
+    for (uint32_t i = 0; i < indexCount; ++i)
+    {
+      check(indices[i] < vertexCount, "vertex index");
+    }
+    for (uint32_t i = 0; i < getMaterialCount(); ++i)
+    {
+      const auto& material = getMaterial(i);
+      check(uint64_t(material.indexOffset) + material.indexCount <= indexCount, "material indices");
+    }
+    for (uint32_t i = 0; i < boneCount; ++i)
+    {
+      auto parent = getBone(i).parent;
+      check(parent == -1 || (parent >= 0 && uint32_t(parent) < boneCount), "bone parent");
+    }
+    const auto chainCount = count(cooked::SECTION_IK_CHAINS);
+    for (uint32_t i = 0; i < getIkCount(); ++i)
+    {
+      const auto& ik = getIk(i);
+      check(ik.target < boneCount && ik.effector < boneCount, "IK bone");
+      check(uint64_t(ik.chainOffset) + ik.chainCount <= chainCount, "IK chain");
+      auto chains = getIkChains(ik);
+      for (uint32_t j = 0; j < ik.chainCount; ++j)
+      {
+        check(chains[j] < boneCount, "IK chain bone");
+      }
+    }
+    const auto faceBaseCount = getFaceBaseCount();
+    auto faceBaseIndices = getFaceBaseIndices();
+    for (uint32_t i = 0; i < faceBaseCount; ++i)
+    {
+      check(faceBaseIndices[i] < vertexCount, "face base vertex index");
+    }
+    const auto faceIndexCount = count(cooked::SECTION_FACE_INDICES);
+    for (uint32_t i = 0; i < getFaceCount(); ++i)
+    {
+      const auto& face = getFace(i);
+      check(uint64_t(face.offset) + face.count <= faceIndexCount, "face indices");
+      auto faceIndices = getFaceIndices(face);
+      for (uint32_t j = 0; j < face.count; ++j)
+      {
+        check(faceIndices[j] < faceBaseCount, "face index");
+      }
+    }
+    const auto rigidBodyCount = getRigidBodyCount();
+    for (uint32_t i = 0; i < rigidBodyCount; ++i)
+    {
+      auto bone = getRigidBody(i).bone;
+      check(bone == -1 || (bone >= 0 && uint32_t(bone) < boneCount), "rigid body bone");
+    }
+    for (uint32_t i = 0; i < getJointCount(); ++i)
+    {
+      const auto& joint = getJoint(i);
+      check(joint.bodies[0] < rigidBodyCount && joint.bodies[1] < rigidBodyCount, "joint rigid body");
+    }
+  }
+}
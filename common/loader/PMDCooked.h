@@ -0,0 +1,187 @@
+﻿#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <string_view>
+
+#include <glm/glm.hpp>
+
+#include "PMDloader.h"
+
+namespace loader
+{
+    // 変換済みモデル形式 (.pmdc).
+    // PMD を描画用に変換した結果(頂点/インデックスバッファ, ボーン, IK, 表情モーフ, マテリアル, 剛体, ジョイント)を
+    // そのままの形で格納する. リトルエンディアン固定で, 各セクションは 16 byte 境界に配置する.
+    // 読み込み側は各セクションを直接参照してステージングバッファへ書き込める.
+    namespace cooked
+    {
+        const uint32_t Version = 2;
+        const uint32_t ByteOrderMark = 0x01020304u;
+        const uint32_t SectionAlignment = 16;
+
+        enum SectionId
+        {
+            SECTION_VERTICES = 0,   /**< loader::PMDVertex (描画用レイアウト) */
+            SECTION_INDICES,        /**< uint32_t */
+            SECTION_MATERIALS,      /**< Material */
+            SECTION_BONES,          /**< Bone */
+            SECTION_IKS,            /**< Ik */
+            SECTION_IK_CHAINS,      /**< uint32_t (各 IK の chainOffset から参照) */
+            SECTION_FACE_BASE_INDICES,  /**< uint32_t */
+            SECTION_FACE_BASE_VERTICES, /**< vec3 */
+            SECTION_FACES,          /**< Face (ベース表情を除く) */
+            SECTION_FACE_INDICES,   /**< uint32_t (各 Face の offset から参照) */
+            SECTION_FACE_OFFSETS,   /**< vec3 */
+            SECTION_RIGID_BODIES,   /**< RigidBody */
+            SECTION_JOINTS,         /**< Joint */
+            SECTION_COUNT,
+        };
+
+        struct Section
+        {
+            uint32_t offset;
+            uint32_t size;
+            uint32_t count;
+            uint32_t reserved;
+        };
+        struct Header
+        {
+            char     magic[4];      /**< "PMDC" */
+            uint32_t version;
+            uint32_t byteOrder;     /**< ByteOrderMark */
+            uint32_t sectionCount;
+            Section  sections[SECTION_COUNT];
+        };
+        struct Material
+        {
+            glm::vec4 diffuse;      /**< rgb + alpha */
+            glm::vec4 ambient;
+            glm::vec4 specular;     /**< rgb + shininess */
+            uint32_t  edgeFlag;
+            uint32_t  indexOffset;
+            uint32_t  indexCount;
+            char      texture[20];  /**< スフィアマップ指定を除いたテクスチャファイル名 */
+        };
+        struct Bone
+        {
+            glm::mat4 invBind;
+            glm::vec3 translation;  /**< 親ボーンからの相対位置 */
+            int32_t   parent;       /**< 親が無い場合は -1 */
+            char      name[20];
+            uint32_t  reserved[3];
+        };
+        struct Ik
+        {
+            uint32_t target;
+            uint32_t effector;
+            uint32_t iterations;
+            float    angleLimit;
+            uint32_t chainOffset;
+            uint32_t chainCount;
+        };
+        struct Face
+        {
+            char     name[20];
+            uint32_t offset;
+            uint32_t count;
+        };
+        // 回転はいずれもオイラー角(ラジアン)で, X, Y, Z 軸の順に適用する.
+        struct RigidBody
+        {
+            glm::vec3 position;     /**< 初期姿勢でのモデル空間の位置 */
+            glm::vec3 rotation;     /**< 初期姿勢でのモデル空間の回転 */
+            glm::vec3 size;         /**< loader::PMDRigidParam::getShapeSize */
+            int32_t   bone;         /**< 関連ボーン. 無い場合は -1 */
+            float     mass;
+            float     linearDamping;
+            float     angularDamping;
+            float     restitution;
+            float     friction;
+            uint32_t  shape;        /**< loader::PMDRigidParam::ShapeType */
+            uint32_t  type;         /**< loader::PMDRigidParam::RigidBodyType */
+            uint32_t  group;
+            uint32_t  groupMask;    /**< 衝突するグループのビット */
+            char      name[20];
+        };
+        struct Joint
+        {
+            glm::vec3 position;     /**< モデル空間の位置 */
+            glm::vec3 rotation;     /**< モデル空間の回転 */
+            glm::vec3 linearLower;  /**< ジョイント空間での範囲 */
+            glm::vec3 linearUpper;
+            glm::vec3 angularLower;
+            glm::vec3 angularUpper;
+            glm::vec3 linearSpring;
+            glm::vec3 angularSpring;
+            uint32_t  bodies[2];    /**< 剛体の番号 */
+            char      name[20];
+            uint32_t  reserved;
+        };
+        static_assert(sizeof(Header) == 16 + 16 * SECTION_COUNT, "cooked::Header layout mismatch.");
+        static_assert(sizeof(Material) == 80, "cooked::Material layout mismatch.");
+        static_assert(sizeof(Bone) == 112, "cooked::Bone layout mismatch.");
+        static_assert(sizeof(Ik) == 24, "cooked::Ik layout mismatch.");
+        static_assert(sizeof(Face) == 28, "cooked::Face layout mismatch.");
+        static_assert(sizeof(RigidBody) == 96, "cooked::RigidBody layout mismatch.");
+        static_assert(sizeof(Joint) == 128, "cooked::Joint layout mismatch.");
+
+        // 固定長の名前フィールドを参照する.
+        std::string_view getName(const char(&name)[20]);
+    }
+
+    // PMD から変換済みモデルのバイト列を生成する.
+    std::vector<char> cookPMD(const PMDFile& pmd);
+
+    // 変換済みモデルの読み込み. 各セクションは元のバイト列を直接参照する.
+    class PMDCookedFile
+    {
+    public:
+        PMDCookedFile() : m_data(nullptr), m_size(0), m_header(nullptr) { }
+        explicit PMDCookedFile(std::shared_ptr<const MappedFile> file);
+        explicit PMDCookedFile(std::vector<char>&& blob);
+
+        uint32_t getVertexCount() const { return count(cooked::SECTION_VERTICES); }
+        const void* getVertexData() const { return section(cooked::SECTION_VERTICES); }
+        uint32_t getVertexDataSize() const { return m_header->sections[cooked::SECTION_VERTICES].size; }
+
+        uint32_t getIndexCount() const { return count(cooked::SECTION_INDICES); }
+        const uint32_t* getIndices() const { return section<uint32_t>(cooked::SECTION_INDICES); }
+
+        uint32_t getMaterialCount() const { return count(cooked::SECTION_MATERIALS); }
+        const cooked::Material& getMaterial(int idx) const { return section<cooked::Material>(cooked::SECTION_MATERIALS)[idx]; }
+
+        uint32_t getBoneCount() const { return count(cooked::SECTION_BONES); }
+        const cooked::Bone& getBone(int idx) const { return section<cooked::Bone>(cooked::SECTION_BONES)[idx]; }
+
+        uint32_t getIkCount() const { return count(cooked::SECTION_IKS); }
+        const cooked::Ik& getIk(int idx) const { return section<cooked::Ik>(cooked::SECTION_IKS)[idx]; }
+        const uint32_t* getIkChains(const cooked::Ik& ik) const { return section<uint32_t>(cooked::SECTION_IK_CHAINS) + ik.chainOffset; }
+
+        uint32_t getFaceBaseCount() const { return count(cooked::SECTION_FACE_BASE_INDICES); }
+        const uint32_t* getFaceBaseIndices() const { return section<uint32_t>(cooked::SECTION_FACE_BASE_INDICES); }
+        const glm::vec3* getFaceBaseVertices() const { return section<glm::vec3>(cooked::SECTION_FACE_BASE_VERTICES); }
+
+        uint32_t getFaceCount() const { return count(cooked::SECTION_FACES); }
+        const cooked::Face& getFace(int idx) const { return section<cooked::Face>(cooked::SECTION_FACES)[idx]; }
+        const uint32_t* getFaceIndices(const cooked::Face& face) const { return section<uint32_t>(cooked::SECTION_FACE_INDICES) + face.offset; }
+        const glm::vec3* getFaceOffsets(const cooked::Face& face) const { return section<glm::vec3>(cooked::SECTION_FACE_OFFSETS) + face.offset; }
+
+        uint32_t getRigidBodyCount() const { return count(cooked::SECTION_RIGID_BODIES); }
+        const cooked::RigidBody& getRigidBody(int idx) const { return section<cooked::RigidBody>(cooked::SECTION_RIGID_BODIES)[idx]; }
+        uint32_t getJointCount() const { return count(cooked::SECTION_JOINTS); }
+        const cooked::Joint& getJoint(int idx) const { return section<cooked::Joint>(cooked::SECTION_JOINTS)[idx]; }
+
+    private:
+        void validate();
+        uint32_t count(cooked::SectionId id) const { return m_header->sections[id].count; }
+        const char* section(cooked::SectionId id) const { return m_data + m_header->sections[id].offset; }
+        template<class T>
+        const T* section(cooked::SectionId id) const { return reinterpret_cast<const T*>(section(id)); }
+
+        std::shared_ptr<const void> m_storage;
+        const char* m_data;
+        size_t  m_size;
+        const cooked::Header* m_header;
+    };
+}
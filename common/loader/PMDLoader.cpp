@@ -1,6 +1,10 @@
 #include "PMDloader.h"
 
-#include <pshpack1.h>
+#include <cstring>
+#include <cstddef>
+#include <stdexcept>
+
+#pragma pack(push, 1)
 namespace loader
 {
   namespace rawblock
@@ -47,10 +51,117 @@ namespace loader
       float       angleLimit;   /**< ] */
     };
 
+    struct PMDFaceHeader {
+      char name[20];
+      uint32_t numVertices;
+      uint8_t faceType;
+    };
+    struct PMDFaceVertex {
+      uint32_t index;
+      vec3 position;
+    };
+    struct PMDRigidBody {
+      char name[20];
+      uint16_t boneId;
+      uint8_t groupId;
+      uint16_t groupMask;
+      uint8_t shapeType;
+      float shapeW, shapeH, shapeD;
+      vec3 position;
+      vec3 rotation;
+      float weight;
+      float attenuationPos;
+      float attenuationRot;
+      float recoil;
+      float friction;
+      uint8_t bodyType;
+    };
+    struct PMDJoint {
+      char name[20];
+      uint32_t targetRigidBodies[2];
+      vec3 position;
+      vec3 rotation;
+      vec3 constraintPos[2];
+      vec3 constraintRot[2];
+      vec3 springPos;
+      vec3 springRot;
+    };
+    static_assert(sizeof(PMDVertex) == 38, "PMDVertex must be packed.");
+    static_assert(sizeof(PMDMaterial) == 70, "PMDMaterial must be packed.");
+    static_assert(sizeof(PMDBone) == 39, "PMDBone must be packed.");
+    static_assert(sizeof(PMDIk) == 11, "PMDIk must be packed.");
+    static_assert(sizeof(PMDFaceHeader) == 25, "PMDFaceHeader must be packed.");
+    static_assert(sizeof(PMDRigidBody) == 83, "PMDRigidBody must be packed.");
+    static_assert(sizeof(PMDJoint) == 124, "PMDJoint must be packed.");
+
     struct VMDHeader {
       unsigned char magic[30];
       char modelName[20];
     };
+    struct VMDMotion {
+      char name[15];
+      uint32_t frame;
+      vec3 location;
+      vec4 rotation;
+      uint8_t interpolation[64];
+    };
+    struct VMDMorph {
+      char name[15];
+      uint32_t frame;
+      float weight;
+    };
+    static_assert(sizeof(VMDMotion) == 111, "VMDMotion must be packed.");
+    static_assert(sizeof(VMDMorph) == 23, "VMDMorph must be packed.");
+
+    // ̃oCg擪ǂݐi߂.
+    // ͈͊O̓ǂݏo͗OƂ.
+    class BlockReader
+    {
+    public:
+      BlockReader(const char* data, size_t size) : m_cur(data), m_end(data + size) { }
+
+      const char* take(size_t bytes)
+      {
+        if (size_t(m_end - m_cur) < bytes)
+        {
+          throw std::runtime_error("PMDFile: unexpected end of data.");
+        }
+        auto p = m_cur;
+        m_cur += bytes;
+        return p;
+      }
+      void skip(size_t bytes) { take(bytes); }
+      bool isEnd() const { return m_cur == m_end; }
+
+      template<class T> T read()
+      {
+        T v;
+        memcpy(&v, take(sizeof(T)), sizeof(T));
+        return v;
+      }
+      // \̂ƂĎo, f[^̐擪ʒuԂ.
+      template<class T> const char* readRecord(T& dst)
+      {
+        auto p = take(sizeof(T));
+        memcpy(&dst, p, sizeof(T));
+        return p;
+      }
+      template<class T> void readArray(T* dst, size_t count)
+      {
+        auto bytes = count * sizeof(T);
+        memcpy(dst, take(bytes), bytes);
+      }
+    private:
+      const char* m_cur;
+      const char* m_end;
+    };
+
+    // Œ蒷̖OtB[hQƂ. I[ꍇ̓tB[h܂.
+    std::string_view toName(const char* p, size_t length)
+    {
+      auto end = static_cast<const char*>(memchr(p, '\0', length));
+      return std::string_view(p, end ? size_t(end - p) : length);
+    }
 
 
     float readFloat(std::istream& is)
@@ -79,13 +190,274 @@ namespace loader
 #ifndef USE_LEFTHAND
     vec3 flipToRH(vec3 v) { v.z *= -1.0f; return v; }
     vec4 flipToRH(vec4 v) { v.z *= -1.0f; v.w *= -1.0f; return v; }
+    // IC[p. Z 𔽓] X, Y ̉]tɂȂ.
+    vec3 flipRotationToRH(vec3 v) { v.x *= -1.0f; v.y *= -1.0f; return v; }
+    // ͈ [lower, upper] ͔]鐬̏㉺ւ.
+    void flipRangeToRH(vec3& lower, vec3& upper, const vec3& flip)
+    {
+      auto l = lower, u = upper;
+      for (int i = 0; i < 3; ++i)
+      {
+        if (flip[i] < 0.0f)
+        {
+          lower[i] = -u[i];
+          upper[i] = -l[i];
+        }
+      }
+    }
 #else
     vec3 flipToRH(vec3 v) { return v; }
     vec4 flipToRH(vec4 v) { return v; }
+    vec3 flipRotationToRH(vec3 v) { return v; }
+    void flipRangeToRH(vec3&, vec3&, const vec3&) { }
 #endif
   }
 }
-#include <poppack.h>
+#pragma pack(pop)
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PMD_DECODE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PMD_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define PMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace loader
+{
+  // _ECfbNXubN̈ꊇϊ.
+  // Enւ̕ϊ(Z], ւ)ƃ{[EFCg̐K
+  // `pCAEg֏oȂ 1 pXōs.
+  namespace decode
+  {
+    // o͐ loader::PMDVertex ̃ItZbg.
+    enum {
+      OutFloats = 0,        // position, normal, uv
+      OutBoneIndices = 32,
+      OutBoneWeights = 40,
+      OutEdgeFlag = 48,
+      OutStride = 52,
+      InFloats = 0,
+      InBoneIndices = 32,
+      InBoneWeight = 36,
+      InEdgeFlag = 37,
+      InStride = 38,
+    };
+
+    // position.z, normal.z ̕𔽓]邽߂̃}XN.
+#ifndef USE_LEFTHAND
+    const uint32_t FlipZ = 0x80000000u;
+#else
+    const uint32_t FlipZ = 0;
+#endif
+
+    inline void decodeVertexTail(const char* src, char* dst)
+    {
+      uint16_t bone[2];
+      memcpy(bone, src + InBoneIndices, sizeof(bone));
+      uint32_t boneIndices[2] = { bone[0], bone[1] };
+      auto w = uint8_t(src[InBoneWeight]);
+      float weights[2] = { w / 100.0f, (100 - w) / 100.0f };
+      uint32_t edgeFlag = uint8_t(src[InEdgeFlag]);
+      memcpy(dst + OutBoneIndices, boneIndices, sizeof(boneIndices));
+      memcpy(dst + OutBoneWeights, weights, sizeof(weights));
+      memcpy(dst + OutEdgeFlag, &edgeFlag, sizeof(edgeFlag));
+    }
+
+    void decodeVerticesScalar(const char* src, uint32_t count, char* dst)
+    {
+      for (uint32_t i = 0; i < count; ++i, src += InStride, dst += OutStride)
+      {
+        uint32_t bits[8];
+        memcpy(bits, src + InFloats, sizeof(bits));
+        bits[2] ^= FlipZ;
+        bits[5] ^= FlipZ;
+        memcpy(dst + OutFloats, bits, sizeof(bits));
+        decodeVertexTail(src, dst);
+      }
+    }
+
+    // Op`Ƃ 2,3 Ԗڂւ 32bit ֊g.
+    void decodeIndicesScalar(const char* src, uint32_t count, uint32_t* dst)
+    {
+      uint32_t i = 0;
+#ifndef USE_LEFTHAND
+      for (; i + 3 <= count; i += 3)
+      {
+        uint16_t tri[3];
+        memcpy(tri, src + i * sizeof(uint16_t), sizeof(tri));
+        dst[i + 0] = tri[0];
+        dst[i + 1] = tri[2];
+        dst[i + 2] = tri[1];
+      }
+#endif
+      for (; i < count; ++i)
+      {
+        uint16_t v;
+        memcpy(&v, src + i * sizeof(uint16_t), sizeof(v));
+        dst[i] = v;
+      }
+    }
+
+#if defined(PMD_DECODE_X86)
+    void decodeVerticesSSE2(const char* src, uint32_t count, char* dst)
+    {
+      // _ 8  (position, normal, uv)  2 WX^ŏ.
+      const __m128i flip0 = _mm_set_epi32(0, int(FlipZ), 0, 0);
+      const __m128i flip1 = _mm_set_epi32(0, 0, int(FlipZ), 0);
+      for (uint32_t i = 0; i < count; ++i, src += InStride, dst += OutStride)
+      {
+        auto v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        auto v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_xor_si128(v0, flip0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_xor_si128(v1, flip1));
+        decodeVertexTail(src, dst);
+      }
+    }
+
+    void decodeIndicesSSE2(const char* src, uint32_t count, uint32_t* dst)
+    {
+      uint32_t i = 0;
+#ifndef USE_LEFTHAND
+      // 4 Op` (12 CfbNX) .
+      const __m128i zero = _mm_setzero_si128();
+      for (; i + 12 <= count; i += 12)
+      {
+        auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        auto hi = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + (i + 8) * 2));
+        auto a = _mm_castsi128_ps(_mm_unpacklo_epi16(lo, zero)); // t0a t0b t0c t1a
+        auto b = _mm_castsi128_ps(_mm_unpackhi_epi16(lo, zero)); // t1b t1c t2a t2b
+        auto c = _mm_castsi128_ps(_mm_unpacklo_epi16(hi, zero)); // t2c t3a t3b t3c
+
+        auto out0 = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 2, 0));
+        auto t1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 0, 2, 2));
+        auto out1 = _mm_shuffle_ps(b, t1, _MM_SHUFFLE(2, 0, 0, 1));
+        auto t2 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 3, 3));
+        auto out2 = _mm_shuffle_ps(t2, c, _MM_SHUFFLE(2, 3, 2, 0));
+
+        _mm_storeu_ps(reinterpret_cast<float*>(dst + i), out0);
+        _mm_storeu_ps(reinterpret_cast<float*>(dst + i + 4), out1);
+        _mm_storeu_ps(reinterpret_cast<float*>(dst + i + 8), out2);
+      }
+#else
+      const __m128i zero = _mm_setzero_si128();
+      for (; i + 8 <= count; i += 8)
+      {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(v, zero));
+      }
+#endif
+      decodeIndicesScalar(src + i * 2, count - i, dst + i);
+    }
+
+    PMD_TARGET_AVX2 void decodeVerticesAVX2(const char* src, uint32_t count, char* dst)
+    {
+      const __m256i flip = _mm256_set_epi32(0, 0, int(FlipZ), 0, 0, int(FlipZ), 0, 0);
+      for (uint32_t i = 0; i < count; ++i, src += InStride, dst += OutStride)
+      {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_xor_si256(v, flip));
+        decodeVertexTail(src, dst);
+      }
+    }
+
+    PMD_TARGET_AVX2 void decodeIndicesAVX2(const char* src, uint32_t count, uint32_t* dst)
+    {
+      uint32_t i = 0;
+#ifndef USE_LEFTHAND
+      // 8 Op` (24 CfbNX) .
+      const __m256i perm0a = _mm256_setr_epi32(0, 2, 1, 3, 5, 4, 6, 0);
+      const __m256i perm0b = _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 0, 0);
+      const __m256i perm1a = _mm256_setr_epi32(7, 7, 7, 7, 7, 7, 7, 7);
+      const __m256i perm1b = _mm256_setr_epi32(0, 1, 3, 2, 4, 6, 5, 7);
+      const __m256i perm2 = _mm256_setr_epi32(1, 0, 2, 4, 3, 5, 7, 6);
+      for (; i + 24 <= count; i += 24)
+      {
+        auto a = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2)));
+        auto b = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i + 8) * 2)));
+        auto c = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i + 16) * 2)));
+
+        auto out0 = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(a, perm0a), _mm256_permutevar8x32_epi32(b, perm0b), 0x80);
+        auto out1 = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(b, perm1b), _mm256_permutevar8x32_epi32(a, perm1a), 0x01);
+        auto out2 = _mm256_permutevar8x32_epi32(c, perm2);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), out0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), out1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 16), out2);
+      }
+#else
+      for (; i + 8 <= count; i += 8)
+      {
+        auto v = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+      }
+#endif
+      decodeIndicesSSE2(src + i * 2, count - i, dst + i);
+    }
+
+    bool isAVX2Supported()
+    {
+#if defined(_MSC_VER)
+      int info[4];
+      __cpuid(info, 0);
+      if (info[0] < 7)
+      {
+        return false;
+      }
+      __cpuid(info, 1);
+      bool osxsave = (info[2] & (1 << 27)) != 0;
+      bool avx = (info[2] & (1 << 28)) != 0;
+      if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+      {
+        return false;
+      }
+      __cpuidex(info, 7, 0);
+      return (info[1] & (1 << 5)) != 0;
+#else
+      return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    // src ͓ǂݍ݌̃ubN(ACgs), dst  loader::PMDVertex ̔z.
+    void decodeVertices(const char* src, uint32_t count, void* dst)
+    {
+      auto out = static_cast<char*>(dst);
+#if defined(PMD_DECODE_X86)
+      static const bool useAVX2 = isAVX2Supported();
+      if (useAVX2)
+      {
+        decodeVerticesAVX2(src, count, out);
+        return;
+      }
+      decodeVerticesSSE2(src, count, out);
+#else
+      decodeVerticesScalar(src, count, out);
+#endif
+    }
+
+    // src  16bit CfbNX̃ubN(ACgs).
+    void decodeIndices(const char* src, uint32_t count, uint32_t* dst)
+    {
+#if defined(PMD_DECODE_X86)
+      static const bool useAVX2 = isAVX2Supported();
+      if (useAVX2)
+      {
+        decodeIndicesAVX2(src, count, dst);
+        return;
+      }
+      decodeIndicesSSE2(src, count, dst);
+#else
+      decodeIndicesScalar(src, count, dst);
+#endif
+    }
+  }
+}
 
 namespace loader
 {
@@ -116,303 +488,423 @@ namespace loader
   }
 
 
-  void PMDVertex::load(std::istream& is)
+  void PMDMaterial::load(rawblock::BlockReader& reader)
   {
-    m_position = rawblock::flipToRH(rawblock::readFloat3(is));
-    m_normal = rawblock::flipToRH(rawblock::readFloat3(is));
-    m_uv = rawblock::readFloat2(is);
-    m_boneNum[0] = rawblock::readUint16(is);
-    m_boneNum[1] = rawblock::readUint16(is);
-    m_boneWeight = rawblock::readUint8(is);
-    m_edgeFlag = rawblock::readUint8(is);
+    rawblock::PMDMaterial src;
+    auto record = reader.readRecord(src);
+    m_diffuse = src.diffuse;
+    m_alpha = src.alpha;
+    m_shininess = src.shininess;
+    m_specular = src.specular;
+    m_ambient = src.ambient;
+    m_toonID = src.toonID;
+    m_edgeFlag = src.edgeFlag;
+    m_numberOfPolygons = src.numberOfPolygons;
+    m_textureFile = rawblock::toName(record + offsetof(rawblock::PMDMaterial, textureFile), sizeof(src.textureFile));
   }
-  void PMDMaterial::load(std::istream& is)
+  void PMDBone::load(rawblock::BlockReader& reader)
   {
-    m_diffuse = rawblock::readFloat3(is);
-    m_alpha = rawblock::readFloat(is);
-    m_shininess = rawblock::readFloat(is);
-    m_specular = rawblock::readFloat3(is);
-    m_ambient = rawblock::readFloat3(is);
-    m_toonID = rawblock::readUint8(is);
-    m_edgeFlag = rawblock::readUint8(is);
-    m_numberOfPolygons = rawblock::readUint32(is);
-
-    char buf[20];
-    is.read(buf, sizeof(buf));
-    m_textureFile = buf;
+    rawblock::PMDBone src;
+    auto record = reader.readRecord(src);
+    m_name = rawblock::toName(record + offsetof(rawblock::PMDBone, name), sizeof(src.name));
+    m_parent = src.parentBoneID;
+    m_child = src.childBoneID;
+    m_type = src.type;
+    m_targetBone = src.targetBoneID;
+    m_position = rawblock::flipToRH(src.position);
   }
-  void PMDBone::load(std::istream& is)
+  void PMDIk::load(rawblock::BlockReader& reader)
   {
-    char buf[20];
-    is.read(buf, sizeof(buf));
-    m_name = buf;
-    m_parent = rawblock::readUint16(is);
-    m_child = rawblock::readUint16(is);
-    m_type = rawblock::readUint8(is);
-    m_targetBone = rawblock::readUint16(is);
-    m_position = rawblock::flipToRH(rawblock::readFloat3(is));
+    auto src = reader.read<rawblock::PMDIk>();
+    m_boneIndex = src.destBoneID;
+    m_boneTarget = src.targetBoneID;
+    m_numChains = src.numChains;
+    m_numIterations = src.numIterations;
+    m_angleLimit = src.angleLimit * glm::pi<float>();
+
+    m_ikBones.resize(m_numChains);
+    reader.readArray(m_ikBones.data(), m_numChains);
   }
-  void PMDIk::load(std::istream& is)
+  void PMDFace::load(rawblock::BlockReader& reader)
   {
-    m_boneIndex = rawblock::readUint16(is);
-    m_boneTarget = rawblock::readUint16(is);
-    m_numChains = rawblock::readUint8(is);
-    m_numIterations = rawblock::readUint16(is);
-    m_angleLimit = rawblock::readFloat(is);
-    m_angleLimit *= glm::pi<float>();
-
-    m_ikBones.reserve(m_numChains);
-    for (uint32_t i = 0; i < m_numChains; ++i)
-    {
-      m_ikBones.emplace_back(rawblock::readUint16(is));
-    }
-  }
-  void PMDFace::load(std::istream& is)
-  {
-    char buf[20];
-    is.read(buf, sizeof(buf));
-    m_name = buf;
-    m_numVertices = rawblock::readUint32(is);
-    m_faceType = FaceType(rawblock::readUint8(is));
+    rawblock::PMDFaceHeader src;
+    auto record = reader.readRecord(src);
+    m_name = rawblock::toName(record + offsetof(rawblock::PMDFaceHeader, name), sizeof(src.name));
+    m_numVertices = src.numVertices;
+    m_faceType = FaceType(src.faceType);
 
-    m_faceVertices.reserve(m_numVertices);
-    m_faceIndices.reserve(m_numVertices);
+    m_faceVertices.resize(m_numVertices);
+    m_faceIndices.resize(m_numVertices);
 
+    auto block = reader.take(m_numVertices * sizeof(rawblock::PMDFaceVertex));
     for (uint32_t i = 0; i < m_numVertices; ++i)
     {
-      m_faceIndices.emplace_back(rawblock::readUint32(is));
-      m_faceVertices.emplace_back(rawblock::flipToRH(rawblock::readFloat3(is)));
+      rawblock::PMDFaceVertex v;
+      memcpy(&v, block + i * sizeof(v), sizeof(v));
+      m_faceIndices[i] = v.index;
+      m_faceVertices[i] = rawblock::flipToRH(v.position);
     }
   }
-  void PMDRigidParam::load(std::istream& is)
+  void PMDRigidParam::load(rawblock::BlockReader& reader)
   {
-    char buf[20];
-    is.read(buf, sizeof(buf));
-    m_name = buf;
-
-    m_boneId = rawblock::readUint16(is);
-    m_groupId = rawblock::readUint8(is);
-    m_groupMask = rawblock::readUint16(is);
-    m_shapeType = ShapeType(rawblock::readUint8(is));
-    m_shapeW = rawblock::readFloat(is);
-    m_shapeH = rawblock::readFloat(is);
-    m_shapeD = rawblock::readFloat(is);
-    m_position = rawblock::readFloat3(is);
-    m_rotation = rawblock::readFloat3(is);
-    m_weight = rawblock::readFloat(is);
-    m_attenuationPos = rawblock::readFloat(is);
-    m_attenuationRot = rawblock::readFloat(is);
-    m_recoil = rawblock::readFloat(is);
-    m_friction = rawblock::readFloat(is);
-    m_bodyType = RigidBodyType(rawblock::readUint8(is));
+    rawblock::PMDRigidBody src;
+    auto record = reader.readRecord(src);
+    m_name = rawblock::toName(record + offsetof(rawblock::PMDRigidBody, name), sizeof(src.name));
+
+    m_boneId = src.boneId;
+    m_groupId = src.groupId;
+    m_groupMask = src.groupMask;
+    m_shapeType = ShapeType(src.shapeType);
+    m_shapeW = src.shapeW;
+    m_shapeH = src.shapeH;
+    m_shapeD = src.shapeD;
+    m_position = rawblock::flipToRH(src.position);
+    m_rotation = rawblock::flipRotationToRH(src.rotation);
+    m_weight = src.weight;
+    m_attenuationPos = src.attenuationPos;
+    m_attenuationRot = src.attenuationRot;
+    m_recoil = src.recoil;
+    m_friction = src.friction;
+    m_bodyType = RigidBodyType(src.bodyType);
   }
 
-  void PMDJointParam::load(std::istream& is)
+  void PMDJointParam::load(rawblock::BlockReader& reader)
   {
-    char buf[20];
-    is.read(buf, sizeof(buf));
-    m_name = buf;
+    rawblock::PMDJoint src;
+    auto record = reader.readRecord(src);
+    m_name = rawblock::toName(record + offsetof(rawblock::PMDJoint, name), sizeof(src.name));
 
-    for (auto& v : m_targetRigidBodies)
-    {
-      v = rawblock::readUint32(is);
-    }
-    m_position = rawblock::readFloat3(is);
-    m_rotation = rawblock::readFloat3(is);
-    for (auto& v : m_constraintPos)
+    for (int i = 0; i < 2; ++i)
     {
-      v = rawblock::readFloat3(is);
+      m_targetRigidBodies[i] = src.targetRigidBodies[i];
+      m_constraintPos[i] = src.constraintPos[i];
+      m_constraintRot[i] = src.constraintRot[i];
     }
-    for (auto& v : m_constraintRot)
+    m_position = rawblock::flipToRH(src.position);
+    m_rotation = rawblock::flipRotationToRH(src.rotation);
+    rawblock::flipRangeToRH(m_constraintPos[0], m_constraintPos[1], vec3(1.0f, 1.0f, -1.0f));
+    rawblock::flipRangeToRH(m_constraintRot[0], m_constraintRot[1], vec3(-1.0f, -1.0f, 1.0f));
+    m_springPos = src.springPos;
+    m_springRot = src.springRot;
+  }
+
+  PMDFile::PMDFile(std::istream& is)
+  {
+    // Xg[̎cꊇœǂݍ, ŉ͂.
+    auto begin = is.tellg();
+    if (begin == std::streampos(-1))
     {
-      v = rawblock::readFloat3(is);
+      throw std::runtime_error("PMDFile: invalid stream.");
     }
-    m_springPos = rawblock::readFloat3(is);
-    m_springRot = rawblock::readFloat3(is);
+    is.seekg(0, std::ios::end);
+    auto size = size_t(is.tellg() - begin);
+    is.seekg(begin);
+
+    auto buffer = std::make_shared<std::vector<char>>(size);
+    is.read(buffer->data(), size);
+    m_storage = buffer;
+    parse(buffer->data(), size_t(is.gcount()));
   }
 
-  PMDFile::PMDFile(std::istream& is)
+  PMDFile::PMDFile(std::shared_ptr<const MappedFile> file)
   {
-    rawblock::PMDHeader header;
-    is.read(reinterpret_cast<char*>(&header), sizeof(header));
+    m_storage = file;
+    parse(file->data(), file->size());
+  }
+
+  void PMDFile::parse(const char* data, size_t size)
+  {
+    rawblock::BlockReader reader(data, size);
 
+    rawblock::PMDHeader header;
+    auto record = reader.readRecord(header);
     m_version = header.version;
-    m_name = header.name;
-    m_comment = header.comment;
+    m_name = rawblock::toName(record + offsetof(rawblock::PMDHeader, name), sizeof(header.name));
+    m_comment = rawblock::toName(record + offsetof(rawblock::PMDHeader, comment), sizeof(header.comment));
 
-    auto vertexCount = rawblock::readUint32(is);
+    // _ƃCfbNX̓ubNPʂŕ`p̌`ֈꊇϊ.
+    static_assert(sizeof(PMDVertex) == decode::OutStride, "PMDVertex layout mismatch.");
+    static_assert(sizeof(rawblock::PMDVertex) == decode::InStride, "rawblock::PMDVertex layout mismatch.");
+    auto vertexCount = reader.read<uint32_t>();
     m_vertices.resize(vertexCount);
-    std::for_each(m_vertices.begin(), m_vertices.end(), [&](auto & v) { v.load(is); });
+    decode::decodeVertices(reader.take(vertexCount * sizeof(rawblock::PMDVertex)), vertexCount, m_vertices.data());
 
-    auto indexCount = rawblock::readUint32(is);
-    m_indices.reserve(indexCount);
-    auto polygonCount = indexCount / 3;
-    for (uint32_t i = 0; i < polygonCount; ++i)
-    {
-      auto idx0 = rawblock::readUint16(is);
-#ifndef USE_LEFTHAND
-      auto idx2 = rawblock::readUint16(is);
-      auto idx1 = rawblock::readUint16(is);
-#else
-      auto idx1 = rawblock::readUint16(is);
-      auto idx2 = rawblock::readUint16(is);
-#endif
-      m_indices.push_back(idx0);
-      m_indices.push_back(idx1);
-      m_indices.push_back(idx2);
-    }
+    auto indexCount = reader.read<uint32_t>();
+    m_indices.resize(indexCount);
+    decode::decodeIndices(reader.take(indexCount * sizeof(uint16_t)), indexCount, m_indices.data());
 
-    auto materialCount = rawblock::readUint32(is);
+    auto materialCount = reader.read<uint32_t>();
     m_materials.resize(materialCount);
-    std::for_each(m_materials.begin(), m_materials.end(), [&](auto & v) { v.load(is); });
+    std::for_each(m_materials.begin(), m_materials.end(), [&](auto & v) { v.load(reader); });
 
-    auto boneCount = rawblock::readUint16(is);
+    auto boneCount = reader.read<uint16_t>();
     m_bones.resize(boneCount);
-    std::for_each(m_bones.begin(), m_bones.end(), [&](auto & v) { v.load(is); });
+    std::for_each(m_bones.begin(), m_bones.end(), [&](auto & v) { v.load(reader); });
 
-    auto ikListCount = rawblock::readUint16(is);
+    auto ikListCount = reader.read<uint16_t>();
     m_iks.resize(ikListCount);
-    std::for_each(m_iks.begin(), m_iks.end(), [&](auto & v) {v.load(is); });
+    std::for_each(m_iks.begin(), m_iks.end(), [&](auto & v) {v.load(reader); });
 
-    auto faceCount = rawblock::readUint16(is);
+    auto faceCount = reader.read<uint16_t>();
     m_faces.resize(faceCount);
-    std::for_each(m_faces.begin(), m_faces.end(), [&](auto & v) {v.load(is); });
+    std::for_each(m_faces.begin(), m_faces.end(), [&](auto & v) {v.load(reader); });
 
     // \g. Skip
-    auto faceDispCount = rawblock::readUint8(is);
-    auto faceDispBlockBytes = faceDispCount * sizeof(uint16_t);
-    is.seekg(faceDispBlockBytes, std::ios::cur);
+    auto faceDispCount = reader.read<uint8_t>();
+    reader.skip(faceDispCount * sizeof(uint16_t));
 
     // {[gO. Skip
-    auto boneDispNameCount = rawblock::readUint8(is);
-    auto boneDispNameBlockBytes = boneDispNameCount * sizeof(char[50]);
-    is.seekg(boneDispNameBlockBytes, std::ios::cur);
+    auto boneDispNameCount = reader.read<uint8_t>();
+    reader.skip(boneDispNameCount * sizeof(char[50]));
 
     // {[g. Skip
-    auto boneDispCount = rawblock::readUint32(is);
-    auto boneDispBlockBytes = boneDispCount * sizeof(char[3]);
-    is.seekg(boneDispBlockBytes, std::ios::cur);
+    auto boneDispCount = reader.read<uint32_t>();
+    reader.skip(boneDispCount * sizeof(char[3]));
+
+    // ȍ~͊ĝ, ܂܂ĂȂt@C.
+    if (reader.isEnd())
+    {
+      return;
+    }
 
     // pꖼwb_. Skip
-    auto engNameCount = rawblock::readUint8(is);
-    auto engNameBlockBytes = engNameCount * sizeof(char[20 + 256]);
-    is.seekg(engNameBlockBytes, std::ios::cur);
+    auto engNameCount = reader.read<uint8_t>();
+    reader.skip(engNameCount * sizeof(char[20 + 256]));
 
     // pꖼ{[. Skip
-    auto engBoneBlockBytes = m_bones.size() * sizeof(char[20]);
-    is.seekg(engBoneBlockBytes, std::ios::cur);
+    reader.skip(m_bones.size() * sizeof(char[20]));
 
     // pꖼ\Xg. Skip
-    auto engFaceBlockBytes = (m_faces.size() - 1) * sizeof(char[20]);
-    is.seekg(engFaceBlockBytes, std::ios::cur);
+    reader.skip((m_faces.empty() ? 0 : m_faces.size() - 1) * sizeof(char[20]));
 
     // pꖼ{[g. Skip
-    auto engBoneDispBlockBytes = boneDispNameCount * sizeof(char[50]);
-    is.seekg(engBoneDispBlockBytes, std::ios::cur);
+    reader.skip(boneDispNameCount * sizeof(char[50]));
 
     // gD[eNX`Xg.
     m_toonTextures.resize(10);
     for (int i = 0; i < 10; ++i)
     {
-      char fileName[100];
-      is.read(fileName, sizeof(fileName));
-      m_toonTextures[i] = fileName;
+      m_toonTextures[i] = rawblock::toName(reader.take(100), 100);
+    }
+    if (reader.isEnd())
+    {
+      return;
     }
 
     // ZE.
-    auto rigidBodyCount = rawblock::readUint32(is);
+    auto rigidBodyCount = reader.read<uint32_t>();
     m_rigidBodies.resize(rigidBodyCount);
-    std::for_each(m_rigidBodies.begin(), m_rigidBodies.end(), [&](auto & v) { v.load(is); });
+    std::for_each(m_rigidBodies.begin(), m_rigidBodies.end(), [&](auto & v) { v.load(reader); });
 
     // ZEWCg.
-    auto jointCount = rawblock::readUint32(is);
+    auto jointCount = reader.read<uint32_t>();
     m_joints.resize(jointCount);
-    std::for_each(m_joints.begin(), m_joints.end(), [&](auto & v) { v.load(is); });
+    std::for_each(m_joints.begin(), m_joints.end(), [&](auto & v) { v.load(reader); });
   }
 
-  template<class T>
-  bool KeyframeComparer(const T& a, const T& b)
+  namespace
   {
-    return a.getKeyframeNumber() < b.getKeyframeNumber();
+    // xɓǂݍރR[h.
+    const uint32_t ChunkRecordCount = 4096;
+
+    // L[t[̃ZNV`NPʂ 2 񑖍, gbNƂ̘Ä֐U蕪.
+    // 1 ڂŖO̓o^ƌ̏Wv, 2 ڂōŏIIȊi[֒ڏ.
+    // Ɨ̈̓`N 1 ƃgbN݂̂, t@CɈˑȂ.
+    template<class Record>
+    class TrackReader
+    {
+    public:
+      TrackReader(std::istream& is, std::streamoff fileEnd,
+        std::vector<std::string>& names, std::unordered_map<std::string, uint32_t>& indexMap, std::vector<uint32_t>& offsets)
+        : m_is(is), m_count(0), m_chunk(ChunkRecordCount), m_indexMap(indexMap)
+      {
+        m_count = rawblock::readUint32(is);
+        m_start = is.tellg();
+        if (!is || uint64_t(m_count) * sizeof(Record) > uint64_t(fileEnd - std::streamoff(m_start)))
+        {
+          throw std::runtime_error("VMDFile: unexpected end of data.");
+        }
+
+        std::vector<uint32_t> counts;
+        std::vector<uint32_t> lastFrames;
+        forEachRecord([&](const Record& src) {
+          auto name = rawblock::toName(src.name, sizeof(src.name));
+          // O 15 byte ȉ̂߈ꎞ̊mۂ͔Ȃ.
+          auto it = indexMap.try_emplace(std::string(name), uint32_t(names.size()));
+          auto track = it.first->second;
+          if (it.second)
+          {
+            names.emplace_back(name);
+            counts.push_back(0);
+            lastFrames.push_back(0);
+          }
+          // oς݂̃[V͑ɕł̂, ёւKvȃgbNoĂ.
+          if (counts[track] > 0 && src.frame < lastFrames[track] &&
+            (m_unsortedTracks.empty() || m_unsortedTracks.back() != track))
+          {
+            m_unsortedTracks.push_back(track);
+          }
+          counts[track]++;
+          lastFrames[track] = src.frame;
+        });
+        std::sort(m_unsortedTracks.begin(), m_unsortedTracks.end());
+        m_unsortedTracks.erase(std::unique(m_unsortedTracks.begin(), m_unsortedTracks.end()), m_unsortedTracks.end());
+
+        auto trackCount = uint32_t(names.size());
+        offsets.resize(trackCount + 1);
+        offsets[0] = 0;
+        for (uint32_t i = 0; i < trackCount; ++i)
+        {
+          offsets[i + 1] = offsets[i] + counts[i];
+        }
+        m_cursor.assign(offsets.begin(), offsets.end() - 1);
+      }
+
+      uint32_t getKeyCount() const { return m_count; }
+      const std::vector<uint32_t>& getUnsortedTracks() const { return m_unsortedTracks; }
+
+      // func(i[, R[h) t@C̏ɌĂяo.
+      template<class Func>
+      void scatter(Func func)
+      {
+        forEachRecord([&](const Record& src) {
+          auto name = rawblock::toName(src.name, sizeof(src.name));
+          auto track = m_indexMap.find(std::string(name))->second;
+          func(m_cursor[track]++, src);
+        });
+      }
+    private:
+      template<class Func>
+      void forEachRecord(Func func)
+      {
+        m_is.clear();
+        m_is.seekg(m_start);
+        for (uint32_t done = 0; done < m_count; )
+        {
+          auto n = std::min(m_count - done, ChunkRecordCount);
+          m_is.read(reinterpret_cast<char*>(m_chunk.data()), n * sizeof(Record));
+          if (!m_is)
+          {
+            throw std::runtime_error("VMDFile: unexpected end of data.");
+          }
+          std::for_each(m_chunk.begin(), m_chunk.begin() + n, func);
+          done += n;
+        }
+      }
+
+      std::istream& m_is;
+      std::streampos m_start;
+      uint32_t m_count;
+      std::vector<Record> m_chunk;
+      std::unordered_map<std::string, uint32_t>& m_indexMap;
+      std::vector<uint32_t> m_cursor;
+      std::vector<uint32_t> m_unsortedTracks;
+    };
+
+    // gbN̗ order ̏ɕבւ.
+    template<class T>
+    void reorderTrack(std::vector<T>& column, uint32_t offset, const std::vector<uint32_t>& order)
+    {
+      std::vector<T> work(column.begin() + offset, column.begin() + offset + order.size());
+      for (size_t i = 0; i < order.size(); ++i)
+      {
+        column[offset + i] = work[order[i]];
+      }
+    }
+
+    // gbN̎̕т߂. ̓t@C̏ۂ.
+    std::vector<uint32_t> sortTrackOrder(const std::vector<uint32_t>& frames, uint32_t offset, uint32_t count)
+    {
+      std::vector<uint32_t> order(count);
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        order[i] = i;
+      }
+      std::stable_sort(order.begin(), order.end(),
+        [&](uint32_t a, uint32_t b) { return frames[offset + a] < frames[offset + b]; });
+      return order;
+    }
   }
 
-  VMDFile::VMDFile(std::istream& is)
+  VMDFile::VMDFile(std::istream& is) : m_keyframeCount(0)
   {
-    std::vector<VMDNode> nodes;
+    // `NPʂœǂݒ, ʒu߂Xg[Kv.
+    auto headerPos = is.tellg();
+    if (headerPos == std::streampos(-1))
+    {
+      throw std::runtime_error("VMDFile: stream must be seekable.");
+    }
+    is.seekg(0, std::ios::end);
+    auto fileEnd = std::streamoff(is.tellg());
+    is.seekg(headerPos);
 
     rawblock::VMDHeader header{};
     is.read(reinterpret_cast<char*>(header.magic), sizeof(header.magic));
     is.read(header.modelName, sizeof(header.modelName));
 
-    uint32_t dataNum = rawblock::readUint32(is);
-    nodes.resize(dataNum);
-    std::for_each(nodes.begin(), nodes.end(), [&](auto & v) { v.load(is); });
-
-    std::for_each(nodes.begin(), nodes.end(), [&](auto & v) {
-      auto& nodeKeyframes = m_animationMap[v.getName()];
-      nodeKeyframes.push_back(v);
-      });
-    std::for_each(m_animationMap.begin(), m_animationMap.end(), [&](auto & v) {
-      std::sort(v.second.begin(), v.second.end(), KeyframeComparer<VMDNode>);
-      });
-    m_keyframeCount = 0;
-    for (const auto& v : m_animationMap)
+    // {[L[t[.
     {
-      auto itr = v.second.rbegin();
+      TrackReader<rawblock::VMDMotion> reader(is, fileEnd, m_nodeNameList, m_nodeIndexMap, m_nodeOffsets);
+
+      auto keyCount = reader.getKeyCount();
+      m_nodeFrames.resize(keyCount);
+      m_nodeLocations.resize(keyCount);
+      m_nodeRotations.resize(keyCount);
+      m_nodeInterpolations.resize(keyCount);
+      reader.scatter([&](uint32_t i, const rawblock::VMDMotion& src) {
+        auto rotParam = rawblock::flipToRH(src.rotation);
+        m_nodeFrames[i] = src.frame;
+        m_nodeLocations[i] = rawblock::flipToRH(src.location);
+        m_nodeRotations[i] = glm::quat(rotParam.w, rotParam.x, rotParam.y, rotParam.z);
+        memcpy(m_nodeInterpolations[i].m_params, src.interpolation, sizeof(VMDInterpolation::m_params));
+        m_keyframeCount = std::max(m_keyframeCount, src.frame);
+      });
 
-      m_keyframeCount = std::max(m_keyframeCount, itr->getKeyframeNumber());
+      for (auto track : reader.getUnsortedTracks())
+      {
+        auto offset = m_nodeOffsets[track];
+        auto order = sortTrackOrder(m_nodeFrames, offset, m_nodeOffsets[track + 1] - offset);
+        reorderTrack(m_nodeFrames, offset, order);
+        reorderTrack(m_nodeLocations, offset, order);
+        reorderTrack(m_nodeRotations, offset, order);
+        reorderTrack(m_nodeInterpolations, offset, order);
+      }
     }
-    for (auto& v : m_animationMap)
+
+    // [tL[t[. Â`ł̓ZNV̂.
+    if (is.peek() == std::char_traits<char>::eof())
     {
-      m_nodeNameList.push_back(v.first);
+      m_morphOffsets.push_back(0);
+      return;
     }
+    {
+      TrackReader<rawblock::VMDMorph> reader(is, fileEnd, m_morphNameList, m_morphIndexMap, m_morphOffsets);
+
+      auto keyCount = reader.getKeyCount();
+      m_morphFrames.resize(keyCount);
+      m_morphWeights.resize(keyCount);
+      reader.scatter([&](uint32_t i, const rawblock::VMDMorph& src) {
+        m_morphFrames[i] = src.frame;
+        m_morphWeights[i] = src.weight;
+      });
 
-    dataNum = rawblock::readUint32(is);
-    std::vector<VMDMorph> morphs;
-    morphs.resize(dataNum);
-    std::for_each(morphs.begin(), morphs.end(), [&](auto& v) { v.load(is); });
-    std::for_each(morphs.begin(), morphs.end(), [&](auto& v) {
-      auto& morphKeyframes = m_morphMap[v.getName()];
-      morphKeyframes.push_back(v);
-    });
-    std::for_each(m_morphMap.begin(), m_morphMap.end(), [&](auto& v) {
-        std::sort(v.second.begin(), v.second.end(), KeyframeComparer<VMDMorph>);
+      for (auto track : reader.getUnsortedTracks())
+      {
+        auto offset = m_morphOffsets[track];
+        auto order = sortTrackOrder(m_morphFrames, offset, m_morphOffsets[track + 1] - offset);
+        reorderTrack(m_morphFrames, offset, order);
+        reorderTrack(m_morphWeights, offset, order);
       }
-    );
-    for (auto& v : m_morphMap)
-    {
-      m_morphNameList.push_back(v.first);
     }
   }
 
-  void VMDNode::load(std::istream& is)
-  {
-    char nameBuf[15];
-    is.read(nameBuf, sizeof(nameBuf));
-    m_name = nameBuf;
-    m_keyframe = rawblock::readUint32(is);
-    m_location = rawblock::flipToRH(rawblock::readFloat3(is));
-    auto rotParam = rawblock::flipToRH(rawblock::readFloat4(is));
-    m_rotation = glm::quat(rotParam.w, rotParam.x, rotParam.y, rotParam.z);
-    is.read(reinterpret_cast<char*>(m_interpolation), sizeof(m_interpolation));
-  }
-
-  vec4 VMDNode::getBezierParam(int idx) const
+  vec4 VMDInterpolation::getBezierParam(int idx) const
   {
     vec4 ret;
     for (int i = 0; i < 4; ++i)
     {
-      ret[i] = float(m_interpolation[4 * i + idx]) / 127.0f;
+      ret[i] = float(m_params[4 * i + idx]) / 127.0f;
     }
     return ret;
   }
-
-  void VMDMorph::load(std::istream& is)
-  {
-    char nameBuf[15];
-    is.read(nameBuf, sizeof(nameBuf));
-    m_name = nameBuf;
-    m_keyframe = rawblock::readUint32(is);
-    m_weight = rawblock::readFloat(is);
-  }
 }
@@ -2,6 +2,8 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <memory>
 #include <array>
 #include <map>
 #include <unordered_map>
@@ -10,11 +12,17 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include "MappedFile.h"
 
 namespace loader
 {
     using namespace glm;
 
+    namespace rawblock
+    {
+        class BlockReader;
+    }
+
     class PMDVertex
     {
     public:
@@ -23,19 +31,20 @@ namespace loader
         vec3 getPosition() const { return m_position; }
         vec3 getNormal() const { return m_normal; }
         vec2 getUV() const { return m_uv; }
-        uint16_t getBoneIndex(int idx) const { return m_boneNum[idx]; }
-        float    getBoneWeight(int idx) const { return (idx == 0 ? m_boneWeight : (100 - m_boneWeight)) / 100.0f; }
-        uint8_t  getEdgeFlag() const { return m_edgeFlag; }
+        uint16_t getBoneIndex(int idx) const { return uint16_t(m_boneNum[idx]); }
+        float    getBoneWeight(int idx) const { return m_boneWeight[idx]; }
+        uint8_t  getEdgeFlag() const { return uint8_t(m_edgeFlag); }
     private:
-        void load(std::istream& is);
         friend class PMDFile;
 
+        // 描画用の頂点レイアウトと同じ並びで展開済みの値を保持する(52 bytes).
+        // 読み込み時にまとめて変換するので, 配列をそのまま頂点バッファへ転送できる.
         vec3    m_position;
         vec3    m_normal;
         vec2    m_uv;
-        std::array<uint16_t,2> m_boneNum;
-        uint8_t     m_boneWeight;
-        uint8_t     m_edgeFlag;
+        uvec2   m_boneNum;
+        vec2    m_boneWeight;
+        uint32_t m_edgeFlag;
     };
 
     class PMDMaterial
@@ -49,10 +58,10 @@ namespace loader
         float   getShininess() const { return m_shininess; }
         uint32_t getNumberOfPolygons() const { return m_numberOfPolygons; }
 
-        const std::string& getTexture() const { return m_textureFile; }
+        std::string_view getTexture() const { return m_textureFile; }
         uint8_t getEdgeFlag() const { return m_edgeFlag; }
     private:
-        void load(std::istream& is);
+        void load(rawblock::BlockReader& reader);
 
         vec3 m_diffuse;
         float   m_alpha;
@@ -62,23 +71,23 @@ namespace loader
         uint8_t m_toonID;
         uint8_t m_edgeFlag;
         uint32_t m_numberOfPolygons;
-        std::string m_textureFile;
+        std::string_view m_textureFile;
 
         friend class PMDFile;
     };
     class PMDBone
     {
     public:
-        const std::string& getName() const { return m_name; }
+        std::string_view getName() const { return m_name; }
         uint16_t getParent() const { return m_parent; }
         
         uint16_t getTarget() const { return m_targetBone; }
 
         vec3 getPosition() const { return m_position; }
     private:
-        void load(std::istream& is);
+        void load(rawblock::BlockReader& reader);
 
-        std::string m_name;
+        std::string_view m_name;
         uint16_t    m_parent;
         uint16_t    m_child;
         uint8_t     m_type;
@@ -97,7 +106,7 @@ namespace loader
         uint16_t getIterations() const { return m_numIterations; }
         float    getAngleLimit() const { return m_angleLimit; }
     private:
-        void load(std::istream& is);
+        void load(rawblock::BlockReader& reader);
 
         uint16_t m_boneIndex;
         uint16_t m_boneTarget;
@@ -120,7 +129,7 @@ namespace loader
             LIP,        /**< リップ */
             OTHER,      /**< その他 */
         };
-        std::string getName() const { return m_name; }
+        std::string_view getName() const { return m_name; }
         FaceType getType() const { return m_faceType; }
         uint32_t getVertexCount() const { return uint32_t(m_faceVertices.size()); }
         uint32_t getIndexCount() const { return uint32_t(m_faceIndices.size()); }
@@ -128,9 +137,9 @@ namespace loader
         const vec3* getFaceVertices() const { return m_faceVertices.data(); }
         const uint32_t* getFaceIndices() const { return m_faceIndices.data(); }
     private:
-        void load(std::istream& is);
+        void load(rawblock::BlockReader& reader);
 
-        std::string m_name;
+        std::string_view m_name;
         uint32_t    m_numVertices;
         FaceType     m_faceType;
 
@@ -151,11 +160,26 @@ namespace loader
             RIGID_BODY_PHYSICS = 1, // 物理演算
             RIGID_BODY_PHYSICS_BONE_CORRECT = 2, // 物理演算(ボーン位置合わせ)
         };
-
+        std::string_view getName() const { return m_name; }
+        uint16_t getBoneId() const { return m_boneId; }   /**< 関連ボーンが無い場合は 0xFFFF */
+        uint8_t getGroupId() const { return m_groupId; }
+        uint16_t getGroupMask() const { return m_groupMask; } /**< 衝突するグループのビット */
+        ShapeType getShapeType() const { return m_shapeType; }
+        RigidBodyType getBodyType() const { return m_bodyType; }
+        // 球は w が半径, 箱は w, h, d が各軸の半分の長さ, カプセルは w が半径, h が高さ(Y 軸方向).
+        vec3 getShapeSize() const { return vec3(m_shapeW, m_shapeH, m_shapeD); }
+        // 関連ボーンからの相対位置と, オイラー角(ラジアン, 右手系へ変換済み).
+        vec3 getPosition() const { return m_position; }
+        vec3 getRotation() const { return m_rotation; }
+        float getMass() const { return m_weight; }
+        float getLinearDamping() const { return m_attenuationPos; }
+        float getAngularDamping() const { return m_attenuationRot; }
+        float getRestitution() const { return m_recoil; }
+        float getFriction() const { return m_friction; }
     private:
-        void load(std::istream& is);
+        void load(rawblock::BlockReader& reader);
 
-        std::string m_name;
+        std::string_view m_name;
         uint16_t    m_boneId;
         uint8_t    m_groupId;
         uint16_t    m_groupMask;
@@ -177,10 +201,23 @@ namespace loader
     };
     class PMDJointParam {
     public:
+        std::string_view getName() const { return m_name; }
+        uint32_t getRigidBodyA() const { return m_targetRigidBodies[0]; }
+        uint32_t getRigidBodyB() const { return m_targetRigidBodies[1]; }
+        // ジョイントの位置とオイラー角(モデル空間, 右手系へ変換済み).
+        vec3 getPosition() const { return m_position; }
+        vec3 getRotation() const { return m_rotation; }
+        // ジョイント空間での移動量, 回転角の範囲 [lower, upper] と, ばねの強さ.
+        vec3 getLinearLower() const { return m_constraintPos[0]; }
+        vec3 getLinearUpper() const { return m_constraintPos[1]; }
+        vec3 getAngularLower() const { return m_constraintRot[0]; }
+        vec3 getAngularUpper() const { return m_constraintRot[1]; }
+        vec3 getLinearSpring() const { return m_springPos; }
+        vec3 getAngularSpring() const { return m_springRot; }
     private:
-        void load(std::istream& is);
+        void load(rawblock::BlockReader& reader);
 
-        std::string m_name;
+        std::string_view m_name;
         std::array<uint32_t,2>  m_targetRigidBodies;
         vec3    m_position, m_rotation;
         std::array<vec3,2>  m_constraintPos;
@@ -194,9 +231,12 @@ namespace loader
     public:
         PMDFile() {} 
         PMDFile(std::istream& is);
+        // メモリマップしたファイルを直接解析する.
+        // 名前などの文字列はマップ領域を参照するため, マッピングは PMDFile と共有して保持する.
+        explicit PMDFile(std::shared_ptr<const MappedFile> file);
 
-        const std::string& getName() const { return m_name; }
-        const std::string& getComment() const { return m_comment; }
+        std::string_view getName() const { return m_name; }
+        std::string_view getComment() const { return m_comment; }
 
         uint32_t getVertexCount() const { return uint32_t(m_vertices.size()); }
         uint32_t getIndexCount() const { return uint32_t(m_indices.size()); }
@@ -210,162 +250,134 @@ namespace loader
         const PMDVertex& getVertex(int idx) const { return m_vertices[idx]; }
         const PMDVertex* getVertex() const { return m_vertices.data(); }
 
-        uint16_t getIndices(int idx) const { return m_indices[idx]; }
-        const uint16_t* getIndices() const { return m_indices.data(); }
+        // 32bit へ拡張済みのインデックス(右手系へ変換済み).
+        uint32_t getIndices(int idx) const { return m_indices[idx]; }
+        const uint32_t* getIndices() const { return m_indices.data(); }
 
         const PMDMaterial& getMaterial(int idx) const { return m_materials[idx]; }
         const PMDBone& getBone(int idx) const { return m_bones[idx]; }
         const PMDIk& getIk(int idx) const { return m_iks[idx]; }
         const PMDFace& getFace(int idx) const { return m_faces[idx]; }
+        const PMDRigidParam& getRigidBody(int idx) const { return m_rigidBodies[idx]; }
+        const PMDJointParam& getJoint(int idx) const { return m_joints[idx]; }
         const PMDFace& getFaceBase() const { auto itr = std::find_if(m_faces.begin(), m_faces.end(), [](const auto & v) { return v.getType() == PMDFace::BASE; }); return *itr; }
 
     private:
+        void parse(const char* data, size_t size);
+
+        // 文字列(string_view)の参照先となるバイト列.
+        std::shared_ptr<const void> m_storage;
+
         float m_version;
-        std::string m_name;
-        std::string m_comment;
+        std::string_view m_name;
+        std::string_view m_comment;
 
         std::vector<PMDVertex> m_vertices;
-        std::vector<uint16_t>  m_indices;
+        std::vector<uint32_t>  m_indices;
         std::vector<PMDMaterial> m_materials;
         std::vector<PMDBone> m_bones;
         std::vector<PMDIk> m_iks;
         std::vector<PMDFace> m_faces;
 
-        std::vector<std::string> m_toonTextures;
+        std::vector<std::string_view> m_toonTextures;
         std::vector<PMDRigidParam> m_rigidBodies;
         std::vector<PMDJointParam> m_joints;
     };
 
 
-    class VMDNode
+    // 連続領域への読み取り専用の参照.
+    template<class T>
+    class Span
     {
     public:
-        const std::string& getName() const { return m_name; }
-        uint32_t getKeyframeNumber() const { return m_keyframe; }
-        const vec3& getLocation() const { return m_location; }
-        const quat& getRotation() const { return m_rotation; }
-
-        vec4 getBezierParam(int idx) const;
+        Span() : m_data(nullptr), m_size(0) { }
+        Span(const T* data, size_t size) : m_data(data), m_size(size) { }
+
+        const T* data() const { return m_data; }
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        const T* begin() const { return m_data; }
+        const T* end() const { return m_data + m_size; }
+        const T& operator[](size_t idx) const { return m_data[idx]; }
+        const T& front() const { return m_data[0]; }
+        const T& back() const { return m_data[m_size - 1]; }
     private:
-        void load(std::istream& is);
-        friend class VMDFile;
-
-        uint32_t    m_keyframe;
-        vec3    m_location;
-        quat    m_rotation;
-        std::string m_name;
-
-        uint8_t m_interpolation[64];
+        const T* m_data;
+        size_t m_size;
     };
-    class VMDMorph
-    {
-    public:
-      const std::string& getName() const { return m_name; }
-      uint32_t getKeyframeNumber() const { return m_keyframe; }
 
-      float getWeight() const { return m_weight; }
-    private:
-      void load(std::istream& is);
-      friend class VMDFile;
+    // ボーンキーフレームの補間パラメータ.
+    // X, Y, Z, 回転 のベジェ制御点 (x1, y1, x2, y2) を 0..127 で保持する.
+    struct VMDInterpolation
+    {
+        uint8_t m_params[16];
 
-      std::string m_name;
-      uint32_t m_keyframe;
-      float   m_weight;
+        vec4 getBezierParam(int idx) const;
     };
 
+    // VMD モーション.
+    // ボーン名・モーフ名はトラックごとに 1 つだけ保持し, キーフレームは全トラック分を
+    // 1 本の配列に列ごと(時刻, 位置, 回転, 補間)に格納する.
+    // トラック i のキーフレームは [offsets[i], offsets[i+1]) の範囲で, 時刻順に並ぶ.
     class VMDFile
     {
     public:
-        VMDFile() = default;
+        VMDFile() : m_keyframeCount(0) { }
 
         VMDFile(std::istream& is);
 
-        using VMDNodeKeyframe = std::vector<VMDNode>;
-        using VMDAnimationNodeMap = std::map<std::string, VMDNodeKeyframe>;
-        using VMDMorphKeyframe = std::vector<VMDMorph>;
-        using VMDMorphMap = std::unordered_map <std::string, VMDMorphKeyframe>;
-
         uint32_t getNodeCount() const { return uint32_t(m_nodeNameList.size()); }
         const std::string& getNodeName(int index) const { return m_nodeNameList[index]; }
+        // 名前からトラック番号を求める. 無い場合は -1.
+        int findNode(const std::string& nodeName) const { return findTrack(m_nodeIndexMap, nodeName); }
+
+        Span<uint32_t> getNodeFrames(int index) const { return track(m_nodeFrames, m_nodeOffsets, index); }
+        Span<vec3> getNodeLocations(int index) const { return track(m_nodeLocations, m_nodeOffsets, index); }
+        Span<quat> getNodeRotations(int index) const { return track(m_nodeRotations, m_nodeOffsets, index); }
+        Span<VMDInterpolation> getNodeInterpolations(int index) const { return track(m_nodeInterpolations, m_nodeOffsets, index); }
 
         uint32_t getMorphCount() const { return uint32_t(m_morphNameList.size()); }
         const std::string& getMorphName(int index) const { return m_morphNameList[index]; }
+        int findMorph(const std::string& morphName) const { return findTrack(m_morphIndexMap, morphName); }
 
-        VMDNodeKeyframe getKeyframes(const std::string& nodeName) { return m_animationMap[nodeName]; }
-        VMDMorphKeyframe getMorphKeyframes(const std::string& morphName) { return m_morphMap[morphName]; }
+        Span<uint32_t> getMorphFrames(int index) const { return track(m_morphFrames, m_morphOffsets, index); }
+        Span<float> getMorphWeights(int index) const { return track(m_morphWeights, m_morphOffsets, index); }
 
-        bool getKeyframeSegment(const std::string& name, uint32_t frame, VMDNode& beg, VMDNode& end)
-        {
-            auto node = findNode(name);
-            if (node == nullptr)
-                return false;
-            auto seg0 = std::find_if(node->rbegin(), node->rend(), [=](const auto & v) {
-                return v.getKeyframeNumber() <= frame;
-                });
-            auto seg1 = std::find_if(node->begin(), node->end(), [=](const auto & v) {
-                return frame < v.getKeyframeNumber();
-                });
-            beg = *seg0;
-            if (seg1 == node->end())
-                end = *seg0;
-            else
-                end = *seg1;
-            return true;
-        }
+        // 全トラック合計のキーフレーム数.
+        uint32_t getNodeKeyCount() const { return uint32_t(m_nodeFrames.size()); }
+        uint32_t getMorphKeyCount() const { return uint32_t(m_morphFrames.size()); }
+
+        // ボーンキーフレームの最終フレーム番号.
+        uint32_t getKeyframeCount() const { return m_keyframeCount; }
+    private:
+        using TrackIndexMap = std::unordered_map<std::string, uint32_t>;
 
-        vec3 getTranslation(const std::string& name, uint32_t frame)
+        template<class T>
+        static Span<T> track(const std::vector<T>& column, const std::vector<uint32_t>& offsets, int index)
         {
-            vec3 trans{};
-            auto node = findNode(name);
-            if (node == nullptr)
-            {
-                return trans;
-            }
-            auto seg0 = std::find_if(node->rbegin(), node->rend(), [=](const auto & v) {
-                return v.getKeyframeNumber() <= frame;
-            });
-            auto seg1 = std::find_if(node->begin(), node->end(), [=](const auto & v) {
-                return frame < v.getKeyframeNumber();
-            });
-            if (seg1 == node->end())
-            {
-                return seg0->getLocation();
-            }
-            auto segment = float(seg1->getKeyframeNumber() - seg0->getKeyframeNumber());
-            auto t = (frame - seg0->getKeyframeNumber()) / segment;
-
-            auto t0 = seg0->getLocation();
-            auto t1 = seg1->getLocation();
-
-            trans.x = t0.x + t * (t1.x - t0.x);
-            trans.y = t0.y + t * (t1.y - t0.y);
-            trans.z = t0.z + t * (t1.z - t0.z);
-
-            return trans;
+            return Span<T>(column.data() + offsets[index], offsets[index + 1] - offsets[index]);
         }
-        vec4 getRotation(const std::string& name, uint32_t frame)
+        static int findTrack(const TrackIndexMap& indexMap, const std::string& name)
         {
-            vec4 rotation{};
-            return rotation;
+            auto it = indexMap.find(name);
+            return it != indexMap.end() ? int(it->second) : -1;
         }
 
-        uint32_t getKeyframeCount() const { return m_keyframeCount; }
-    private:
-        const VMDNodeKeyframe* findNode(const std::string& nodeName)
-        {
-            auto it = m_animationMap.find(nodeName);
-            if (it != m_animationMap.end())
-            {
-                return &(it->second);
-            }
-            return nullptr;
-        }
         uint32_t m_keyframeCount;
-        VMDAnimationNodeMap m_animationMap;
+
         std::vector<std::string> m_nodeNameList;
+        TrackIndexMap m_nodeIndexMap;
+        std::vector<uint32_t> m_nodeOffsets;
+        std::vector<uint32_t> m_nodeFrames;
+        std::vector<vec3>     m_nodeLocations;
+        std::vector<quat>     m_nodeRotations;
+        std::vector<VMDInterpolation> m_nodeInterpolations;
 
-        VMDMorphMap  m_morphMap;
         std::vector<std::string> m_morphNameList;
+        TrackIndexMap m_morphIndexMap;
+        std::vector<uint32_t> m_morphOffsets;
+        std::vector<uint32_t> m_morphFrames;
+        std::vector<float>    m_morphWeights;
     };
 
 